@@ -41,11 +41,13 @@
 #include "timekeeping.h"
 #include "buffer.h"
 #include "engine.h"
+#include "master_bus.h"
 #include "midi_event.h"
 #include "midi_process.h"
 #include "alsa_pcm.h"
 #include "settings.h"
 #include "debug.h"
+#include "trace.h"
 #include "driver.h"
 #include "settings.h"
 
@@ -374,7 +376,7 @@ alsa_pcm_set_hwparams(ALSA_PCM_INFO    *pcminfo,
 	}
 	/* set variables needed in buffer mixdown */
 	alsa_pcm_format_bits            = (unsigned int) snd_pcm_format_width(alsa_pcm_format);
-	alsa_pcm_max_sample_val         = (unsigned int)((1 << (alsa_pcm_format_bits - 1)) - 1);
+	alsa_pcm_max_sample_val         = (1U << (alsa_pcm_format_bits - 1U)) - 1U;
 	f_alsa_pcm_max_sample_val       = (sample_t) alsa_pcm_max_sample_val;
 	alsa_pcm_bytes_per_sample       = alsa_pcm_format_bits / 8;
 	alsa_pcm_phys_bytes_per_sample  = (unsigned int)(snd_pcm_format_physical_width
@@ -780,12 +782,9 @@ alsa_pcm_init(void)
 	}
 #endif
 
-	buffer_periods      = DEFAULT_BUFFER_PERIODS;
-	buffer_size         = (unsigned int)(alsa_pcm_period_size * buffer_periods);
-	buffer_size_mask    = buffer_size - 1;
-	buffer_period_size  = (unsigned int) alsa_pcm_period_size;
-	buffer_period_mask  = buffer_period_size - 1;
-	buffer_latency      = setting_buffer_latency * buffer_period_size;
+	if (set_buffer_geometry((unsigned int) alsa_pcm_period_size) != 0) {
+		return -EINVAL;
+	}
 
 	for (i = 2; i < 24; i++) {
 		if (buffer_size == (1U << i)) {
@@ -970,7 +969,6 @@ alsa_pcm_mix_parts(ALSA_PCM_INFO                *pcminfo,
                    const snd_pcm_channel_area_t *USED_FOR_INPUTS(capt_areas),
                    const snd_pcm_channel_area_t *play_areas)
 {
-	PART                            *part;
 #ifdef ENABLE_INPUTS
 	const snd_pcm_channel_area_t    *capture_areas = ((capt_areas == NULL) ?
 	                                                  pcminfo->capture_areas : capt_areas);
@@ -983,9 +981,14 @@ alsa_pcm_mix_parts(ALSA_PCM_INFO                *pcminfo,
 	unsigned int                    playback_steps[alsa_pcm_playback_channels];
 	unsigned int                    chn;
 	unsigned int                    a_index;
-	unsigned int                    part_num;
+#ifdef ENABLE_INPUTS
+	unsigned int                    r_index;
+#endif
 	unsigned int                    i;
 	unsigned int                    j;
+	double                          out1;
+	double                          out2;
+	double                          max_val;
 	union {
 		float           f;
 		int             i;
@@ -996,6 +999,9 @@ alsa_pcm_mix_parts(ALSA_PCM_INFO                *pcminfo,
 		unsigned char   c[4];
 	}                               ival[16];
 
+	PHASEX_TRACE(TRACE_AUDIO_PERIOD_BEGIN, -1,
+	             (get_audio_index() / buffer_period_size), nframes, 0, 0);
+
 	set_midi_cycle_time();
 
 	if (check_active_sensing_timeout() > 0) {
@@ -1040,20 +1046,12 @@ alsa_pcm_mix_parts(ALSA_PCM_INFO                *pcminfo,
 		playback_samples[chn] += offset * playback_steps[chn];
 	}
 
-	memset(output_buffer1, 0, sizeof(sample_t) * nframes);
-	memset(output_buffer2, 0, sizeof(sample_t) * nframes);
-
 	a_index = get_audio_index();
 
-	/* mix parts generated in engine threads */
-	for (part_num = 0; part_num < MAX_PARTS; part_num++) {
-		part = get_part(part_num);
+	flush_midi_out(nframes, a_index);
 
-		for (j = 0; j < nframes; j++) {
-			output_buffer1[j] += part->output_buffer1[a_index + j];
-			output_buffer2[j] += part->output_buffer2[a_index + j];
-		}
-	}
+	/* mix, limit, and meter parts generated in engine threads */
+	run_master_bus(a_index, nframes);
 
 	/* fill the output channel areas from output buffers. */
 	for (j = 0; j < nframes; j++) {
@@ -1064,12 +1062,20 @@ alsa_pcm_mix_parts(ALSA_PCM_INFO                *pcminfo,
 			ival[1].i = fval[1].i;
 		}
 		else {
+			/* clip instead of letting integer conversion wrap around.
+			   scale in double, since a float full scale for 32 bit
+			   formats rounds up past INT_MAX. */
+			max_val = (double) alsa_pcm_max_sample_val;
+			out1    = (double) output_buffer1[j] * max_val;
+			out2    = (double) output_buffer2[j] * max_val;
+			out1    = (out1 > max_val) ? max_val : ((out1 < -max_val) ? -max_val : out1);
+			out2    = (out2 > max_val) ? max_val : ((out2 < -max_val) ? -max_val : out2);
+			ival[0].i = (int) out1;
+			ival[1].i = (int) out2;
 			if (alsa_pcm_is_unsigned) {
 				ival[0].u ^= 1U << (alsa_pcm_format_bits - 1U);
 				ival[1].u ^= 1U << (alsa_pcm_format_bits - 1U);
 			}
-			ival[0].i = (int)(output_buffer1[j] * f_alsa_pcm_max_sample_val);
-			ival[1].i = (int)(output_buffer2[j] * f_alsa_pcm_max_sample_val);
 		}
 
 		/* TODO: handle output channel mapping and > 2 output channels. */
@@ -1094,6 +1100,7 @@ alsa_pcm_mix_parts(ALSA_PCM_INFO                *pcminfo,
 #ifdef ENABLE_INPUTS
 	if (alsa_pcm_enable_inputs) {
 		/* fill the input buffers from the input channel areas. */
+		r_index = a_index;
 		for (j = 0; j < nframes; j++) {
 			/* TODO: handle input channel mapping and > 2 input channels. */
 			for (chn = 0; chn < 2; chn++) {
@@ -1114,17 +1121,20 @@ alsa_pcm_mix_parts(ALSA_PCM_INFO                *pcminfo,
 
 			if (alsa_pcm_is_float) {
 				fval[0].i                  = ival[0].i;
-				input_buffer1[a_index + j] = (sample_t) fval[0].f;
-				fval[1].i                  = ival[1].i;
-				input_buffer2[a_index + j] = (sample_t) fval[1].f;
+				input_buffer1[r_index] = (sample_t) fval[0].f;
+				fval[1].i              = ival[1].i;
+				input_buffer2[r_index] = (sample_t) fval[1].f;
 			}
 			else {
 				if (alsa_pcm_is_unsigned) {
 					ival[0].u ^= 1U << (alsa_pcm_format_bits - 1U);
 					ival[1].u ^= 1U << (alsa_pcm_format_bits - 1U);
 				}
-				input_buffer1[a_index + j] = (sample_t) ival[0].i / f_alsa_pcm_max_sample_val;
-				input_buffer2[a_index + j] = (sample_t) ival[1].i / f_alsa_pcm_max_sample_val;
+				input_buffer1[r_index] = (sample_t) ival[0].i / f_alsa_pcm_max_sample_val;
+				input_buffer2[r_index] = (sample_t) ival[1].i / f_alsa_pcm_max_sample_val;
+			}
+			if (++r_index >= buffer_size) {
+				r_index = 0;
 			}
 		}
 	}
@@ -1133,6 +1143,8 @@ alsa_pcm_mix_parts(ALSA_PCM_INFO                *pcminfo,
 	/* Done using the audio index until next ALSA PCM period. */
 	inc_audio_index(nframes);
 
+	PHASEX_TRACE(TRACE_AUDIO_PERIOD_END, -1, 0, 0, 0, 0);
+
 	return 0;
 }
 
@@ -1260,7 +1272,7 @@ alsa_pcm_write_and_poll_loop(ALSA_PCM_INFO *pcminfo)
 			                                     (unsigned int) capture_count, 1)) < 0) {
 				if ((snd_pcm_state(pcminfo->capture_handle) == SND_PCM_STATE_XRUN) ||
 				    (snd_pcm_state(pcminfo->capture_handle) == SND_PCM_STATE_SUSPENDED)) {
-					PHASEX_DEBUG(DEBUG_CLASS_MIDI_TIMING, "xxx1xxx ");
+					PHASEX_TRACE(TRACE_AUDIO_XRUN, -1, 1, snd_pcm_state(pcminfo->capture_handle), 0, 0);
 					result = (snd_pcm_state(pcminfo->capture_handle) ==
 					          SND_PCM_STATE_XRUN) ? -EPIPE : -ESTRPIPE;
 					if (alsa_pcm_xrun_recovery(pcminfo->capture_handle, result) < 0) {
@@ -1281,17 +1293,13 @@ alsa_pcm_write_and_poll_loop(ALSA_PCM_INFO *pcminfo)
 				}
 			}
 		}
-		else {
-			PHASEX_DEBUG(DEBUG_CLASS_MIDI_TIMING,
-			             DEBUG_COLOR_MAGENTA "*" DEBUG_COLOR_DEFAULT);
-		}
 
 		ptr     = pcminfo->capture_samples;
 		nframes = (int) buffer_period_size;
 		while (nframes > 0) {
 			if ((result = (int) snd_pcm_readi(pcminfo->capture_handle,
 			                                  ptr, (unsigned int) nframes)) < 0) {
-				PHASEX_DEBUG(DEBUG_CLASS_MIDI_TIMING, "xxx2xxx ");
+				PHASEX_TRACE(TRACE_AUDIO_XRUN, -1, 2, result, 0, 0);
 				if (alsa_pcm_xrun_recovery(pcminfo->capture_handle, result) < 0) {
 					PHASEX_ERROR("ALSA PCM read error 2: (%d) %s\n",
 					             result, snd_strerror(result));
@@ -1323,7 +1331,7 @@ alsa_pcm_write_and_poll_loop(ALSA_PCM_INFO *pcminfo)
 			                                     (unsigned int) capture_count, 1)) < 0) {
 				if ((snd_pcm_state(pcminfo->capture_handle) == SND_PCM_STATE_XRUN) ||
 				    (snd_pcm_state(pcminfo->capture_handle) == SND_PCM_STATE_SUSPENDED)) {
-					PHASEX_DEBUG(DEBUG_CLASS_MIDI_TIMING, "xxx3xxx ");
+					PHASEX_TRACE(TRACE_AUDIO_XRUN, -1, 3, snd_pcm_state(pcminfo->capture_handle), 0, 0);
 					result = (snd_pcm_state(pcminfo->capture_handle) ==
 					          SND_PCM_STATE_XRUN) ? -EPIPE : -ESTRPIPE;
 					if (alsa_pcm_xrun_recovery(pcminfo->capture_handle, result) < 0) {
@@ -1354,7 +1362,7 @@ alsa_pcm_write_and_poll_loop(ALSA_PCM_INFO *pcminfo)
 			                                     (unsigned int) playback_count, 0)) < 0) {
 				if ((snd_pcm_state(pcminfo->playback_handle) == SND_PCM_STATE_XRUN) ||
 				    (snd_pcm_state(pcminfo->playback_handle) == SND_PCM_STATE_SUSPENDED)) {
-					PHASEX_DEBUG(DEBUG_CLASS_MIDI_TIMING, "xxx4xxx ");
+					PHASEX_TRACE(TRACE_AUDIO_XRUN, -1, 4, snd_pcm_state(pcminfo->playback_handle), 0, 0);
 					result = (snd_pcm_state(pcminfo->playback_handle) ==
 					          SND_PCM_STATE_XRUN) ? -EPIPE : -ESTRPIPE;
 					if (alsa_pcm_xrun_recovery(pcminfo->playback_handle, result) < 0) {
@@ -1389,17 +1397,13 @@ alsa_pcm_write_and_poll_loop(ALSA_PCM_INFO *pcminfo)
 			}
 
 		}
-		else {
-			PHASEX_DEBUG(DEBUG_CLASS_MIDI_TIMING,
-			             DEBUG_COLOR_YELLOW "*" DEBUG_COLOR_DEFAULT);
-		}
 
 		ptr     = pcminfo->playback_samples;
 		nframes = (int) buffer_period_size;
 		while (nframes > 0) {
 			if ((result = (int) snd_pcm_writei(pcminfo->playback_handle,
 			                                   ptr, (unsigned int) nframes)) < 0) {
-				PHASEX_DEBUG(DEBUG_CLASS_MIDI_TIMING, "xxx5xxx ");
+				PHASEX_TRACE(TRACE_AUDIO_XRUN, -1, 5, result, 0, 0);
 				if (alsa_pcm_xrun_recovery(pcminfo->playback_handle, result) < 0) {
 					PHASEX_ERROR("ALSA PCM write error 2: %s\n", snd_strerror(result));
 					select_audio_driver(NULL, AUDIO_DRIVER_NONE);
@@ -1431,7 +1435,7 @@ alsa_pcm_write_and_poll_loop(ALSA_PCM_INFO *pcminfo)
 			                                     (unsigned int) playback_count, 0)) < 0) {
 				if ((snd_pcm_state(pcminfo->playback_handle) == SND_PCM_STATE_XRUN) ||
 				    (snd_pcm_state(pcminfo->playback_handle) == SND_PCM_STATE_SUSPENDED)) {
-					PHASEX_DEBUG(DEBUG_CLASS_MIDI_TIMING, "xxx6xxx ");
+					PHASEX_TRACE(TRACE_AUDIO_XRUN, -1, 6, snd_pcm_state(pcminfo->playback_handle), 0, 0);
 					result = (snd_pcm_state(pcminfo->playback_handle) ==
 					          SND_PCM_STATE_XRUN) ? -EPIPE : -ESTRPIPE;
 					if (alsa_pcm_xrun_recovery(pcminfo->playback_handle, result) < 0) {
@@ -1732,6 +1736,8 @@ alsa_pcm_thread(void *UNUSED(arg))
 	schedparam.sched_priority = setting_audio_priority;
 	pthread_setschedparam(thread_id, setting_sched_policy, &schedparam);
 
+	trace_thread_init("alsa pcm");
+
 	/* setup thread cleanup handler */
 	pthread_cleanup_push(&alsa_pcm_cleanup, NULL);
 
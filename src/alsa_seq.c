@@ -34,6 +34,7 @@
 #include "alsa_seq.h"
 #include "mididefs.h"
 #include "midi_event.h"
+#include "midi_out.h"
 #include "midi_process.h"
 #include "engine.h"
 #include "patch.h"
@@ -42,7 +43,9 @@
 #include "bank.h"
 #include "settings.h"
 #include "driver.h"
+#include "midimap.h"
 #include "debug.h"
+#include "trace.h"
 
 #ifndef WITHOUT_LASH
 # include "lash.h"
@@ -250,6 +253,11 @@ alsa_seq_subscribe_port(ALSA_SEQ_INFO *seq_info, ALSA_SEQ_PORT *seq_port, char *
 		snd_seq_port_subscribe_malloc(&subs);
 		snd_seq_port_subscribe_set_sender(subs, &sender);
 		snd_seq_port_subscribe_set_dest(subs, &dest);
+		if (seq_info->queue >= 0) {
+			snd_seq_port_subscribe_set_queue(subs, seq_info->queue);
+			snd_seq_port_subscribe_set_time_update(subs, 1);
+			snd_seq_port_subscribe_set_time_real(subs, 1);
+		}
 		snd_seq_subscribe_port(seq_info->seq, subs);
 
 		seq_port->subs = subs;
@@ -426,6 +434,8 @@ open_alsa_seq_in(char *alsa_port)
 		phasex_shutdown("Out of memory!\n");
 	}
 	memset(new_seq_info, 0, sizeof(ALSA_SEQ_INFO));
+	new_seq_info->queue = -1;
+	new_seq_info->out_port = -1;
 	if ((new_seq_info->in_port = malloc(sizeof(ALSA_SEQ_PORT))) == NULL) {
 		phasex_shutdown("Out of memory!\n");
 	}
@@ -440,9 +450,9 @@ open_alsa_seq_in(char *alsa_port)
 	/* TODO: need a better handler here */
 	snd_lib_error_set_handler(alsa_error_handler);
 
-	/* open the sequencer */
+	/* open the sequencer (output is needed for starting the queue) */
 	if (snd_seq_open(&new_seq_info->seq, "default",
-	                 SND_SEQ_OPEN_INPUT, SND_SEQ_NONBLOCK) < 0) {
+	                 SND_SEQ_OPEN_DUPLEX, SND_SEQ_NONBLOCK) < 0) {
 		PHASEX_ERROR("Unable to open ALSA sequencer.\n");
 		return NULL;
 	}
@@ -516,6 +526,13 @@ open_alsa_seq_in(char *alsa_port)
 		return NULL;
 	}
 
+	/* allocate a queue for the kernel to timestamp incoming events */
+	if ((new_seq_info->queue = snd_seq_alloc_named_queue(new_seq_info->seq, "phasex")) < 0) {
+		PHASEX_WARN("Unable to allocate ALSA sequencer queue.  "
+		            "Using arrival time for MIDI event timing.\n");
+		new_seq_info->queue = -1;
+	}
+
 	/* create a port */
 	snprintf(port_name, sizeof(port_name), "phasex in");
 	new_seq_info->in_port->port =
@@ -533,6 +550,41 @@ open_alsa_seq_in(char *alsa_port)
 #endif
 		                           SND_SEQ_PORT_TYPE_MIDI_GENERIC);
 
+	/* create an output port for thru, note output, and parameter echo */
+	snprintf(port_name, sizeof(port_name), "phasex out");
+	if ((new_seq_info->out_port =
+	     snd_seq_create_simple_port(new_seq_info->seq, port_name,
+	                                SND_SEQ_PORT_CAP_READ |
+	                                SND_SEQ_PORT_CAP_SUBS_READ,
+#ifdef SND_SEQ_PORT_TYPE_SOFTWARE
+	                                SND_SEQ_PORT_TYPE_SOFTWARE |
+#endif
+#ifdef SND_SEQ_PORT_TYPE_APPLICATION
+	                                SND_SEQ_PORT_TYPE_APPLICATION |
+#endif
+	                                SND_SEQ_PORT_TYPE_MIDI_GENERIC)) < 0) {
+		PHASEX_WARN("Unable to create ALSA sequencer output port.\n");
+		new_seq_info->out_port = -1;
+	}
+
+	/* stamp events delivered to our port with queue real time */
+	if (new_seq_info->queue >= 0) {
+		snd_seq_get_port_info(new_seq_info->seq, new_seq_info->in_port->port, pinfo);
+		snd_seq_port_info_set_timestamping(pinfo, 1);
+		snd_seq_port_info_set_timestamp_real(pinfo, 1);
+		snd_seq_port_info_set_timestamp_queue(pinfo, new_seq_info->queue);
+		if ((snd_seq_set_port_info(new_seq_info->seq, new_seq_info->in_port->port, pinfo) < 0) ||
+		    (snd_seq_start_queue(new_seq_info->seq, new_seq_info->queue, NULL) < 0)) {
+			PHASEX_WARN("Unable to start ALSA sequencer queue.  "
+			            "Using arrival time for MIDI event timing.\n");
+			snd_seq_free_queue(new_seq_info->seq, new_seq_info->queue);
+			new_seq_info->queue = -1;
+		}
+		else {
+			snd_seq_drain_output(new_seq_info->seq);
+		}
+	}
+
 	/* since we opened nonblocking, we need our poll descriptors */
 	if ((new_seq_info->npfds = snd_seq_poll_descriptors_count
 	     (new_seq_info->seq, POLLIN)) > 0) {
@@ -646,6 +698,10 @@ alsa_seq_init(void)
 		return -1;
 	}
 
+	if (alsa_seq_info->out_port >= 0) {
+		g_atomic_int_set(&midi_out_active, 1);
+	}
+
 #ifndef WITHOUT_LASH
 	if (!lash_disabled) {
 		lash_client_set_alsa_id(alsa_seq_info->seq);
@@ -668,6 +724,9 @@ alsa_seq_cleanup(void *UNUSED(arg))
 	ALSA_SEQ_PORT   *cur;
 	ALSA_SEQ_PORT   *prev;
 
+	/* stop midi output before the sequencer goes away */
+	g_atomic_int_set(&midi_out_active, 0);
+
 	/* disconnect from list of specified source ports, if any */
 	if (alsa_seq_info != NULL) {
 		cur = alsa_seq_info->src_ports;
@@ -704,6 +763,9 @@ alsa_seq_cleanup(void *UNUSED(arg))
 
 		/* close sequencer */
 		if (alsa_seq_info->seq != NULL) {
+			if (alsa_seq_info->queue >= 0) {
+				snd_seq_free_queue(alsa_seq_info->seq, alsa_seq_info->queue);
+			}
 			snd_seq_close(alsa_seq_info->seq);
 		}
 		snd_config_update_free_global();
@@ -721,6 +783,60 @@ alsa_seq_cleanup(void *UNUSED(arg))
 }
 
 
+/*****************************************************************************
+ * alsa_seq_queue_events()
+ *
+ * Converts kernel queue timestamps for a batch of events to frame positions
+ * in one pass, and queues the events for the engine threads.  Without a
+ * running queue, the whole batch is timed at arrival.
+ *****************************************************************************/
+static void
+alsa_seq_queue_events(snd_seq_real_time_t *stamp, int num_events)
+{
+	snd_seq_queue_status_t      *status;
+	const snd_seq_real_time_t   *queue_time = NULL;
+	MIDI_EVENT                  *event;
+	timecalc_t                  age_nsec[ALSA_SEQ_BATCH_SIZE];
+	unsigned int                cycle_frame[ALSA_SEQ_BATCH_SIZE];
+	unsigned int                m_index;
+	int                         j;
+
+	snd_seq_queue_status_alloca(&status);
+	if ((alsa_seq_info->queue >= 0) &&
+	    (snd_seq_get_queue_status(alsa_seq_info->seq, alsa_seq_info->queue, status) >= 0)) {
+		queue_time = snd_seq_queue_status_get_real_time(status);
+	}
+
+	for (j = 0; j < num_events; j++) {
+		age_nsec[j] = 0.0;
+		if (queue_time != NULL) {
+			age_nsec[j] = (((timecalc_t)((long) queue_time->tv_sec - (long) stamp[j].tv_sec)) *
+			               1000000000.0) +
+				(timecalc_t)((long) queue_time->tv_nsec - (long) stamp[j].tv_nsec);
+			if (age_nsec[j] < 0.0) {
+				age_nsec[j] = 0.0;
+			}
+		}
+	}
+
+	m_index = get_midi_cycle_frames(age_nsec, cycle_frame, num_events);
+	PHASEX_TRACE(TRACE_MIDI_QUEUE, -1, (m_index / buffer_period_size), 0, 0, 0);
+
+	for (j = 0; j < num_events; j++) {
+		event = & (alsa_seq_info->event[j]);
+		if (event->type == MIDI_EVENT_STOP) {
+			queue_midi_realtime_event(ALL_PARTS, MIDI_EVENT_STOP,
+			                          cycle_frame[j], m_index);
+		}
+		else {
+			queue_midi_event_parts(get_midi_route(event), event,
+			                       cycle_frame[j], m_index);
+			queue_midi_out_thru(event, (int) buffer_index_add(m_index, cycle_frame[j]));
+		}
+	}
+}
+
+
 /*****************************************************************************
  * midi_thread()
  *
@@ -730,19 +846,16 @@ alsa_seq_cleanup(void *UNUSED(arg))
 void *
 alsa_seq_thread(void *UNUSED(arg))
 {
-	PART                *part;
-	MIDI_EVENT          *event      = & (alsa_seq_info->event);
-	timecalc_t          delta_nsec;
-	struct timespec     now;
+	MIDI_EVENT          *event;
 	struct sched_param  schedparam;
 	pthread_t           thread_id;
 	snd_seq_event_t     *ev         = NULL;
-	unsigned int        part_num;
-	unsigned int        cycle_frame = 0;
-	unsigned int        m_index;
+	snd_seq_real_time_t stamp[ALSA_SEQ_BATCH_SIZE];
+	int                 num_events;
+	int                 more;
 
 	/* clear outgoing event buffer */
-	memset(event, 0, sizeof(MIDI_EVENT));
+	memset(alsa_seq_info->event, 0, sizeof(alsa_seq_info->event));
 
 	/* set realtime scheduling and priority */
 	thread_id = pthread_self();
@@ -750,6 +863,8 @@ alsa_seq_thread(void *UNUSED(arg))
 	schedparam.sched_priority = setting_midi_priority;
 	pthread_setschedparam(thread_id, setting_sched_policy, &schedparam);
 
+	trace_thread_init("alsa seq");
+
 	/* setup thread cleanup handler */
 	pthread_cleanup_push(&alsa_seq_cleanup, NULL);
 
@@ -773,130 +888,126 @@ alsa_seq_thread(void *UNUSED(arg))
 		/* poll for new MIDI input */
 		if (poll(alsa_seq_info->pfd, (nfds_t) alsa_seq_info->npfds, 100) > 0) {
 
-			/* cycle through all available events */
-			while ((snd_seq_event_input(alsa_seq_info->seq, &ev) >= 0) &&
-			       ev != NULL) {
-
-				/* get timestamp and determine index and frame position of
-				   this event. */
-				delta_nsec  = get_time_delta(&now);
-				cycle_frame = get_midi_cycle_frame(delta_nsec);
-				m_index = get_midi_index();
-				PHASEX_DEBUG(DEBUG_CLASS_MIDI_TIMING,
-				             DEBUG_COLOR_CYAN "[%d] " DEBUG_COLOR_DEFAULT,
-				             (m_index / buffer_period_size));
-
-				event->type  = MIDI_EVENT_NO_EVENT;
-				event->state = EVENT_STATE_ALLOCATED;
-
-				/* process event for each part that wants it */
-				for (part_num = 0; part_num < MAX_PARTS; part_num++) {
-					part = get_part(part_num);
-
-					/* make sure this part wants this channel */
-					if ((ev->data.note.channel == part->midi_channel) ||
-					    (part->midi_channel == 16)) {
-
-						event->channel = ev->data.note.channel;
-
-						switch (ev->type) {
-
-						case SND_SEQ_EVENT_NOTEON:
-							event->type           = MIDI_EVENT_NOTE_ON;
-							event->note           = ev->data.note.note & 0x7F;
-							event->velocity       = ev->data.note.velocity & 0x7F;
-							break;
-						case SND_SEQ_EVENT_NOTEOFF:
-							event->type           = MIDI_EVENT_NOTE_OFF;
-							event->note           = ev->data.note.note & 0x7F;
-							event->velocity       = ev->data.note.velocity & 0x7F;
-							break;
-						case SND_SEQ_EVENT_KEYPRESS:
-							event->type           = MIDI_EVENT_AFTERTOUCH;
-							event->note           = ev->data.note.note & 0x7F;
-							event->velocity       = ev->data.note.velocity & 0x7F;
-							break;
-						case SND_SEQ_EVENT_PGMCHANGE:
-							event->type           = MIDI_EVENT_PROGRAM_CHANGE;
-							event->program        = ev->data.control.value & 0x7F;
-							break;
-						case SND_SEQ_EVENT_CHANPRESS:
-							event->type           = MIDI_EVENT_POLYPRESSURE;
-							event->polypressure   = ev->data.control.value & 0x7F;
-							break;
-						case SND_SEQ_EVENT_CONTROLLER:
-							event->type           = MIDI_EVENT_CONTROLLER;
-							event->controller     = ev->data.control.param & 0x7F;
-							event->value          = ev->data.control.value & 0x7F;
-							break;
-						case SND_SEQ_EVENT_PITCHBEND:
-							event->type           = MIDI_EVENT_PITCHBEND;
-							event->lsb            = (ev->data.control.value + 8192) & 0x7F;
-							event->msb            = ((ev->data.control.value + 8192) >> 7) & 0x7F;
-							break;
-						case SND_SEQ_EVENT_SENSING:
-							set_active_sensing_timeout();
-							event->type = MIDI_EVENT_NO_EVENT;
-							break;
-						case SND_SEQ_EVENT_STOP:
-							queue_midi_realtime_event(ALL_PARTS, MIDI_EVENT_STOP,
-							                          cycle_frame, m_index);
-							event->type = MIDI_EVENT_NO_EVENT;
-							break;
+			/* drain all available events, converting them in batches and
+			   timing each batch in one pass */
+			more = 1;
+			while (more) {
+				num_events = 0;
+				while ((more = ((snd_seq_event_input(alsa_seq_info->seq, &ev) >= 0) &&
+				                (ev != NULL)))) {
+
+					event = & (alsa_seq_info->event[num_events]);
+					event->type  = MIDI_EVENT_NO_EVENT;
+					event->state = EVENT_STATE_ALLOCATED;
+
+					/* convert the event once, then queue it for each part that wants it */
+					event->channel = ev->data.note.channel;
+
+					switch (ev->type) {
+
+					case SND_SEQ_EVENT_NOTEON:
+						event->type           = MIDI_EVENT_NOTE_ON;
+						event->note           = ev->data.note.note & 0x7F;
+						event->velocity       = ev->data.note.velocity & 0x7F;
+						break;
+					case SND_SEQ_EVENT_NOTEOFF:
+						event->type           = MIDI_EVENT_NOTE_OFF;
+						event->note           = ev->data.note.note & 0x7F;
+						event->velocity       = ev->data.note.velocity & 0x7F;
+						break;
+					case SND_SEQ_EVENT_KEYPRESS:
+						event->type           = MIDI_EVENT_AFTERTOUCH;
+						event->note           = ev->data.note.note & 0x7F;
+						event->velocity       = ev->data.note.velocity & 0x7F;
+						break;
+					case SND_SEQ_EVENT_PGMCHANGE:
+						event->type           = MIDI_EVENT_PROGRAM_CHANGE;
+						event->program        = ev->data.control.value & 0x7F;
+						break;
+					case SND_SEQ_EVENT_CHANPRESS:
+						event->type           = MIDI_EVENT_POLYPRESSURE;
+						event->polypressure   = ev->data.control.value & 0x7F;
+						break;
+					case SND_SEQ_EVENT_CONTROLLER:
+						event->type           = MIDI_EVENT_CONTROLLER;
+						event->controller     = ev->data.control.param & 0x7F;
+						event->value          = ev->data.control.value & 0x7F;
+						break;
+					case SND_SEQ_EVENT_PITCHBEND:
+						event->type           = MIDI_EVENT_PITCHBEND;
+						event->lsb            = (ev->data.control.value + 8192) & 0x7F;
+						event->msb            = ((ev->data.control.value + 8192) >> 7) & 0x7F;
+						break;
+					case SND_SEQ_EVENT_SENSING:
+						set_active_sensing_timeout();
+						event->type = MIDI_EVENT_NO_EVENT;
+						break;
+					case SND_SEQ_EVENT_STOP:
+						event->type = MIDI_EVENT_STOP;
+						break;
 #ifdef MIDI_CLOCK_SYNC
-						case SND_SEQ_EVENT_CLOCK:
-							PHASEX_DEBUG(DEBUG_CLASS_MIDI_EVENT,
-							             "-- Clock msg: %d %d\n",
-							             ev->data.queue.param.d32[0],
-							             ev->data.queue.param.d32[1]);
-							break;
-						case SND_SEQ_EVENT_SONGPOS:
-							PHASEX_DEBUG(DEBUG_CLASS_MIDI_EVENT,
-							             "-- Song Position: %d %d\n",
-							             ev->data.control.param,
-							             ev->data.control.value);
-							break;
-						case SND_SEQ_EVENT_START:
-							PHASEX_DEBUG(DEBUG_CLASS_MIDI_EVENT,
-							             "-- Start msg: %d %d\n",
-							             ev->data.queue.param.d32[0],
-							             ev->data.queue.param.d32[1]);
-							break;
-						case SND_SEQ_EVENT_CONTINUE:
-							PHASEX_DEBUG(DEBUG_CLASS_MIDI_EVENT,
-							             "-- Continue msg: %d %d\n",
-							             ev->data.queue.param.d32[0],
-							             ev->data.queue.param.d32[1]);
-							break;
-						case SND_SEQ_EVENT_SETPOS_TICK:
-							PHASEX_DEBUG(DEBUG_CLASS_MIDI_EVENT,
-							             "-- SetPos Tick msg: %d %d\n",
-							             ev->data.queue.param.d32[0],
-							             ev->data.queue.param.d32[1]);
-							break;
-						case SND_SEQ_EVENT_TICK:
-							PHASEX_DEBUG(DEBUG_CLASS_MIDI_EVENT,
-							             "-- Tick msg: %d %d\n",
-							             ev->data.queue.param.d32[0],
-							             ev->data.queue.param.d32[1]);
-							break;
+					case SND_SEQ_EVENT_CLOCK:
+						PHASEX_DEBUG(DEBUG_CLASS_MIDI_EVENT,
+						             "-- Clock msg: %d %d\n",
+						             ev->data.queue.param.d32[0],
+						             ev->data.queue.param.d32[1]);
+						break;
+					case SND_SEQ_EVENT_SONGPOS:
+						PHASEX_DEBUG(DEBUG_CLASS_MIDI_EVENT,
+						             "-- Song Position: %d %d\n",
+						             ev->data.control.param,
+						             ev->data.control.value);
+						break;
+					case SND_SEQ_EVENT_START:
+						PHASEX_DEBUG(DEBUG_CLASS_MIDI_EVENT,
+						             "-- Start msg: %d %d\n",
+						             ev->data.queue.param.d32[0],
+						             ev->data.queue.param.d32[1]);
+						break;
+					case SND_SEQ_EVENT_CONTINUE:
+						PHASEX_DEBUG(DEBUG_CLASS_MIDI_EVENT,
+						             "-- Continue msg: %d %d\n",
+						             ev->data.queue.param.d32[0],
+						             ev->data.queue.param.d32[1]);
+						break;
+					case SND_SEQ_EVENT_SETPOS_TICK:
+						PHASEX_DEBUG(DEBUG_CLASS_MIDI_EVENT,
+						             "-- SetPos Tick msg: %d %d\n",
+						             ev->data.queue.param.d32[0],
+						             ev->data.queue.param.d32[1]);
+						break;
+					case SND_SEQ_EVENT_TICK:
+						PHASEX_DEBUG(DEBUG_CLASS_MIDI_EVENT,
+						             "-- Tick msg: %d %d\n",
+						             ev->data.queue.param.d32[0],
+						             ev->data.queue.param.d32[1]);
+						break;
 #endif
-						default:
-							PHASEX_DEBUG(DEBUG_CLASS_MIDI_EVENT,
-							             "*** WARNING:  Unhandled ALSA Seq event!  type=%d  ***\n",
-							             ev->type);
-							break;
-						}
+					default:
+						PHASEX_DEBUG(DEBUG_CLASS_MIDI_EVENT,
+						             "*** WARNING:  Unhandled ALSA Seq event!  type=%d  ***\n",
+						             ev->type);
+						break;
+					}
 
-						/* queue event for engine thread */
-						if (event->type != MIDI_EVENT_NO_EVENT) {
-							queue_midi_event(part_num, event, cycle_frame, m_index);
-						}
+					/* keep event and its kernel timestamp for this batch */
+					if (event->type != MIDI_EVENT_NO_EVENT) {
+						stamp[num_events] = ev->time.time;
+						num_events++;
+					}
+
+					snd_seq_free_event(ev);
+					ev = NULL;
+
+					if (num_events == ALSA_SEQ_BATCH_SIZE) {
+						break;
 					}
 				}
 
-				snd_seq_free_event(ev);
-				ev = NULL;
+				/* queue batch for engine threads */
+				if (num_events > 0) {
+					alsa_seq_queue_events(stamp, num_events);
+				}
 			}
 		}
 	}
@@ -908,3 +1019,76 @@ alsa_seq_thread(void *UNUSED(arg))
 	pthread_exit(NULL);
 	return NULL;
 }
+
+
+/*****************************************************************************
+ * alsa_seq_out_flush()
+ *
+ * Called from the audio process callback (via flush_midi_out()) with the
+ * audio ring index for this cycle.  Sends queued output events due within
+ * this cycle, scheduled on the timestamping queue at their frame offsets
+ * when the queue is running, or directly otherwise.
+ *****************************************************************************/
+void
+alsa_seq_out_flush(unsigned int nframes, unsigned int a_index)
+{
+	snd_seq_event_t     ev;
+	snd_seq_real_time_t when;
+	unsigned char       data[3];
+	unsigned int        offset;
+	timecalc_t          nsec;
+	int                 sent = 0;
+
+	if ((alsa_seq_info == NULL) || (alsa_seq_info->out_port < 0)) {
+		return;
+	}
+
+	while (dequeue_midi_out(a_index, nframes, data, &offset) > 0) {
+		snd_seq_ev_clear(&ev);
+		switch (data[0] & MIDI_TYPE_MASK) {
+		case MIDI_EVENT_NOTE_OFF:
+			snd_seq_ev_set_noteoff(&ev, data[0] & MIDI_CHANNEL_MASK, data[1], data[2]);
+			break;
+		case MIDI_EVENT_NOTE_ON:
+			snd_seq_ev_set_noteon(&ev, data[0] & MIDI_CHANNEL_MASK, data[1], data[2]);
+			break;
+		case MIDI_EVENT_AFTERTOUCH:
+			snd_seq_ev_set_keypress(&ev, data[0] & MIDI_CHANNEL_MASK, data[1], data[2]);
+			break;
+		case MIDI_EVENT_CONTROLLER:
+			snd_seq_ev_set_controller(&ev, data[0] & MIDI_CHANNEL_MASK, data[1], data[2]);
+			break;
+		case MIDI_EVENT_PROGRAM_CHANGE:
+			snd_seq_ev_set_pgmchange(&ev, data[0] & MIDI_CHANNEL_MASK, data[1]);
+			break;
+		case MIDI_EVENT_POLYPRESSURE:
+			snd_seq_ev_set_chanpress(&ev, data[0] & MIDI_CHANNEL_MASK, data[1]);
+			break;
+		case MIDI_EVENT_PITCHBEND:
+			snd_seq_ev_set_pitchbend(&ev, data[0] & MIDI_CHANNEL_MASK,
+			                         ((data[2] << 7) | data[1]) - 8192);
+			break;
+		default:
+			continue;
+		}
+		snd_seq_ev_set_source(&ev, (unsigned char) alsa_seq_info->out_port);
+		snd_seq_ev_set_subs(&ev);
+
+		/* offsets are relative to the start of this cycle */
+		if ((alsa_seq_info->queue >= 0) && (offset > 0)) {
+			nsec = (timecalc_t) offset * nsec_per_frame;
+			when.tv_sec  = (unsigned int)(nsec / 1000000000.0);
+			when.tv_nsec = (unsigned int)(nsec - ((timecalc_t) when.tv_sec * 1000000000.0));
+			snd_seq_ev_schedule_real(&ev, alsa_seq_info->queue, 1, &when);
+		}
+		else {
+			snd_seq_ev_set_direct(&ev);
+		}
+		snd_seq_event_output(alsa_seq_info->seq, &ev);
+		sent++;
+	}
+
+	if (sent > 0) {
+		snd_seq_drain_output(alsa_seq_info->seq);
+	}
+}
@@ -29,6 +29,10 @@
 #include "mididefs.h"
 
 
+/* Max number of sequencer events converted and timestamped together */
+#define ALSA_SEQ_BATCH_SIZE         64
+
+
 typedef struct alsa_seq_port {
 	int                         client;
 	int                         port;
@@ -46,13 +50,15 @@ typedef struct alsa_seq_info {
 	snd_seq_t                   *seq;
 	struct pollfd               *pfd;
 	int                         npfds;
+	int                         queue;      /* timestamping queue, or -1 */
 	short                       auto_hw;
 	short                       auto_sw;
 	ALSA_SEQ_PORT               *in_port;
+	int                         out_port;   /* midi output port, or -1 */
 	ALSA_SEQ_PORT               *src_ports;
 	ALSA_SEQ_PORT               *capture_ports;
 	ALSA_SEQ_PORT               *playback_ports;
-	MIDI_EVENT                  event;
+	MIDI_EVENT                  event[ALSA_SEQ_BATCH_SIZE];
 } ALSA_SEQ_INFO;
 
 
@@ -84,6 +90,7 @@ ALSA_SEQ_INFO *open_alsa_seq_in(char *alsa_port);
 void alsa_seq_cleanup(void *UNUSED(arg));
 int alsa_seq_init(void);
 void *alsa_seq_thread(void *UNUSED(arg));
+void alsa_seq_out_flush(unsigned int nframes, unsigned int a_index);
 
 
 #endif /* _ALSA_SEQ_H_ */
@@ -0,0 +1,561 @@
+/*****************************************************************************
+ *
+ * autosave.c
+ *
+ * PHASEX:  [P]hase [H]armonic [A]dvanced [S]ynthesis [EX]periment
+ *
+ * Copyright (C) 2012-2013 William Weston <whw@linuxmail.org>
+ *
+ * PHASEX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PHASEX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PHASEX.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <glib.h>
+#include "phasex.h"
+#include "autosave.h"
+#include "engine.h"
+#include "patch.h"
+#include "param.h"
+#include "bank.h"
+#include "session.h"
+#include "midimap.h"
+#include "settings.h"
+#include "debug.h"
+
+
+pthread_t           autosave_thread_p       = 0;
+
+volatile gint       autosave_requested      = 0;
+volatile gint       autosave_snapshot_state = AUTOSAVE_SNAPSHOT_IDLE;
+
+/* Files captured in memory by the gui thread for the current autosave
+   batch.  The gui thread fills these in while the snapshot state is
+   REQUESTED, and the autosave thread writes them out once it is READY. */
+static AUTOSAVE_PENDING autosave_pending[AUTOSAVE_MAX_PENDING];
+static int          autosave_num_pending    = 0;
+static int          autosave_capture_active = 0;
+static pthread_t    autosave_capture_thread;
+
+/* Content hashes of what was last written to the dump files, and of what
+   the batch being written holds.  Only touched by the gui thread, which
+   takes on the batch hashes at its next snapshot if the autosave thread
+   has set autosave_batch_ok. */
+static guint32      autosave_patch_hash[MAX_PARTS];
+static guint32      autosave_midimap_hash   = 0;
+static guint32      autosave_settings_hash  = 0;
+static int          autosave_initialized    = 0;
+
+static guint32      batch_patch_hash[MAX_PARTS];
+static guint32      batch_midimap_hash      = 0;
+static guint32      batch_settings_hash     = 0;
+static volatile gint autosave_batch_ok      = 0;
+
+
+/*****************************************************************************
+ * atomic_fopen()
+ *
+ * Opens a uniquely named temp file alongside <filename> for writing.  The
+ * temp file name is returned in <tmpname>.  Use atomic_fclose() to move the
+ * finished file into place.  While taking an autosave snapshot, the file is
+ * captured in memory instead, and written later by the autosave thread.
+ *****************************************************************************/
+FILE *
+atomic_fopen(char *filename, char *tmpname, size_t tmpname_len)
+{
+	AUTOSAVE_PENDING    *pending;
+	FILE                *file_f;
+	int                 fd;
+
+	if (autosave_capture_active &&
+	    (autosave_num_pending < AUTOSAVE_MAX_PENDING) &&
+	    pthread_equal(pthread_self(), autosave_capture_thread)) {
+		pending = & (autosave_pending[autosave_num_pending]);
+		pending->buf = NULL;
+		pending->len = 0;
+		if ((pending->file_f = open_memstream(&pending->buf, &pending->len)) != NULL) {
+			tmpname[0] = '\0';
+			return pending->file_f;
+		}
+	}
+
+	snprintf(tmpname, tmpname_len, "%s.XXXXXX", filename);
+	if ((fd = mkstemp(tmpname)) < 0) {
+		return NULL;
+	}
+	fchmod(fd, 0644);
+	if ((file_f = fdopen(fd, "wt")) == NULL) {
+		close(fd);
+		unlink(tmpname);
+		return NULL;
+	}
+
+	return file_f;
+}
+
+
+/*****************************************************************************
+ * atomic_fclose()
+ *
+ * Finishes a file opened with atomic_fopen().  The temp file is synced and
+ * renamed over <filename>, so readers only ever see a complete file.  Files
+ * captured for an autosave snapshot are added to the autosave batch, to be
+ * written, synced, and renamed into place by the autosave thread.
+ *****************************************************************************/
+int
+atomic_fclose(FILE *file_f, char *tmpname, char *filename)
+{
+	AUTOSAVE_PENDING    *pending;
+
+	if (autosave_capture_active &&
+	    (autosave_num_pending < AUTOSAVE_MAX_PENDING) &&
+	    (autosave_pending[autosave_num_pending].file_f == file_f)) {
+		pending = & (autosave_pending[autosave_num_pending]);
+		pending->file_f = NULL;
+		if ((fclose(file_f) != 0) || (pending->buf == NULL)) {
+			PHASEX_ERROR("Error capturing %s for autosave.\n", filename);
+			free(pending->buf);
+			pending->buf = NULL;
+			return -1;
+		}
+		strncpy(pending->filename, filename, (PATH_MAX - 1));
+		pending->filename[PATH_MAX - 1] = '\0';
+		autosave_num_pending++;
+		return 0;
+	}
+
+	if ((fflush(file_f) != 0) || ferror(file_f)) {
+		PHASEX_ERROR("Error writing %s: %s\n", filename, strerror(errno));
+		fclose(file_f);
+		unlink(tmpname);
+		return -1;
+	}
+
+	fdatasync(fileno(file_f));
+	fclose(file_f);
+	if (rename(tmpname, filename) != 0) {
+		PHASEX_ERROR("Unable to rename %s to %s: %s\n",
+		             tmpname, filename, strerror(errno));
+		unlink(tmpname);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+/*****************************************************************************
+ * write_pending()
+ *
+ * Writes a captured file to a temp file alongside its final name, leaving
+ * the descriptor open for autosave_batch_commit() to sync.
+ *****************************************************************************/
+static int
+write_pending(AUTOSAVE_PENDING *pending)
+{
+	size_t          offset  = 0;
+	ssize_t         len;
+
+	snprintf(pending->tmpname, sizeof(pending->tmpname), "%s.XXXXXX", pending->filename);
+	if ((pending->fd = mkstemp(pending->tmpname)) < 0) {
+		PHASEX_ERROR("Unable to create temp file for %s: %s\n",
+		             pending->filename, strerror(errno));
+		return -1;
+	}
+	fchmod(pending->fd, 0644);
+
+	while (offset < pending->len) {
+		if ((len = write(pending->fd, pending->buf + offset, pending->len - offset)) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			PHASEX_ERROR("Error writing %s: %s\n", pending->filename, strerror(errno));
+			close(pending->fd);
+			unlink(pending->tmpname);
+			pending->fd = -1;
+			return -1;
+		}
+		offset += (size_t) len;
+	}
+
+	return 0;
+}
+
+
+/*****************************************************************************
+ * autosave_batch_commit()
+ *
+ * Writes all files captured for the current autosave batch, syncs them,
+ * renames them into place, and then syncs each containing directory once.
+ * Returns 0 if every file made it into place, or -1 otherwise.
+ *****************************************************************************/
+static int
+autosave_batch_commit(void)
+{
+	AUTOSAVE_PENDING    *pending;
+	char                dirname_buf[PATH_MAX];
+	char                last_dir[PATH_MAX];
+	char                *dir;
+	int                 dir_fd;
+	int                 j;
+	int                 ret         = 0;
+
+	for (j = 0; j < autosave_num_pending; j++) {
+		pending = & (autosave_pending[j]);
+		if (write_pending(pending) != 0) {
+			ret = -1;
+		}
+		free(pending->buf);
+		pending->buf = NULL;
+		pending->len = 0;
+	}
+
+	/* data first, so that writeback for the whole batch can overlap */
+	for (j = 0; j < autosave_num_pending; j++) {
+		if (autosave_pending[j].fd >= 0) {
+			fdatasync(autosave_pending[j].fd);
+			close(autosave_pending[j].fd);
+		}
+	}
+
+	last_dir[0] = '\0';
+	for (j = 0; j < autosave_num_pending; j++) {
+		pending = & (autosave_pending[j]);
+		if (pending->fd < 0) {
+			continue;
+		}
+		if (rename(pending->tmpname, pending->filename) != 0) {
+			PHASEX_ERROR("Unable to rename %s to %s: %s\n",
+			             pending->tmpname, pending->filename, strerror(errno));
+			unlink(pending->tmpname);
+			ret = -1;
+			continue;
+		}
+		strncpy(dirname_buf, pending->filename, (PATH_MAX - 1));
+		dirname_buf[PATH_MAX - 1] = '\0';
+		dir = dirname(dirname_buf);
+		if (strcmp(dir, last_dir) != 0) {
+			if ((dir_fd = open(dir, O_RDONLY)) >= 0) {
+				fsync(dir_fd);
+				close(dir_fd);
+			}
+			strncpy(last_dir, dir, (PATH_MAX - 1));
+			last_dir[PATH_MAX - 1] = '\0';
+		}
+	}
+
+	PHASEX_DEBUG(DEBUG_CLASS_SESSION, "Autosave:  wrote %d files.\n",
+	             autosave_num_pending);
+
+	autosave_num_pending = 0;
+
+	return ret;
+}
+
+
+/*****************************************************************************
+ * hash_patch()
+ *
+ * Returns a hash of the parts of a patch that end up in its patch file.
+ *****************************************************************************/
+static guint32
+hash_patch(PATCH *patch)
+{
+	guint32         hash = 2166136261U;
+	char            *p;
+	unsigned int    param_num;
+
+	for (param_num = 0; param_num < NUM_PARAMS; param_num++) {
+		hash = (hash ^ (guint32) patch->param[param_num].value.int_val) * 16777619U;
+	}
+	if ((p = patch->name) != NULL) {
+		while (*p != '\0') {
+			hash = (hash ^ (guint32)(unsigned char)(*p++)) * 16777619U;
+		}
+	}
+
+	return hash;
+}
+
+
+/*****************************************************************************
+ * hash_midimap()
+ *
+ * Returns a hash of the midi channels and controller assignments that end up
+ * in the midimap file.
+ *****************************************************************************/
+static guint32
+hash_midimap(void)
+{
+	PARAM           *param;
+	guint32         hash = 2166136261U;
+	unsigned int    part_num;
+	unsigned int    param_num;
+
+	for (part_num = 0; part_num < MAX_PARTS; part_num++) {
+		hash = (hash ^ (guint32) get_part(part_num)->midi_channel) * 16777619U;
+		hash = (hash ^ (guint32) midi_split[part_num].key_low) * 16777619U;
+		hash = (hash ^ (guint32) midi_split[part_num].key_high) * 16777619U;
+		hash = (hash ^ (guint32) midi_split[part_num].velocity_low) * 16777619U;
+		hash = (hash ^ (guint32) midi_split[part_num].velocity_high) * 16777619U;
+	}
+	for (param_num = 0; param_num < NUM_PARAMS; param_num++) {
+		param = get_param(0, param_num);
+		hash = (hash ^ (guint32) param->info->cc_num) * 16777619U;
+		hash = (hash ^ (guint32) param->info->locked) * 16777619U;
+		hash = (hash ^ (guint32) param->info->cc_hires) * 16777619U;
+		hash = (hash ^ (guint32) param->info->nrpn_num) * 16777619U;
+		hash = (hash ^ (guint32) param->info->rpn_num) * 16777619U;
+	}
+
+	return hash;
+}
+
+
+/*****************************************************************************
+ * hash_pending()
+ *
+ * Returns a hash of the contents of a captured file.
+ *****************************************************************************/
+static guint32
+hash_pending(AUTOSAVE_PENDING *pending)
+{
+	guint32         hash = 2166136261U;
+	size_t          j;
+
+	for (j = 0; j < pending->len; j++) {
+		hash = (hash ^ (guint32)(unsigned char) pending->buf[j]) * 16777619U;
+	}
+
+	return hash;
+}
+
+
+/*****************************************************************************
+ * discard_pending()
+ *
+ * Drops captured files from the end of the autosave batch, down to <count>.
+ *****************************************************************************/
+static void
+discard_pending(int count)
+{
+	while (autosave_num_pending > count) {
+		autosave_num_pending--;
+		free(autosave_pending[autosave_num_pending].buf);
+		autosave_pending[autosave_num_pending].buf = NULL;
+		autosave_pending[autosave_num_pending].len = 0;
+	}
+}
+
+
+/*****************************************************************************
+ * autosave_snapshot()
+ *
+ * Captures the dump session for the visible session in memory, skipping
+ * everything that has not changed since the last autosave.  Per-part patch
+ * dumps are only captured for parts whose patch contents changed.  The
+ * midimap, config, and bank files in the dump session directory are only
+ * rewritten when anything else in the session, or the settings, changed.
+ *
+ * Runs in the gui thread, which owns the patches, banks, and settings, when
+ * the autosave thread has requested a snapshot.  The autosave thread then
+ * writes the captured files without touching any of them.  What was saved
+ * only counts as written once the autosave thread reports that the batch
+ * made it to disk, so a failed batch is captured again next time.
+ *****************************************************************************/
+void
+autosave_snapshot(void)
+{
+	SESSION         *session    = get_current_session();
+	PATCH           *patch;
+	char            filename[PATH_MAX];
+	guint32         hash;
+	unsigned int    sess_num    = visible_sess_num;
+	unsigned int    part_num;
+	int             settings_index;
+	int             dirty       = 0;
+
+	if (g_atomic_int_get(&autosave_snapshot_state) != AUTOSAVE_SNAPSHOT_REQUESTED) {
+		return;
+	}
+
+	/* the last batch is on disk, so its contents are now current */
+	if (g_atomic_int_compare_and_exchange(&autosave_batch_ok, 1, 0)) {
+		memcpy(autosave_patch_hash, batch_patch_hash, sizeof(autosave_patch_hash));
+		autosave_midimap_hash  = batch_midimap_hash;
+		autosave_settings_hash = batch_settings_hash;
+		autosave_initialized   = 1;
+	}
+	memcpy(batch_patch_hash, autosave_patch_hash, sizeof(batch_patch_hash));
+	batch_midimap_hash  = autosave_midimap_hash;
+	batch_settings_hash = autosave_settings_hash;
+
+	autosave_capture_thread = pthread_self();
+	autosave_capture_active = 1;
+	autosave_num_pending    = 0;
+
+	for (part_num = 0; part_num < MAX_PARTS; part_num++) {
+		patch = get_patch(sess_num, part_num, session->prog_num[part_num]);
+		hash  = hash_patch(patch);
+		if (!autosave_initialized || (hash != autosave_patch_hash[part_num])) {
+			if (save_patch(user_patchdump_file[part_num], patch) == 0) {
+				batch_patch_hash[part_num] = hash;
+				dirty = 1;
+			}
+		}
+	}
+
+	hash = hash_midimap();
+	if (!autosave_initialized || (hash != autosave_midimap_hash)) {
+		if (save_midimap(user_midimap_dump_file) == 0) {
+			batch_midimap_hash = hash;
+		}
+		dirty = 1;
+	}
+
+	/* settings are small enough to compare by their file contents */
+	settings_index = autosave_num_pending;
+	snprintf(filename, sizeof(filename), "%s/phasex.cfg", user_session_dump_dir);
+	save_settings(filename);
+	if (autosave_num_pending > settings_index) {
+		hash = hash_pending(& (autosave_pending[settings_index]));
+		if (!autosave_initialized || (hash != autosave_settings_hash)) {
+			batch_settings_hash = hash;
+			dirty = 1;
+		}
+	}
+
+	if (dirty) {
+		snprintf(filename, sizeof(filename), "%s/phasex.map", user_session_dump_dir);
+		save_midimap(filename);
+		snprintf(filename, sizeof(filename), "%s/%s", user_session_dump_dir, USER_BANK_FILE);
+		save_patch_bank(filename);
+		snprintf(filename, sizeof(filename), "%s/%s", user_session_dump_dir,
+		         USER_SESSION_BANK_FILE);
+		save_session_bank(filename);
+	}
+	else {
+		discard_pending(0);
+	}
+
+	autosave_capture_active = 0;
+
+	g_atomic_int_set(&autosave_snapshot_state,
+	                 (autosave_num_pending > 0) ?
+	                 AUTOSAVE_SNAPSHOT_READY : AUTOSAVE_SNAPSHOT_IDLE);
+}
+
+
+/*****************************************************************************
+ * autosave_dump_dir_ready()
+ *
+ * Makes sure the dump session directory exists before asking for a snapshot.
+ *****************************************************************************/
+static int
+autosave_dump_dir_ready(void)
+{
+	DIR             *dir;
+
+	if ((dir = opendir(user_session_dump_dir)) == NULL) {
+		if ((errno != ENOENT) || (mkdir(user_session_dump_dir, 0755) != 0)) {
+			PHASEX_ERROR("Unable to create session directory '%s'.\n",
+			             user_session_dump_dir);
+			return 0;
+		}
+	}
+	else {
+		closedir(dir);
+	}
+
+	return 1;
+}
+
+
+/*****************************************************************************
+ * request_autosave()
+ *
+ * Asks the autosave thread to write the dump session at its next wakeup,
+ * without waiting for the autosave interval.  Multiple requests made before
+ * the autosave thread wakes up are coalesced into a single autosave.
+ *****************************************************************************/
+void
+request_autosave(void)
+{
+	g_atomic_int_set(&autosave_requested, 1);
+}
+
+
+/*****************************************************************************
+ * autosave_thread()
+ *
+ * Background I/O thread for periodic session dumps, keeping disk access out
+ * of the gui thread.  The autosave interval is in seconds, and an interval of
+ * zero disables timed autosave.  The gui thread takes the snapshot of what
+ * gets saved (see autosave_snapshot()), and this thread writes it out.
+ *****************************************************************************/
+void *
+autosave_thread(void *UNUSED(arg))
+{
+	unsigned int    elapsed_usec = 0;
+
+	PHASEX_DEBUG(DEBUG_CLASS_INIT, "Starting Autosave Thread\n");
+
+	while (!pending_shutdown) {
+		usleep(AUTOSAVE_POLL_USEC);
+		elapsed_usec += AUTOSAVE_POLL_USEC;
+
+		/* write out the snapshot taken by the gui thread */
+		if (g_atomic_int_get(&autosave_snapshot_state) == AUTOSAVE_SNAPSHOT_READY) {
+			g_atomic_int_set(&autosave_batch_ok, (autosave_batch_commit() == 0));
+			g_atomic_int_set(&autosave_snapshot_state, AUTOSAVE_SNAPSHOT_IDLE);
+		}
+
+		if ((g_atomic_int_get(&autosave_snapshot_state) == AUTOSAVE_SNAPSHOT_IDLE) &&
+		    (g_atomic_int_compare_and_exchange(&autosave_requested, 1, 0) ||
+		     ((setting_autosave_interval > 0) &&
+		      (elapsed_usec >= ((unsigned int) setting_autosave_interval * 1000000))))) {
+			elapsed_usec = 0;
+			if (!pending_shutdown && autosave_dump_dir_ready()) {
+				g_atomic_int_set(&autosave_snapshot_state, AUTOSAVE_SNAPSHOT_REQUESTED);
+			}
+		}
+	}
+
+	pthread_exit(NULL);
+	return NULL;
+}
+
+
+/*****************************************************************************
+ * start_autosave_thread()
+ *****************************************************************************/
+void
+start_autosave_thread(void)
+{
+	int     ret;
+
+	if ((ret = pthread_create(&autosave_thread_p, NULL, &autosave_thread, NULL)) != 0) {
+		PHASEX_ERROR("Unable to start autosave thread (error %d).\n", ret);
+		autosave_thread_p = 0;
+	}
+}
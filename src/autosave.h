@@ -0,0 +1,70 @@
+/*****************************************************************************
+ *
+ * autosave.h
+ *
+ * PHASEX:  [P]hase [H]armonic [A]dvanced [S]ynthesis [EX]periment
+ *
+ * Copyright (C) 2012-2013 William Weston <whw@linuxmail.org>
+ *
+ * PHASEX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PHASEX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PHASEX.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+#ifndef _PHASEX_AUTOSAVE_H_
+#define _PHASEX_AUTOSAVE_H_
+
+#include <stdio.h>
+#include <pthread.h>
+#include <glib.h>
+#include "phasex.h"
+
+
+/* Autosave thread wakes up this often to check the interval and requests. */
+#define AUTOSAVE_POLL_USEC          250000
+
+/* Max number of files renamed into place in a single autosave batch. */
+#define AUTOSAVE_MAX_PENDING        (MAX_PARTS + 8)
+
+
+/* Autosave snapshot handoff between the autosave and gui threads. */
+#define AUTOSAVE_SNAPSHOT_IDLE      0
+#define AUTOSAVE_SNAPSHOT_REQUESTED 1
+#define AUTOSAVE_SNAPSHOT_READY     2
+
+
+typedef struct autosave_pending {
+	FILE            *file_f;                /* memory stream while capturing   */
+	char            *buf;                   /* captured file contents          */
+	size_t          len;                    /* length of captured contents     */
+	int             fd;                     /* open descriptor for fdatasync() */
+	char            tmpname[PATH_MAX];      /* temp file written by the batch  */
+	char            filename[PATH_MAX];     /* final name after rename()       */
+} AUTOSAVE_PENDING;
+
+
+extern pthread_t        autosave_thread_p;
+
+extern volatile gint    autosave_requested;
+extern volatile gint    autosave_snapshot_state;
+
+
+FILE *atomic_fopen(char *filename, char *tmpname, size_t tmpname_len);
+int atomic_fclose(FILE *file_f, char *tmpname, char *filename);
+
+void autosave_snapshot(void);
+void request_autosave(void);
+void *autosave_thread(void *UNUSED(arg));
+void start_autosave_thread(void);
+
+
+#endif /* _PHASEX_AUTOSAVE_H_ */
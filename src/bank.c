@@ -23,32 +23,61 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <errno.h>
 #include <ctype.h>
 #include <string.h>
 #include <math.h>
+#include <glib.h>
 #include "phasex.h"
 #include "config.h"
 #include "patch.h"
 #include "param.h"
+#include "param_cb.h"
 #include "bank.h"
 #include "session.h"
 #include "settings.h"
 #include "string_util.h"
 #include "engine.h"
-#include "gui_patch.h"
+#include "autosave.h"
+#include "midimap.h"
+#include "engine_api.h"
+#include "midi_process.h"
 #include "debug.h"
 
 
-PATCH           patch_bank[MAX_PARTS][PATCH_BANK_SIZE];
-PATCH_STATE     state_bank[MAX_PARTS][PATCH_BANK_SIZE];
+pthread_t       bank_thread_p           = 0;
 
 unsigned int    visible_sess_num        = 0;
 unsigned int    visible_part_num        = 0;
 unsigned int    visible_prog_num[MAX_PARTS];
 
+static BANK_SLOT        bank_slot[MAX_PARTS][PATCH_BANK_SIZE];
+
+/* Serializes loading of bank entries between the engine, gui, and bank
+   threads.  Lookups of entries already loaded do not take the lock. */
+static pthread_mutex_t  bank_load_mutex                         = PTHREAD_MUTEX_INITIALIZER;
+
+/* Pending prefetch and program change requests, as (prog_num + 1) per
+   part, or 0 for none. */
+static volatile gint    bank_prefetch_request[MAX_PARTS];
+static volatile gint    program_change_request[MAX_PARTS];
+
+/* Program changes ready to be picked up by the engine threads. */
+static PATCH            *prepared_patch[MAX_PARTS];
+
+/* Patch states for prepared program changes, built away from the live
+   state and copied in by the engine thread at the swap.  Busy from the
+   start of preparation until the engine thread has taken the copy. */
+static PATCH_STATE      prepared_state[MAX_PARTS];
+static volatile gint    prepared_state_busy[MAX_PARTS];
+
+static sem_t            bank_thread_sem;
+
 
 /*****************************************************************************
  * get_patch_from_bank()
@@ -61,7 +90,7 @@ get_patch_from_bank(unsigned int part_num, unsigned int prog_num)
 	if (prog_num == 0) {
 		return & (session_bank[visible_sess_num].patch[part_num]);
 	}
-	return & (patch_bank[part_num][prog_num]);
+	return get_bank_patch(part_num, prog_num);
 }
 
 
@@ -78,14 +107,373 @@ set_patch_from_bank(unsigned int part_num, unsigned int prog_num)
 		active_state[part_num] = & (session_bank[visible_sess_num].state[part_num]);
 	}
 	else {
-		active_patch[part_num] = & (patch_bank[part_num][prog_num]);
-		active_state[part_num] = & (state_bank[part_num][prog_num]);
+		active_patch[part_num] = get_bank_patch(part_num, prog_num);
+		active_state[part_num] = active_patch[part_num]->state;
 	}
 
 	return active_patch[part_num];
 }
 
 
+/*****************************************************************************
+ * read_bank_slot_patch()
+ *
+ * Reads a bank slot's patch file into <patch>, falling back to the default
+ * patch for empty slots and unreadable files.  Called with bank_load_mutex
+ * held.
+ *****************************************************************************/
+static void
+read_bank_slot_patch(BANK_SLOT *slot, PATCH *patch, unsigned int prog_num)
+{
+	char            *tmpname;
+	char            buffer[32];
+
+	if ((slot->filename == NULL) || (read_patch(slot->filename, patch) != 0)) {
+		if (slot->filename != NULL) {
+			PHASEX_WARN("Failed to load patch '%s'\n", slot->filename);
+		}
+
+		/* initialize on failure and set name based on program number */
+		if (read_patch(user_default_patch, patch) != 0) {
+			if (read_patch(sys_default_patch, patch) != 0) {
+				PHASEX_WARN("Unable to load system default patch '%s'\n", sys_default_patch);
+			}
+		}
+		snprintf(buffer, sizeof(buffer), "Untitled-%04d", (prog_num + 1));
+		tmpname = patch->name;
+		patch->name = strdup(buffer);
+		if (tmpname != NULL) {
+			free(tmpname);
+		}
+		if (patch->directory != NULL) {
+			free(patch->directory);
+		}
+		patch->directory = strdup(user_patch_dir);
+	}
+	patch->modified = 0;
+}
+
+
+/*****************************************************************************
+ * load_bank_entry()
+ *
+ * Builds the patch and patch state for a bank slot from its patch file.
+ * Called with bank_load_mutex held.
+ *****************************************************************************/
+static BANK_ENTRY *
+load_bank_entry(unsigned int part_num, unsigned int prog_num)
+{
+	BANK_SLOT       *slot   = & (bank_slot[part_num][prog_num]);
+	BANK_ENTRY      *entry;
+	PATCH           *patch;
+
+	if ((entry = calloc(1, sizeof(BANK_ENTRY))) == NULL) {
+		phasex_shutdown("Out of memory!\n");
+	}
+
+	patch            = & (entry->patch);
+	patch->name      = NULL;
+	patch->filename  = NULL;
+	patch->directory = NULL;
+	init_patch_data_structures(patch, SESSION_BANK_SIZE, part_num, prog_num);
+	patch->state     = & (entry->state);
+	patch->param[PARAM_MIDI_CHANNEL].value.cc_prev = (int) part_num;
+	patch->param[PARAM_MIDI_CHANNEL].value.cc_val  = (int) part_num;
+	patch->param[PARAM_MIDI_CHANNEL].value.int_val = (int) part_num +
+		patch->param[PARAM_MIDI_CHANNEL].info->cc_offset;
+
+	read_bank_slot_patch(slot, patch, prog_num);
+
+	PHASEX_DEBUG(DEBUG_CLASS_INIT, "Loaded bank patch:  part=%d  prog=%d  '%s'\n",
+	             (part_num + 1), (prog_num + 1), patch->name);
+
+	return entry;
+}
+
+
+/*****************************************************************************
+ * get_bank_patch()
+ *
+ * Returns the patch for a bank program, loading it on first use.
+ *****************************************************************************/
+PATCH *
+get_bank_patch(unsigned int part_num, unsigned int prog_num)
+{
+	BANK_SLOT       *slot   = & (bank_slot[part_num][prog_num]);
+	BANK_ENTRY      *entry;
+
+	if ((entry = g_atomic_pointer_get(&slot->entry)) == NULL) {
+		pthread_mutex_lock(&bank_load_mutex);
+		if ((entry = slot->entry) == NULL) {
+			entry = load_bank_entry(part_num, prog_num);
+			g_atomic_pointer_set(&slot->entry, entry);
+		}
+		pthread_mutex_unlock(&bank_load_mutex);
+	}
+
+	return & (entry->patch);
+}
+
+
+/*****************************************************************************
+ * get_bank_state()
+ *****************************************************************************/
+PATCH_STATE *
+get_bank_state(unsigned int part_num, unsigned int prog_num)
+{
+	return get_bank_patch(part_num, prog_num)->state;
+}
+
+
+/*****************************************************************************
+ * get_loaded_bank_patch()
+ *
+ * Returns the patch for a bank program, or NULL if it has not been loaded.
+ *****************************************************************************/
+PATCH *
+get_loaded_bank_patch(unsigned int part_num, unsigned int prog_num)
+{
+	BANK_ENTRY      *entry = g_atomic_pointer_get(&bank_slot[part_num][prog_num].entry);
+
+	if (entry == NULL) {
+		return NULL;
+	}
+	return & (entry->patch);
+}
+
+
+/*****************************************************************************
+ * request_bank_prefetch()
+ *
+ * Asks the bank thread to load the programs surrounding prog_num.  Only
+ * the most recent request for each part is kept.
+ *****************************************************************************/
+void
+request_bank_prefetch(unsigned int part_num, unsigned int prog_num)
+{
+	g_atomic_int_set(&bank_prefetch_request[part_num], (gint)(prog_num + 1));
+}
+
+
+/*****************************************************************************
+ * prepare_program_change()
+ *
+ * Loads the patch for a MIDI program change and builds its patch state in
+ * the part's prepared state, then hands it to the engine thread for the
+ * part.  Runs in the bank thread, so patch file I/O and parameter callbacks
+ * stay off of the realtime path.  The patch's own state may be live, so it
+ * is left for the engine thread to update in commit_program_change().
+ *****************************************************************************/
+static void
+prepare_program_change(unsigned int part_num, unsigned int prog_num)
+{
+	PATCH           *patch = get_patch(visible_sess_num, part_num, prog_num);
+
+	memset(&prepared_state[part_num], 0, sizeof(PATCH_STATE));
+
+	/* part, voice, and effect state is applied at the swap frame */
+	set_param_cb_state_only(&prepared_state[part_num]);
+	init_patch_state(patch);
+	set_param_cb_state_only(NULL);
+
+	PHASEX_DEBUG(DEBUG_CLASS_MIDI_EVENT,
+	             "\n*** Program Change Ready:  part=%d  prog=%d (%d)\n\n",
+	             (part_num + 1), prog_num, (prog_num + 1));
+
+	g_atomic_pointer_set(&prepared_patch[part_num], patch);
+	request_bank_prefetch(part_num, prog_num);
+}
+
+
+/*****************************************************************************
+ * take_prepared_patch()
+ *
+ * Returns the patch for a prepared program change, or NULL if there is
+ * none.  Called once per frame by the engine thread for the part.
+ *****************************************************************************/
+PATCH *
+take_prepared_patch(unsigned int part_num)
+{
+	PATCH           *patch = g_atomic_pointer_get(&prepared_patch[part_num]);
+
+	if ((patch != NULL) &&
+	    g_atomic_pointer_compare_and_exchange(&prepared_patch[part_num], patch, NULL)) {
+		return patch;
+	}
+	return NULL;
+}
+
+
+/*****************************************************************************
+ * commit_program_change()
+ *
+ * Makes a prepared patch the active patch for the part.  Called by the
+ * engine thread for the part at the frame where the swap happens.
+ *****************************************************************************/
+void
+commit_program_change(unsigned int part_num, PATCH *patch)
+{
+	SESSION         *session = get_current_session();
+	PATCH_STATE     *state   = &prepared_state[part_num];
+	PATCH           *prev    = active_patch[part_num];
+
+	/* keep the engine's running values, and ramp to the new targets if
+	   this state is already live */
+	state->filter_cutoff = patch->state->filter_cutoff;
+	state->smooth_serial = g_atomic_int_get(&patch->state->smooth_serial) + 1;
+	memcpy(patch->state, state, sizeof(PATCH_STATE));
+	g_atomic_int_set(&prepared_state_busy[part_num], 0);
+
+	patch->sess_num = visible_sess_num;
+
+	active_patch[part_num] = patch;
+	active_state[part_num] = patch->state;
+	apply_patch_part_state(patch, prev);
+
+	visible_prog_num[part_num]                        = patch->prog_num;
+	session_bank[visible_sess_num].prog_num[part_num] = patch->prog_num;
+	notify_visible_patch(part_num, patch);
+	session->modified = 1;
+
+	replay_held_midi_events(part_num);
+}
+
+
+/*****************************************************************************
+ * prepare_program_change_requests()
+ *
+ * Prepares all pending MIDI program change requests.  Called from the bank
+ * thread, or directly by synchronous engine clients running without one.
+ *****************************************************************************/
+void
+prepare_program_change_requests(void)
+{
+	unsigned int    part_num;
+	gint            request;
+	PATCH           *patch;
+
+	for (part_num = 0; part_num < MAX_PARTS; part_num++) {
+		request = g_atomic_int_get(&program_change_request[part_num]);
+		if (request == 0) {
+			continue;
+		}
+
+		/* a newer request replaces one the engine has not taken yet */
+		patch = g_atomic_pointer_get(&prepared_patch[part_num]);
+		if ((patch != NULL) &&
+		    g_atomic_pointer_compare_and_exchange(&prepared_patch[part_num], patch, NULL)) {
+			g_atomic_int_set(&prepared_state_busy[part_num], 0);
+		}
+
+		/* otherwise, wait for the engine to finish with the last one */
+		if (g_atomic_int_get(&prepared_state_busy[part_num])) {
+			continue;
+		}
+
+		if (g_atomic_int_compare_and_exchange(&program_change_request[part_num],
+		                                      request, 0)) {
+			g_atomic_int_set(&prepared_state_busy[part_num], 1);
+			prepare_program_change(part_num, (unsigned int)(request - 1));
+		}
+	}
+}
+
+
+/*****************************************************************************
+ * program_change_requested()
+ *
+ * Returns nonzero when a MIDI program change is waiting to be prepared.
+ * Safe to call from any thread.
+ *****************************************************************************/
+int
+program_change_requested(void)
+{
+	unsigned int    part_num;
+
+	for (part_num = 0; part_num < MAX_PARTS; part_num++) {
+		if (g_atomic_int_get(&program_change_request[part_num]) != 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+
+/*****************************************************************************
+ * bank_thread()
+ *
+ * Background loader for bank programs.  Prepares MIDI program changes for
+ * the engine threads, then loads bank programs near the most recently
+ * selected program on each part.
+ *****************************************************************************/
+void *
+bank_thread(void *UNUSED(arg))
+{
+	struct timespec wake_time;
+	unsigned int    part_num;
+	int             prog_num;
+	int             prog;
+	gint            request;
+
+	PHASEX_DEBUG(DEBUG_CLASS_INIT, "Starting Bank Thread\n");
+
+	while (!pending_shutdown) {
+		clock_gettime(CLOCK_REALTIME, &wake_time);
+		wake_time.tv_nsec += BANK_THREAD_POLL_USEC * 1000;
+		if (wake_time.tv_nsec >= 1000000000) {
+			wake_time.tv_nsec -= 1000000000;
+			wake_time.tv_sec++;
+		}
+		sem_timedwait(&bank_thread_sem, &wake_time);
+
+		/* program changes are waiting on us, so they go first */
+		prepare_program_change_requests();
+
+		for (part_num = 0; part_num < MAX_PARTS; part_num++) {
+			request = g_atomic_int_get(&bank_prefetch_request[part_num]);
+			if ((request == 0) ||
+			    !g_atomic_int_compare_and_exchange(&bank_prefetch_request[part_num],
+			                                       request, 0)) {
+				continue;
+			}
+			prog_num = (int) request - 1;
+
+			/* nearest neighbours first */
+			for (prog = 1; prog <= BANK_PREFETCH_RADIUS; prog++) {
+				if (pending_shutdown ||
+				    (g_atomic_int_get(&program_change_request[part_num]) != 0)) {
+					break;
+				}
+				if ((prog_num + prog) < PATCH_BANK_SIZE) {
+					get_bank_patch(part_num, (unsigned int)(prog_num + prog));
+				}
+				if ((prog_num - prog) > 0) {
+					get_bank_patch(part_num, (unsigned int)(prog_num - prog));
+				}
+			}
+		}
+	}
+
+	pthread_exit(NULL);
+	return NULL;
+}
+
+
+/*****************************************************************************
+ * start_bank_thread()
+ *****************************************************************************/
+void
+start_bank_thread(void)
+{
+	int     ret;
+
+	if ((ret = pthread_create(&bank_thread_p, NULL, &bank_thread, NULL)) != 0) {
+		PHASEX_ERROR("Unable to start bank thread (error %d).\n", ret);
+		bank_thread_p = 0;
+	}
+}
+
+
 /*****************************************************************************
  * init_patch_bank()
  *****************************************************************************/
@@ -94,26 +482,18 @@ init_patch_bank(char *filename)
 {
 	PATCH           *patch;
 	int             part_num;
-	unsigned int    prog_num;
 
-	/* initialize patchbank memory */
+	sem_init(&bank_thread_sem, 0, 0);
+
+	/* bank programs are loaded on first use, so only the session
+	   programs need patch data up front. */
 	for (part_num = 0; part_num < MAX_PARTS; part_num++) {
 		visible_prog_num[part_num] = 0;
 		get_part(part_num)->midi_channel = part_num;
-		for (prog_num = 0; prog_num < PATCH_BANK_SIZE; prog_num++) {
-			patch            = & (patch_bank[part_num][prog_num]);
-			patch->name      = NULL;
-			patch->filename  = NULL;
-			patch->directory = NULL;
-			init_patch_data_structures(patch, SESSION_BANK_SIZE, (unsigned int) part_num, prog_num);
-			patch->param[PARAM_MIDI_CHANNEL].value.cc_prev = part_num;
-			patch->param[PARAM_MIDI_CHANNEL].value.cc_val  = part_num;
-			patch->param[PARAM_MIDI_CHANNEL].value.int_val = part_num +
-				patch->param[PARAM_MIDI_CHANNEL].info->cc_offset;
-		}
 		patch = set_active_patch(0, (unsigned int) part_num, 0);
 		read_patch(sys_default_patch, patch);
 	}
+	build_midi_route();
 
 	/* load the bank for all parts */
 	load_patch_bank(filename);
@@ -122,10 +502,16 @@ init_patch_bank(char *filename)
 
 /*****************************************************************************
  * load_patch_bank()
+ *
+ * Reads the bank file, recording the patch file and name for each program.
+ * Patches themselves are read on first use.  Programs the bank defines that
+ * were already loaded are read again in place, so that no program keeps the
+ * patch of the previous bank.
  *****************************************************************************/
 void
 load_patch_bank(char *filename)
 {
+	BANK_SLOT       *slot;
 	PATCH           *patch;
 	FILE            *bank_f;
 	char            *bank_file;
@@ -137,7 +523,6 @@ load_patch_bank(char *filename)
 	int             prog        = 0;
 	unsigned int    line        = 0;
 	static int      once        = 1;
-	int             result;
 
 	if (filename == NULL) {
 		bank_file = user_bank_file;
@@ -193,7 +578,6 @@ load_patch_bank(char *filename)
 		if ((prog < 0) || (prog >= PATCH_BANK_SIZE)) {
 			prog = 0;
 		}
-		patch = & (patch_bank[part_num][prog]);
 
 		/* make sure there's an '=' */
 		if ((p = get_next_token(buffer)) == NULL) {
@@ -231,74 +615,63 @@ load_patch_bank(char *filename)
 		/* flush remainder of line */
 		while (get_next_token(buffer) != NULL);
 
-		/* load patch into bank */
-		result = 0;
+		/* Lock some global parameters after the first patch is found */
+		if (once) {
+			get_param_info_by_id(PARAM_MIDI_CHANNEL)->locked = 1;
+			get_param_info_by_id(PARAM_BPM)->locked          = 1;
+
+			once = 0;
+		}
+
+		/* program 1 always comes from the session bank. */
+		if (prog == 0) {
+			free(patch_file);
+			continue;
+		}
+		slot = & (bank_slot[part_num][prog]);
+		pthread_mutex_lock(&bank_load_mutex);
+		if (slot->filename != NULL) {
+			free(slot->filename);
+		}
+		if (slot->name != NULL) {
+			free(slot->name);
+		}
 
 		/* handle bare patch names from 0.10.x versions */
 		if (patch_file[0] != '/') {
 			snprintf(buffer, sizeof(buffer), "%s/%s.phx", user_patch_dir, patch_file);
-			result = read_patch(buffer, patch);
-			if (result != 0) {
+			if (access(buffer, R_OK) != 0) {
 				snprintf(buffer, sizeof(buffer), "%s/%s.phx", PATCH_DIR, patch_file);
-				result = read_patch(buffer, patch);
-			}
-			if (result != 0) {
-				PHASEX_WARN("Failed to load patch '%s''\n", buffer);
 			}
+			slot->filename = strdup(buffer);
 		}
 
 		/* handle fully qualified filenames */
 		else {
-			result = read_patch(patch_file, patch);
+			slot->filename = strdup(patch_file);
 		}
-
-		/* initialize on failure and set name based on program number */
-		if (result != 0) {
-			if (read_patch(user_default_patch, patch) != 0) {
-				if (read_patch(sys_default_patch, patch) != 0) {
-					PHASEX_WARN("Unable to load system default patch '%s'\n", sys_default_patch);
-				}
-			}
-			snprintf(buffer, sizeof(buffer), "Untitled-%04d", (prog + 1));
-			tmpname = patch->name;
-			patch->name = strdup(buffer);
-			if (tmpname != NULL) {
-				free(tmpname);
-			}
-			if (patch->directory != NULL) {
-				free(patch->directory);
+		if (slot->filename == NULL) {
+			phasex_shutdown("Out of memory!\n");
+		}
+		slot->name = get_patch_name_from_filename(slot->filename);
+
+		/* loaded programs are replaced in place, since the engine or
+		   gui may be holding on to the patch. */
+		if (slot->entry != NULL) {
+			patch = & (slot->entry->patch);
+			read_bank_slot_patch(slot, patch, (unsigned int) prog);
+			if (patch == get_active_patch((unsigned int) part_num)) {
+				init_patch_state(patch);
 			}
-			patch->directory = strdup(user_patch_dir);
 		}
+		pthread_mutex_unlock(&bank_load_mutex);
 
 		/* free up memory used to piece filename together */
 		free(patch_file);
-
-		/* Lock some global parameters after the first patch is read */
-		if (once) {
-			get_param_info_by_id(PARAM_MIDI_CHANNEL)->locked = 1;
-			get_param_info_by_id(PARAM_BPM)->locked          = 1;
-
-			once = 0;
-		}
 	}
 
-	/* done parsing */
+	/* done parsing.  empty bank slots get the default patch on first use. */
 	fclose(bank_f);
-
-	/* now fill the empty bank slots with the default patch */
-	for (prog = 0; prog < PATCH_BANK_SIZE; prog++) {
-		patch = & (patch_bank[part_num][prog]);
-		if (patch->name == NULL) {
-			if (read_patch(user_default_patch, patch) != 0) {
-				read_patch(sys_default_patch, patch);
-			}
-			snprintf(buffer, sizeof(buffer), "Untitled-%04d", (prog + 1));
-			patch->name = strdup(buffer);
-			patch->directory = strdup(user_patch_dir);
-		}
-		patch->modified = 0;
-	}
 }
 
 
@@ -311,6 +684,8 @@ save_patch_bank(char *filename)
 	PATCH           *patch;
 	FILE            *bank_f;
 	char            *bank_file;
+	char            *patch_file;
+	char            tmpname[PATH_MAX];
 	unsigned int    part_num;
 	unsigned int    prog;
 
@@ -322,7 +697,7 @@ save_patch_bank(char *filename)
 	}
 
 	/* open the bank file */
-	if ((bank_f = fopen(bank_file, "wt")) == NULL) {
+	if ((bank_f = atomic_fopen(bank_file, tmpname, sizeof(tmpname))) == NULL) {
 		PHASEX_ERROR("Error opening bank file %s for write: %s\n",
 		             bank_file, strerror(errno));
 		return;
@@ -333,17 +708,23 @@ save_patch_bank(char *filename)
 	for (part_num = 0; part_num < MAX_PARTS; part_num++) {
 		/* first program for each part is always from the session dump */
 		fprintf(bank_f, "%d,0001 = %s;\n", (part_num + 1), user_patchdump_file[part_num]);
-		/* fill in the rest from the in-memory bank */
+		/* fill in the rest from the in-memory bank, without loading
+		   programs that have not been used yet */
 		for (prog = 1; prog < PATCH_BANK_SIZE; prog++) {
-			patch = get_patch_from_bank(part_num, prog);
-			if (patch->filename != NULL) {
-				fprintf(bank_f, "%d,%04d = %s;\n", (part_num + 1), (prog + 1), patch->filename);
+			if ((patch = get_loaded_bank_patch(part_num, prog)) != NULL) {
+				patch_file = patch->filename;
+			}
+			else {
+				patch_file = bank_slot[part_num][prog].filename;
+			}
+			if (patch_file != NULL) {
+				fprintf(bank_f, "%d,%04d = %s;\n", (part_num + 1), (prog + 1), patch_file);
 			}
 		}
 	}
 
 	/* done saving */
-	fclose(bank_f);
+	atomic_fclose(bank_f, tmpname, bank_file);
 }
 
 
@@ -354,11 +735,22 @@ unsigned int
 find_patch(char *name, unsigned int part_num)
 {
 	PATCH           *patch;
+	char            *patch_name;
+	char            buffer[32];
 	unsigned int    prog;
 
 	for (prog = 0; prog < PATCH_BANK_SIZE; prog++) {
-		patch = get_patch_from_bank(part_num, prog);
-		if (strcmp(name, patch->name) == 0) {
+		if (prog == 0) {
+			patch_name = get_patch_from_bank(part_num, 0)->name;
+		}
+		else if ((patch = get_loaded_bank_patch(part_num, prog)) != NULL) {
+			patch_name = patch->name;
+		}
+		else if ((patch_name = bank_slot[part_num][prog].name) == NULL) {
+			snprintf(buffer, sizeof(buffer), "Untitled-%04d", (prog + 1));
+			patch_name = buffer;
+		}
+		if ((patch_name != NULL) && (strcmp(name, patch_name) == 0)) {
 			break;
 		}
 	}
@@ -462,23 +854,16 @@ get_patch_name_from_filename(char *filename)
 /*****************************************************************************
  * midi_select_program()
  *****************************************************************************/
-void
+int
 midi_select_program(unsigned int part_num, unsigned int prog_num)
 {
-	SESSION     *session = get_current_session();
-	PATCH       *patch;
-
 	if (!setting_ignore_midi_program_change) {
-		patch = set_active_patch(visible_sess_num, part_num, prog_num);
-		init_patch_state(patch);
 		PHASEX_DEBUG(DEBUG_CLASS_MIDI_EVENT,
 		             "\n*** MIDI Program Change:  part=%d  prog=%d (%d)\n\n",
 		             (part_num + 1), prog_num, (prog_num + 1));
-		visible_prog_num[part_num]                        = prog_num;
-		session_bank[visible_sess_num].prog_num[part_num] = prog_num;
-		if ((part_num == visible_part_num)) {
-			pending_visible_patch = patch;
-		}
-		session->modified = 1;
+		g_atomic_int_set(&program_change_request[part_num], (gint)(prog_num + 1));
+		sem_post(&bank_thread_sem);
+		return 1;
 	}
+	return 0;
 }
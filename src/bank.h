@@ -23,6 +23,7 @@
 #ifndef _PHASEX_BANK_H_
 #define _PHASEX_BANK_H_
 
+#include <pthread.h>
 #include <gtk/gtk.h>
 #include "phasex.h"
 #include "patch.h"
@@ -34,9 +35,27 @@
 
 #define PATCH_BANK_SIZE     1024
 
+/* Programs on either side of a newly selected program that are loaded in
+   the background, so that stepping through a bank rarely touches disk. */
+#define BANK_PREFETCH_RADIUS        2
+#define BANK_THREAD_POLL_USEC       20000
 
-extern PATCH        patch_bank[MAX_PARTS][PATCH_BANK_SIZE];
-extern PATCH_STATE  state_bank[MAX_PARTS][PATCH_BANK_SIZE];
+
+/* Patch and state for a bank program, allocated on first use. */
+typedef struct bank_entry {
+	PATCH               patch;
+	PATCH_STATE         state;
+} BANK_ENTRY;
+
+/* Bank programs are kept as references until first selected. */
+typedef struct bank_slot {
+	char                *filename;      /* patch file, or NULL if empty */
+	char                *name;          /* patch name until loaded      */
+	BANK_ENTRY          *entry;         /* NULL until loaded            */
+} BANK_SLOT;
+
+
+extern pthread_t    bank_thread_p;
 
 extern unsigned int visible_sess_num;
 extern unsigned int visible_part_num;
@@ -46,6 +65,18 @@ extern unsigned int visible_prog_num[MAX_PARTS];
 PATCH *get_patch_from_bank(unsigned int part_num, unsigned int prog_num);
 PATCH *set_patch_from_bank(unsigned int part_num, unsigned int prog_num);
 
+PATCH *get_bank_patch(unsigned int part_num, unsigned int prog_num);
+PATCH_STATE *get_bank_state(unsigned int part_num, unsigned int prog_num);
+PATCH *get_loaded_bank_patch(unsigned int part_num, unsigned int prog_num);
+
+void request_bank_prefetch(unsigned int part_num, unsigned int prog_num);
+PATCH *take_prepared_patch(unsigned int part_num);
+void commit_program_change(unsigned int part_num, PATCH *patch);
+void prepare_program_change_requests(void);
+int program_change_requested(void);
+void *bank_thread(void *UNUSED(arg));
+void start_bank_thread(void);
+
 void init_patch_bank(char *filename);
 void load_patch_bank(char *filename);
 void save_patch_bank(char *filename);
@@ -56,7 +87,7 @@ unsigned int find_patch(char *name, unsigned int part_num);
 
 char *get_patch_name_from_filename(char *filename);
 
-void midi_select_program(unsigned int part_num, unsigned int prog_num);
+int midi_select_program(unsigned int part_num, unsigned int prog_num);
 
 
 #endif /* _PHASEX_BANK_H_ */
@@ -40,6 +40,7 @@ void
 override_bpm(unsigned int new_bpm)
 {
 	PARAM           *param;
+	PATCH           *patch;
 	unsigned int    sess_num;
 	unsigned int    part_num;
 	unsigned int    prog_num;
@@ -47,9 +48,13 @@ override_bpm(unsigned int new_bpm)
 	if (new_bpm > 0) {
 		for (part_num = 0; part_num < MAX_PARTS; part_num++) {
 			get_param_info_by_id(PARAM_BPM)->locked = 1;
-			for (prog_num = 0; prog_num < PATCH_BANK_SIZE; prog_num++) {
-				param = & (patch_bank[part_num]
-				           [prog_num].param[PARAM_BPM]);
+			/* bank programs not loaded yet pick up the locked bpm
+			   when they are read. */
+			for (prog_num = 1; prog_num < PATCH_BANK_SIZE; prog_num++) {
+				if ((patch = get_loaded_bank_patch(part_num, prog_num)) == NULL) {
+					continue;
+				}
+				param = & (patch->param[PARAM_BPM]);
 				param->value.cc_prev = param->value.cc_val;
 				param->value.cc_val  = (int) new_bpm - 64;
 				param->value.int_val = (int) new_bpm;
@@ -24,19 +24,19 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
+#include <string.h>
 #include <glib.h>
 #include "phasex.h"
 #include "buffer.h"
 #include "timekeeping.h"
 #include "driver.h"
+#include "settings.h"
 #include "debug.h"
 
 
 unsigned int    buffer_size         = PHASEX_MAX_BUFSIZE;
-unsigned int    buffer_size_mask    = (PHASEX_MAX_BUFSIZE - 1);
 unsigned int    buffer_periods      = DEFAULT_BUFFER_PERIODS;
 unsigned int    buffer_period_size  = DEFAULT_BUFFER_PERIOD_SIZE;
-unsigned int    buffer_period_mask  = DEFAULT_BUFFER_PERIOD_SIZE - 1;
 unsigned int    buffer_latency      = DEFAULT_BUFFER_PERIOD_SIZE;
 unsigned int    buffer_size_bits;
 unsigned int    buffer_period_size_bits;
@@ -44,27 +44,199 @@ unsigned int    buffer_period_size_bits;
 volatile gint   audio_index;
 volatile gint   midi_index;
 volatile gint   engine_index;
+volatile gint   buffer_generation;
 
-int             need_index_resync[MAX_PARTS];
+
+/*****************************************************************************
+ * set_buffer_geometry()
+ *  unsigned int    period_size
+ *
+ * Sets ring buffer size, number of periods, and latency for the given audio
+ * period size.  Period size does not need to be a power of two.  The number
+ * of periods comes from setting_buffer_periods, reduced as necessary to fit
+ * within PHASEX_MAX_BUFSIZE.  Returns 0 on success, or -1 if the period size
+ * is too large to fit MIN_BUFFER_PERIODS periods in the ring.
+ *****************************************************************************/
+int
+set_buffer_geometry(unsigned int period_size)
+{
+	unsigned int    periods = setting_buffer_periods;
+
+	if ((period_size == 0) || (period_size > (PHASEX_MAX_BUFSIZE / MIN_BUFFER_PERIODS))) {
+		PHASEX_ERROR("Period size %u not supported.  Max is %u.\n",
+		             period_size, (PHASEX_MAX_BUFSIZE / MIN_BUFFER_PERIODS));
+		return -1;
+	}
+
+	if (periods < MIN_BUFFER_PERIODS) {
+		periods = MIN_BUFFER_PERIODS;
+	}
+	if ((periods * period_size) > PHASEX_MAX_BUFSIZE) {
+		periods = PHASEX_MAX_BUFSIZE / period_size;
+		PHASEX_WARN("Reducing buffer to %u periods of %u frames.\n",
+		            periods, period_size);
+	}
+
+	buffer_period_size = period_size;
+	buffer_periods     = periods;
+	buffer_size        = period_size * periods;
+	buffer_latency     = setting_buffer_latency * period_size;
+
+	return 0;
+}
 
 
 /*****************************************************************************
  * init_buffer_indices()
+ *
+ * Resets the audio (read) and engine / midi (write) cursors.  With <resync>
+ * set, the buffer generation is bumped so that engine threads pick up the new
+ * engine index at their next period boundary.
  *****************************************************************************/
 void
 init_buffer_indices(int resync)
 {
-	int             part_num;
-
 	g_atomic_int_set(&need_increment, 0);
 	set_audio_index(buffer_size - buffer_latency);
 	set_engine_index(0);
 	set_midi_index(0);
 	if (resync) {
-		for (part_num = 0; part_num < MAX_PARTS; part_num++) {
-			need_index_resync[part_num] = 1;
-		}
+		g_atomic_int_inc(&buffer_generation);
+	}
+}
+
+
+/*****************************************************************************
+ * get_buffer_generation()
+ *
+ * Atomically reads buffer_generation, which changes every time the buffer
+ * indices are forcibly reset.
+ *****************************************************************************/
+unsigned int
+get_buffer_generation(void)
+{
+	volatile gint   *addr = &buffer_generation;
+	return (unsigned int) g_atomic_int_get(addr);
+}
+
+
+/*****************************************************************************
+ *
+ * Ring Buffer Helpers:
+ *
+ * Part output buffers and the input buffers are rings of buffer_size frames.
+ * The engine threads write at the engine index, the audio thread reads (and
+ * writes inputs) at the audio index.  Spans that cross the end of the ring are
+ * split into two contiguous copies.
+ *
+ *****************************************************************************/
+
+/*****************************************************************************
+ * buffer_index_add()
+ *
+ * Returns <index> advanced by <nframes>, wrapped to the ring size.
+ *****************************************************************************/
+unsigned int
+buffer_index_add(unsigned int index, unsigned int nframes)
+{
+	index += nframes;
+	while (index >= buffer_size) {
+		index -= buffer_size;
+	}
+	return index;
+}
+
+
+/*****************************************************************************
+ * buffer_contiguous_frames()
+ *
+ * Returns the number of the <nframes> frames starting at <index> that can be
+ * accessed before wrapping to the start of the ring.
+ *****************************************************************************/
+unsigned int
+buffer_contiguous_frames(unsigned int index, unsigned int nframes)
+{
+	if ((index + nframes) > buffer_size) {
+		return (buffer_size - index);
+	}
+	return nframes;
+}
+
+
+/*****************************************************************************
+ * buffer_read_ring()
+ *
+ * Copies <nframes> frames from <ring> starting at <index> into <dest>.
+ *****************************************************************************/
+void
+buffer_read_ring(float *dest, volatile sample_t *ring,
+                 unsigned int index, unsigned int nframes)
+{
+	unsigned int    len = buffer_contiguous_frames(index, nframes);
+#ifndef MATH_32_BIT
+	unsigned int    j;
+#endif
+
+#ifdef MATH_32_BIT
+	memcpy((void *) dest, (void *) & (ring[index]), sizeof(float) * len);
+	memcpy((void *) & (dest[len]), (void *) ring, sizeof(float) * (nframes - len));
+#else
+	for (j = 0; j < len; j++) {
+		dest[j] = (float) ring[index + j];
+	}
+	for (; j < nframes; j++) {
+		dest[j] = (float) ring[j - len];
+	}
+#endif
+}
+
+
+/*****************************************************************************
+ * buffer_mix_ring()
+ *
+ * Mixes <nframes> frames from <ring> starting at <index> into <dest>.
+ *****************************************************************************/
+void
+buffer_mix_ring(float *dest, volatile sample_t *ring,
+                unsigned int index, unsigned int nframes)
+{
+	unsigned int    len = buffer_contiguous_frames(index, nframes);
+	unsigned int    j;
+
+	for (j = 0; j < len; j++) {
+		dest[j] += (float) ring[index + j];
+	}
+	for (; j < nframes; j++) {
+		dest[j] += (float) ring[j - len];
+	}
+}
+
+
+/*****************************************************************************
+ * buffer_write_ring()
+ *
+ * Copies <nframes> frames from <src> into <ring> starting at <index>.
+ *****************************************************************************/
+void
+buffer_write_ring(sample_t *ring, float *src,
+                  unsigned int index, unsigned int nframes)
+{
+	unsigned int    len = buffer_contiguous_frames(index, nframes);
+#ifndef MATH_32_BIT
+	unsigned int    j;
+#endif
+
+#ifdef MATH_32_BIT
+	memcpy((void *) & (ring[index]), (void *) src, sizeof(float) * len);
+	memcpy((void *) ring, (void *) & (src[len]), sizeof(float) * (nframes - len));
+#else
+	for (j = 0; j < len; j++) {
+		ring[index + j] = (sample_t) src[j];
+	}
+	for (; j < nframes; j++) {
+		ring[j - len] = (sample_t) src[j];
 	}
+#endif
 }
 
 
@@ -164,7 +336,7 @@ unsigned int
 test_audio_index(unsigned int val)
 {
 	volatile gint   *addr = &audio_index;
-	return ((((unsigned int) g_atomic_int_get(addr) + buffer_latency) & buffer_size_mask) == val);
+	return (buffer_index_add((unsigned int) g_atomic_int_get(addr), buffer_latency) == val);
 }
 
 /*****************************************************************************
@@ -191,7 +363,7 @@ inc_audio_index(unsigned int nframes)
 	guint           old_read_index;
 	guint           new_read_index;
 	old_read_index = (guint) g_atomic_int_get(addr);
-	new_read_index = ((old_read_index + nframes) & buffer_size_mask);
+	new_read_index = buffer_index_add(old_read_index, nframes);
 	g_atomic_int_set(addr, (gint) new_read_index);
 }
 
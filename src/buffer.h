@@ -27,23 +27,37 @@
 #include "phasex.h"
 
 
+/* Minimum number of periods in the part output / input rings:  room for the
+   maximum latency setting, plus the period currently being rendered. */
+#define MIN_BUFFER_PERIODS      4
+#define MAX_BUFFER_PERIODS      32
+
+
 extern unsigned int     buffer_size;
-extern unsigned int     buffer_size_mask;
 extern unsigned int     buffer_latency;
 extern unsigned int     buffer_periods;
 extern unsigned int     buffer_period_size;
-extern unsigned int     buffer_period_mask;
 extern unsigned int     buffer_size_bits;
 extern unsigned int     buffer_period_size_bits;
 
 extern volatile gint    audio_index;
 extern volatile gint    midi_index;
 extern volatile gint    engine_index;
-
-extern int              need_index_resync[MAX_PARTS];
+extern volatile gint    buffer_generation;
 
 
+int set_buffer_geometry(unsigned int period_size);
 void init_buffer_indices(int resync);
+unsigned int get_buffer_generation(void);
+
+unsigned int buffer_index_add(unsigned int index, unsigned int nframes);
+unsigned int buffer_contiguous_frames(unsigned int index, unsigned int nframes);
+void buffer_read_ring(float *dest, volatile sample_t *ring,
+                      unsigned int index, unsigned int nframes);
+void buffer_mix_ring(float *dest, volatile sample_t *ring,
+                     unsigned int index, unsigned int nframes);
+void buffer_write_ring(sample_t *ring, float *src,
+                       unsigned int index, unsigned int nframes);
 
 unsigned int test_midi_index(unsigned int val);
 unsigned int get_midi_index(void);
@@ -0,0 +1,123 @@
+/*****************************************************************************
+ *
+ * control.c
+ *
+ * PHASEX:  [P]hase [H]armonic [A]dvanced [S]ynthesis [EX]periment
+ *
+ * Copyright (C) 2012-2013 William Weston <whw@linuxmail.org>
+ *
+ * PHASEX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PHASEX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PHASEX.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+#include <unistd.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+#include <glib.h>
+#include "phasex.h"
+#include "control.h"
+#include "param.h"
+#include "patch.h"
+#include "debug.h"
+
+
+pthread_t           control_thread_p    = 0;
+
+/* Mailbox of parameters whose full callbacks still need to run, written by
+   the engine threads and emptied by the control thread.  Repeated updates
+   of the same parameter before the control thread gets to it collapse into
+   a single callback run with the latest value. */
+static PARAM        *control_param[MAX_PARTS][NUM_PARAMS];
+static volatile gint control_part_pending[MAX_PARTS];
+
+static sem_t        control_sem;
+
+
+/*****************************************************************************
+ * queue_param_control()
+ *
+ * Hands a parameter off to the control thread for its full callback.  Safe
+ * to call from the engine threads.
+ *****************************************************************************/
+void
+queue_param_control(PARAM *param)
+{
+	unsigned int    part_num = param->patch->part_num;
+
+	g_atomic_pointer_set(&control_param[part_num][param->info->id], param);
+	g_atomic_int_set(&control_part_pending[part_num], 1);
+	sem_post(&control_sem);
+}
+
+
+/*****************************************************************************
+ * control_thread()
+ *
+ * Non-realtime thread for the expensive parts of parameter updates received
+ * via MIDI, such as buffer clears and updates that touch every part.
+ *****************************************************************************/
+void *
+control_thread(void *UNUSED(arg))
+{
+	PARAM           *param;
+	struct timespec wake_time;
+	unsigned int    part_num;
+	unsigned int    param_num;
+
+	PHASEX_DEBUG(DEBUG_CLASS_INIT, "Starting Control Thread\n");
+
+	while (!pending_shutdown) {
+		clock_gettime(CLOCK_REALTIME, &wake_time);
+		wake_time.tv_nsec += CONTROL_POLL_USEC * 1000;
+		if (wake_time.tv_nsec >= 1000000000) {
+			wake_time.tv_nsec -= 1000000000;
+			wake_time.tv_sec++;
+		}
+		sem_timedwait(&control_sem, &wake_time);
+
+		for (part_num = 0; part_num < MAX_PARTS; part_num++) {
+			if (!g_atomic_int_compare_and_exchange(&control_part_pending[part_num], 1, 0)) {
+				continue;
+			}
+			for (param_num = 0; param_num < NUM_PARAMS; param_num++) {
+				param = g_atomic_pointer_get(&control_param[part_num][param_num]);
+				if ((param != NULL) &&
+				    g_atomic_pointer_compare_and_exchange(&control_param[part_num][param_num],
+				                                          param, NULL)) {
+					cb_info[param_num].update_patch_state(param);
+				}
+			}
+		}
+	}
+
+	pthread_exit(NULL);
+	return NULL;
+}
+
+
+/*****************************************************************************
+ * start_control_thread()
+ *****************************************************************************/
+void
+start_control_thread(void)
+{
+	int     ret;
+
+	sem_init(&control_sem, 0, 0);
+	if ((ret = pthread_create(&control_thread_p, NULL, &control_thread, NULL)) != 0) {
+		PHASEX_ERROR("Unable to start control thread (error %d).\n", ret);
+		control_thread_p = 0;
+	}
+}
@@ -0,0 +1,44 @@
+/*****************************************************************************
+ *
+ * control.h
+ *
+ * PHASEX:  [P]hase [H]armonic [A]dvanced [S]ynthesis [EX]periment
+ *
+ * Copyright (C) 2012-2013 William Weston <whw@linuxmail.org>
+ *
+ * PHASEX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PHASEX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PHASEX.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+#ifndef _PHASEX_CONTROL_H_
+#define _PHASEX_CONTROL_H_
+
+#include <pthread.h>
+#include <glib.h>
+#include "phasex.h"
+#include "param.h"
+
+
+/* Control thread wakes up at least this often to check for shutdown. */
+#define CONTROL_POLL_USEC           100000
+
+
+extern pthread_t        control_thread_p;
+
+
+void queue_param_control(PARAM *param);
+void *control_thread(void *UNUSED(arg));
+void start_control_thread(void);
+
+
+#endif /* _PHASEX_CONTROL_H_ */
@@ -28,6 +28,7 @@
 #include <pthread.h>
 #include "phasex.h"
 #include "debug.h"
+#include "trace.h"
 
 
 DEBUG_RINGBUFFER    main_debug_queue;
@@ -35,7 +36,7 @@ DEBUG_RINGBUFFER    main_debug_queue;
 int                 debug       = 0;
 unsigned long       debug_class = 0;
 
-DEBUG_CLASS         debug_class_list[16] = {
+DEBUG_CLASS         debug_class_list[17] = {
 	{ DEBUG_CLASS_NONE,           "none" },
 	{ DEBUG_CLASS_INIT,           "init" },
 	{ DEBUG_CLASS_GUI,            "gui" },
@@ -50,6 +51,7 @@ DEBUG_CLASS         debug_class_list[16] = {
 	{ DEBUG_CLASS_ENGINE,         "engine" },
 	{ DEBUG_CLASS_ENGINE_TIMING,  "engine-timing" },
 	{ DEBUG_CLASS_SESSION,        "session" },
+	{ DEBUG_CLASS_TRACE,          "trace" },
 	{ DEBUG_CLASS_ALL,            "all" },
 	{ (~0UL),                     NULL }
 };
@@ -97,8 +99,13 @@ phasex_debug_thread(void *UNUSED(arg))
 			main_debug_queue.read_index =
 				(main_debug_queue.read_index + 1) & DEBUG_BUFFER_MASK;
 		}
+		if (g_atomic_int_get(&trace_enabled)) {
+			trace_drain();
+		}
 	}
 
+	close_trace_file();
+
 	pthread_exit(NULL);
 	return NULL;
 }
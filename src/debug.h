@@ -48,7 +48,9 @@
 #define DEBUG_CLASS_ENGINE          (1<<11)
 #define DEBUG_CLASS_ENGINE_TIMING   (1<<12)
 #define DEBUG_CLASS_SESSION         (1<<13)
-#define DEBUG_CLASS_ALL             ~(0UL | DEBUG_CLASS_MIDI_TIMING | DEBUG_CLASS_ENGINE_TIMING)
+#define DEBUG_CLASS_TRACE           (1<<14)
+#define DEBUG_CLASS_ALL             ~(0UL | DEBUG_CLASS_MIDI_TIMING | DEBUG_CLASS_ENGINE_TIMING | \
+                                      DEBUG_CLASS_TRACE)
 
 #define DEBUG_ATTR_RESET            0
 #define DEBUG_ATTR_BRIGHT           1
@@ -99,7 +101,7 @@ extern DEBUG_RINGBUFFER main_debug_queue;
 extern int              debug;
 extern unsigned long    debug_class;
 
-extern DEBUG_CLASS      debug_class_list[16];
+extern DEBUG_CLASS      debug_class_list[17];
 
 
 #define PHASEX_ERROR(args...)                                           \
@@ -40,6 +40,8 @@
 #include "alsa_seq.h"
 #include "alsa_pcm.h"
 #include "jack.h"
+#include "jack_midi.h"
+#include "midi_out.h"
 #include "engine.h"
 #include "patch.h"
 #include "param.h"
@@ -83,29 +85,6 @@ int                 midi_ready                  = 0;
 
 int                 audio_stopped               = 0;
 int                 midi_stopped                = 0;
-int                 engine_stopped              = 0;
-
-
-char *audio_driver_names[] = {
-	"none",
-	"alsa",
-	"jack",
-	NULL
-};
-
-char *midi_driver_names[] = {
-	"none",
-	"jack",
-	"alsa-seq",
-	"alsa-raw",
-#ifdef ENABLE_RAWMIDI_GENERIC
-	"generic",
-#endif
-#ifdef ENABLE_RAWMIDI_OSS
-	"oss",
-#endif
-	NULL
-};
 
 
 /*****************************************************************************
@@ -307,6 +286,10 @@ init_midi(void)
 {
 	/* build midi controller matrix after init_params() and before midi_thread() */
 	build_ccmatrix();
+	build_midi_route();
+
+	/* midi output queue is ready before any driver can activate output */
+	init_midi_out();
 
 	if (midi_driver == MIDI_DRIVER_NONE) {
 		select_midi_driver(NULL, DEFAULT_MIDI_DRIVER);
@@ -806,6 +789,30 @@ audio_driver_running(void)
 }
 
 
+/*****************************************************************************
+ * flush_midi_out()
+ *
+ * Called from the audio process callback with the audio ring index for the
+ * current cycle.  Hands queued midi output events due within this cycle to
+ * the midi driver's output port.
+ *****************************************************************************/
+void
+flush_midi_out(unsigned int nframes, unsigned int a_index)
+{
+	if (!g_atomic_int_get(&midi_out_active)) {
+		return;
+	}
+	switch (midi_driver) {
+	case MIDI_DRIVER_JACK:
+		jack_midi_out_flush((jack_nframes_t) nframes, a_index);
+		break;
+	case MIDI_DRIVER_ALSA_SEQ:
+		alsa_seq_out_flush(nframes, a_index);
+		break;
+	}
+}
+
+
 /*****************************************************************************
  * query_audio_driver_status()
  *****************************************************************************/
@@ -75,10 +75,6 @@ extern int              midi_ready;
 
 extern int              audio_stopped;
 extern int              midi_stopped;
-extern int              engine_stopped;
-
-extern char             *audio_driver_names[];
-extern char             *midi_driver_names[];
 
 
 void select_audio_driver(char *driver_name, int driver_id);
@@ -98,6 +94,7 @@ void restart_midi(void);
 void phasex_watchdog(void);
 void scan_audio_and_midi(void);
 int  audio_driver_running(void);
+void flush_midi_out(unsigned int nframes, unsigned int a_index);
 void query_audio_driver_status(char *buf);
 
 
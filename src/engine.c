@@ -25,21 +25,27 @@
 #include <string.h>
 #include <math.h>
 #include <pthread.h>
+#include <time.h>
 #include <glib.h>
 #include "phasex.h"
 #include "timekeeping.h"
 #include "buffer.h"
 #include "wave.h"
 #include "filter.h"
+#include "oversample.h"
+#include "fx_bus.h"
+#include "master_bus.h"
 #include "engine.h"
 #include "patch.h"
 #include "param.h"
+#include "bank.h"
 #include "midi_event.h"
 #include "midi_process.h"
 #include "jack.h"
 #include "settings.h"
 #include "driver.h"
 #include "debug.h"
+#include "trace.h"
 
 
 #ifdef ENABLE_INPUTS
@@ -59,6 +65,12 @@ GLOBAL          global;
 pthread_mutex_t engine_ready_mutex;
 pthread_cond_t  engine_ready_cond           = PTHREAD_COND_INITIALIZER;
 volatile gint   engine_ready[MAX_PARTS];
+int             engine_stopped              = 0;
+
+volatile gint   voices_in_use               = 0;
+volatile gint   voice_budget_limit          = 0;
+
+static int      engine_num_cpus             = 1;
 
 int             sample_rate                 = 0;
 sample_t        f_sample_rate               = 0.0;
@@ -96,12 +108,17 @@ init_engine_buffers(void)
 #else
 		memset((void *)(chorus->buf),   0, CHORUS_MAX * 2 * sizeof(sample_t));
 #endif
-		memset((void *)(delay->buf),    0, DELAY_MAX  * 2 * sizeof(sample_t));
+		memset((void *)(delay->buf_1),  0, DELAY_MAX      * sizeof(sample_t));
+		memset((void *)(delay->buf_2),  0, DELAY_MAX      * sizeof(sample_t));
 
 		memset((void *)(part->output_buffer1), 0,
 		       PHASEX_MAX_BUFSIZE * sizeof(jack_default_audio_sample_t));
 		memset((void *)(part->output_buffer2), 0,
 		       PHASEX_MAX_BUFSIZE * sizeof(jack_default_audio_sample_t));
+		memset((void *)(part->chorus_send_buffer1), 0, PHASEX_MAX_BUFSIZE * sizeof(sample_t));
+		memset((void *)(part->chorus_send_buffer2), 0, PHASEX_MAX_BUFSIZE * sizeof(sample_t));
+		memset((void *)(part->delay_send_buffer1),  0, PHASEX_MAX_BUFSIZE * sizeof(sample_t));
+		memset((void *)(part->delay_send_buffer2),  0, PHASEX_MAX_BUFSIZE * sizeof(sample_t));
 	}
 
 #ifdef ENABLE_INPUTS
@@ -140,6 +157,7 @@ init_engine_internals(void)
 	/* keep engine re-init from clobbering the parts */
 	if (once) {
 		memset(&synth_part, 0, MAX_PARTS * sizeof(PART));
+		g_atomic_int_set(&voices_in_use, 0);
 		once = 0;
 	}
 
@@ -152,10 +170,13 @@ init_engine_internals(void)
 
 		/* no midi keys in play yet */
 		part->head     = NULL;
+		part->tail     = NULL;
 		part->cur      = NULL;
-		part->prev     = NULL;
 		part->midi_key = -1;
 		part->prev_key = -1;
+		part->last_key = 0;
+		part->high_key = 0;
+		part->low_key  = 0;
 
 		/* set buffer sizes and zero buffers */
 		delay->bufsize  = DELAY_MAX;
@@ -240,8 +261,12 @@ init_engine_parameters(void)
 
 		/* initialize delay */
 		delay->size        = state->delay_time * f_sample_rate / global.bps;
-		delay->length      = (int)(delay->size);
-		delay->write_index = 0;
+		delay->length          = (int)(delay->size);
+		delay->cur_length      = (sample_t) delay->length;
+		delay->distance_target = delay->cur_length + 1.0;
+		delay->write_index     = 0;
+		delay->silent_samples  = 0;
+		delay->control_samples = 0;
 
 		/* initialize chorus */
 		chorus->lfo_freq     = global.bps * state->chorus_lfo_rate;
@@ -262,46 +287,11 @@ init_engine_parameters(void)
 			chorus->phase_index_b -= F_WAVEFORM_SIZE;
 		}
 
-		chorus->phase_index_c = chorus->phase_index_a + (F_WAVEFORM_SIZE * 0.5);
-		if (chorus->phase_index_c >= F_WAVEFORM_SIZE) {
-			chorus->phase_index_c -= F_WAVEFORM_SIZE;
-		}
-
-		chorus->phase_index_d = chorus->phase_index_a + (F_WAVEFORM_SIZE * 0.75);
-		if (chorus->phase_index_d >= F_WAVEFORM_SIZE) {
-			chorus->phase_index_d -= F_WAVEFORM_SIZE;
-		}
-
-		/* set mix weights for the 90 degree offset chorus lfo positions */
-		chorus->phase_amount_a = (1.0 + osc_table[WAVE_SINE][(int) chorus->phase_index_a])
-			* 0.5 * (mix_table[127 - state->chorus_phase_balance_cc]);
-
-		chorus->phase_amount_b = (1.0 + osc_table[WAVE_SINE][(int) chorus->phase_index_b])
-			* 0.5 * (mix_table[state->chorus_phase_balance_cc]);
-
-		chorus->phase_amount_c = (1.0 + osc_table[WAVE_SINE][(int) chorus->phase_index_c])
-			* 0.5 * (mix_table[127 - state->chorus_phase_balance_cc]);
-
-		chorus->phase_amount_d = (1.0 + osc_table[WAVE_SINE][(int) chorus->phase_index_d])
-			* 0.5 * (mix_table[state->chorus_phase_balance_cc]);
-
-		/* set chorus lfo indices */
-		chorus->lfo_index_a = 0.0;
-
-		if ((chorus->lfo_index_b = chorus->lfo_index_a +
-		     (F_WAVEFORM_SIZE * 0.25)) >= F_WAVEFORM_SIZE) {
-			chorus->lfo_index_b -= F_WAVEFORM_SIZE;
-		}
-
-		if ((chorus->lfo_index_c = chorus->lfo_index_a +
-		     (F_WAVEFORM_SIZE * 0.5)) >= F_WAVEFORM_SIZE) {
-			chorus->lfo_index_c -= F_WAVEFORM_SIZE;
-		}
-
-		if ((chorus->lfo_index_d = chorus->lfo_index_a +
-		     (F_WAVEFORM_SIZE * 0.75)) >= F_WAVEFORM_SIZE) {
-			chorus->lfo_index_d -= F_WAVEFORM_SIZE;
-		}
+		/* set chorus lfo index.  tap delays and mix weights for the 90
+		   degree offset lfo positions are set up on the first sample. */
+		chorus->lfo_index_a     = 0.0;
+		chorus->control_samples = 0;
+		chorus->silent_samples  = 0;
 
 		/* initialize pitch bend attrs */
 		part->pitch_bend_target = part->pitch_bend_base = 0.0;
@@ -328,6 +318,23 @@ init_engine_parameters(void)
 		/* init denormal offset (sign gets flipped every frame) */
 		part->denormal_offset = (sample_t)(1e-19);
 
+		/* parts start out awake, and go to sleep once silent */
+		part->sleeping        = 0;
+		part->sleep_samples   = 0;
+
+		/* no program change in flight, so no events held behind one */
+		part->program_change_pending = 0;
+		part->held_event_count       = 0;
+
+		/* oscillators and filter run at 1x, 2x, or 4x the sample
+		   rate.  the filter table is indexed an octave lower for each
+		   doubling of the rate. */
+		part->oversample      = 1 << get_oversample_shift(setting_part_oversample[part_num]);
+		part->os_filter_shift = get_oversample_shift(part->oversample) * 12 * TUNING_RESOLUTION;
+		part->os_step         = 0;
+		part->os_wave_period  = wave_period / (sample_t) part->oversample;
+		memset(part->os_out, 0, sizeof(part->os_out));
+
 		/* per-lfo setup (including LFO_OFF/LFO_VELOCITY) */
 		for (lfo = 0; lfo <= NUM_LFOS; lfo++) {
 
@@ -343,7 +350,6 @@ init_engine_parameters(void)
 			part->lfo_pitch_bend[lfo]   = 0.0;
 			part->lfo_portamento[lfo]   = 0.0;
 			part->lfo_out[lfo]          = 0.0;
-			part->lfo_freq_lfo_mod[lfo] = 0.0;
 		}
 
 		/* per-oscillator setup */
@@ -360,6 +366,10 @@ init_engine_parameters(void)
 			voice = get_voice(part_num, voice_num);
 			voice->id = (int) voice_num;
 
+			/* clear oversampling decimators */
+			memset(voice->os_2x, 0, sizeof(voice->os_2x));
+			memset(voice->os_4x, 0, sizeof(voice->os_4x));
+
 			/* init portamento and velocity */
 			voice->portamento_samples     = env_table[state->portamento];
 			voice->velocity               = 0;
@@ -506,12 +516,451 @@ init_engine_parameters(void)
 			voice->filter_oldy3_2 = 0.0;
 		}
 
+		/* all voices start out free */
+		init_voice_alloc(part);
+
 		/* mono gets voice 0 */
 		if (state->keymode != KEYMODE_POLY) {
 			voice = get_voice(part_num, 0);
 			voice->active    = 1;
 			voice->allocated = 1;
+			voice_alloc_claim(part, 0);
+		}
+	}
+
+	/* decide which parts use the shared chorus and delay */
+	init_fx_bus();
+
+	/* limiter, dc blocker, and meters on the final mix */
+	init_master_bus();
+}
+
+
+/*****************************************************************************
+ * init_voice_alloc()
+ *
+ * Marks all voices of a part as free, with an empty allocation order.
+ *****************************************************************************/
+void
+init_voice_alloc(PART *part)
+{
+	int             voice_num;
+
+	g_atomic_int_add(&voices_in_use, -g_atomic_int_get(&part->voice_count));
+	g_atomic_int_set(&part->voice_count, 0);
+	g_atomic_int_set(&part->voice_shed_request, 0);
+
+	part->voice_free     = (1U << MAX_VOICES) - 1;
+	part->voice_lru_head = -1;
+	part->voice_lru_tail = -1;
+	for (voice_num = 0; voice_num < MAX_VOICES; voice_num++) {
+		part->voice_lru_prev[voice_num] = -1;
+		part->voice_lru_next[voice_num] = -1;
+	}
+
+	/* drop notes waiting on stolen voices */
+	part->steal_pending = 0;
+	part->steal_replay  = 0;
+	for (voice_num = 0; voice_num < MAX_VOICES; voice_num++) {
+		voice_pool[part - synth_part][voice_num].steal_pending = 0;
+	}
+}
+
+
+/*****************************************************************************
+ * reset_part_voices()
+ *
+ * Deactivates all voices of a part and frees them for allocation, as for a
+ * keymode change.  Called only from the engine thread for the part.
+ *****************************************************************************/
+void
+reset_part_voices(PART *part, unsigned int part_num)
+{
+	VOICE           *voice;
+	int             voice_num;
+
+	for (voice_num = 0; voice_num < MAX_VOICES; voice_num++) {
+		voice = get_voice(part_num, (unsigned int) voice_num);
+		voice->active    = 0;
+		voice->allocated = 0;
+		voice->midi_key  = -1;
+	}
+	init_voice_alloc(part);
+}
+
+
+/*****************************************************************************
+ * request_voice_reset()
+ *
+ * Asks the engine thread for a part to reset its voices before it
+ * processes any more events.  Safe to call from any thread.
+ *****************************************************************************/
+void
+request_voice_reset(unsigned int part_num)
+{
+	g_atomic_int_set(&(get_part(part_num)->voice_reset_request), 1);
+}
+
+
+/*****************************************************************************
+ * run_voice_reset()
+ *
+ * Services a pending voice reset request.  Called from the engine thread
+ * for the part, ahead of each frame's events.
+ *****************************************************************************/
+void
+run_voice_reset(PART *part, unsigned int part_num)
+{
+	if (g_atomic_int_get(&part->voice_reset_request) &&
+	    g_atomic_int_compare_and_exchange(&part->voice_reset_request, 1, 0)) {
+		reset_part_voices(part, part_num);
+	}
+}
+
+
+/*****************************************************************************
+ * voice_alloc_unlink()
+ *****************************************************************************/
+static void
+voice_alloc_unlink(PART *part, int voice_num)
+{
+	short           prev = part->voice_lru_prev[voice_num];
+	short           next = part->voice_lru_next[voice_num];
+
+	if (prev >= 0) {
+		part->voice_lru_next[prev] = next;
+	}
+	else {
+		part->voice_lru_head = next;
+	}
+	if (next >= 0) {
+		part->voice_lru_prev[next] = prev;
+	}
+	else {
+		part->voice_lru_tail = prev;
+	}
+	part->voice_lru_prev[voice_num] = -1;
+	part->voice_lru_next[voice_num] = -1;
+}
+
+
+/*****************************************************************************
+ * voice_alloc_claim()
+ *
+ * Marks a voice as allocated and makes it the most recently allocated.
+ *****************************************************************************/
+void
+voice_alloc_claim(PART *part, int voice_num)
+{
+	if (!(part->voice_free & (1U << voice_num))) {
+		voice_alloc_unlink(part, voice_num);
+	}
+	else {
+		g_atomic_int_inc(&part->voice_count);
+		g_atomic_int_inc(&voices_in_use);
+	}
+	part->voice_free &= ~(1U << voice_num);
+
+	part->voice_lru_prev[voice_num] = part->voice_lru_tail;
+	part->voice_lru_next[voice_num] = -1;
+	if (part->voice_lru_tail >= 0) {
+		part->voice_lru_next[part->voice_lru_tail] = (short) voice_num;
+	}
+	else {
+		part->voice_lru_head = (short) voice_num;
+	}
+	part->voice_lru_tail = (short) voice_num;
+}
+
+
+/*****************************************************************************
+ * voice_alloc_release()
+ *
+ * Returns a voice to the free set.
+ *****************************************************************************/
+void
+voice_alloc_release(PART *part, int voice_num)
+{
+	if (part->voice_free & (1U << voice_num)) {
+		return;
+	}
+	voice_alloc_unlink(part, voice_num);
+	part->voice_free |= (1U << voice_num);
+	g_atomic_int_add(&part->voice_count, -1);
+	g_atomic_int_add(&voices_in_use, -1);
+}
+
+
+/*****************************************************************************
+ * voice_alloc_find_free()
+ *
+ * Returns the lowest numbered free voice within the current polyphony, or
+ * -1 if all voices are allocated.
+ *****************************************************************************/
+int
+voice_alloc_find_free(PART *part)
+{
+	unsigned int    mask = part->voice_free & ((1U << setting_polyphony) - 1);
+
+	if (mask == 0) {
+		return -1;
+	}
+	return g_bit_nth_lsf((gulong) mask, -1);
+}
+
+
+/*****************************************************************************
+ * voice_alloc_find_key()
+ *
+ * Returns an allocated voice playing <midi_key>, for same key retrigger, or
+ * -1 if there is none.
+ *****************************************************************************/
+int
+voice_alloc_find_key(PART *part, unsigned int part_num, int midi_key)
+{
+	VOICE           *voice;
+	short           voice_num = part->voice_lru_head;
+
+	while (voice_num >= 0) {
+		voice = get_voice(part_num, voice_num);
+		if ((voice_num < setting_polyphony) && !voice->steal_pending &&
+		    (voice->midi_key == midi_key)) {
+			return voice_num;
+		}
+		voice_num = part->voice_lru_next[voice_num];
+	}
+	return -1;
+}
+
+
+/*****************************************************************************
+ * voice_alloc_find_victim()
+ *
+ * Picks an allocated voice to steal according to the voice stealing policy,
+ * skipping voices already fading out for another note.  Returns -1 if
+ * there are none.
+ *****************************************************************************/
+int
+voice_alloc_find_victim(PART *part, unsigned int part_num)
+{
+	VOICE           *voice;
+	short           voice_num = part->voice_lru_head;
+	int             oldest    = -1;
+	int             victim    = -1;
+	sample_t        quietest  = 2.0;
+
+	/* walk allocated voices from oldest to newest */
+	while (voice_num >= 0) {
+		voice = get_voice(part_num, voice_num);
+		if ((voice_num < setting_polyphony) && !voice->steal_pending) {
+			if (oldest < 0) {
+				oldest = voice_num;
+			}
+			switch (setting_voice_steal_policy) {
+			case VOICE_STEAL_RELEASED:
+				if ((victim < 0) && (voice->cur_amp_interval >= ENV_INTERVAL_RELEASE)) {
+					victim = voice_num;
+				}
+				break;
+			case VOICE_STEAL_QUIETEST:
+				if (voice->amp_env_raw < quietest) {
+					quietest = voice->amp_env_raw;
+					victim   = voice_num;
+				}
+				break;
+			}
+		}
+		voice_num = part->voice_lru_next[voice_num];
+	}
+
+	return (victim >= 0) ? victim : oldest;
+}
+
+
+/*****************************************************************************
+ * voice_budget_find_shed()
+ *
+ * Returns the lowest priority part (highest part number) above <part_num>
+ * holding more voices than it has reserved, or -1 if there is none.
+ *****************************************************************************/
+static int
+voice_budget_find_shed(int part_num)
+{
+	int             shed_num;
+
+	for (shed_num = MAX_PARTS - 1; shed_num > part_num; shed_num--) {
+		if (g_atomic_int_get(&(get_part((unsigned int) shed_num)->voice_count)) >
+		    setting_part_voice_min[shed_num]) {
+			return shed_num;
+		}
+	}
+	return -1;
+}
+
+
+/*****************************************************************************
+ * voice_budget_shed_part()
+ *
+ * When the global voice budget is used up, returns the part which should
+ * give up a voice:  the lowest priority part holding voices beyond its
+ * reservation, or <part_num> itself.  Returns -1 while under budget, or
+ * while <part_num> is still within its own reservation.
+ *****************************************************************************/
+int
+voice_budget_shed_part(unsigned int part_num)
+{
+	int             limit    = g_atomic_int_get(&voice_budget_limit);
+	int             shed_num;
+
+	if ((limit <= 0) || (g_atomic_int_get(&voices_in_use) < limit)) {
+		return -1;
+	}
+	if (g_atomic_int_get(&(get_part(part_num)->voice_count)) < setting_part_voice_min[part_num]) {
+		return -1;
+	}
+	if ((shed_num = voice_budget_find_shed((int) part_num)) >= 0) {
+		return shed_num;
+	}
+	return (int) part_num;
+}
+
+
+/*****************************************************************************
+ * voice_budget_max()
+ *
+ * Configured global voice budget, or total polyphony of all parts.
+ *****************************************************************************/
+int
+voice_budget_max(void)
+{
+	if (setting_voice_budget > 0) {
+		return setting_voice_budget;
+	}
+	return (MAX_PARTS * setting_polyphony);
+}
+
+
+/*****************************************************************************
+ * get_dsp_load()
+ *
+ * Returns the engine load in permille of the period time:  the busiest
+ * engine thread, or all engine threads spread across the cpus, whichever
+ * is higher.
+ *****************************************************************************/
+int
+get_dsp_load(void)
+{
+	unsigned int    part_num;
+	int             load;
+	int             max_load = 0;
+	int             sum_load = 0;
+
+	for (part_num = 0; part_num < MAX_PARTS; part_num++) {
+		load = g_atomic_int_get(&(get_part(part_num)->dsp_load));
+		sum_load += load;
+		if (load > max_load) {
+			max_load = load;
+		}
+	}
+	sum_load /= engine_num_cpus;
+
+	return (sum_load > max_load) ? sum_load : max_load;
+}
+
+
+/*****************************************************************************
+ * update_voice_budget()
+ *
+ * Called once per period from the first engine thread.  With a DSP load
+ * limit set, shrinks the global voice budget one voice at a time while the
+ * load is over the limit (shedding voices beyond it), and grows it back
+ * slowly once the load is well under the limit.
+ *****************************************************************************/
+void
+update_voice_budget(void)
+{
+	static int      hold_periods = 0;
+	int             max_limit    = voice_budget_max();
+	int             limit        = g_atomic_int_get(&voice_budget_limit);
+	int             min_limit    = 0;
+	int             in_use;
+	int             load;
+	int             shed_num;
+	unsigned int    part_num;
+
+	if (setting_dsp_load_limit <= 0) {
+		if (limit != max_limit) {
+			g_atomic_int_set(&voice_budget_limit, max_limit);
 		}
+		return;
+	}
+
+	if ((limit <= 0) || (limit > max_limit)) {
+		limit = max_limit;
+	}
+
+	/* give each change time to show up in the load */
+	if (hold_periods > 0) {
+		hold_periods--;
+	}
+	else {
+		load   = get_dsp_load();
+		in_use = g_atomic_int_get(&voices_in_use);
+
+		if (load > (setting_dsp_load_limit * 10)) {
+			for (part_num = 0; part_num < MAX_PARTS; part_num++) {
+				min_limit += setting_part_voice_min[part_num];
+			}
+			if (limit > in_use) {
+				limit = in_use;
+			}
+			if (limit > ((min_limit > 1) ? min_limit : 1)) {
+				limit--;
+			}
+			if ((in_use > limit) && ((shed_num = voice_budget_find_shed(-1)) >= 0)) {
+				g_atomic_int_set(&(get_part((unsigned int) shed_num)->voice_shed_request), 1);
+			}
+			hold_periods = VOICE_BUDGET_SHRINK_PERIODS;
+		}
+		else if (((load * 4) < (setting_dsp_load_limit * 30)) && (limit < max_limit)) {
+			limit++;
+			hold_periods = VOICE_BUDGET_GROW_PERIODS;
+		}
+	}
+
+	g_atomic_int_set(&voice_budget_limit, limit);
+}
+
+
+/*****************************************************************************
+ * voice_steal_fade()
+ *
+ * Starts a short fade out on a voice being stolen, instead of cutting it
+ * off mid-waveform.  When <event> is given, the note on is kept with the
+ * voice and replayed by run_voice_envelopes() once the voice is free.
+ *****************************************************************************/
+void
+voice_steal_fade(PART *part, VOICE *voice, MIDI_EVENT *event)
+{
+	int             fade_samples = setting_voice_steal_fade_time * sample_rate / 1000;
+
+	if (fade_samples < 1) {
+		fade_samples = 1;
+	}
+
+	/* detach from its key so note off for the old note leaves it alone */
+	voice->midi_key   = -1;
+	voice->keypressed = -1;
+
+	voice->cur_amp_interval = ENV_INTERVAL_FADE;
+	voice->cur_amp_sample   = voice->amp_env_dur[ENV_INTERVAL_FADE] = fade_samples;
+	voice->amp_env_delta[ENV_INTERVAL_FADE] = (0.0 - voice->amp_env_raw) / (sample_t) fade_samples;
+
+	if ((event != NULL) && !voice->steal_pending) {
+		memcpy(&(voice->steal_event), event, sizeof(MIDI_EVENT));
+		voice->steal_event.next = NULL;
+		voice->steal_pending = 1;
+		part->steal_pending++;
 	}
 }
 
@@ -527,19 +976,28 @@ engine_thread(void *arg)
 	unsigned int        part_num        = ((unsigned int)((long int) arg % MAX_PARTS));
 	PART                *part           = get_part(part_num);
 	PATCH_STATE         *state          = get_active_state(part_num);
+	PATCH               *next_patch     = NULL;
 	struct sched_param  schedparam;
 	pthread_t           thread_id;
 #ifdef ENABLE_INPUTS
 	sample_t            tmp;
 #endif
+	unsigned int        generation      = get_buffer_generation();
 	unsigned int        e_index         = get_engine_index();
 	unsigned int        m_index         = e_index;
 	int                 cycle_frame     = (int) buffer_period_size;
 	sample_t            last_out1       = 0;
 	sample_t            last_out2       = 0;
+	sample_t            fade_gain       = 1.0;
+	sample_t            fade_step       = 0.0;
 	timecalc_t          delta_nsec;
 	struct timespec     now;
 	struct timespec     sleep_time      = { 0, 0 };
+	struct timespec     period_start    = { 0, 0 };
+	struct timespec     period_end;
+	timecalc_t          busy_nsec;
+	char                trace_name[TRACE_NAME_SIZE];
+	int                 sleep_kind;
 	int                 engine_sleep_time;
 
 	/* Sleep interval should be in the range of 100us - 2000us, depending on
@@ -556,6 +1014,9 @@ engine_thread(void *arg)
 	schedparam.sched_priority = setting_engine_priority;
 	pthread_setschedparam(thread_id, setting_sched_policy, &schedparam);
 
+	snprintf(trace_name, sizeof(trace_name), "engine %d", (part_num + 1));
+	trace_thread_init(trace_name);
+
 	g_atomic_int_set(&engine_ready[part_num], 1);
 
 	/* MAIN LOOP: one time through for each sample */
@@ -564,6 +1025,20 @@ engine_thread(void *arg)
 		if (cycle_frame >= (int) buffer_period_size) {
 			cycle_frame = 0;
 
+			/* measure engine load for the period just generated */
+			if ((period_start.tv_sec != 0) &&
+			    (clock_gettime(CLOCK_MONOTONIC, &period_end) == 0)) {
+				busy_nsec = ((timecalc_t)(period_end.tv_sec - period_start.tv_sec) * 1000000000.0) +
+					(timecalc_t)(period_end.tv_nsec - period_start.tv_nsec);
+				PHASEX_TRACE(TRACE_ENGINE_PERIOD_END, part_num, (busy_nsec / 1000.0), 0, 0, 0);
+				g_atomic_int_set(&part->dsp_load,
+				                 ((7 * g_atomic_int_get(&part->dsp_load)) +
+				                  (gint)(busy_nsec * 1000.0 / nsec_per_period)) / 8);
+			}
+			if (part_num == 0) {
+				update_voice_budget();
+			}
+
 			/* At period boundry, set patch state in case of program change. */
 			state = get_active_state(part_num);
 
@@ -573,9 +1048,9 @@ engine_thread(void *arg)
 				inc_midi_index();
 			}
 			while (!engine_stopped && !pending_shutdown && (test_midi_index(e_index))) {
-				if (need_index_resync[part_num]) {
+				if (get_buffer_generation() != generation) {
+					generation = get_buffer_generation();
 					e_index = get_engine_index();
-					need_index_resync[part_num] = 0;
 					delta_nsec = get_time_delta(&now);
 					if (delta_nsec >= 0.0) {
 						inc_midi_index();
@@ -585,23 +1060,17 @@ engine_thread(void *arg)
 
 				/* usually signifies a clock start */
 				if (delta_nsec == 0.0) {
-					/* if (part_num == 0) */ {
-						PHASEX_DEBUG(DEBUG_CLASS_ENGINE_TIMING, "*");
-					}
+					sleep_kind = TRACE_SLEEP_CLOCK_START;
 					sleep_time.tv_nsec = (long int)(engine_sleep_time * 1000);
 				}
 				/* woke up too early -- sleep for rest of midi period. */
 				else if (delta_nsec < 0.0) {
-					/* if (part_num == 0) */ {
-						PHASEX_DEBUG(DEBUG_CLASS_ENGINE_TIMING, ",");
-					}
+					sleep_kind = TRACE_SLEEP_EARLY;
 					sleep_time.tv_nsec = - (long int) delta_nsec;
 				}
 				/* normal adaptive sleep. */
 				else if (delta_nsec < nsec_per_period) {
-					/* if (part_num == 0) */ {
-						PHASEX_DEBUG(DEBUG_CLASS_ENGINE_TIMING, "%c", ('a' + part_num));
-					}
+					sleep_kind = TRACE_SLEEP_ADAPTIVE;
 					sleep_time.tv_nsec = (long int)(nsec_per_period - delta_nsec +
 					                                (8.0 * nsec_per_frame));
 				}
@@ -609,11 +1078,11 @@ engine_thread(void *arg)
 				   reached once the MIDI clock has stabliized (a few seconds
 				   after clock start). */
 				else {
-					/* if (part_num == 0) */ {
-						PHASEX_DEBUG(DEBUG_CLASS_ENGINE_TIMING, ".");
-					}
+					sleep_kind = TRACE_SLEEP_WAIT_CLOCK;
 					sleep_time.tv_nsec = (long int)(engine_sleep_time * 1000);
 				}
+				PHASEX_TRACE(TRACE_ENGINE_SLEEP, part_num, sleep_kind,
+				             (sleep_time.tv_nsec / 1000), 0, 0);
 #ifdef HAVE_CLOCK_NANOSLEEP
 				clock_nanosleep(CLOCK_MONOTONIC, 0, &sleep_time, NULL);
 #else
@@ -625,20 +1094,22 @@ engine_thread(void *arg)
 					inc_midi_index();
 				}
 			}
-			//if (part_num == 0) {
-			PHASEX_DEBUG(DEBUG_CLASS_ENGINE_TIMING,
-			             DEBUG_COLOR_RED "[%c:%d] " DEBUG_COLOR_DEFAULT,
-			             ('a' + part_num), (e_index / buffer_period_size));
-			//}
-
-			/* Check for forced index resync.  This happens when
-			   (re)starting audio and midi subsystems. */
-			if (need_index_resync[part_num]) {
+
+			/* Pick up the new engine index if the buffer indices were
+			   reset.  This happens when (re)starting audio and midi
+			   subsystems. */
+			if (get_buffer_generation() != generation) {
+				generation = get_buffer_generation();
 				e_index = get_engine_index();
-				need_index_resync[part_num] = 0;
 			}
 
 			m_index = e_index;
+
+			PHASEX_TRACE(TRACE_ENGINE_PERIOD_BEGIN, part_num,
+			             (e_index / buffer_period_size),
+			             (get_midi_index() / buffer_period_size), 0, 0);
+
+			clock_gettime(CLOCK_MONOTONIC, &period_start);
 		}
 
 #ifdef ENABLE_INPUTS
@@ -661,25 +1132,26 @@ engine_thread(void *arg)
 		}
 #endif
 
-		/* get any new midi events for this part */
+		/* get any new midi events for this part, and stamp any midi
+		   output they generate with this sample's position */
+		part->midi_out_index = (int) e_index;
 		process_midi_events(m_index, (unsigned int)cycle_frame, part_num);
 
 		/* generate sample for this part */
 		run_part(part, state, part_num);
 
-		/* For oversampling, generate another sample and use
-		   linear interpolation. */
+		/* For oversampling, generate another sample and decimate
+		   the pair with the halfband filter. */
 		if (sample_rate_mode == SAMPLE_RATE_OVERSAMPLE) {
 			last_out1 = part->out1;
 			last_out2 = part->out2;
 
 			run_part(part, state, part_num);
 
-			part->out1  += last_out1;
-			part->out1  *= 0.5;
-
-			part->out2  += last_out2;
-			part->out2  *= 0.5;
+			part->out1 = halfband_decimate(&(part->os_out[0]), halfband_2x_coef,
+			                               HALFBAND_2X_COEFS, last_out1, part->out1);
+			part->out2 = halfband_decimate(&(part->os_out[1]), halfband_2x_coef,
+			                               HALFBAND_2X_COEFS, last_out2, part->out2);
 		}
 
 		/* undersample needs to check to second frame's
@@ -688,6 +1160,41 @@ engine_thread(void *arg)
 			process_midi_events(m_index, (unsigned int)(cycle_frame + 1), part_num);
 		}
 
+		/* Program changes are prepared by the bank thread and swapped in
+		   here, at the bottom of a faded out section when fading. */
+		if ((fade_step == 0.0) &&
+		    ((next_patch = take_prepared_patch(part_num)) != NULL)) {
+			if (setting_program_fade_time > 0) {
+				fade_step = (sample_t)(-1000.0 / ((sample_t) setting_program_fade_time *
+				                                  f_sample_rate));
+			}
+			else {
+				commit_program_change(part_num, next_patch);
+				state = next_patch->state;
+				next_patch = NULL;
+			}
+		}
+		if (fade_step != 0.0) {
+			fade_gain += fade_step;
+			if (fade_gain <= 0.0) {
+				fade_gain = 0.0;
+				fade_step = -fade_step;
+				commit_program_change(part_num, next_patch);
+				state = next_patch->state;
+				next_patch = NULL;
+			}
+			else if (fade_gain >= 1.0) {
+				fade_gain = 1.0;
+				fade_step = 0.0;
+			}
+			part->out1 *= fade_gain;
+			part->out2 *= fade_gain;
+			part->chorus_send1 *= fade_gain;
+			part->chorus_send2 *= fade_gain;
+			part->delay_send1  *= fade_gain;
+			part->delay_send2  *= fade_gain;
+		}
+
 		/* flip sign of denormal offset */
 		part->denormal_offset *= -1.0;
 
@@ -696,24 +1203,28 @@ engine_thread(void *arg)
 
 #ifdef ENABLE_INPUTS
 		/* get current input sample from buffer */
-		part->in1 = (sample_t) input_buffer1[e_index] * state->input_boost;
-		part->in2 = (sample_t) input_buffer2[e_index] * state->input_boost;
+		part->in1 = (sample_t) input_buffer1[e_index] * part->smooth_value[SMOOTH_INPUT_BOOST];
+		part->in2 = (sample_t) input_buffer2[e_index] * part->smooth_value[SMOOTH_INPUT_BOOST];
 #endif
 
 		/* for undersampling, use linear interpolation on
 		   input and output */
 		if (sample_rate_mode == SAMPLE_RATE_UNDERSAMPLE) {
 #ifdef ENABLE_INPUTS
-			part->in1 += ((sample_t) input_buffer1[e_index] * state->input_boost);
+			part->in1 += ((sample_t) input_buffer1[e_index] *
+			              part->smooth_value[SMOOTH_INPUT_BOOST]);
 			part->in1 *= 0.5;
 
-			part->in2 += ((sample_t) input_buffer2[e_index] * state->input_boost);
+			part->in2 += ((sample_t) input_buffer2[e_index] *
+			              part->smooth_value[SMOOTH_INPUT_BOOST]);
 			part->in2 *= 0.5;
 #endif
 			part->output_buffer1[e_index] = (sample_t)((part->out1 + last_out1) * 0.5);
 			part->output_buffer2[e_index] = (sample_t)((part->out2 + last_out2) * 0.5);
 
-			e_index = (e_index + 1) & buffer_size_mask;
+			if (++e_index >= buffer_size) {
+				e_index = 0;
+			}
 			cycle_frame++;
 
 			last_out1 = part->out1;
@@ -723,9 +1234,17 @@ engine_thread(void *arg)
 		/* output this sample to the buffer */
 		part->output_buffer1[e_index] = part->out1;
 		part->output_buffer2[e_index] = part->out2;
+		if (part->fx_send) {
+			part->chorus_send_buffer1[e_index] = part->chorus_send1;
+			part->chorus_send_buffer2[e_index] = part->chorus_send2;
+			part->delay_send_buffer1[e_index]  = part->delay_send1;
+			part->delay_send_buffer2[e_index]  = part->delay_send2;
+		}
 
 		/* update buffer position */
-		e_index = (e_index + 1) & buffer_size_mask;
+		if (++e_index >= buffer_size) {
+			e_index = 0;
+		}
 		cycle_frame++;
 	}
 
@@ -744,6 +1263,12 @@ start_engine_threads(void)
 	unsigned int    part_num;
 	int             ret;
 
+	/* spread of engine threads for dsp load measurement */
+	if ((engine_num_cpus = (int) sysconf(_SC_NPROCESSORS_ONLN)) < 1) {
+		engine_num_cpus = 1;
+	}
+	g_atomic_int_set(&voice_budget_limit, voice_budget_max());
+
 	for (part_num = 0; part_num < MAX_PARTS; part_num++) {
 		g_atomic_int_set(& (engine_ready[part_num]), 0);
 		if ((ret = pthread_create(&engine_thread_p[part_num], NULL, &engine_thread,
@@ -756,7 +1281,9 @@ start_engine_threads(void)
 			usleep(100000);
 		}
 	}
+#ifndef PHASEX_LV2
 	set_engine_priority(NULL, NULL);
+#endif /* !PHASEX_LV2 */
 	usleep(150000);
 }
 
@@ -771,6 +1298,202 @@ stop_engine(void)
 }
 
 
+/*****************************************************************************
+ * run_param_smoothing()
+ *
+ * Ramps this part's smoothed parameters linearly toward the targets set
+ * by the parameter callbacks.  A new ramp is started whenever the target
+ * serial changes.  A new patch state (program change, faded to silence
+ * by the engine thread) jumps straight to its targets.
+ *****************************************************************************/
+void
+run_param_smoothing(PART *part, PATCH_STATE *state)
+{
+	sample_t        scale;
+	int             serial = g_atomic_int_get(&state->smooth_serial);
+	int             j;
+
+	if (part->smooth_state != state) {
+		part->smooth_state   = state;
+		part->smooth_serial  = serial;
+		part->smooth_samples = 0;
+		for (j = 0; j < NUM_SMOOTH_PARAMS; j++) {
+			part->smooth_value[j] = state->smooth_target[j];
+		}
+		return;
+	}
+
+	if (part->smooth_serial != serial) {
+		part->smooth_serial  = serial;
+		part->smooth_samples = (int)((sample_t) setting_param_smooth_time *
+		                             f_sample_rate * 0.001);
+		if (part->smooth_samples < 1) {
+			part->smooth_samples = 1;
+		}
+		scale = 1.0 / (sample_t) part->smooth_samples;
+		for (j = 0; j < NUM_SMOOTH_PARAMS; j++) {
+			part->smooth_step[j] = (state->smooth_target[j] - part->smooth_value[j]) * scale;
+		}
+	}
+
+	if (part->smooth_samples > 0) {
+		/* land exactly on the targets at the end of the ramp */
+		if (--part->smooth_samples == 0) {
+			for (j = 0; j < NUM_SMOOTH_PARAMS; j++) {
+				part->smooth_value[j] = state->smooth_target[j];
+			}
+		}
+		else {
+			for (j = 0; j < NUM_SMOOTH_PARAMS; j++) {
+				part->smooth_value[j] += part->smooth_step[j];
+			}
+		}
+	}
+}
+
+
+/*****************************************************************************
+ * advance_sleeping_part()
+ *
+ * Advances the free running LFO and chorus phases of a sleeping part by the
+ * samples counted in sleep_samples, and resets the count.
+ *****************************************************************************/
+static void
+advance_sleeping_part(PART *part, PATCH_STATE *state, unsigned int part_num)
+{
+	CHORUS          *chorus = get_chorus(part_num);
+	sample_t        elapsed = (sample_t) part->sleep_samples;
+	unsigned int    lfo;
+
+	part->sleep_samples = 0;
+
+	for (lfo = 0; lfo < NUM_LFOS; lfo++) {
+		switch (state->lfo_freq_base[lfo]) {
+		case FREQ_BASE_MIDI_KEY:
+		case FREQ_BASE_TEMPO:
+		case FREQ_BASE_TEMPO_KEYTRIG:
+			part->lfo_index[lfo] = MATH_FMOD(part->lfo_index[lfo] +
+			                                 (part->lfo_adjust[lfo] * elapsed),
+			                                 F_WAVEFORM_SIZE);
+			if (part->lfo_index[lfo] < 0.0) {
+				part->lfo_index[lfo] += F_WAVEFORM_SIZE;
+			}
+			break;
+		}
+	}
+
+	/* a sending part's chorus is unused, or is the shared bus, which
+	   keeps running in the audio thread while the part sleeps */
+	if (!part->fx_send) {
+		chorus->lfo_index_a   = MATH_FMOD(chorus->lfo_index_a + (chorus->lfo_adjust * elapsed),
+		                                  F_WAVEFORM_SIZE);
+		chorus->phase_index_a = MATH_FMOD(chorus->phase_index_a + (chorus->phase_adjust * elapsed),
+		                                  F_WAVEFORM_SIZE);
+		chorus->phase_index_b = chorus->phase_index_a + (F_WAVEFORM_SIZE * 0.25);
+		if (chorus->phase_index_b >= F_WAVEFORM_SIZE) {
+			chorus->phase_index_b -= F_WAVEFORM_SIZE;
+		}
+		chorus->control_samples = 0;
+	}
+}
+
+
+/*****************************************************************************
+ * wake_part()
+ *
+ * Bring a sleeping part back up to date before it generates audio again.
+ * LFO phases are advanced by the time spent asleep, and smoothed values
+ * jump to their targets, since any ramps would have finished in silence.
+ *****************************************************************************/
+void
+wake_part(PART *part, PATCH_STATE *state, unsigned int part_num)
+{
+	int             j;
+
+	if (!part->sleeping) {
+		return;
+	}
+
+	PHASEX_DEBUG(DEBUG_CLASS_ENGINE, "Part %d:  Waking.\n", (part_num + 1));
+
+	part->sleeping = 0;
+	advance_sleeping_part(part, state, part_num);
+
+	part->smooth_serial  = g_atomic_int_get(&state->smooth_serial);
+	part->smooth_samples = 0;
+	for (j = 0; j < NUM_SMOOTH_PARAMS; j++) {
+		part->smooth_value[j] = state->smooth_target[j];
+	}
+	part->pitch_bend_base = part->pitch_bend_target;
+	part->velocity_coef   = part->velocity_target;
+	state->filter_cutoff  = part->filter_cutoff_target;
+}
+
+
+/*****************************************************************************
+ * phase_sync_fx()
+ *
+ * Shifts a delay and chorus by <phase_correction> samples, for syncing to
+ * JACK Transport.  Called from process_phase_sync(), or from run_fx_bus()
+ * for the shared buses.
+ *****************************************************************************/
+void
+phase_sync_fx(DELAY *delay, CHORUS *chorus, int phase_correction)
+{
+	delay->write_index += phase_correction;
+	while (delay->write_index < 0.0) {
+		delay->write_index += delay->bufsize;
+	}
+	while (delay->write_index >= delay->bufsize) {
+		delay->write_index -= delay->bufsize;
+	}
+
+	chorus->lfo_index_a += (sample_t) phase_correction * chorus->lfo_adjust;
+	while (chorus->lfo_index_a < 0.0) {
+		chorus->lfo_index_a += F_WAVEFORM_SIZE;
+	}
+	while (chorus->lfo_index_a >= F_WAVEFORM_SIZE) {
+		chorus->lfo_index_a -= F_WAVEFORM_SIZE;
+	}
+}
+
+
+/*****************************************************************************
+ * part_is_idle()
+ *
+ * Returns nonzero when a part has no voices and nothing left ringing in
+ * its effects, so that it can sleep until the next note.
+ *****************************************************************************/
+int
+part_is_idle(PART *part, PATCH_STATE *state, unsigned int part_num)
+{
+	CHORUS  *chorus = get_chorus(part_num);
+	DELAY   *delay  = get_delay(part_num);
+
+	if ((g_atomic_int_get(&part->voice_count) > 0) ||
+	    (part->steal_pending > 0) ||
+	    (part->smooth_samples > 0) ||
+	    (part->portamento_sample > 0) ||
+	    (MATH_ABS(part->out1) >= MINIMUM_GAIN) ||
+	    (MATH_ABS(part->out2) >= MINIMUM_GAIN)) {
+		return 0;
+	}
+	if (part->fx_send) {
+		return 1;
+	}
+	if ((state->chorus_mix_cc || (part->smooth_value[SMOOTH_CHORUS_WET] > 0.0)) &&
+	    (chorus->silent_samples < chorus->bufsize)) {
+		return 0;
+	}
+	if ((state->delay_mix_cc || (part->smooth_value[SMOOTH_DELAY_WET] > 0.0)) &&
+	    ((delay->silent_samples <= (delay->length + 1)) ||
+	     (delay->silent_samples <= ((int)(delay->cur_length) + 2)))) {
+		return 0;
+	}
+	return 1;
+}
+
+
 /*****************************************************************************
  * run_part()
  *
@@ -785,6 +1508,24 @@ run_part(PART *part, PATCH_STATE *state, unsigned int part_num)
 	sample_t        tmp2;
 #endif
 
+	/* Sleeping parts output silence until a voice is allocated.  Notes
+	   normally wake the part before they are processed. */
+	if (part->sleeping) {
+		if (g_atomic_int_get(&part->voice_count) == 0) {
+			if (++part->sleep_samples >= SLEEP_FOLD_SAMPLES) {
+				advance_sleeping_part(part, state, part_num);
+			}
+			part->out1 = part->out2 = 0.0;
+			part->chorus_send1 = part->chorus_send2 = 0.0;
+			part->delay_send1  = part->delay_send2  = 0.0;
+			return;
+		}
+		wake_part(part, state, part_num);
+	}
+
+	/* ramp smoothed parameters toward their targets */
+	run_param_smoothing(part, state);
+
 	/* generate amplitude envelopes for all voices */
 	run_voice_envelopes(part, state, part_num);
 
@@ -798,6 +1539,9 @@ run_part(PART *part, PATCH_STATE *state, unsigned int part_num)
 	/* parts get mixed at end of voice loop, so init now */
 	part->out1 = part->out2 = 0.0;
 
+	/* oscillator phase increment at the oversampled rate */
+	part->os_wave_period = wave_period / (sample_t) part->oversample;
+
 	/* update number of samples left in portamento */
 	if (part->portamento_sample > 0) {
 		part->portamento_sample--;
@@ -831,16 +1575,27 @@ run_part(PART *part, PATCH_STATE *state, unsigned int part_num)
 #endif
 
 	/* now apply patch volume and panning */
-	part->out1 *= state->volume * pan_table[127 - state->pan_cc];
-	part->out2 *= state->volume * pan_table[state->pan_cc];
+	part->out1 *= part->smooth_value[SMOOTH_GAIN_LEFT];
+	part->out2 *= part->smooth_value[SMOOTH_GAIN_RIGHT];
 
 
-	/* effects are last in the chain. */
-	if (state->chorus_mix_cc) {
-		run_chorus(get_chorus(part_num), part, state);
+	/* Parts on the shared buses pass dry signal through, and send to the
+	   bus effects at their mix levels. */
+	if (part->fx_send) {
+		part->chorus_send1 = part->out1 * part->smooth_value[SMOOTH_CHORUS_WET];
+		part->chorus_send2 = part->out2 * part->smooth_value[SMOOTH_CHORUS_WET];
+		part->delay_send1  = part->out1 * part->smooth_value[SMOOTH_DELAY_WET];
+		part->delay_send2  = part->out2 * part->smooth_value[SMOOTH_DELAY_WET];
 	}
-	if (state->delay_mix_cc) {
-		run_delay(get_delay(part_num), part, state);
+
+	/* effects are last in the chain.  keep running while mix ramps out. */
+	else {
+		if (state->chorus_mix_cc || (part->smooth_value[SMOOTH_CHORUS_WET] > 0.0)) {
+			run_chorus(get_chorus(part_num), part, state);
+		}
+		if (state->delay_mix_cc || (part->smooth_value[SMOOTH_DELAY_WET] > 0.0)) {
+			run_delay(get_delay(part_num), part, state);
+		}
 	}
 
 	/* output this sample to the buffer */
@@ -855,6 +1610,12 @@ run_part(PART *part, PATCH_STATE *state, unsigned int part_num)
 	part->dcR_in2  = tmp2;
 	part->dcR_out2 = part->out2;
 #endif
+
+	/* go to sleep once everything has gone quiet */
+	if (part_is_idle(part, state, part_num)) {
+		PHASEX_DEBUG(DEBUG_CLASS_ENGINE, "Part %d:  Sleeping.\n", (part_num + 1));
+		part->sleeping = 1;
+	}
 }
 
 
@@ -868,6 +1629,7 @@ run_voice_envelopes(PART *part, PATCH_STATE *state, unsigned int part_num)
 {
 	VOICE           *voice;
 	unsigned int    voice_num;
+	int             victim;
 
 	/* reset envelope tracking variables */
 	part->amp_env_max    = 0.0;
@@ -884,6 +1646,28 @@ run_voice_envelopes(PART *part, PATCH_STATE *state, unsigned int part_num)
 
 		run_voice_envelope(part, state, voice, part_num);
 	}
+
+	/* another part is over the voice budget and wants us to give one up */
+	if (g_atomic_int_get(&part->voice_shed_request)) {
+		g_atomic_int_set(&part->voice_shed_request, 0);
+		if ((victim = voice_alloc_find_victim(part, part_num)) >= 0) {
+			voice_steal_fade(part, get_voice(part_num, (unsigned int) victim), NULL);
+		}
+	}
+
+	/* play notes that were waiting for stolen voices to fade out */
+	if (part->steal_pending > 0) {
+		for (voice_num = 0; voice_num < (unsigned int) setting_polyphony; voice_num++) {
+			voice = get_voice(part_num, voice_num);
+			if (voice->steal_pending && !voice->allocated) {
+				voice->steal_pending = 0;
+				part->steal_pending--;
+				part->steal_replay = 1;
+				process_note_on(&(voice->steal_event), part_num);
+				part->steal_replay = 0;
+			}
+		}
+	}
 }
 
 
@@ -965,6 +1749,7 @@ run_voice_envelope(PART         *part,
 			case ENV_INTERVAL_DONE:
 				voice->active    = 0;
 				voice->allocated = 0;
+				voice_alloc_release(part, voice->id);
 				voice->age       = 0;
 				voice->midi_key  = -1;
 				for (osc = 0; osc < NUM_OSCS; osc++) {
@@ -1144,7 +1929,7 @@ void run_lfo(PART         *part,
 		part->lfo_adjust[lfo] = part->lfo_freq[lfo] *
 			halfsteps_to_freq_mult(state->lfo_transpose[lfo] +
 			                       part->lfo_pitch_bend[lfo] +
-			                       (part->lfo_freq_lfo_mod[lfo] *
+			                       (part->smooth_value[SMOOTH_LFO_FM + lfo] *
 			                        part->lfo_out[1])) * wave_period;
 
 		/* grab LFO output from osc table */
@@ -1241,8 +2026,41 @@ run_voice(VOICE *voice, PART *part, PATCH_STATE *state)
 	                               voice->velocity_target_log) * aftertouch_smooth_factor;
 
 	/* the real heavy lifting / osc modulations happens here */
-	run_oscillators(voice, part, state);
+	if (part->oversample > 1) {
+		run_voice_oversampled(voice, part, state);
+	}
+	else {
+		run_oscillators(voice, part, state);
+		run_voice_filter(voice, part, state);
+	}
 
+	/* Apply dedicated LFO AM for this voice */
+	tmp = (1.0 + part->smooth_value[SMOOTH_LFO_VOICE_AM] * (part->lfo_out[0] - 1.0));
+
+	/* Apply the amp velocity and amp envelope for this voice */
+	tmp *= voice->velocity_coef_log * env_curve[(int)(voice->amp_env_raw * F_ENV_CURVE_SIZE)];
+	voice->out1 *= tmp;
+	voice->out2 *= tmp;
+
+	/* end of per voice parameters.  mix voices */
+	part->out1 += ((voice->out1 * part->smooth_value[SMOOTH_STEREO_WIDTH]) +
+	               (voice->out2 * (1.0 - part->smooth_value[SMOOTH_STEREO_WIDTH])));
+	part->out2 += ((voice->out2 * part->smooth_value[SMOOTH_STEREO_WIDTH]) +
+	               (voice->out1 * (1.0 - part->smooth_value[SMOOTH_STEREO_WIDTH])));
+
+	/* keep track of voice's age for note stealing */
+	voice->age++;
+}
+
+
+/*****************************************************************************
+ * run_voice_filter()
+ *
+ * Run the filter selected by the patch on the current voice output.
+ *****************************************************************************/
+void
+run_voice_filter(VOICE *voice, PART *part, PATCH_STATE *state)
+{
 	/* filters are run per voice! */
 	switch (state->filter_type) {
 	case FILTER_TYPE_DIST:
@@ -1258,23 +2076,50 @@ run_voice(VOICE *voice, PART *part, PATCH_STATE *state)
 		run_experimental_filter(voice, part, state);
 		break;
 	}
+}
 
-	/* Apply dedicated LFO AM for this voice */
-	tmp = (1.0 + state->lfo_1_voice_am * (part->lfo_out[0] - 1.0));
-
-	/* Apply the amp velocity and amp envelope for this voice */
-	tmp *= voice->velocity_coef_log * env_curve[(int)(voice->amp_env_raw * F_ENV_CURVE_SIZE)];
-	voice->out1 *= tmp;
-	voice->out2 *= tmp;
 
-	/* end of per voice parameters.  mix voices */
-	part->out1 += ((voice->out1 * state->stereo_width) +
-	               (voice->out2 * (1.0 - state->stereo_width)));
-	part->out2 += ((voice->out2 * state->stereo_width) +
-	               (voice->out1 * (1.0 - state->stereo_width)));
+/*****************************************************************************
+ * run_voice_oversampled()
+ *
+ * Generate oscillators and filter for a single voice at 2x or 4x the
+ * sample rate, then decimate back down with halfband filters.  Envelopes,
+ * LFOs, and inputs are held for the duration of the sample.
+ *****************************************************************************/
+void
+run_voice_oversampled(VOICE *voice, PART *part, PATCH_STATE *state)
+{
+	sample_t    out1[MAX_PART_OVERSAMPLE];
+	sample_t    out2[MAX_PART_OVERSAMPLE];
+	int         step;
+
+	for (step = 0; step < part->oversample; step++) {
+		part->os_step = step;
+		voice->out1 = voice->out2 = 0.0;
+		run_oscillators(voice, part, state);
+		run_voice_filter(voice, part, state);
+		out1[step] = voice->out1;
+		out2[step] = voice->out2;
+	}
+	part->os_step = 0;
+
+	/* 4x -> 2x */
+	if (part->oversample == 4) {
+		out1[0] = halfband_decimate(&(voice->os_4x[0]), halfband_4x_coef,
+		                            HALFBAND_4X_COEFS, out1[0], out1[1]);
+		out1[1] = halfband_decimate(&(voice->os_4x[0]), halfband_4x_coef,
+		                            HALFBAND_4X_COEFS, out1[2], out1[3]);
+		out2[0] = halfband_decimate(&(voice->os_4x[1]), halfband_4x_coef,
+		                            HALFBAND_4X_COEFS, out2[0], out2[1]);
+		out2[1] = halfband_decimate(&(voice->os_4x[1]), halfband_4x_coef,
+		                            HALFBAND_4X_COEFS, out2[2], out2[3]);
+	}
 
-	/* keep track of voice's age for note stealing */
-	voice->age++;
+	/* 2x -> 1x */
+	voice->out1 = halfband_decimate(&(voice->os_2x[0]), halfband_2x_coef,
+	                                HALFBAND_2X_COEFS, out1[0], out1[1]);
+	voice->out2 = halfband_decimate(&(voice->os_2x[1]), halfband_2x_coef,
+	                                HALFBAND_2X_COEFS, out2[0], out2[1]);
 }
 
 
@@ -1322,6 +2167,7 @@ run_osc(VOICE *voice, PART *part, PATCH_STATE *state, unsigned int osc)
 	sample_t        freq_adjust;
 	sample_t        phase_adjust1;
 	sample_t        phase_adjust2;
+	sample_t        am_amount;
 	sample_t        tmp_1;
 	sample_t        tmp_2;
 	int             j;
@@ -1332,10 +2178,12 @@ run_osc(VOICE *voice, PART *part, PATCH_STATE *state, unsigned int osc)
 	switch (state->osc_freq_base[osc]) {
 
 	case FREQ_BASE_MIDI_KEY:
-		/* handle portamento if necessary */
+		/* handle portamento if necessary (once per output sample) */
 		if (voice->portamento_sample > 0) {
-			voice->osc_freq[osc] += voice->osc_portamento[osc];
-			voice->portamento_sample--;
+			if (part->os_step == 0) {
+				voice->osc_freq[osc] += voice->osc_portamento[osc];
+				voice->portamento_sample--;
+			}
 		}
 		/* otherwise set frequency directly */
 		else {
@@ -1381,10 +2229,10 @@ run_osc(VOICE *voice, PART *part, PATCH_STATE *state, unsigned int osc)
 		   pitch bender, etc, and come up with adjustment to current
 		   index. */
 		freq_adjust = halfsteps_to_freq_mult((tmp_1
-		                                      * state->freq_lfo_amount[osc])
+		                                      * part->smooth_value[SMOOTH_OSC_FREQ_LFO + osc])
 		                                     + part->osc_pitch_bend[osc]
 		                                     + state->osc_transpose[osc])
-			* voice->osc_freq[osc] * wave_period;
+			* voice->osc_freq[osc] * part->os_wave_period;
 
 		/* shift the wavetable index by amounts determined above */
 		voice->index[osc] += freq_adjust;
@@ -1435,8 +2283,8 @@ run_osc(VOICE *voice, PART *part, PATCH_STATE *state, unsigned int osc)
 		}
 
 		/* calculate phase adjustment */
-		phase_adjust1 = tmp_1 * state->phase_lfo_amount[osc] * F_WAVEFORM_SIZE;
-		phase_adjust2 = tmp_2 * state->phase_lfo_amount[osc] * F_WAVEFORM_SIZE;
+		phase_adjust1 = tmp_1 * part->smooth_value[SMOOTH_OSC_PHASE_LFO + osc] * F_WAVEFORM_SIZE;
+		phase_adjust2 = tmp_2 * part->smooth_value[SMOOTH_OSC_PHASE_LFO + osc] * F_WAVEFORM_SIZE;
 
 		/* grab osc output from osc table, applying phase adjustments
 		   to right and left */
@@ -1497,6 +2345,7 @@ run_osc(VOICE *voice, PART *part, PATCH_STATE *state, unsigned int osc)
 	}
 
 	/* last modulation to apply is AM */
+	am_amount = part->smooth_value[SMOOTH_OSC_AM_LFO + osc];
 	switch (state->am_mod_type[osc]) {
 	case MOD_TYPE_OSC_LATCH:
 		if (voice->latch[part->osc_am_mod[osc]]) {
@@ -1504,33 +2353,33 @@ run_osc(VOICE *voice, PART *part, PATCH_STATE *state, unsigned int osc)
 		}
 		/* intentional fall-through */
 	case MOD_TYPE_OSC:
-		if (state->am_lfo_amount[osc] > 0.0) {
+		if (am_amount > 0.0) {
 			voice->osc_out1[osc] *= ((voice->osc_out1[part->osc_am_mod[osc]] *
-			                          state->am_lfo_amount[osc]) + 1.0) * 0.5;
+			                          am_amount) + 1.0) * 0.5;
 			voice->osc_out2[osc] *= ((voice->osc_out2[part->osc_am_mod[osc]] *
-			                          state->am_lfo_amount[osc]) + 1.0) * 0.5;
+			                          am_amount) + 1.0) * 0.5;
 		}
-		else if (state->am_lfo_amount[osc] < 0.0) {
+		else if (am_amount < 0.0) {
 			voice->osc_out1[osc] *= ((voice->osc_out1[part->osc_am_mod[osc]] *
-			                          state->am_lfo_amount[osc]) - 1.0) * 0.5;
+			                          am_amount) - 1.0) * 0.5;
 			voice->osc_out2[osc] *= ((voice->osc_out2[part->osc_am_mod[osc]] *
-			                          state->am_lfo_amount[osc]) - 1.0) * 0.5;
+			                          am_amount) - 1.0) * 0.5;
 		}
 		break;
 	case MOD_TYPE_LFO:
-		if (state->am_lfo_amount[osc] > 0.0) {
-			tmp_1 = ((part->lfo_out[state->am_lfo[osc]] * state->am_lfo_amount[osc]) + 1.0) * 0.5;
+		if (am_amount > 0.0) {
+			tmp_1 = ((part->lfo_out[state->am_lfo[osc]] * am_amount) + 1.0) * 0.5;
 			voice->osc_out1[osc] *= tmp_1;
 			voice->osc_out2[osc] *= tmp_1;
 		}
-		else if (state->am_lfo_amount[osc] < 0.0) {
-			tmp_1 = ((part->lfo_out[state->am_lfo[osc]] * state->am_lfo_amount[osc]) - 1.0) * 0.5;
+		else if (am_amount < 0.0) {
+			tmp_1 = ((part->lfo_out[state->am_lfo[osc]] * am_amount) - 1.0) * 0.5;
 			voice->osc_out1[osc] *= tmp_1;
 			voice->osc_out2[osc] *= tmp_1;
 		}
 		break;
 	case MOD_TYPE_VELOCITY:
-		tmp_1 = 1.0 - ((1.0 - voice->velocity_coef_linear) * state->am_lfo_amount[osc]);
+		tmp_1 = 1.0 - ((1.0 - voice->velocity_coef_linear) * am_amount);
 		voice->osc_out1[osc] *= tmp_1;
 		voice->osc_out2[osc] *= tmp_1;
 		break;
@@ -1544,6 +2393,49 @@ run_osc(VOICE *voice, PART *part, PATCH_STATE *state, unsigned int osc)
 }
 
 
+/*****************************************************************************
+ * run_delay_control()
+ *
+ * Start a new delay control block.  The read distance ramps linearly
+ * across the block, following the delay LFO and gliding toward a new
+ * length after tempo or delay time changes.  Feedback gains are looked
+ * up here instead of every sample.
+ *****************************************************************************/
+void
+run_delay_control(DELAY *delay, PART *part, PATCH_STATE *state)
+{
+	sample_t    target;
+	sample_t    diff;
+
+	/* glide to the new delay length instead of jumping */
+	diff = (sample_t) delay->length - delay->cur_length;
+	if (MATH_ABS(diff) < (1.0 / 64.0)) {
+		delay->cur_length = (sample_t) delay->length;
+	}
+	else {
+		delay->cur_length += diff * DELAY_GLIDE_COEF;
+	}
+
+	/* read distance at the end of this block */
+	if (state->delay_lfo == LFO_OFF) {
+		target = delay->cur_length + 1.0;
+	}
+	else {
+		target = ((part->lfo_out[state->delay_lfo] + 1.0) * delay->cur_length * 0.5) + 1.0;
+	}
+
+	delay->distance        = delay->distance_target;
+	delay->distance_target = target;
+	delay->distance_step   = (target - delay->distance) * (1.0 / (sample_t) DELAY_CONTROL_SAMPLES);
+
+	delay->feed_gain       = mix_table[state->delay_feed_cc];
+	delay->input_gain      = mix_table[127 - state->delay_feed_cc];
+	delay->crossover       = state->delay_crossover;
+
+	delay->control_samples = DELAY_CONTROL_SAMPLES;
+}
+
+
 /*****************************************************************************
  * run_delay()
  *
@@ -1553,43 +2445,61 @@ void
 run_delay(DELAY *delay, PART *part, PATCH_STATE *state)
 {
 	sample_t    tmp_1, tmp_2, tmp_3, tmp_4;
+	sample_t    mu;
+	int         d;
+	int         j;
+	int         k;
 
-	/* set read position into delay buffer */
-	if (state->delay_lfo == LFO_OFF) {
-		delay->read_index =
-			(delay->bufsize + delay->write_index -
-			 delay->length - 1) & delay->bufsize_mask;
+	if (delay->control_samples == 0) {
+		run_delay_control(delay, part, state);
 	}
+	delay->control_samples--;
 
-	/* set read position into delay buffer based on delay lfo */
-	else {
-		delay->read_index =
-			(delay->bufsize + delay->write_index -
-			 (int)(((part->lfo_out[state->delay_lfo] + 1.0) *
-			        delay->size * 0.5)) - 1) & delay->bufsize_mask;
-	}
+	/* read delayed signal from fractional position in delay buffer.  the
+	   fraction comes from the distance alone, since a float read position
+	   the size of the buffer has too few bits left for it. */
+	d   = (int) delay->distance;
+	mu  = 1.0 - (delay->distance - (sample_t) d);
+	j   = (delay->write_index - d - 1) & delay->bufsize_mask;
+	k   = (j + 1) & delay->bufsize_mask;
+
+	tmp_1 = delay->buf_1[j] + (mu * (delay->buf_1[k] - delay->buf_1[j]));
+	tmp_2 = delay->buf_2[j] + (mu * (delay->buf_2[k] - delay->buf_2[j]));
 
-	/* read delayed signal from delay buffer */
-	tmp_1 = delay->buf[2 * delay->read_index];
-	tmp_2 = delay->buf[2 * delay->read_index + 1];
+	delay->distance += delay->distance_step;
 
 	/* keep original input signal around for buffer writing */
 	tmp_3 = part->out1;
 	tmp_4 = part->out2;
 
 	/* mix delayed signal with input */
-	part->out1 = (part->out1 * (mix_table[127 - state->delay_mix_cc])) +
-		(tmp_1 * mix_table[state->delay_mix_cc]);
-	part->out2 = (part->out2 * (mix_table[127 - state->delay_mix_cc])) +
-		(tmp_2 * mix_table[state->delay_mix_cc]);
+	part->out1 = (tmp_3 * part->smooth_value[SMOOTH_DELAY_DRY]) +
+		(tmp_1 * part->smooth_value[SMOOTH_DELAY_WET]);
+	part->out2 = (tmp_4 * part->smooth_value[SMOOTH_DELAY_DRY]) +
+		(tmp_2 * part->smooth_value[SMOOTH_DELAY_WET]);
 
 	/* write input to delay buffer with feedback */
-	delay->buf[2 * delay->write_index + state->delay_crossover] =
-		(tmp_1 * (mix_table[state->delay_feed_cc])) +
-		(tmp_3 * (mix_table[127 - state->delay_feed_cc])) - part->denormal_offset;
-	delay->buf[2 * delay->write_index + (1 - state->delay_crossover)] =
-		(tmp_2 * (mix_table[state->delay_feed_cc])) +
-		(tmp_4 * (mix_table[127 - state->delay_feed_cc])) - part->denormal_offset;
+	tmp_1 = (tmp_1 * delay->feed_gain) + (tmp_3 * delay->input_gain) - part->denormal_offset;
+	tmp_2 = (tmp_2 * delay->feed_gain) + (tmp_4 * delay->input_gain) - part->denormal_offset;
+
+	if (delay->crossover) {
+		delay->buf_1[delay->write_index] = tmp_2;
+		delay->buf_2[delay->write_index] = tmp_1;
+	}
+	else {
+		delay->buf_1[delay->write_index] = tmp_1;
+		delay->buf_2[delay->write_index] = tmp_2;
+	}
+
+	/* count consecutive inaudible writes to know when the buffer is empty */
+	if ((MATH_ABS(tmp_1) < MINIMUM_GAIN) && (MATH_ABS(tmp_2) < MINIMUM_GAIN)) {
+		if (delay->silent_samples < delay->bufsize) {
+			delay->silent_samples++;
+		}
+	}
+	else {
+		delay->silent_samples = 0;
+	}
 
 	/* increment delay write index */
 	delay->write_index++;
@@ -1598,109 +2508,171 @@ run_delay(DELAY *delay, PART *part, PATCH_STATE *state)
 
 
 /*****************************************************************************
- * run_chorus()
+ * run_chorus_lfos()
  *
- * Apply chorus effect to current part / current sample.
+ * Advance the chorus LFOs by one control block, and set up linear ramps
+ * for the tap delays and phase weights across the block.  The taps are
+ * 90 degrees apart on both the delay LFO and the phase LFO.
  *****************************************************************************/
 void
-run_chorus(CHORUS *chorus, PART *part, PATCH_STATE *state)
+run_chorus_lfos(CHORUS *chorus, PATCH_STATE *state)
 {
-	sample_t        tmp_1,   tmp_2,   tmp_3,   tmp_4;
-	sample_t        tmp_1_a, tmp_1_b, tmp_1_c, tmp_1_d;
-	sample_t        tmp_2_a, tmp_2_b, tmp_2_c, tmp_2_d;
+	sample_t        delay_start[CHORUS_TAPS];
+	sample_t        amount_start[CHORUS_TAPS];
+	sample_t        base;
+	sample_t        depth;
+	sample_t        index;
+	sample_t        balance_a;
+	sample_t        balance_b;
+	unsigned int    pass;
+	unsigned int    j;
 
+	base      = (sample_t)(chorus->length + 1);
+	depth     = chorus->half_size * state->chorus_amount;
+	balance_a = 0.5 * mix_table[127 - state->chorus_phase_balance_cc];
+	balance_b = 0.5 * mix_table[state->chorus_phase_balance_cc];
+
+	/* first pass gets values at the start of the block, second at the end */
+	for (pass = 0; pass < 2; pass++) {
+		for (j = 0; j < CHORUS_TAPS; j++) {
+			index = chorus->lfo_index_a + ((sample_t) j * F_WAVEFORM_SIZE * 0.25);
+			if (index >= F_WAVEFORM_SIZE) {
+				index -= F_WAVEFORM_SIZE;
+			}
 #ifdef INTERPOLATE_CHORUS
-	/* with interpolation, chorus buffer must be two separate mono buffers */
+			chorus->tap_delay[j] = base -
+				((osc_table[state->chorus_lfo_wave][(int) index] + 1.0) * depth);
+#else
+			/* without interpolation, taps c and d swing around the base
+			   delay instead of above it */
+			chorus->tap_delay[j] = base -
+				((osc_table[state->chorus_lfo_wave][(int) index] + ((j < 2) ? 1.0 : 0.0))
+				 * depth);
+#endif
+		}
 
-	/* set phase offset read indices into chorus delay buffer */
-	chorus->read_index_a =
-		((sample_t)(chorus->bufsize + chorus->write_index - chorus->length - 1) +
-		 ((osc_table[state->chorus_lfo_wave][(int) chorus->lfo_index_a] + 1.0) *
-		  chorus->half_size * state->chorus_amount));
+		/* mix weights for the LFO positions at right angles */
+		chorus->phase_amount[0] = (1.0 + osc_table[WAVE_SINE][(int)(chorus->phase_index_a)])
+			* balance_a;
+		chorus->phase_amount[1] = (1.0 + osc_table[WAVE_SINE][(int)(chorus->phase_index_b)])
+			* balance_b;
+		chorus->phase_amount[2] = 1.0 - chorus->phase_amount[0];
+		chorus->phase_amount[3] = 1.0 - chorus->phase_amount[1];
+
+		if (pass == 0) {
+			for (j = 0; j < CHORUS_TAPS; j++) {
+				delay_start[j]  = chorus->tap_delay[j];
+				amount_start[j] = chorus->phase_amount[j];
+			}
 
-	chorus->read_index_b =
-		((sample_t)(chorus->bufsize + chorus->write_index - chorus->length - 1) +
-		 ((osc_table[state->chorus_lfo_wave][(int) chorus->lfo_index_b] + 1.0) *
-		  chorus->half_size * state->chorus_amount));
+			/* advance phase and delay lfos to the end of the block */
+			chorus->phase_index_a += chorus->phase_adjust * (sample_t) CHORUS_CONTROL_SAMPLES;
+			while (chorus->phase_index_a >= F_WAVEFORM_SIZE) {
+				chorus->phase_index_a -= F_WAVEFORM_SIZE;
+			}
+			chorus->phase_index_b = chorus->phase_index_a + (F_WAVEFORM_SIZE * 0.25);
+			if (chorus->phase_index_b >= F_WAVEFORM_SIZE) {
+				chorus->phase_index_b -= F_WAVEFORM_SIZE;
+			}
 
-	chorus->read_index_c =
-		((sample_t)(chorus->bufsize + chorus->write_index - chorus->length - 1) +
-		 ((osc_table[state->chorus_lfo_wave][(int) chorus->lfo_index_c] + 1.0) *
-		  chorus->half_size * state->chorus_amount));
+			chorus->lfo_index_a += chorus->lfo_adjust * (sample_t) CHORUS_CONTROL_SAMPLES;
+			while (chorus->lfo_index_a >= F_WAVEFORM_SIZE) {
+				chorus->lfo_index_a -= F_WAVEFORM_SIZE;
+			}
+		}
+	}
 
-	chorus->read_index_d =
-		((sample_t)(chorus->bufsize + chorus->write_index - chorus->length - 1) +
-		 ((osc_table[state->chorus_lfo_wave][(int) chorus->lfo_index_d] + 1.0) *
-		  chorus->half_size * state->chorus_amount));
+	/* ramp from start to end values */
+	for (j = 0; j < CHORUS_TAPS; j++) {
+		chorus->tap_delay_step[j]    = (chorus->tap_delay[j] - delay_start[j]) *
+			(1.0 / (sample_t) CHORUS_CONTROL_SAMPLES);
+		chorus->phase_amount_step[j] = (chorus->phase_amount[j] - amount_start[j]) *
+			(1.0 / (sample_t) CHORUS_CONTROL_SAMPLES);
+		chorus->tap_delay[j]         = delay_start[j];
+		chorus->phase_amount[j]      = amount_start[j];
+	}
 
-	/* grab values from phase offset positions within chorus delay buffer */
-	tmp_1_a = chorus_hermite(chorus->buf_1, chorus->read_index_a);
-	tmp_2_a = chorus_hermite(chorus->buf_2, chorus->read_index_a);
+	chorus->control_samples = CHORUS_CONTROL_SAMPLES;
+}
 
-	tmp_1_b = chorus_hermite(chorus->buf_1, chorus->read_index_b);
-	tmp_2_b = chorus_hermite(chorus->buf_2, chorus->read_index_b);
 
-	tmp_1_c = chorus_hermite(chorus->buf_1, chorus->read_index_c);
-	tmp_2_c = chorus_hermite(chorus->buf_2, chorus->read_index_c);
+/*****************************************************************************
+ * run_chorus()
+ *
+ * Apply chorus effect to current part / current sample.
+ *****************************************************************************/
+void
+run_chorus(CHORUS *chorus, PART *part, PATCH_STATE *state)
+{
+	sample_t        read_index[CHORUS_TAPS];
+	sample_t        tap_1[CHORUS_TAPS];
+	sample_t        tap_2[CHORUS_TAPS];
+	sample_t        tmp_1,   tmp_2,   tmp_3,   tmp_4;
+	unsigned int    j;
+#ifndef INTERPOLATE_CHORUS
+	int             k;
+#endif
 
-	tmp_1_d = chorus_hermite(chorus->buf_1, chorus->read_index_d);
-	tmp_2_d = chorus_hermite(chorus->buf_2, chorus->read_index_d);
-#else
-	/* chorus_buf MUST be a single stereo width buffer, not separate buffers!
-	   Set phase offset read indices into chorus delay buffer */
-	chorus->read_index_a =
-		(chorus->bufsize + chorus->write_index +
-		 (int)(((osc_table[state->chorus_lfo_wave][(int)(chorus->lfo_index_a)] + 1.0) *
-		        chorus->half_size * state->chorus_amount)) -
-		 chorus->length - 1) & chorus->bufsize_mask;
-
-	chorus->read_index_b =
-		(chorus->bufsize + chorus->write_index +
-		 (int)(((osc_table[state->chorus_lfo_wave][(int)(chorus->lfo_index_b)] + 1.0) *
-		        chorus->half_size * state->chorus_amount)) -
-		 chorus->length - 1) & chorus->bufsize_mask;
-
-	chorus->read_index_c =
-		(chorus->bufsize + chorus->write_index +
-		 (int)(((osc_table[state->chorus_lfo_wave][(int)(chorus->lfo_index_c)] * 1.0) *
-		        chorus->half_size * state->chorus_amount)) -
-		 chorus->length - 1) & chorus->bufsize_mask;
-
-	chorus->read_index_d =
-		(chorus->bufsize + chorus->write_index +
-		 (int)(((osc_table[state->chorus_lfo_wave][(int)(chorus->lfo_index_d)] * 1.0) *
-		        chorus->half_size * state->chorus_amount)) -
-		 chorus->length - 1) & chorus->bufsize_mask;
+	if (chorus->control_samples == 0) {
+		run_chorus_lfos(chorus, state);
+	}
+	chorus->control_samples--;
 
-	/* grab values from phase offset positions within chorus delay buffer */
-	tmp_1_a = chorus->buf[2 * chorus->read_index_a];
-	tmp_2_a = chorus->buf[2 * chorus->read_index_a + 1];
+	/* keep dry signal around for chorus delay buffer mixing */
+	tmp_3 = part->out1;
+	tmp_4 = part->out2;
 
-	tmp_1_b = chorus->buf[2 * chorus->read_index_b];
-	tmp_2_b = chorus->buf[2 * chorus->read_index_b + 1];
+	/* Once everything in the buffer has fallen below audibility and there
+	   is no new input, the wet signal is silent.  Only keep the indices
+	   moving until input shows up again. */
+	if ((chorus->silent_samples >= chorus->bufsize) &&
+	    (MATH_ABS(tmp_3) < MINIMUM_GAIN) && (MATH_ABS(tmp_4) < MINIMUM_GAIN)) {
+		part->out1 = tmp_3 * part->smooth_value[SMOOTH_CHORUS_DRY];
+		part->out2 = tmp_4 * part->smooth_value[SMOOTH_CHORUS_DRY];
+		for (j = 0; j < CHORUS_TAPS; j++) {
+			chorus->tap_delay[j]    += chorus->tap_delay_step[j];
+			chorus->phase_amount[j] += chorus->phase_amount_step[j];
+		}
+		chorus->write_index = (chorus->write_index + 1) & chorus->bufsize_mask;
+		chorus->delay_index = (chorus->delay_index + 1) & chorus->bufsize_mask;
+		return;
+	}
 
-	tmp_1_c = chorus->buf[2 * chorus->read_index_c];
-	tmp_2_c = chorus->buf[2 * chorus->read_index_c + 1];
+	/* tap read positions, trailing the write index */
+	for (j = 0; j < CHORUS_TAPS; j++) {
+		read_index[j] = (sample_t)(chorus->write_index + chorus->bufsize) - chorus->tap_delay[j];
+	}
 
-	tmp_1_d = chorus->buf[2 * chorus->read_index_d];
-	tmp_2_d = chorus->buf[2 * chorus->read_index_d + 1];
+	/* grab values from phase offset positions within chorus delay buffer */
+#ifdef INTERPOLATE_CHORUS
+	/* with interpolation, chorus buffer must be two separate mono buffers */
+	chorus_hermite_taps(chorus->buf_1, chorus->buf_2, read_index, tap_1, tap_2);
+#else
+	/* chorus_buf MUST be a single stereo width buffer, not separate buffers! */
+	for (j = 0; j < CHORUS_TAPS; j++) {
+		k = ((int)(read_index[j])) & chorus->bufsize_mask;
+		tap_1[j] = chorus->buf[2 * k];
+		tap_2[j] = chorus->buf[2 * k + 1];
+	}
 #endif
 
 	/* add them together, with channel crossing */
-	tmp_1 = ((tmp_1_a * chorus->phase_amount_a) + (tmp_2_b * chorus->phase_amount_b) +
-	         (tmp_1_c * chorus->phase_amount_c) + (tmp_2_d * chorus->phase_amount_d));
-	tmp_2 = ((tmp_2_a * chorus->phase_amount_a) + (tmp_1_b * chorus->phase_amount_b) +
-	         (tmp_2_c * chorus->phase_amount_c) + (tmp_1_d * chorus->phase_amount_d));
-
-	/* keep dry signal around for chorus delay buffer mixing */
-	tmp_3 = part->out1;
-	tmp_4 = part->out2;
+	tmp_1 = ((tap_1[0] * chorus->phase_amount[0]) + (tap_2[1] * chorus->phase_amount[1]) +
+	         (tap_1[2] * chorus->phase_amount[2]) + (tap_2[3] * chorus->phase_amount[3]));
+	tmp_2 = ((tap_2[0] * chorus->phase_amount[0]) + (tap_1[1] * chorus->phase_amount[1]) +
+	         (tap_2[2] * chorus->phase_amount[2]) + (tap_1[3] * chorus->phase_amount[3]));
+
+	/* step the control ramps */
+	for (j = 0; j < CHORUS_TAPS; j++) {
+		chorus->tap_delay[j]    += chorus->tap_delay_step[j];
+		chorus->phase_amount[j] += chorus->phase_amount_step[j];
+	}
 
 	/* combine dry/wet for final output */
-	part->out1 = (tmp_3 * (mix_table[127 - state->chorus_mix_cc])) +
-		(tmp_1 * mix_table[state->chorus_mix_cc]);
-	part->out2 = (tmp_4 * (mix_table[127 - state->chorus_mix_cc])) +
-		(tmp_2 * mix_table[state->chorus_mix_cc]);
+	part->out1 = (tmp_3 * part->smooth_value[SMOOTH_CHORUS_DRY]) +
+		(tmp_1 * part->smooth_value[SMOOTH_CHORUS_WET]);
+	part->out2 = (tmp_4 * part->smooth_value[SMOOTH_CHORUS_DRY]) +
+		(tmp_2 * part->smooth_value[SMOOTH_CHORUS_WET]);
 
 #ifdef INTERPOLATE_CHORUS
 	/* write to chorus delay buffer with feedback */
@@ -1720,66 +2692,24 @@ run_chorus(CHORUS *chorus, PART *part, PATCH_STATE *state)
 	}
 #else
 	/* write to chorus delay buffer with feedback */
-	chorus->buf[2 * chorus->write_index + state->chorus_crossover] =
-		((chorus->buf[2 * chorus->delay_index]     * mix_table[state->chorus_feed_cc])
-		 + (tmp_3 * mix_table[127 - state->chorus_feed_cc])) - part->denormal_offset;
-
-	chorus->buf[2 * chorus->write_index + (1 - state->chorus_crossover)] =
-		((chorus->buf[2 * chorus->delay_index + 1] * mix_table[state->chorus_feed_cc])
-		 + (tmp_4 * mix_table[127 - state->chorus_feed_cc])) - part->denormal_offset;
-#endif
-
-	/* set phase lfo indices */
-	chorus->phase_index_a += chorus->phase_adjust;
-	if (chorus->phase_index_a >= F_WAVEFORM_SIZE) {
-		chorus->phase_index_a -= F_WAVEFORM_SIZE;
-	}
-
-	chorus->phase_index_b = chorus->phase_index_a + (F_WAVEFORM_SIZE * 0.25);
-	if (chorus->phase_index_b >= F_WAVEFORM_SIZE) {
-		chorus->phase_index_b -= F_WAVEFORM_SIZE;
-	}
-
-	chorus->phase_index_c = chorus->phase_index_a + (F_WAVEFORM_SIZE * 0.5);
-	if (chorus->phase_index_c >= F_WAVEFORM_SIZE) {
-		chorus->phase_index_c -= F_WAVEFORM_SIZE;
-	}
-
-	chorus->phase_index_d = chorus->phase_index_a + (F_WAVEFORM_SIZE * 0.75);
-	if (chorus->phase_index_d >= F_WAVEFORM_SIZE) {
-		chorus->phase_index_d -= F_WAVEFORM_SIZE;
-	}
-
-	/* set amount used for mix weight for the LFO positions at right angles */
-	chorus->phase_amount_a = (1.0 + osc_table[WAVE_SINE][(int)(chorus->phase_index_a)])
-		* 0.5 * (mix_table[127 - state->chorus_phase_balance_cc]);
-
-	chorus->phase_amount_c = 1.0 - chorus->phase_amount_a;
-
-	chorus->phase_amount_b = (1.0 + osc_table[WAVE_SINE][(int)(chorus->phase_index_b)])
-		* 0.5 * (mix_table[state->chorus_phase_balance_cc]);
-
-	chorus->phase_amount_d = 1.0 - chorus->phase_amount_b;
+	tmp_1 = ((chorus->buf[2 * chorus->delay_index]     * mix_table[state->chorus_feed_cc])
+	         + (tmp_3 * mix_table[127 - state->chorus_feed_cc])) - part->denormal_offset;
 
-	/* set lfo indices */
-	chorus->lfo_index_a += chorus->lfo_adjust;
-	if (chorus->lfo_index_a >= F_WAVEFORM_SIZE) {
-		chorus->lfo_index_a -= F_WAVEFORM_SIZE;
-	}
+	tmp_2 = ((chorus->buf[2 * chorus->delay_index + 1] * mix_table[state->chorus_feed_cc])
+	         + (tmp_4 * mix_table[127 - state->chorus_feed_cc])) - part->denormal_offset;
 
-	chorus->lfo_index_b = chorus->lfo_index_a + (F_WAVEFORM_SIZE * 0.25);
-	if (chorus->lfo_index_b >= F_WAVEFORM_SIZE) {
-		chorus->lfo_index_b -= F_WAVEFORM_SIZE;
-	}
+	chorus->buf[2 * chorus->write_index + state->chorus_crossover]       = tmp_1;
+	chorus->buf[2 * chorus->write_index + (1 - state->chorus_crossover)] = tmp_2;
+#endif
 
-	chorus->lfo_index_c = chorus->lfo_index_a + (F_WAVEFORM_SIZE * 0.5);
-	if (chorus->lfo_index_c >= F_WAVEFORM_SIZE) {
-		chorus->lfo_index_c -= F_WAVEFORM_SIZE;
+	/* count consecutive inaudible writes to know when the buffer is empty */
+	if ((MATH_ABS(tmp_1) < MINIMUM_GAIN) && (MATH_ABS(tmp_2) < MINIMUM_GAIN)) {
+		if (chorus->silent_samples < chorus->bufsize) {
+			chorus->silent_samples++;
+		}
 	}
-
-	chorus->lfo_index_d = chorus->lfo_index_a + (F_WAVEFORM_SIZE * 0.75);
-	if (chorus->lfo_index_d >= F_WAVEFORM_SIZE) {
-		chorus->lfo_index_d -= F_WAVEFORM_SIZE;
+	else {
+		chorus->silent_samples = 0;
 	}
 
 	/* increment chorus write index */
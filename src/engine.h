@@ -29,6 +29,7 @@
 #include "wave.h"
 #include "mididefs.h"
 #include "jack.h"
+#include "oversample.h"
 
 
 /* Basis by which oscillator frequency and phase triggering is set */
@@ -77,6 +78,22 @@
 #define ENV_INTERVAL_FADE           4   /* fade-out for env filter */
 #define ENV_INTERVAL_DONE           5   /* envelope has finished */
 
+/* poly voice stealing policies */
+#define VOICE_STEAL_OLDEST          0   /* oldest note in play */
+#define VOICE_STEAL_RELEASED        1   /* oldest released note, then oldest */
+#define VOICE_STEAL_QUIETEST        2   /* lowest amp envelope level */
+
+/* periods to wait between adaptive voice budget changes */
+#define VOICE_BUDGET_SHRINK_PERIODS 4
+#define VOICE_BUDGET_GROW_PERIODS   32
+
+/* samples a sleeping part counts before advancing its lfo phases, which
+   keeps the count small enough to be exact as a sample_t */
+#define SLEEP_FOLD_SAMPLES          65536
+
+/* events a part can hold while its program change is pending */
+#define MAX_HELD_EVENTS             64
+
 
 /* internal global parameters used by synth engine */
 typedef struct global {
@@ -105,6 +122,7 @@ typedef struct voice {
 	int         portamento_sample;          /* sample number within portamento */
 	int         portamento_samples;         /* portamento time in samples */
 	int         age;                        /* voice age, in samples */
+	int         steal_pending;              /* note waiting for stolen voice to fade */
 	sample_t    out1;                       /* output sample 1 */
 	sample_t    out2;                       /* output sample 2 */
 	sample_t    amp_env;                    /* smoothed final output of env generator */
@@ -161,12 +179,18 @@ typedef struct voice {
 	sample_t    filter_oldy2_2;
 	sample_t    filter_oldy3_1;
 	sample_t    filter_oldy3_2;
+	HALFBAND    os_2x[2];                   /* 2x->1x oscillator/filter decimators */
+	HALFBAND    os_4x[2];                   /* 4x->2x oscillator/filter decimators */
+	MIDI_EVENT  steal_event;                /* note on to play after steal fade */
 } VOICE;
 
 
-/* linked list of keys currently held in play */
+/* Doubly linked list of keys currently held in play, oldest first.  Nodes
+   are preallocated per midi key, so push and remove are O(1). */
 typedef struct keylist {
 	short           midi_key;
+	short           held;       /* set while linked into the list */
+	struct keylist  *prev;
 	struct keylist  *next;
 } KEYLIST;
 
@@ -175,13 +199,31 @@ typedef struct keylist {
 typedef struct part {
 	KEYLIST     keylist[128];
 	KEYLIST     *head;
+	KEYLIST     *tail;
 	KEYLIST     *cur;
-	KEYLIST     *prev;
+	unsigned int voice_free;                /* bitmap of unallocated voices */
+	short       voice_lru_head;             /* least recently allocated voice */
+	short       voice_lru_tail;             /* most recently allocated voice */
+	short       voice_lru_prev[MAX_VOICES]; /* allocated voices, oldest first */
+	short       voice_lru_next[MAX_VOICES];
+	gint        voice_count;                /* allocated voices, for global budget */
+	gint        voice_shed_request;         /* set by other parts when over budget */
+	gint        voice_reset_request;        /* set on keymode change from other threads */
+	gint        dsp_load;                   /* smoothed engine load, in permille */
+	int         steal_pending;              /* number of voices with steal_pending */
+	int         steal_replay;               /* set while replaying a deferred note */
+	int         sleeping;                   /* silent and idle, so not generated */
+	int         sleep_samples;              /* samples slept since lfos were advanced */
+	int         fx_send;                    /* send to shared fx buses, not inserts */
+	int         program_change_pending;     /* hold events until the new patch is live */
+	int         held_event_count;           /* number of events in held_events */
+	MIDI_EVENT  held_events[MAX_HELD_EVENTS];
 	MIDI_EVENT  event_queue[MIDI_EVENT_POOL_SIZE];
 	MIDI_EVENT  bulk_queue[MIDI_EVENT_POOL_SIZE];
 	int         portamento_samples;         /* portamento time in samples */
 	int         portamento_sample;          /* sample number within portamento */
 	int         midi_channel;
+	int         midi_out_index;             /* buffer index for events sent by engine */
 	short       hold_pedal;                 /* flag to indicate hold pedal in use */
 	short       midi_key;                   /* last midi key pressed */
 	short       prev_key;                   /* previous to last midi key pressed */
@@ -190,6 +232,11 @@ typedef struct part {
 	short       low_key;                    /* lowest oscillator key in play */
 	short       velocity;                   /* most recent note-on velocity */
 	short       _padding1;
+	int         oversample;                 /* osc/filter oversampling factor */
+	int         os_step;                    /* current step within oversampled sample */
+	int         os_filter_shift;            /* filter table index shift for oversampling */
+	sample_t    os_wave_period;             /* wave_period at oversampled rate */
+	HALFBAND    os_out[2];                  /* decimators for SAMPLE_RATE_OVERSAMPLE */
 	sample_t    velocity_coef;              /* velocity coefficient for calculations */
 	sample_t    velocity_target;            /* target for velocity_coef smoothing */
 	sample_t    filter_cutoff_target;       /* filter value smoothing algorithm moves to */
@@ -210,6 +257,10 @@ typedef struct part {
 	sample_t    in2;                        /* input sample 2 */
 	sample_t    out1;                       /* output sample 1 */
 	sample_t    out2;                       /* output sample 2 */
+	sample_t    chorus_send1;               /* chorus bus send sample 1 */
+	sample_t    chorus_send2;               /* chorus bus send sample 2 */
+	sample_t    delay_send1;                /* delay bus send sample 1 */
+	sample_t    delay_send2;                /* delay bus send sample 2 */
 	sample_t    amp_env_max;                /* max of amp env for all active voices */
 	sample_t    filter_env_max;             /* max of filter env for all active voices */
 	sample_t    osc_init_index[NUM_OSCS];   /* initial phase index for oscillator */
@@ -228,57 +279,62 @@ typedef struct part {
 	sample_t    lfo_portamento[NUM_LFOS + 1]; /* sample-wise freq adjust amt for portamento */
 	sample_t    lfo_index[NUM_LFOS + 1];    /* unconverted index into waveform lookup table */
 	sample_t    lfo_out[NUM_LFOS + 2];      /* raw sample output for LFOs */
-	sample_t    lfo_freq_lfo_mod[NUM_LFOS + 1];
+	sample_t    smooth_value[NUM_SMOOTH_PARAMS]; /* current smoothed parameter values */
+	sample_t    smooth_step[NUM_SMOOTH_PARAMS];  /* per-sample increment toward targets */
+	int         smooth_samples;             /* number of samples left in ramp */
+	int         smooth_serial;              /* last target serial seen by engine */
+	struct patch_state *smooth_state;       /* state the smoothed values belong to */
 	short       _padding3;
 	short       _padding4;
-	int         _padding5;
-	int         _padding6;
+	long long   _padding5;
+	long long   _padding6;
 	long long   _padding7;
 	long long   _padding8;
 	long long   _padding9;
 	long long   _padding10;
+	long long   _padding11;
+	long long   _padding12;
 	volatile     sample_t   output_buffer1[PHASEX_MAX_BUFSIZE];
 	volatile     sample_t   output_buffer2[PHASEX_MAX_BUFSIZE];
+	volatile     sample_t   chorus_send_buffer1[PHASEX_MAX_BUFSIZE];
+	volatile     sample_t   chorus_send_buffer2[PHASEX_MAX_BUFSIZE];
+	volatile     sample_t   delay_send_buffer1[PHASEX_MAX_BUFSIZE];
+	volatile     sample_t   delay_send_buffer2[PHASEX_MAX_BUFSIZE];
 } PART;
 
 
 typedef struct delay {
 	sample_t    size;                   /* length of delay buffer in samples */
 	sample_t    half_size;              /* length of delay buffer in samples */
+	sample_t    cur_length;             /* delay length, gliding toward length */
+	sample_t    distance;               /* read position behind write_index */
+	sample_t    distance_target;        /* read distance at end of control block */
+	sample_t    distance_step;          /* per sample distance ramp */
+	sample_t    feed_gain;              /* feedback gain for this control block */
+	sample_t    input_gain;             /* input gain for this control block */
 	int         write_index;            /* buffer write position */
-	int         read_index;             /* buffer read position (lfo modulated) */
 	int         bufsize;                /* size of delay buffer in samples */
 	int         bufsize_mask;           /* binary mask value for delay bufsize */
 	int         length;                 /* integer length lf delay buffer in samples */
-	char        _padding[36];
-	sample_t    buf[(DELAY_MAX) * 2];   /* stereo delay circular buffer */
+	int         silent_samples;         /* consecutive inaudible buffer writes */
+	int         control_samples;        /* samples left in current control block */
+	int         crossover;              /* crossover for this control block */
+	char        _padding[4];
+	sample_t    buf_1[(DELAY_MAX)];     /* left mono delay circular buffer */
+	sample_t    buf_2[(DELAY_MAX)];     /* right mono delay circular buffer */
 } DELAY;
 
 
 typedef struct chorus {
 	sample_t    phase_index_a;          /* index into chorus phase lfo */
 	sample_t    phase_index_b;          /* index into chorus phase lfo+90 */
-	sample_t    phase_index_c;          /* index into chorus phase lfo+180 */
-	sample_t    phase_index_d;          /* index into chorus phase lfo+270 */
-	sample_t    phase_amount_a;         /* amount to mix from lfo based position */
-	sample_t    phase_amount_b;         /* amount to mix from lfo+90 based position */
-	sample_t    phase_amount_c;         /* amount to mix from lfo+180 based position */
-	sample_t    phase_amount_d;         /* amount to mix from lfo+270 based position */
-#ifdef INTERPOLATE_CHORUS
-	sample_t    read_index_a;           /* chorus_buffer read position (lfo modulated) */
-	sample_t    read_index_b;           /* chorus_buffer read position (offset 90 deg) */
-	sample_t    read_index_c;           /* chorus_buffer read position (offset 180 deg) */
-	sample_t    read_index_d;           /* chorus_buffer read position (offset 270 deg) */
-#else
-	int         read_index_a;           /* chorus_buffer read position (lfo modulated) */
-	int         read_index_b;           /* chorus_buffer read position (offset 90 deg) */
-	int         read_index_c;           /* chorus_buffer read position (offset 180 deg) */
-	int         read_index_d;           /* chorus_buffer read position (offset 270 deg) */
-#endif
-	sample_t    lfo_index_a;            /* index into chorus lfo */
-	sample_t    lfo_index_b;            /* index into chorus lfo (offset ~90 deg) */
-	sample_t    lfo_index_c;            /* index into chorus lfo (offset 180 deg) */
-	sample_t    lfo_index_d;            /* index into chorus lfo (offset ~270 deg) */
+	sample_t    phase_amount[CHORUS_TAPS];      /* amount to mix from each tap */
+	sample_t    phase_amount_step[CHORUS_TAPS]; /* per sample phase_amount ramp */
+	sample_t    tap_delay[CHORUS_TAPS];         /* tap distance behind write_index */
+	sample_t    tap_delay_step[CHORUS_TAPS];    /* per sample tap_delay ramp */
+	sample_t    lfo_index_a;            /* index into chorus lfo (taps at +90 deg) */
+	int         control_samples;        /* samples left in current lfo block */
+	int         silent_samples;         /* consecutive inaudible buffer writes */
 	int         write_index;            /* chorus_buffer write position */
 	int         delay_index;            /* chorus_buffer feedback read position */
 	int         bufsize;                /* size of chorus buffer in samples */
@@ -316,8 +372,13 @@ extern CHORUS           per_part_chorus[MAX_PARTS];
 extern GLOBAL           global;
 
 extern volatile gint    engine_ready[MAX_PARTS];
+extern int              engine_stopped;
+
+extern volatile gint    voices_in_use;
+extern volatile gint    voice_budget_limit;
 
 extern int              sample_rate;
+extern int              sample_rate_mode;
 extern sample_t         f_sample_rate;
 extern sample_t         nyquist_freq;
 extern sample_t         wave_period;
@@ -341,17 +402,35 @@ extern sample_t         pitch_bend_smooth_factor;
 void init_engine_buffers(void);
 void init_engine_internals(void);
 void init_engine_parameters(void);
+void init_voice_alloc(PART *part);
+void reset_part_voices(PART *part, unsigned int part_num);
+void request_voice_reset(unsigned int part_num);
+void run_voice_reset(PART *part, unsigned int part_num);
+void voice_alloc_claim(PART *part, int voice_num);
+void voice_alloc_release(PART *part, int voice_num);
+int voice_alloc_find_free(PART *part);
+int voice_alloc_find_key(PART *part, unsigned int part_num, int midi_key);
+int voice_alloc_find_victim(PART *part, unsigned int part_num);
+int voice_budget_shed_part(unsigned int part_num);
+int voice_budget_max(void);
+void update_voice_budget(void);
+int get_dsp_load(void);
+void voice_steal_fade(PART *part, VOICE *voice, MIDI_EVENT *event);
 void *engine_thread(void *arg);
 void start_engine_threads(void);
 void stop_engine(void);
 void run_cycle(unsigned int part_num, unsigned int nframes, sample_t *out1, sample_t *out2);
 
 /* these functions are internal to the synth engine */
+void run_chorus_lfos(CHORUS *chorus, PATCH_STATE *state);
 void run_chorus(CHORUS *this_chorus, PART *part, PATCH_STATE *state);
+void run_delay_control(DELAY *delay, PART *part, PATCH_STATE *state);
 void run_delay(DELAY *this_delay, PART *part, PATCH_STATE *state);
 void run_osc(VOICE *voice, PART *part, PATCH_STATE *state, unsigned int osc);
 void run_oscillators(VOICE *voice, PART *part, PATCH_STATE *state);
 void run_voice(VOICE *voice, PART *part, PATCH_STATE *state);
+void run_voice_filter(VOICE *voice, PART *part, PATCH_STATE *state);
+void run_voice_oversampled(VOICE *voice, PART *part, PATCH_STATE *state);
 void run_voices(PART *part, PATCH_STATE *state, unsigned int part_num);
 void run_lfo(PART *part, PATCH_STATE *state, unsigned int lfo, unsigned int UNUSED(part_num));
 void run_lfos(PART *part, PATCH_STATE *state, unsigned int part_num);
@@ -360,6 +439,10 @@ void run_voice_envelope(PART *part,
                         VOICE *voice,
                         unsigned int UNUSED(part_num));
 void run_voice_envelopes(PART *part, PATCH_STATE *state, unsigned int part_num);
+void run_param_smoothing(PART *part, PATCH_STATE *state);
+void wake_part(PART *part, PATCH_STATE *state, unsigned int part_num);
+void phase_sync_fx(DELAY *delay, CHORUS *chorus, int phase_correction);
+int part_is_idle(PART *part, PATCH_STATE *state, unsigned int part_num);
 void run_part(PART *part, PATCH_STATE *state, unsigned int part_num);
 void run_parts(void);
 
@@ -0,0 +1,439 @@
+/*****************************************************************************
+ *
+ * engine_api.c
+ *
+ * PHASEX:  [P]hase [H]armonic [A]dvanced [S]ynthesis [EX]periment
+ *
+ * Copyright (C) 2012-2013 William Weston <whw@linuxmail.org>
+ *
+ * PHASEX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PHASEX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PHASEX.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+#include "phasex.h"
+#include "engine_api.h"
+#include "timekeeping.h"
+#include "buffer.h"
+#include "wave.h"
+#include "filter.h"
+#include "engine.h"
+#include "master_bus.h"
+#include "patch.h"
+#include "param.h"
+#include "bank.h"
+#include "midi_event.h"
+#include "midi_process.h"
+#include "midimap.h"
+#include "mididefs.h"
+#include "settings.h"
+#include "debug.h"
+
+
+ENGINE_CLIENT   engine_client           = { NULL, NULL, NULL };
+
+/* midi queue position of the block being rendered by phasex_engine_render() */
+static unsigned int render_index        = 0;
+
+
+/*****************************************************************************
+ * notify_param_update()
+ *
+ * Tells the client that a parameter was changed by MIDI.
+ *****************************************************************************/
+void
+notify_param_update(PARAM *param, int cc_val)
+{
+	if (engine_client.param_update != NULL) {
+		engine_client.param_update(param, cc_val);
+	}
+}
+
+
+/*****************************************************************************
+ * notify_controller()
+ *
+ * Tells the client which controller a part just received.
+ *****************************************************************************/
+void
+notify_controller(unsigned int part_num, int cc)
+{
+	if (engine_client.controller != NULL) {
+		engine_client.controller(part_num, cc);
+	}
+}
+
+
+/*****************************************************************************
+ * notify_visible_patch()
+ *
+ * Tells the client that a program change made <patch> active for a part.
+ *****************************************************************************/
+void
+notify_visible_patch(unsigned int part_num, PATCH *patch)
+{
+	if (engine_client.visible_patch != NULL) {
+		engine_client.visible_patch(part_num, patch);
+	}
+}
+
+
+/*****************************************************************************
+ * phasex_engine_init()
+ *
+ * Brings up the engine for synchronous rendering at <rate>, in blocks of at
+ * most <period_size> frames.  No engine, audio, or MIDI threads are started;
+ * everything runs from the caller's thread in phasex_engine_render(), on a
+ * virtual clock.
+ * Settings should already have been read.  Returns 0 on success.
+ *****************************************************************************/
+int
+phasex_engine_init(unsigned int rate, unsigned int period_size)
+{
+	if ((rate == 0) || (set_buffer_geometry(period_size) != 0)) {
+		return -1;
+	}
+
+	/* the host owns the sample rate, so no over/undersampling */
+	setting_sample_rate_mode = SAMPLE_RATE_NORMAL;
+
+	sample_rate   = (int) rate;
+	f_sample_rate = (sample_t) sample_rate;
+	nyquist_freq  = (sample_t)(f_sample_rate / 2.0);
+	wave_period   = (sample_t)(F_WAVEFORM_SIZE / f_sample_rate);
+
+	if (sys_default_patch[0] == '\0') {
+		snprintf(sys_default_patch, PATH_MAX, "%s/%s", PATCH_DIR, SYS_DEFAULT_PATCH);
+	}
+	if (sys_bank_file[0] == '\0') {
+		snprintf(sys_bank_file, PATH_MAX, "%s/%s", PHASEX_DIR, USER_BANK_FILE);
+	}
+
+	build_freq_table();
+	build_freq_shift_table();
+	build_waveform_tables();
+	build_mix_table();
+	build_pan_table();
+	build_gain_table();
+	build_velocity_gain_table();
+	build_keyfollow_table();
+	init_params();
+	build_filter_tables();
+	build_env_tables();
+
+	midi_clock_virtual = 1;
+	start_midi_clock();
+	init_engine_internals();
+	init_patch_param_data();
+	init_patch_bank(sys_bank_file);
+	run_param_callbacks(1);
+
+	phasex_engine_reset();
+
+	PHASEX_DEBUG(DEBUG_CLASS_INIT, "Engine initialized for synchronous rendering:  "
+	             "rate=%u  period=%u\n", rate, period_size);
+
+	return 0;
+}
+
+
+/*****************************************************************************
+ * phasex_engine_reset()
+ *
+ * Returns the engine to a fixed initial state with the current patches:  no
+ * voices or queued events, empty delay and chorus lines, LFO and chorus
+ * phases and denormal offsets from their initial values, and the render
+ * position back at zero.  The engine has no random sources and never reads
+ * the wall clock in synchronous mode, so renders of the same MIDI input
+ * from a reset are bit-identical.
+ *****************************************************************************/
+int
+phasex_engine_reset(void)
+{
+	unsigned int    part_num;
+
+	init_engine_internals();
+	init_engine_parameters();
+	for (part_num = 0; part_num < MAX_PARTS; part_num++) {
+		init_patch_state(get_active_patch(part_num));
+		g_atomic_int_set(&(get_part(part_num)->dsp_load), 0);
+
+		/* smoothed values and filter cutoff start over from the patch
+		   state instead of gliding from where the last render left them */
+		get_part(part_num)->smooth_state = NULL;
+		get_active_state(part_num)->filter_cutoff = get_part(part_num)->filter_cutoff_target;
+	}
+
+	/* budget is recomputed from settings at the top of the next block */
+	g_atomic_int_set(&voice_budget_limit, 0);
+
+	init_buffer_indices(1);
+	render_index = 0;
+	set_midi_index(render_index);
+
+	return 0;
+}
+
+
+/*****************************************************************************
+ * phasex_engine_load_patch()
+ *
+ * Reads a patch file into the active patch for a part.  Must not be called
+ * concurrently with phasex_engine_render().  Returns 0 on success.
+ *****************************************************************************/
+int
+phasex_engine_load_patch(unsigned int part_num, const char *filename)
+{
+	PATCH           *patch;
+	char            patch_file[PATH_MAX];
+
+	if ((part_num >= MAX_PARTS) || (filename == NULL)) {
+		return -1;
+	}
+
+	strncpy(patch_file, filename, (PATH_MAX - 1));
+	patch_file[PATH_MAX - 1] = '\0';
+
+	patch = get_active_patch(part_num);
+	if (read_patch(patch_file, patch) != 0) {
+		return -1;
+	}
+	init_patch_state(patch);
+
+	return 0;
+}
+
+
+/*****************************************************************************
+ * phasex_engine_save_patch()
+ *
+ * Writes the active patch for a part in the standard patch file format.
+ * Must not be called concurrently with phasex_engine_render().  Returns 0
+ * on success.
+ *****************************************************************************/
+int
+phasex_engine_save_patch(unsigned int part_num, const char *filename)
+{
+	char            patch_file[PATH_MAX];
+
+	if ((part_num >= MAX_PARTS) || (filename == NULL)) {
+		return -1;
+	}
+
+	strncpy(patch_file, filename, (PATH_MAX - 1));
+	patch_file[PATH_MAX - 1] = '\0';
+
+	return save_patch(patch_file, get_active_patch(part_num));
+}
+
+
+/*****************************************************************************
+ * phasex_engine_load_bank()
+ *
+ * Reads a bank file.  Programs are loaded on first use, as with the
+ * standalone synth.  Returns 0 on success.
+ *****************************************************************************/
+int
+phasex_engine_load_bank(const char *filename)
+{
+	char            bank_file[PATH_MAX];
+
+	if ((filename == NULL) || (access(filename, R_OK) != 0)) {
+		return -1;
+	}
+
+	strncpy(bank_file, filename, (PATH_MAX - 1));
+	bank_file[PATH_MAX - 1] = '\0';
+
+	load_patch_bank(bank_file);
+
+	return 0;
+}
+
+
+/*****************************************************************************
+ * phasex_engine_program_pending()
+ *
+ * Returns nonzero when a MIDI program change is waiting for
+ * phasex_engine_prepare_programs().  Safe to call from the render thread.
+ *****************************************************************************/
+int
+phasex_engine_program_pending(void)
+{
+	return program_change_requested();
+}
+
+
+/*****************************************************************************
+ * phasex_engine_prepare_programs()
+ *
+ * Loads the patches for pending MIDI program changes, which then take
+ * effect at the top of the next phasex_engine_render().  May read patch
+ * files, so call it from a non-realtime thread, concurrently with
+ * rendering or between blocks.  Returns 0 on success.
+ *****************************************************************************/
+int
+phasex_engine_prepare_programs(void)
+{
+	prepare_program_change_requests();
+
+	return 0;
+}
+
+
+/*****************************************************************************
+ * phasex_engine_set_param()
+ *
+ * Sets a parameter of a part's active patch to <value>, in the same units
+ * as its MIDI controller value (0 to cc_limit).  Fractional values are
+ * passed on to parameters that interpolate between steps.  Returns 0 on
+ * success.
+ *****************************************************************************/
+int
+phasex_engine_set_param(unsigned int part_num, unsigned int param_id, float value)
+{
+	PARAM           *param;
+
+	if ((part_num >= MAX_PARTS) || (param_id >= NUM_PARAMS)) {
+		return -1;
+	}
+
+	param = & (get_active_patch(part_num)->param[param_id]);
+	if (value < 0.0) {
+		value = 0.0;
+	}
+	param_midi_update_fine(param, (int)(value * 128.0));
+
+	return 0;
+}
+
+
+/*****************************************************************************
+ * phasex_engine_queue_midi()
+ *
+ * Queues one raw MIDI message at <frame> within the next block to be
+ * rendered.  Channel messages are routed through the midimap, as with
+ * JACK MIDI input.  Returns 0 when the message was accepted or ignored, or
+ * -1 when it is malformed or the frame is out of range.
+ *****************************************************************************/
+int
+phasex_engine_queue_midi(const unsigned char *msg, size_t len, unsigned int frame)
+{
+	MIDI_EVENT      event;
+	unsigned char   type;
+
+	if ((msg == NULL) || (len < 1) || (frame >= buffer_period_size)) {
+		return -1;
+	}
+
+	memset(&event, 0, sizeof(MIDI_EVENT));
+	event.state = EVENT_STATE_ALLOCATED;
+
+	/* handle messages with channel number embedded in the first byte */
+	if (msg[0] < 0xF0) {
+		type = msg[0] & 0xF0;
+		/* program change and channel pressure have 1 byte following
+		   the status byte, everything else has 2 */
+		if ((len < 2) || ((len < 3) &&
+		                  (type != MIDI_EVENT_PROGRAM_CHANGE) &&
+		                  (type != MIDI_EVENT_POLYPRESSURE))) {
+			return -1;
+		}
+		event.type    = type;
+		event.channel = msg[0] & 0x0F;
+		event.byte2   = msg[1];
+		if ((type != MIDI_EVENT_PROGRAM_CHANGE) && (type != MIDI_EVENT_POLYPRESSURE)) {
+			event.byte3 = msg[2];
+		}
+		queue_midi_event_parts(get_midi_route(&event), &event, frame, render_index);
+	}
+	else if ((msg[0] == MIDI_EVENT_STOP) || (msg[0] == MIDI_EVENT_SYSTEM_RESET)) {
+		queue_midi_realtime_event(ALL_PARTS, msg[0], frame, render_index);
+	}
+
+	return 0;
+}
+
+
+/*****************************************************************************
+ * phasex_engine_render()
+ *
+ * Renders <nframes> (at most the period size given to phasex_engine_init())
+ * of all parts, mixed into <out1> and <out2>.  Program changes prepared
+ * by phasex_engine_prepare_programs() take effect at the top of the block.
+ * Never reads files, so it is safe to call from a realtime thread.  MIDI
+ * queued past <nframes> is applied at the end of the block.  Returns 0 on
+ * success.
+ *****************************************************************************/
+int
+phasex_engine_render(unsigned int nframes, float *out1, float *out2)
+{
+	PART            *part;
+	PATCH_STATE     *state;
+	PATCH           *patch;
+	unsigned int    part_num;
+	unsigned int    frame;
+	unsigned int    index;
+
+	if ((nframes > buffer_period_size) || (out1 == NULL) || (out2 == NULL)) {
+		return -1;
+	}
+
+	for (part_num = 0; part_num < MAX_PARTS; part_num++) {
+		if ((patch = take_prepared_patch(part_num)) != NULL) {
+			commit_program_change(part_num, patch);
+		}
+	}
+	update_voice_budget();
+
+	/* one part at a time keeps each part's state in cache for the block */
+	for (part_num = 0; part_num < MAX_PARTS; part_num++) {
+		part  = get_part(part_num);
+		state = get_active_state(part_num);
+		for (frame = 0; frame < nframes; frame++) {
+			part->midi_out_index = (int) buffer_index_add(render_index, frame);
+			process_midi_events(render_index, frame, part_num);
+			run_part(part, state, part_num);
+			part->denormal_offset *= -1.0;
+			index = buffer_index_add(render_index, frame);
+			part->output_buffer1[index] = part->out1;
+			part->output_buffer2[index] = part->out2;
+			if (part->fx_send) {
+				part->chorus_send_buffer1[index] = part->chorus_send1;
+				part->chorus_send_buffer2[index] = part->chorus_send2;
+				part->delay_send_buffer1[index]  = part->delay_send1;
+				part->delay_send_buffer2[index]  = part->delay_send2;
+			}
+		}
+		for (; frame < buffer_period_size; frame++) {
+			process_midi_events(render_index, frame, part_num);
+		}
+	}
+
+	/* mix, limit, and meter all parts, as the audio drivers do */
+	run_master_bus(render_index, nframes);
+	for (frame = 0; frame < nframes; frame++) {
+		out1[frame] = (float) output_buffer1[frame];
+		out2[frame] = (float) output_buffer2[frame];
+	}
+
+	/* events generated between blocks go to the start of the next one */
+	render_index = buffer_index_add(render_index, buffer_period_size);
+	set_midi_index(render_index);
+
+	return 0;
+}
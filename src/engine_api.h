@@ -0,0 +1,62 @@
+/*****************************************************************************
+ *
+ * engine_api.h
+ *
+ * PHASEX:  [P]hase [H]armonic [A]dvanced [S]ynthesis [EX]periment
+ *
+ * Copyright (C) 2012-2013 William Weston <whw@linuxmail.org>
+ *
+ * PHASEX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PHASEX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PHASEX.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+#ifndef _PHASEX_ENGINE_API_H_
+#define _PHASEX_ENGINE_API_H_
+
+#include <stddef.h>
+#include "phasex.h"
+#include "patch.h"
+#include "param.h"
+
+
+/* Notifications from the engine to its client (the GTK UI, or an embedding
+   host).  Any of these may be left NULL.  Called from engine and MIDI
+   threads, or from phasex_engine_render() when running synchronously, so
+   implementations must not block. */
+typedef struct engine_client {
+	void        (*param_update)(PARAM *param, int cc_val);
+	void        (*controller)(unsigned int part_num, int cc);
+	void        (*visible_patch)(unsigned int part_num, PATCH *patch);
+} ENGINE_CLIENT;
+
+
+extern ENGINE_CLIENT    engine_client;
+
+
+void notify_param_update(PARAM *param, int cc_val);
+void notify_controller(unsigned int part_num, int cc);
+void notify_visible_patch(unsigned int part_num, PATCH *patch);
+
+int phasex_engine_init(unsigned int rate, unsigned int period_size);
+int phasex_engine_reset(void);
+int phasex_engine_load_patch(unsigned int part_num, const char *filename);
+int phasex_engine_save_patch(unsigned int part_num, const char *filename);
+int phasex_engine_load_bank(const char *filename);
+int phasex_engine_program_pending(void);
+int phasex_engine_prepare_programs(void);
+int phasex_engine_set_param(unsigned int part_num, unsigned int param_id, float value);
+int phasex_engine_queue_midi(const unsigned char *msg, size_t len, unsigned int frame);
+int phasex_engine_render(unsigned int nframes, float *out1, float *out2);
+
+
+#endif /* _PHASEX_ENGINE_API_H_ */
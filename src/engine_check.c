@@ -0,0 +1,160 @@
+/*****************************************************************************
+ *
+ * engine_check.c
+ *
+ * PHASEX:  [P]hase [H]armonic [A]dvanced [S]ynthesis [EX]periment
+ *
+ * Copyright (C) 2012-2013 William Weston <whw@linuxmail.org>
+ *
+ * PHASEX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PHASEX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PHASEX.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "phasex.h"
+#include "engine_api.h"
+#include "filter.h"
+#include "wave.h"
+#include "param.h"
+
+
+#define CHECK_SAMPLE_RATE       44100
+#define CHECK_PERIOD_SIZE       256
+#define CHECK_PERIODS           16
+#define CHECK_NOTE_OFF_PERIOD   8
+
+/* the source tree's patches are set by the makefile */
+#ifndef CHECK_PATCH_DIR
+# define CHECK_PATCH_DIR        PATCH_DIR
+#endif
+
+/* sampled waveforms are read from the installed samples, so they are not
+   part of the check */
+#define is_sampled_wave(wave)   (((wave) >= WAVE_JUNO_OSC) && ((wave) <= WAVE_VOX_2))
+
+
+/* Render hashes for each filter type and oscillator 1 waveform, from a
+   reset engine with the source tree's default patch, with oscillators 2
+   and 3 moved off of their sampled waveforms.  Regenerate with
+   --print after a change that is meant to alter the engine output. */
+static const unsigned int expected_hash[NUM_FILTER_TYPES][NUM_WAVEFORMS] = {
+#include "engine_check.hashes"
+};
+
+
+/*****************************************************************************
+ * render_hash()
+ *
+ * Renders one note with the given filter type and oscillator 1 waveform
+ * and returns a hash of the output, quantized to 16 bits so that the hash
+ * does not depend on the last bits of floating point rounding.
+ *****************************************************************************/
+static unsigned int
+render_hash(int filter_type, int wave)
+{
+	static const unsigned char  note_on[3]  = { 0x90, 60, 100 };
+	static const unsigned char  note_off[3] = { 0x80, 60, 0 };
+	float                       out1[CHECK_PERIOD_SIZE];
+	float                       out2[CHECK_PERIOD_SIZE];
+	unsigned int                hash        = 2166136261U;
+	unsigned int                sample;
+	int                         period;
+	int                         j;
+
+	/* parameter changes can glide from the old value, so reset after */
+	phasex_engine_set_param(0, PARAM_FILTER_TYPE, (float) filter_type);
+	phasex_engine_set_param(0, PARAM_OSC1_WAVE, (float) wave);
+	phasex_engine_reset();
+
+	for (period = 0; period < CHECK_PERIODS; period++) {
+		if (period == 0) {
+			phasex_engine_queue_midi(note_on, sizeof(note_on), 0);
+		}
+		else if (period == CHECK_NOTE_OFF_PERIOD) {
+			phasex_engine_queue_midi(note_off, sizeof(note_off), 0);
+		}
+		if (phasex_engine_render(CHECK_PERIOD_SIZE, out1, out2) != 0) {
+			return 0;
+		}
+		for (j = 0; j < CHECK_PERIOD_SIZE; j++) {
+			sample = (unsigned int)(int) lrintf(out1[j] * 32767.0f);
+			hash   = (hash ^ (sample & 0xFFFF)) * 16777619U;
+			sample = (unsigned int)(int) lrintf(out2[j] * 32767.0f);
+			hash   = (hash ^ (sample & 0xFFFF)) * 16777619U;
+		}
+	}
+
+	return hash;
+}
+
+
+/*****************************************************************************
+ * main()
+ *
+ * Renders a note through the engine API for every filter type and
+ * computed oscillator 1 waveform, and compares each render against its
+ * stored hash.
+ * With --print, writes the hash table for engine_check.hashes instead.
+ *****************************************************************************/
+int
+main(int argc, char **argv)
+{
+	unsigned int    hash;
+	int             print       = ((argc > 1) && (strcmp(argv[1], "--print") == 0));
+	int             failed      = 0;
+	int             filter_type;
+	int             wave;
+
+	/* use the source tree's default patch, not an installed one */
+	snprintf(sys_default_patch, PATH_MAX, "%s/%s", CHECK_PATCH_DIR, SYS_DEFAULT_PATCH);
+
+	if (phasex_engine_init(CHECK_SAMPLE_RATE, CHECK_PERIOD_SIZE) != 0) {
+		fprintf(stderr, "engine_check:  unable to initialize engine.\n");
+		return 1;
+	}
+
+	/* the default patch uses sampled waveforms on oscillators 2 and 3 */
+	phasex_engine_set_param(0, PARAM_OSC2_WAVE, (float) WAVE_SAW);
+	phasex_engine_set_param(0, PARAM_OSC3_WAVE, (float) WAVE_SQUARE);
+
+	for (filter_type = 0; filter_type < NUM_FILTER_TYPES; filter_type++) {
+		if (print) {
+			printf("\t{");
+		}
+		for (wave = 0; wave < NUM_WAVEFORMS; wave++) {
+			hash = is_sampled_wave(wave) ? 0 : render_hash(filter_type, wave);
+			if (print) {
+				printf("%s0x%08x%s", (((wave % 4) == 0) ? "\n\t\t" : " "), hash,
+				       ((wave < (NUM_WAVEFORMS - 1)) ? "," : ""));
+			}
+			else if (hash != expected_hash[filter_type][wave]) {
+				fprintf(stderr, "engine_check:  filter type %d, wave %d:  "
+				        "hash 0x%08x, expected 0x%08x\n",
+				        filter_type, wave, hash, expected_hash[filter_type][wave]);
+				failed++;
+			}
+		}
+		if (print) {
+			printf("\n\t},\n");
+		}
+	}
+
+	if (!print) {
+		printf("engine_check:  %d of %d renders differ.\n",
+		       failed, (NUM_FILTER_TYPES * NUM_WAVEFORMS));
+	}
+
+	return (failed > 0) ? 1 : 0;
+}
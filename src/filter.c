@@ -257,7 +257,7 @@ run_experimental_filter(VOICE *voice, PART *part, PATCH_STATE *state)
 
 	/* assignable lfo/velocity controls with dedicated lfo cutoff */
 	filter_index = ((int)(((tmp * state->filter_lfo_cutoff) +
-	                       (part->lfo_out[2] * state->lfo_3_cutoff) +
+	                       (part->lfo_out[2] * part->smooth_value[SMOOTH_LFO_CUTOFF]) +
 	                       (state->filter_env_amount * voice->filter_env_raw) -
 	                       part->filter_env_offset +
 	                       state->filter_cutoff +
@@ -266,15 +266,19 @@ run_experimental_filter(VOICE *voice, PART *part, PATCH_STATE *state)
 		state->patch_tune;
 
 	if (filter_index < 0) {
-		filter_f = filter_table[0];
 		PHASEX_DEBUG(DEBUG_CLASS_ENGINE, "Filter Index = %d\n", filter_index);
+		filter_index = 0;
 	}
 	else if (filter_index > (filter_limit - (24 * TUNING_RESOLUTION) - 0)) {
-		filter_f = filter_table[filter_limit - (24 * TUNING_RESOLUTION) - 0];
+		filter_index = filter_limit - (24 * TUNING_RESOLUTION) - 0;
 	}
-	else {
-		filter_f = filter_table[filter_index];
+
+	/* an octave down in the table for each doubling of the rate */
+	filter_index -= part->os_filter_shift;
+	if (filter_index < 0) {
+		filter_index = 0;
 	}
+	filter_f = filter_table[filter_index];
 
 	filter_k = (2.0 * filter_f) - 1.0;
 	filter_r = (sample_t)(((1.0 + (sample_t) MATH_SIN(filter_q * M_PI_2)) *
@@ -453,7 +457,7 @@ run_moog_filter(VOICE *voice, PART *part, PATCH_STATE *state)
 
 	/* assignable lfo/velocity controls with dedicated lfo cutoff */
 	filter_index = ((int)(((tmp * state->filter_lfo_cutoff) +
-	                       (part->lfo_out[2] * state->lfo_3_cutoff) +
+	                       (part->lfo_out[2] * part->smooth_value[SMOOTH_LFO_CUTOFF]) +
 	                       (state->filter_env_amount * voice->filter_env_raw) -
 	                       part->filter_env_offset +
 	                       state->filter_cutoff +
@@ -462,15 +466,19 @@ run_moog_filter(VOICE *voice, PART *part, PATCH_STATE *state)
 		state->patch_tune;
 
 	if (filter_index < 0) {
-		filter_f = filter_table[0];
 		PHASEX_DEBUG(DEBUG_CLASS_ENGINE, "Filter Index = %d\n", filter_index);
+		filter_index = 0;
 	}
 	else if (filter_index > (filter_limit - (24 * TUNING_RESOLUTION) - 0)) {
-		filter_f = filter_table[filter_limit - (24 * TUNING_RESOLUTION) - 0];
+		filter_index = filter_limit - (24 * TUNING_RESOLUTION) - 0;
 	}
-	else {
-		filter_f = filter_table[filter_index];
+
+	/* an octave down in the table for each doubling of the rate */
+	filter_index -= part->os_filter_shift;
+	if (filter_index < 0) {
+		filter_index = 0;
 	}
+	filter_f = filter_table[filter_index];
 
 	filter_k = (2.0 * filter_f) - 1.0;
 	filter_r = (sample_t)(((1.0 + (sample_t) MATH_SIN(filter_q * M_PI_2)) *
@@ -649,7 +657,7 @@ run_filter(VOICE *voice, PART *part, PATCH_STATE *state)
 
 	/* assignable lfo/velocity controls with dedicated lfo cutoff */
 	filter_index = ((int)(((tmp * state->filter_lfo_cutoff) +
-	                       (part->lfo_out[2] * state->lfo_3_cutoff) +
+	                       (part->lfo_out[2] * part->smooth_value[SMOOTH_LFO_CUTOFF]) +
 	                       (state->filter_env_amount * voice->filter_env_raw) -
 	                       part->filter_env_offset +
 	                       state->filter_cutoff +
@@ -660,15 +668,19 @@ run_filter(VOICE *voice, PART *part, PATCH_STATE *state)
 	/* now look up the f coefficient from the table */
 	/* use hard clipping (top midi note + 2 octaves) for filter cutoff */
 	if (filter_index < 0) {
-		filter_f = filter_table[0];
 		PHASEX_DEBUG(DEBUG_CLASS_ENGINE, "Filter Index = %d\n", filter_index);
+		filter_index = 0;
 	}
 	else if (filter_index > (filter_limit - 11)) {
-		filter_f = filter_table[filter_limit - 11];
+		filter_index = filter_limit - 11;
 	}
-	else {
-		filter_f = filter_table[filter_index];
+
+	/* an octave down in the table for each doubling of the rate */
+	filter_index -= part->os_filter_shift;
+	if (filter_index < 0) {
+		filter_index = 0;
 	}
+	filter_f = filter_table[filter_index];
 
 	/* Two variations of the Chamberlin filter */
 	switch (state->filter_type) {
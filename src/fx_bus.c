@@ -0,0 +1,188 @@
+/*****************************************************************************
+ *
+ * fx_bus.c
+ *
+ * PHASEX:  [P]hase [H]armonic [A]dvanced [S]ynthesis [EX]periment
+ *
+ * Copyright (C) 2012-2013 William Weston <whw@linuxmail.org>
+ *
+ * PHASEX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PHASEX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PHASEX.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+#include <string.h>
+#include <glib.h>
+#include "phasex.h"
+#include "engine.h"
+#include "patch.h"
+#include "buffer.h"
+#include "settings.h"
+#include "fx_bus.h"
+#include "debug.h"
+
+
+/* Shared chorus and delay returns for the current period */
+sample_t        fx_bus_out1[PHASEX_MAX_BUFSIZE];
+sample_t        fx_bus_out2[PHASEX_MAX_BUFSIZE];
+
+int             fx_bus_active       = 0;
+unsigned int    fx_bus_part_num     = 0;
+
+/* Sends summed over all sending parts for the current period */
+static sample_t chorus_in1[PHASEX_MAX_BUFSIZE];
+static sample_t chorus_in2[PHASEX_MAX_BUFSIZE];
+static sample_t delay_in1[PHASEX_MAX_BUFSIZE];
+static sample_t delay_in2[PHASEX_MAX_BUFSIZE];
+
+/* Stand-in part for running the shared effects.  run_chorus() and
+   run_delay() read their input from and write their output to the part,
+   so the real bus part can keep running its voices meanwhile. */
+static PART     bus_part;
+
+/* Phase correction from the bus part's engine thread, not yet applied */
+static gint     phase_sync_pending  = 0;
+
+
+/*****************************************************************************
+ * init_fx_bus()
+ *
+ * Marks which parts send to the shared chorus and delay buses instead of
+ * running their own.  The buses are the chorus and delay of fx_bus_part,
+ * using that part's patch settings.  Buses are only used at the normal
+ * sample rate, since under- and oversampled parts size their effects
+ * for the engine rate.  Called from init_engine_parameters().
+ *****************************************************************************/
+void
+init_fx_bus(void)
+{
+	PART            *part;
+	unsigned int    part_num;
+
+	fx_bus_part_num = (unsigned int)(setting_fx_bus_part - 1);
+	fx_bus_active   = 0;
+
+	if (sample_rate_mode == SAMPLE_RATE_NORMAL) {
+		for (part_num = 0; part_num < MAX_PARTS; part_num++) {
+			if (setting_part_fx_send[part_num]) {
+				fx_bus_active = 1;
+			}
+		}
+	}
+
+	/* the bus part's own effects are the buses, so it always sends */
+	for (part_num = 0; part_num < MAX_PARTS; part_num++) {
+		part = get_part(part_num);
+		part->fx_send = fx_bus_active &&
+			(setting_part_fx_send[part_num] || (part_num == fx_bus_part_num));
+		part->chorus_send1 = part->chorus_send2 = 0.0;
+		part->delay_send1  = part->delay_send2  = 0.0;
+	}
+
+	/* bus effects return fully wet */
+	bus_part.smooth_value[SMOOTH_CHORUS_DRY] = 0.0;
+	bus_part.smooth_value[SMOOTH_CHORUS_WET] = 1.0;
+	bus_part.smooth_value[SMOOTH_DELAY_DRY]  = 0.0;
+	bus_part.smooth_value[SMOOTH_DELAY_WET]  = 1.0;
+	bus_part.denormal_offset = (sample_t)(1e-19);
+
+	if (fx_bus_active) {
+		PHASEX_DEBUG(DEBUG_CLASS_ENGINE, "Shared fx buses running on part %d.\n",
+		             (fx_bus_part_num + 1));
+	}
+}
+
+
+/*****************************************************************************
+ * queue_fx_bus_phase_sync()
+ *
+ * Queues a phase correction for the shared buses, to be applied by the
+ * audio thread at the start of its next period.  Called from the bus
+ * part's engine thread.
+ *****************************************************************************/
+void
+queue_fx_bus_phase_sync(int phase_correction)
+{
+	g_atomic_int_add(&phase_sync_pending, phase_correction);
+}
+
+
+/*****************************************************************************
+ * run_fx_bus()
+ *
+ * Sums <nframes> of chorus and delay sends from all sending parts,
+ * starting at ring buffer <index>, and runs the shared chorus and delay
+ * once over the result.  The returns are left in fx_bus_out1/2 for the
+ * audio driver to mix in:  into the master mix, or into the bus part's
+ * own outputs with JACK multi-out.  Runs in the audio thread, once per
+ * period.
+ *****************************************************************************/
+void
+run_fx_bus(unsigned int index, unsigned int nframes)
+{
+	PART            *part;
+	PART            *src_part = get_part(fx_bus_part_num);
+	PATCH_STATE     *state    = get_active_state(fx_bus_part_num);
+	CHORUS          *chorus   = get_chorus(fx_bus_part_num);
+	DELAY           *delay    = get_delay(fx_bus_part_num);
+	unsigned int    part_num;
+	unsigned int    r_index;
+	unsigned int    j;
+	int             phase_correction;
+
+	phase_correction = g_atomic_int_get(&phase_sync_pending);
+	if (phase_correction != 0) {
+		g_atomic_int_add(&phase_sync_pending, -phase_correction);
+		phase_sync_fx(delay, chorus, phase_correction);
+	}
+
+	memset(chorus_in1, 0, nframes * sizeof(sample_t));
+	memset(chorus_in2, 0, nframes * sizeof(sample_t));
+	memset(delay_in1,  0, nframes * sizeof(sample_t));
+	memset(delay_in2,  0, nframes * sizeof(sample_t));
+
+	for (part_num = 0; part_num < MAX_PARTS; part_num++) {
+		part = get_part(part_num);
+		if (!part->fx_send) {
+			continue;
+		}
+		r_index = index;
+		for (j = 0; j < nframes; j++) {
+			chorus_in1[j] += part->chorus_send_buffer1[r_index];
+			chorus_in2[j] += part->chorus_send_buffer2[r_index];
+			delay_in1[j]  += part->delay_send_buffer1[r_index];
+			delay_in2[j]  += part->delay_send_buffer2[r_index];
+			if (++r_index >= buffer_size) {
+				r_index = 0;
+			}
+		}
+	}
+
+	/* delay lfo follows the bus part's lfos */
+	memcpy(bus_part.lfo_out, src_part->lfo_out, sizeof(bus_part.lfo_out));
+
+	for (j = 0; j < nframes; j++) {
+		bus_part.out1 = chorus_in1[j];
+		bus_part.out2 = chorus_in2[j];
+		run_chorus(chorus, &bus_part, state);
+		fx_bus_out1[j] = bus_part.out1;
+		fx_bus_out2[j] = bus_part.out2;
+
+		bus_part.out1 = delay_in1[j];
+		bus_part.out2 = delay_in2[j];
+		run_delay(delay, &bus_part, state);
+		fx_bus_out1[j] += bus_part.out1;
+		fx_bus_out2[j] += bus_part.out2;
+
+		bus_part.denormal_offset *= -1.0;
+	}
+}
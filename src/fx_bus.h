@@ -0,0 +1,41 @@
+/*****************************************************************************
+ *
+ * fx_bus.h
+ *
+ * PHASEX:  [P]hase [H]armonic [A]dvanced [S]ynthesis [EX]periment
+ *
+ * Copyright (C) 2012-2013 William Weston <whw@linuxmail.org>
+ *
+ * PHASEX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PHASEX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PHASEX.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+#ifndef _PHASEX_FX_BUS_H_
+#define _PHASEX_FX_BUS_H_
+
+#include "phasex.h"
+
+
+extern sample_t         fx_bus_out1[PHASEX_MAX_BUFSIZE];
+extern sample_t         fx_bus_out2[PHASEX_MAX_BUFSIZE];
+
+extern int              fx_bus_active;
+extern unsigned int     fx_bus_part_num;
+
+
+void init_fx_bus(void);
+void queue_fx_bus_phase_sync(int phase_correction);
+void run_fx_bus(unsigned int index, unsigned int nframes);
+
+
+#endif /* _PHASEX_FX_BUS_H_ */
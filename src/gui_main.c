@@ -39,6 +39,7 @@
 #include "param.h"
 #include "midimap.h"
 #include "midi_process.h"
+#include "engine_api.h"
 #include "alsa_pcm.h"
 #include "alsa_seq.h"
 #include "rawmidi.h"
@@ -56,6 +57,7 @@
 #include "bank.h"
 #include "session.h"
 #include "settings.h"
+#include "autosave.h"
 #include "help.h"
 #include "debug.h"
 
@@ -121,6 +123,11 @@ gtkui_thread(void *UNUSED(arg))
 		PHASEX_ERROR("gtk_init_check() failure!\n");
 	}
 
+	/* route engine notifications to the GUI */
+	engine_client.param_update  = gui_param_midi_update;
+	engine_client.controller    = gui_midimap_controller;
+	engine_client.visible_patch = gui_visible_patch_change;
+
 	/* create splash screen and sit in gtk_main until the rest is ready */
 	create_splash_window();
 
@@ -440,9 +447,11 @@ gui_main_loop_iteration(gpointer data)
 {
 	PATCH           *patch      = get_visible_patch();
 	int             interval    = (int)((long int) data % 1000000);
-	static int      counter     = 0;
 #ifdef WALKING_UPDATE
 	static int      walking     = 0;
+#endif
+#ifdef ENABLE_CONFIG_DIALOG
+	static int      stats_msec  = 0;
 #endif
 	int             num_updated = 0;
 	int             param_num;
@@ -487,6 +496,14 @@ gui_main_loop_iteration(gpointer data)
 		}
 	}
 
+	/* part and master levels from the master bus */
+	update_gui_meters(0);
+
+	/* the gui owns what autosave writes, so the snapshot is taken here */
+	if (g_atomic_int_get(&autosave_snapshot_state) == AUTOSAVE_SNAPSHOT_REQUESTED) {
+		autosave_snapshot();
+	}
+
 	/* check for changes in audio/midi connection lists */
 	/* TODO:  rebuild menu items when hardware or port lists change */
 	if (alsa_pcm_hw_changed || alsa_seq_ports_changed || alsa_rawmidi_hw_changed) {
@@ -515,18 +532,16 @@ gui_main_loop_iteration(gpointer data)
 		focus_widget = NULL;
 	}
 
-	/* dump the session and midimap every 100x through here */
-	counter++;
-	if (counter == 50) {
-		save_midimap(user_midimap_dump_file);
-	}
-	else if (counter == 100) {
-		counter = 0;
-		save_session(user_session_dump_dir, visible_sess_num, 0);
-
-		/* TODO: allow feeding of new patches through
-		   /tmp/patchload-## or /tmp/sessionload */
+#ifdef ENABLE_CONFIG_DIALOG
+	/* refresh midi clock statistics about once per second */
+	if (midi_clock_stats_label != NULL) {
+		stats_msec += interval;
+		if (stats_msec >= 1000) {
+			stats_msec = 0;
+			update_midi_clock_stats_label();
+		}
 	}
+#endif
 
 	/* if config dialog was open before restarting, then open it again */
 #ifdef ENABLE_CONFIG_DIALOG
@@ -951,6 +966,7 @@ restart_gtkui(void)
 
 	patch_modified_label       = NULL;
 	session_modified_label     = NULL;
+	meter_label                = NULL;
 
 	patch_io_start_adj         = NULL;
 	session_io_start_adj       = NULL;
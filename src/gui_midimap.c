@@ -165,6 +165,21 @@ close_cc_edit_dialog(GtkWidget *UNUSED(widget), gpointer UNUSED(data))
 }
 
 
+/*****************************************************************************
+ * gui_midimap_controller()
+ *
+ * Engine client hook:  picks up the controller number while the cc edit
+ * dialog is listening for MIDI.
+ *****************************************************************************/
+void
+gui_midimap_controller(unsigned int UNUSED(part_num), int cc)
+{
+	if (!cc_edit_ignore_midi && cc_edit_active) {
+		cc_edit_cc_num = cc;
+	}
+}
+
+
 /*****************************************************************************
  * create_midimap_load_dialog()
  *****************************************************************************/
@@ -43,6 +43,7 @@ void update_param_cc_map(GtkWidget *widget, gpointer data);
 void update_param_locked(GtkWidget *widget, gpointer data);
 void update_param_ignore(GtkWidget *widget, gpointer UNUSED(data));
 void close_cc_edit_dialog(GtkWidget *UNUSED(widget), gpointer UNUSED(data));
+void gui_midimap_controller(unsigned int UNUSED(part_num), int cc);
 void create_midimap_load_dialog(void);
 void run_midimap_load_dialog(void);
 void create_midimap_save_dialog(void);
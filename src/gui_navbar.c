@@ -42,6 +42,7 @@
 #include "session.h"
 #include "settings.h"
 #include "engine.h"
+#include "master_bus.h"
 #include "gui_main.h"
 #include "gui_bank.h"
 #include "gui_session.h"
@@ -54,6 +55,7 @@
 #include "midi_event.h"
 #include "timekeeping.h"
 #include "buffer.h"
+#include "midimap.h"
 #include "debug.h"
 
 
@@ -76,6 +78,8 @@ GtkObject   *midi_channel_adj           = NULL;
 GtkWidget   *patch_modified_label       = NULL;
 GtkWidget   *session_modified_label     = NULL;
 
+GtkWidget   *meter_label                = NULL;
+
 int         show_patch_modified         = 0;
 int         show_session_modified       = 0;
 
@@ -587,6 +591,23 @@ create_navbar(GtkWidget *UNUSED(main_window), GtkWidget *parent_vbox)
 	                 GTK_SIGNAL_FUNC(broadcast_notes_off),
 	                 (gpointer) NULL);
 
+	/* *** Part and master level meter */
+	event = gtk_event_box_new();
+	gtk_widget_set_name(event, "IndicatorLabel");
+	widget_set_backing_store(event);
+	meter_label = gtk_label_new(NULL);
+	gtk_widget_set_name(meter_label, "IndicatorLabel");
+	widget_set_custom_font(meter_label, numeric_font_desc);
+	widget_set_backing_store(meter_label);
+#if GTK_CHECK_VERSION(2, 6, 0)
+	gtk_label_set_width_chars(GTK_LABEL(meter_label), 12);
+#else
+	gtk_widget_set_size_request(meter_label, 96, 22);
+#endif
+	gtk_container_add(GTK_CONTAINER(event), meter_label);
+	gtk_box_pack_start(GTK_BOX(box), event, TRUE, TRUE, 1);
+	update_gui_meters(1);
+
 	/* *** MIDI CH selector box (label + knob + label) */
 	box = gtk_hbox_new(FALSE, 0);
 	widget_set_backing_store(box);
@@ -880,6 +901,7 @@ midi_channel_label_handle_event(gpointer UNUSED(data1),
 	/* only deal with real changes */
 	if (part->midi_channel != new_channel) {
 		part->midi_channel = new_channel;
+		build_midi_route();
 		gp->param[info->id].value.cc_prev = gp->param[info->id].value.cc_val;
 		gp->param[info->id].value.cc_val  = new_channel;
 		gp->param[info->id].value.int_val = new_channel + gp->param[info->id].info->cc_offset;
@@ -907,6 +929,74 @@ midi_channel_label_handle_event(gpointer UNUSED(data1),
 }
 
 
+/*****************************************************************************
+ * meter_db()
+ *
+ * Converts a meter level to whole dB for display, with -99 for silence.
+ *****************************************************************************/
+static int
+meter_db(sample_t level)
+{
+	if (level < 0.00001) {
+		return -99;
+	}
+	return (int) lrint(20.0 * log10((double) level));
+}
+
+
+/*****************************************************************************
+ * update_gui_meters()
+ *
+ * Shows the peak level of the visible part, the peak level of the final
+ * mix, and the master limiter's gain reduction, as published by the master
+ * bus.  The label is only rewritten when a displayed value changes, or
+ * when <force> is set.
+ *****************************************************************************/
+void
+update_gui_meters(int force)
+{
+	static int      show_part_db    = 0;
+	static int      show_master_db  = 0;
+	static int      show_limit_db   = 0;
+	char            meter_text[64];
+	sample_t        peak;
+	sample_t        rms;
+	int             part_db;
+	int             master_db;
+	int             limit_db;
+
+	if (meter_label == NULL) {
+		return;
+	}
+
+	get_part_meter(visible_part_num, &peak, &rms);
+	part_db = meter_db(peak);
+	get_master_meter(&peak, &rms);
+	master_db = meter_db(peak);
+	limit_db  = meter_db(get_master_limiter_gain());
+
+	if (!force && (part_db == show_part_db) &&
+	    (master_db == show_master_db) && (limit_db == show_limit_db)) {
+		return;
+	}
+	show_part_db   = part_db;
+	show_master_db = master_db;
+	show_limit_db  = limit_db;
+
+	if (limit_db < 0) {
+		snprintf(meter_text, sizeof(meter_text),
+		         "<small>Part %3d dB\nMain %3d %3d</small>",
+		         part_db, master_db, limit_db);
+	}
+	else {
+		snprintf(meter_text, sizeof(meter_text),
+		         "<small>Part %3d dB\nMain %3d dB</small>",
+		         part_db, master_db);
+	}
+	gtk_label_set_markup(GTK_LABEL(meter_label), meter_text);
+}
+
+
 /*****************************************************************************
  * queue_test_note()
  *
@@ -45,6 +45,8 @@ extern GtkObject    *midi_channel_adj;
 extern GtkWidget    *patch_modified_label;
 extern GtkWidget    *session_modified_label;
 
+extern GtkWidget    *meter_label;
+
 extern GtkWidget    *patch_io_start_spin;
 
 extern int          show_patch_modified;
@@ -57,6 +59,7 @@ void create_navbar(GtkWidget *UNUSED(main_window), GtkWidget *parent_vbox);
 int midi_channel_label_handle_event(gpointer UNUSED(data1),
                                     gpointer data2,
                                     gpointer UNUSED(data3));
+void update_gui_meters(int force);
 void queue_test_note(GtkWidget *UNUSED(widget), gpointer UNUSED(data));
 
 
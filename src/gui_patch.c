@@ -275,3 +275,18 @@ update_gui_patch(PATCH *patch, int part_switch)
 	update_gui_patch_modified();
 	update_gui_session_modified();
 }
+
+
+/*****************************************************************************
+ * gui_visible_patch_change()
+ *
+ * Engine client hook:  queues a full GUI update when a program change lands
+ * on the visible part.  Picked up by the GUI main loop.
+ *****************************************************************************/
+void
+gui_visible_patch_change(unsigned int part_num, PATCH *patch)
+{
+	if (part_num == visible_part_num) {
+		pending_visible_patch = patch;
+	}
+}
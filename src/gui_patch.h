@@ -44,6 +44,7 @@ void update_gui_patch_modified(void);
 void update_gui_session_modified(void);
 void update_gui_patch_changed(PATCH *patch, int part_switch);
 void update_gui_patch(PATCH *patch, int part_switch);
+void gui_visible_patch_change(unsigned int part_num, PATCH *patch);
 
 
 #endif /* _PHASEX_GUI_PATCH_H_ */
@@ -39,14 +39,18 @@
 #include "buffer.h"
 #include "jack.h"
 #include "jack_midi.h"
+#include "midi_out.h"
 #include "jack_transport.h"
 #include "midi_event.h"
 #include "midi_process.h"
 #include "engine.h"
+#include "master_bus.h"
+#include "fx_bus.h"
 #include "bank.h"
 #include "session.h"
 #include "settings.h"
 #include "debug.h"
+#include "trace.h"
 #include "driver.h"
 
 #ifdef HAVE_JACK_SESSION_H
@@ -72,6 +76,7 @@ jack_port_t             *dest_port1[MAX_PARTS];
 jack_port_t             *dest_port2[MAX_PARTS];
 
 jack_port_t             *midi_input_port            = NULL;
+jack_port_t             *midi_output_port           = NULL;
 
 pthread_mutex_t         sample_rate_mutex;
 
@@ -109,14 +114,14 @@ jack_process_buffer_multi_out(jack_nframes_t nframes, void *UNUSED(arg))
 	unsigned int                i;
 	PART                        *part;
 	unsigned int                a_index;
-#ifdef MATH_64_BIT
-	unsigned int                j;
-#endif
 
 	if (!jack_running || pending_shutdown || (jack_audio_client == NULL)) {
 		return 0;
 	}
 
+	PHASEX_TRACE(TRACE_AUDIO_PERIOD_BEGIN, -1,
+	             (get_audio_index() / buffer_period_size), nframes, 0, 0);
+
 	set_midi_cycle_time();
 	if (midi_driver == MIDI_DRIVER_JACK) {
 		jack_process_midi(nframes);
@@ -127,48 +132,43 @@ jack_process_buffer_multi_out(jack_nframes_t nframes, void *UNUSED(arg))
 
 	a_index = get_audio_index();
 
+	flush_midi_out(nframes, a_index);
+
 	for (i = 0; i < MAX_PARTS; i++) {
 		out1 = jack_port_get_buffer(output_port1[i], nframes);
 		out2 = jack_port_get_buffer(output_port2[i], nframes);
 
 		part = get_part(i);
 
-#ifdef MATH_32_BIT
-		memcpy((void *) out1, (void *) & (part->output_buffer1[a_index]),
-		       sizeof(jack_default_audio_sample_t) * nframes);
-		memcpy((void *) out2, (void *) & (part->output_buffer2[a_index]),
-		       sizeof(jack_default_audio_sample_t) * nframes);
-#endif
-#ifdef MATH_64_BIT
-		for (j = 0; j < nframes; j++) {
-			out1[j] = (jack_default_audio_sample_t)part->output_buffer1[a_index + j];
-			out2[j] = (jack_default_audio_sample_t)part->output_buffer2[a_index + j];
+		buffer_read_ring(out1, part->output_buffer1, a_index, nframes);
+		buffer_read_ring(out2, part->output_buffer2, a_index, nframes);
+	}
+
+	/* shared chorus and delay return on the bus part's outputs */
+	if (fx_bus_active) {
+		run_fx_bus(a_index, nframes);
+		out1 = jack_port_get_buffer(output_port1[fx_bus_part_num], nframes);
+		out2 = jack_port_get_buffer(output_port2[fx_bus_part_num], nframes);
+		for (i = 0; i < nframes; i++) {
+			out1[i] += (jack_default_audio_sample_t) fx_bus_out1[i];
+			out2[i] += (jack_default_audio_sample_t) fx_bus_out2[i];
 		}
-#endif
 	}
 
 #ifdef ENABLE_INPUTS
 	in1 = jack_port_get_buffer(input_port1, nframes);
 	in2 = jack_port_get_buffer(input_port2, nframes);
 
-# ifdef MATH_32_BIT
-	memcpy((void *) & (input_buffer1[a_index]), (void *) in1,
-	       sizeof(jack_default_audio_sample_t) * nframes);
-	memcpy((void *) & (input_buffer2[a_index]), (void *) in2,
-	       sizeof(jack_default_audio_sample_t) * nframes);
-# endif
-# ifdef MATH_64_BIT
-	for (j = 0; j < nframes; j++) {
-		input_buffer1[a_index + j] = (sample_t)in1[j];
-		input_buffer2[a_index + j] = (sample_t)in2[j];
-	}
-# endif
+	buffer_write_ring(input_buffer1, in1, a_index, nframes);
+	buffer_write_ring(input_buffer2, in2, a_index, nframes);
 #endif
 
 	inc_audio_index(nframes);
 
 	jack_process_transport(nframes);
 
+	PHASEX_TRACE(TRACE_AUDIO_PERIOD_END, -1, 0, 0, 0, 0);
+
 	return 0;
 }
 
@@ -181,9 +181,7 @@ jack_process_buffer_multi_out(jack_nframes_t nframes, void *UNUSED(arg))
 int
 jack_process_buffer_stereo_out(jack_nframes_t nframes, void *UNUSED(arg))
 {
-	PART                        *part;
 	unsigned int                i;
-	unsigned int                j;
 	unsigned int                a_index;
 # ifdef ENABLE_INPUTS
 	jack_default_audio_sample_t *in1;
@@ -196,6 +194,9 @@ jack_process_buffer_stereo_out(jack_nframes_t nframes, void *UNUSED(arg))
 		return 0;
 	}
 
+	PHASEX_TRACE(TRACE_AUDIO_PERIOD_BEGIN, -1,
+	             (get_audio_index() / buffer_period_size), nframes, 0, 0);
+
 	set_midi_cycle_time();
 	if (midi_driver == MIDI_DRIVER_JACK) {
 		jack_process_midi(nframes);
@@ -207,34 +208,31 @@ jack_process_buffer_stereo_out(jack_nframes_t nframes, void *UNUSED(arg))
 	out1 = jack_port_get_buffer(output_port1[0], nframes);
 	out2 = jack_port_get_buffer(output_port2[0], nframes);
 
-	memset((void *) out1, 0, nframes * sizeof(jack_default_audio_sample_t));
-	memset((void *) out2, 0, nframes * sizeof(jack_default_audio_sample_t));
-
 	a_index = get_audio_index();
 
-	for (i = 0; i < MAX_PARTS; i++) {
-		part = get_part(i);
+	flush_midi_out(nframes, a_index);
 
-		for (j = 0; j < nframes; j++) {
-			out1[j] += (jack_default_audio_sample_t) part->output_buffer1[a_index + j];
-			out2[j] += (jack_default_audio_sample_t) part->output_buffer2[a_index + j];
-		}
+	/* mix, limit, and meter all parts */
+	run_master_bus(a_index, nframes);
+	for (i = 0; i < nframes; i++) {
+		out1[i] = (jack_default_audio_sample_t) output_buffer1[i];
+		out2[i] = (jack_default_audio_sample_t) output_buffer2[i];
 	}
 
 # ifdef ENABLE_INPUTS
 	in1 = jack_port_get_buffer(input_port1, nframes);
 	in2 = jack_port_get_buffer(input_port2, nframes);
 
-	memcpy((void *) & (input_buffer1[a_index]), (void *) in1,
-	       sizeof(jack_default_audio_sample_t) * nframes);
-	memcpy((void *) & (input_buffer2[a_index]), (void *) in2,
-	       sizeof(jack_default_audio_sample_t) * nframes);
+	buffer_write_ring(input_buffer1, in1, a_index, nframes);
+	buffer_write_ring(input_buffer2, in2, a_index, nframes);
 # endif
 
 	inc_audio_index(nframes);
 
 	jack_process_transport(nframes);
 
+	PHASEX_TRACE(TRACE_AUDIO_PERIOD_END, -1, 0, 0, 0, 0);
+
 	return 0;
 }
 
@@ -539,32 +537,21 @@ jack_port_rename_handler(jack_port_id_t UNUSED(port),
 int
 jack_bufsize_handler(jack_nframes_t nframes, void *UNUSED(arg))
 {
-	/* Make sure buffer doesn't get overrun */
-	if (nframes > PHASEX_MAX_BUFSIZE) {
-		PHASEX_ERROR("JACK requested buffer size:  "
-		             "%d (%d * %d periods).  Max is:  %d.\n",
-		             (nframes * DEFAULT_BUFFER_PERIODS),
-		             nframes,
-		             DEFAULT_BUFFER_PERIODS,
-		             PHASEX_MAX_BUFSIZE);
-		phasex_shutdown("Buffer size exceeded.  Exiting...\n");
-	}
 	if ((unsigned int) buffer_period_size != nframes) {
 		sample_rate_changed = 1;
 	}
-	buffer_periods     = DEFAULT_BUFFER_PERIODS;
-	buffer_period_size = nframes;
-	buffer_size        = nframes * buffer_periods;
-	buffer_latency     = setting_buffer_latency * buffer_period_size;
-	buffer_size_mask   = buffer_size - 1;
-	buffer_period_mask = buffer_period_size - 1;
+
+	/* Make sure buffer doesn't get overrun */
+	if (set_buffer_geometry(nframes) != 0) {
+		phasex_shutdown("Buffer size exceeded.  Exiting...\n");
+	}
 
 	init_buffer_indices(1);
 	start_midi_clock();
 
 	PHASEX_DEBUG(DEBUG_CLASS_AUDIO,
-	             "JACK requested buffer size:  %d (%d * %d periods, mask=0x%x)\n",
-	             buffer_size, buffer_period_size, buffer_periods, buffer_size_mask);
+	             "JACK requested buffer size:  %d (%d * %d periods)\n",
+	             buffer_size, buffer_period_size, buffer_periods);
 
 	return 0;
 }
@@ -640,12 +627,27 @@ jack_shutdown_handler(void *UNUSED(arg))
 	jack_thread_p       = 0;
 	jack_audio_client   = NULL;
 	midi_input_port     = NULL;
+	midi_output_port    = NULL;
+	g_atomic_int_set(&midi_out_active, 0);
 
 	PHASEX_DEBUG(DEBUG_CLASS_AUDIO, "JACK shutdown handler called in client thread 0x%lx\n",
 	             pthread_self());
 }
 
 
+/*****************************************************************************
+ * jack_thread_init_handler()
+ *
+ * Called by JACK in each thread it creates for the client, before the
+ * thread runs any callbacks.
+ *****************************************************************************/
+void
+jack_thread_init_handler(void *UNUSED(arg))
+{
+	trace_thread_init("jack process");
+}
+
+
 /*****************************************************************************
  * jack_xrun_handler()
  *
@@ -711,6 +713,11 @@ jack_latency_handler(jack_latency_callback_mode_t mode, void *UNUSED(arg))
 	else if (mode == JackPlaybackLatency) {
 		min_adj = setting_buffer_latency * buffer_period_size;
 		max_adj = setting_buffer_latency * buffer_period_size;
+		/* limiter lookahead only applies to the stereo mix */
+		if (!setting_jack_multi_out) {
+			min_adj += get_master_latency();
+			max_adj += get_master_latency();
+		}
 		for (i = 0; i < num_output_pairs; i++) {
 			jack_port_get_latency_range(dest_port1[i], JackPlaybackLatency, &range);
 			PHASEX_DEBUG(DEBUG_CLASS_AUDIO,
@@ -919,17 +926,9 @@ jack_audio_init(void)
 	/* get buffer size */
 	new_period_size = jack_get_buffer_size(jack_audio_client);
 	if (buffer_period_size != new_period_size) {
-		buffer_period_size = new_period_size;
 		sample_rate_changed = 1;
 	}
-	buffer_periods     = DEFAULT_BUFFER_PERIODS;
-	buffer_size        = buffer_period_size * buffer_periods;
-	buffer_latency     = setting_buffer_latency * buffer_period_size;
-	buffer_size_mask   = buffer_size - 1;
-	buffer_period_mask = buffer_period_size - 1;
-	if (buffer_size > PHASEX_MAX_BUFSIZE) {
-		PHASEX_WARN("JACK requested buffer size:  %d (%d * %d periods).  Max is:  %d.\n",
-		            buffer_size, buffer_period_size, buffer_periods, PHASEX_MAX_BUFSIZE);
+	if (set_buffer_geometry(new_period_size) != 0) {
 		PHASEX_ERROR("JACK buffer size exceeded.  Closing client...\n");
 		jack_client_close(jack_audio_client);
 		jack_audio_client  = NULL;
@@ -938,8 +937,8 @@ jack_audio_init(void)
 	}
 
 	PHASEX_DEBUG(DEBUG_CLASS_AUDIO,
-	             "JACK audio buffer size:  %d (%d * %d periods, mask = 0x%x)\n",
-	             buffer_size, buffer_period_size, buffer_periods, buffer_size_mask);
+	             "JACK audio buffer size:  %d (%d * %d periods)\n",
+	             buffer_size, buffer_period_size, buffer_periods);
 
 	/* create ports */
 #ifdef ENABLE_INPUTS
@@ -990,6 +989,12 @@ jack_audio_init(void)
 		midi_input_port = jack_port_register(jack_audio_client, "midi_in",
 		                                     JACK_DEFAULT_MIDI_TYPE,
 		                                     JackPortIsInput, 0);
+		midi_output_port = jack_port_register(jack_audio_client, "midi_out",
+		                                      JACK_DEFAULT_MIDI_TYPE,
+		                                      JackPortIsOutput, 0);
+		if (midi_output_port != NULL) {
+			g_atomic_int_set(&midi_out_active, 1);
+		}
 	}
 
 	/* build list of available midi ports */
@@ -1016,6 +1021,8 @@ jack_audio_init(void)
 		jack_set_process_callback
 			(jack_audio_client, jack_process_buffer_stereo_out, (void *) NULL);
 	}
+	jack_set_thread_init_callback
+		(jack_audio_client, jack_thread_init_handler, (void *) NULL);
 	jack_set_buffer_size_callback
 		(jack_audio_client, jack_bufsize_handler, 0);
 	jack_set_xrun_callback
@@ -1083,6 +1090,8 @@ jack_start(void)
 		jack_thread_p       = 0;
 		jack_audio_client   = NULL;
 		midi_input_port     = NULL;
+		midi_output_port    = NULL;
+		g_atomic_int_set(&midi_out_active, 0);
 		return 1;
 	}
 
@@ -1288,6 +1297,8 @@ jack_stop(void)
 		jack_audio_client   = NULL;
 		jack_thread_p       = 0;
 		midi_input_port     = NULL;
+		midi_output_port    = NULL;
+		g_atomic_int_set(&midi_out_active, 0);
 
 #ifdef JACK_DEACTIVATE_BEFORE_CLOSE
 		jack_deactivate(tmp_client);
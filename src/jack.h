@@ -44,6 +44,7 @@ extern pthread_mutex_t      sample_rate_mutex;
 extern pthread_cond_t       sample_rate_cond;
 
 extern jack_port_t          *midi_input_port;
+extern jack_port_t          *midi_output_port;
 
 extern int                  jack_running;
 
@@ -31,10 +31,12 @@
 #include "buffer.h"
 #include "jack.h"
 #include "jack_midi.h"
+#include "midi_out.h"
 #include "midi_event.h"
 #include "midi_process.h"
 #include "engine.h"
 #include "settings.h"
+#include "midimap.h"
 #include "debug.h"
 
 
@@ -49,7 +51,6 @@ MIDI_EVENT  output_events;
 void
 jack_process_midi(jack_nframes_t nframes)
 {
-	PART                *part;
 	MIDI_EVENT          *out_event  = & (output_events);
 	void                *port_buf   = jack_port_get_buffer(midi_input_port, nframes);
 	jack_midi_event_t   in_event;
@@ -57,7 +58,6 @@ jack_process_midi(jack_nframes_t nframes)
 	unsigned char       type        = MIDI_EVENT_NO_EVENT;
 	unsigned char       channel;
 	unsigned short      e;
-	unsigned short      part_num;
 	unsigned int        m_index;
 
 	out_event->state = EVENT_STATE_ALLOCATED;
@@ -89,12 +89,10 @@ jack_process_midi(jack_nframes_t nframes)
 				out_event->byte3 = 0x00;
 			}
 			/* queue event for all parts listening to the incoming channel. */
-			for (part_num = 0; part_num < MAX_PARTS; part_num++) {
-				part = get_part(part_num);
-				if ((channel == part->midi_channel) || (part->midi_channel == 16)) {
-					queue_midi_event(part_num, out_event, in_event.time, m_index);
-				}
-			}
+			queue_midi_event_parts(get_midi_route(out_event), out_event,
+			                       in_event.time, m_index);
+			queue_midi_out_thru(out_event,
+			                    (int) buffer_index_add(m_index, in_event.time));
 		}
 		/* handle other messages (sysex / clock / automation / etc) */
 		else {
@@ -152,3 +150,39 @@ jack_process_midi(jack_nframes_t nframes)
 	/* All events are processed. Engine can start now. */
 	inc_midi_index();
 }
+
+
+/*****************************************************************************
+ * jack_midi_out_flush()
+ *
+ * Called from the JACK process callback (via flush_midi_out()) with the
+ * audio ring index for this cycle.  Writes all queued output events due
+ * within this cycle to the midi output port.
+ *****************************************************************************/
+void
+jack_midi_out_flush(jack_nframes_t nframes, unsigned int a_index)
+{
+	void                *port_buf;
+	unsigned char       data[3];
+	unsigned int        offset;
+	unsigned int        last_offset = 0;
+	int                 size;
+
+	if (midi_output_port == NULL) {
+		return;
+	}
+
+	port_buf = jack_port_get_buffer(midi_output_port, nframes);
+	jack_midi_clear_buffer(port_buf);
+
+	while ((size = dequeue_midi_out(a_index, nframes, data, &offset)) > 0) {
+		/* JACK requires events in non-decreasing time order */
+		if (offset < last_offset) {
+			offset = last_offset;
+		}
+		if (jack_midi_event_write(port_buf, offset, data, (size_t) size) != 0) {
+			PHASEX_DEBUG(DEBUG_CLASS_MIDI, "JACK MIDI output buffer full!\n");
+		}
+		last_offset = offset;
+	}
+}
@@ -25,6 +25,7 @@
 
 
 extern void jack_process_midi(jack_nframes_t nframes);
+extern void jack_midi_out_flush(jack_nframes_t nframes, unsigned int a_index);
 
 
 #endif /* _JACK_MIDI_H_ */
@@ -0,0 +1,482 @@
+/*****************************************************************************
+ *
+ * lv2_plugin.c
+ *
+ * PHASEX:  [P]hase [H]armonic [A]dvanced [S]ynthesis [EX]periment
+ *
+ * Copyright (C) 2012-2013 William Weston <whw@linuxmail.org>
+ *
+ * PHASEX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PHASEX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PHASEX.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include <lv2/core/lv2.h>
+#include <lv2/atom/atom.h>
+#include <lv2/atom/util.h>
+#include <lv2/midi/midi.h>
+#include <lv2/urid/urid.h>
+#include <lv2/state/state.h>
+#include <lv2/log/log.h>
+#include <lv2/log/logger.h>
+#include <lv2/worker/worker.h>
+#include "phasex.h"
+#include "lv2_plugin.h"
+#include "engine_api.h"
+#include "patch.h"
+#include "param.h"
+#include "settings.h"
+
+
+typedef struct phasex_lv2 {
+	LV2_URID_Map            *map;
+	LV2_Log_Logger          logger;
+	LV2_Worker_Schedule     *worker;
+	int                     work_pending;
+	LV2_URID                midi_event;
+	LV2_URID                atom_path;
+	LV2_URID                patch_key[MAX_PARTS];
+	const LV2_Atom_Sequence *midi_in;
+	float                   *out1;
+	float                   *out2;
+	const float             *param_port[NUM_PARAMS];
+	float                   param_last[NUM_PARAMS];
+} PHASEX_LV2;
+
+
+/* The engine keeps its state in globals, so only one instance may run in
+   a host process at a time. */
+static volatile gint    lv2_instances           = 0;
+
+
+/*****************************************************************************
+ * lv2_get_feature()
+ *****************************************************************************/
+static void *
+lv2_get_feature(const LV2_Feature *const *features, const char *uri)
+{
+	int             j;
+
+	if (features != NULL) {
+		for (j = 0; features[j] != NULL; j++) {
+			if (strcmp(features[j]->URI, uri) == 0) {
+				return features[j]->data;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+
+/*****************************************************************************
+ * lv2_free_path()
+ *
+ * Frees a path handed out by the host's state path features.
+ *****************************************************************************/
+static void
+lv2_free_path(LV2_State_Free_Path *free_path, char *path)
+{
+	if (free_path != NULL) {
+		free_path->free_path(free_path->handle, path);
+	}
+	else {
+		free(path);
+	}
+}
+
+
+/*****************************************************************************
+ * lv2_load_param_last()
+ *
+ * Takes the last applied control port values from the first part's active
+ * patch, so that run() only applies ports that differ from the patch.
+ *****************************************************************************/
+static void
+lv2_load_param_last(PHASEX_LV2 *plugin)
+{
+	PATCH           *patch = get_active_patch(0);
+	unsigned int    param_id;
+
+	for (param_id = 0; param_id < NUM_PARAMS; param_id++) {
+		plugin->param_last[param_id] = (float) patch->param[param_id].value.fine_val / 128.0f;
+	}
+}
+
+
+/*****************************************************************************
+ * lv2_instantiate()
+ *
+ * Errors go to the host's log, or to stderr without one, since the engine's
+ * debug queue is only drained by the standalone synth.
+ *****************************************************************************/
+static LV2_Handle
+lv2_instantiate(const LV2_Descriptor    *UNUSED(descriptor),
+                double                  rate,
+                const char              *UNUSED(bundle_path),
+                const LV2_Feature *const *features)
+{
+	PHASEX_LV2      *plugin;
+	LV2_URID_Map    *map    = lv2_get_feature(features, LV2_URID__map);
+	LV2_Log_Logger  logger;
+	char            key_uri[128];
+	unsigned int    part_num;
+
+	lv2_log_logger_init(&logger, map, lv2_get_feature(features, LV2_LOG__log));
+
+	if (map == NULL) {
+		lv2_log_error(&logger, "LV2 host does not provide %s.\n", LV2_URID__map);
+		return NULL;
+	}
+
+	if (!g_atomic_int_compare_and_exchange(&lv2_instances, 0, 1)) {
+		lv2_log_error(&logger, "Only one PHASEX plugin instance is supported per process.\n");
+		return NULL;
+	}
+
+	if ((plugin = calloc(1, sizeof(PHASEX_LV2))) == NULL) {
+		g_atomic_int_set(&lv2_instances, 0);
+		return NULL;
+	}
+
+	plugin->map        = map;
+	plugin->logger     = logger;
+	plugin->worker     = lv2_get_feature(features, LV2_WORKER__schedule);
+	plugin->midi_event = map->map(map->handle, LV2_MIDI__MidiEvent);
+	plugin->atom_path  = map->map(map->handle, LV2_ATOM__Path);
+	for (part_num = 0; part_num < MAX_PARTS; part_num++) {
+		snprintf(key_uri, sizeof(key_uri), "%s#patch%02u", PHASEX_LV2_URI, (part_num + 1));
+		plugin->patch_key[part_num] = map->map(map->handle, key_uri);
+	}
+
+	/* patches are read in the worker, never in run().  without one, a
+	   program change would be held pending forever. */
+	if (plugin->worker == NULL) {
+		lv2_log_warning(&logger, "LV2 host does not provide %s.  "
+		                "MIDI program changes are ignored.\n", LV2_WORKER__schedule);
+	}
+	setting_ignore_midi_program_change = (plugin->worker == NULL);
+
+	if (phasex_engine_init((unsigned int) rate, PHASEX_LV2_PERIOD_SIZE) != 0) {
+		lv2_log_error(&logger, "Unable to initialize the PHASEX engine.\n");
+		free(plugin);
+		g_atomic_int_set(&lv2_instances, 0);
+		return NULL;
+	}
+	lv2_load_param_last(plugin);
+
+	return (LV2_Handle) plugin;
+}
+
+
+/*****************************************************************************
+ * lv2_connect_port()
+ *****************************************************************************/
+static void
+lv2_connect_port(LV2_Handle instance, uint32_t port, void *data)
+{
+	PHASEX_LV2      *plugin = (PHASEX_LV2 *) instance;
+
+	switch (port) {
+	case PHASEX_LV2_PORT_MIDI_IN:
+		plugin->midi_in = (const LV2_Atom_Sequence *) data;
+		break;
+	case PHASEX_LV2_PORT_OUT_1:
+		plugin->out1 = (float *) data;
+		break;
+	case PHASEX_LV2_PORT_OUT_2:
+		plugin->out2 = (float *) data;
+		break;
+	default:
+		if ((port >= PHASEX_LV2_PORT_PARAM) &&
+		    (port < (PHASEX_LV2_PORT_PARAM + NUM_PARAMS))) {
+			plugin->param_port[port - PHASEX_LV2_PORT_PARAM] = (const float *) data;
+		}
+		break;
+	}
+}
+
+
+/*****************************************************************************
+ * lv2_activate()
+ *
+ * Starts from the engine's fixed initial state, so that offline renders of
+ * the same input are repeatable.
+ *****************************************************************************/
+static void
+lv2_activate(LV2_Handle instance)
+{
+	PHASEX_LV2      *plugin = (PHASEX_LV2 *) instance;
+
+	phasex_engine_reset();
+	lv2_load_param_last(plugin);
+	plugin->work_pending = 0;
+}
+
+
+/*****************************************************************************
+ * lv2_run()
+ *
+ * Renders synchronously in the host's thread.  Changed control ports are
+ * applied at the top of the block.  The block is split into engine periods,
+ * with each MIDI event queued at its exact frame.  MIDI program changes are
+ * handed to the host's worker, and take effect in a later block.
+ *****************************************************************************/
+static void
+lv2_run(LV2_Handle instance, uint32_t sample_count)
+{
+	PHASEX_LV2              *plugin = (PHASEX_LV2 *) instance;
+	const LV2_Atom_Event    *ev     = NULL;
+	uint32_t                offset  = 0;
+	uint32_t                nframes;
+	int64_t                 frame;
+	unsigned int            param_id;
+
+	for (param_id = 0; param_id < NUM_PARAMS; param_id++) {
+		if ((plugin->param_port[param_id] != NULL) &&
+		    (*(plugin->param_port[param_id]) != plugin->param_last[param_id])) {
+			plugin->param_last[param_id] = *(plugin->param_port[param_id]);
+			phasex_engine_set_param(0, param_id, plugin->param_last[param_id]);
+		}
+	}
+
+	if (plugin->midi_in != NULL) {
+		ev = lv2_atom_sequence_begin(&(plugin->midi_in->body));
+	}
+
+	while (offset < sample_count) {
+		nframes = sample_count - offset;
+		if (nframes > PHASEX_LV2_PERIOD_SIZE) {
+			nframes = PHASEX_LV2_PERIOD_SIZE;
+		}
+
+		/* queue this chunk's events */
+		while ((ev != NULL) &&
+		       !lv2_atom_sequence_is_end(&(plugin->midi_in->body),
+		                                 plugin->midi_in->atom.size, ev) &&
+		       (ev->time.frames < (int64_t)(offset + nframes))) {
+			if (ev->body.type == plugin->midi_event) {
+				frame = ev->time.frames - (int64_t) offset;
+				if (frame < 0) {
+					frame = 0;
+				}
+				phasex_engine_queue_midi((const unsigned char *) LV2_ATOM_BODY_CONST(&(ev->body)),
+				                         ev->body.size, (unsigned int) frame);
+			}
+			ev = lv2_atom_sequence_next(ev);
+		}
+
+		phasex_engine_render(nframes, (plugin->out1 + offset), (plugin->out2 + offset));
+		offset += nframes;
+	}
+
+	if ((plugin->worker != NULL) && !plugin->work_pending && phasex_engine_program_pending()) {
+		if (plugin->worker->schedule_work(plugin->worker->handle, sizeof(plugin->work_pending),
+		                                  &(plugin->work_pending)) == LV2_WORKER_SUCCESS) {
+			plugin->work_pending = 1;
+		}
+	}
+}
+
+
+/*****************************************************************************
+ * lv2_work()
+ *
+ * Reads the patches for pending MIDI program changes, in the host's
+ * non-realtime worker thread.
+ *****************************************************************************/
+static LV2_Worker_Status
+lv2_work(LV2_Handle                     UNUSED(instance),
+         LV2_Worker_Respond_Function    respond,
+         LV2_Worker_Respond_Handle      handle,
+         uint32_t                       size,
+         const void                     *data)
+{
+	phasex_engine_prepare_programs();
+
+	return respond(handle, size, data);
+}
+
+
+/*****************************************************************************
+ * lv2_work_response()
+ *
+ * Allows run() to schedule the next program change.  The prepared patches
+ * are committed by the engine at the top of the next block.
+ *****************************************************************************/
+static LV2_Worker_Status
+lv2_work_response(LV2_Handle instance, uint32_t UNUSED(size), const void *UNUSED(body))
+{
+	PHASEX_LV2      *plugin = (PHASEX_LV2 *) instance;
+
+	plugin->work_pending = 0;
+
+	return LV2_WORKER_SUCCESS;
+}
+
+
+/*****************************************************************************
+ * lv2_cleanup()
+ *****************************************************************************/
+static void
+lv2_cleanup(LV2_Handle instance)
+{
+	free(instance);
+	g_atomic_int_set(&lv2_instances, 0);
+}
+
+
+/*****************************************************************************
+ * lv2_save()
+ *
+ * Saves each part's active patch as a standard patch file in the host's
+ * state directory.  Files are named after the LASH save files, so that
+ * save_patch() leaves the patch's own filename and name alone.
+ *****************************************************************************/
+static LV2_State_Status
+lv2_save(LV2_Handle                 instance,
+         LV2_State_Store_Function   store,
+         LV2_State_Handle           handle,
+         uint32_t                   UNUSED(flags),
+         const LV2_Feature *const   *features)
+{
+	PHASEX_LV2              *plugin     = (PHASEX_LV2 *) instance;
+	LV2_State_Map_Path      *map_path   = lv2_get_feature(features, LV2_STATE__mapPath);
+	LV2_State_Make_Path     *make_path  = lv2_get_feature(features, LV2_STATE__makePath);
+	LV2_State_Free_Path     *free_path  = lv2_get_feature(features, LV2_STATE__freePath);
+	LV2_State_Status        status      = LV2_STATE_SUCCESS;
+	char                    patch_name[16];
+	char                    *path;
+	char                    *abstract_path;
+	unsigned int            part_num;
+
+	if ((map_path == NULL) || (make_path == NULL)) {
+		return LV2_STATE_ERR_NO_FEATURE;
+	}
+
+	for (part_num = 0; part_num < MAX_PARTS; part_num++) {
+		snprintf(patch_name, sizeof(patch_name), "phasex-%02u.phx", (part_num + 1));
+		if ((path = make_path->path(make_path->handle, patch_name)) == NULL) {
+			return LV2_STATE_ERR_UNKNOWN;
+		}
+		if (phasex_engine_save_patch(part_num, path) != 0) {
+			lv2_log_error(&(plugin->logger), "Unable to save LV2 state patch '%s'.\n", path);
+			status = LV2_STATE_ERR_UNKNOWN;
+		}
+		else if ((abstract_path = map_path->abstract_path(map_path->handle, path)) != NULL) {
+			store(handle, plugin->patch_key[part_num], abstract_path,
+			      (strlen(abstract_path) + 1), plugin->atom_path,
+			      (LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE));
+			lv2_free_path(free_path, abstract_path);
+		}
+		lv2_free_path(free_path, path);
+	}
+
+	return status;
+}
+
+
+/*****************************************************************************
+ * lv2_restore()
+ *
+ * Reads back the patch files written by lv2_save().  Parts without a saved
+ * patch keep their current one.  Control ports are then compared against
+ * the restored patch, so that run() does not overwrite it.
+ *****************************************************************************/
+static LV2_State_Status
+lv2_restore(LV2_Handle                  instance,
+            LV2_State_Retrieve_Function retrieve,
+            LV2_State_Handle            handle,
+            uint32_t                    UNUSED(flags),
+            const LV2_Feature *const    *features)
+{
+	PHASEX_LV2              *plugin     = (PHASEX_LV2 *) instance;
+	LV2_State_Map_Path      *map_path   = lv2_get_feature(features, LV2_STATE__mapPath);
+	LV2_State_Free_Path     *free_path  = lv2_get_feature(features, LV2_STATE__freePath);
+	LV2_State_Status        status      = LV2_STATE_SUCCESS;
+	const void              *value;
+	char                    *path;
+	size_t                  size;
+	uint32_t                type;
+	uint32_t                value_flags;
+	unsigned int            part_num;
+
+	if (map_path == NULL) {
+		return LV2_STATE_ERR_NO_FEATURE;
+	}
+
+	for (part_num = 0; part_num < MAX_PARTS; part_num++) {
+		value = retrieve(handle, plugin->patch_key[part_num], &size, &type, &value_flags);
+		if ((value == NULL) || (type != plugin->atom_path)) {
+			continue;
+		}
+		if ((path = map_path->absolute_path(map_path->handle, (const char *) value)) == NULL) {
+			continue;
+		}
+		if (phasex_engine_load_patch(part_num, path) != 0) {
+			lv2_log_error(&(plugin->logger), "Unable to restore LV2 state patch '%s'.\n", path);
+			status = LV2_STATE_ERR_UNKNOWN;
+		}
+		lv2_free_path(free_path, path);
+	}
+	lv2_load_param_last(plugin);
+
+	return status;
+}
+
+
+/*****************************************************************************
+ * lv2_extension_data()
+ *****************************************************************************/
+static const void *
+lv2_extension_data(const char *uri)
+{
+	static const LV2_State_Interface    state_interface  = { lv2_save, lv2_restore };
+	static const LV2_Worker_Interface   worker_interface = { lv2_work, lv2_work_response, NULL };
+
+	if (strcmp(uri, LV2_STATE__interface) == 0) {
+		return &state_interface;
+	}
+	if (strcmp(uri, LV2_WORKER__interface) == 0) {
+		return &worker_interface;
+	}
+
+	return NULL;
+}
+
+
+static const LV2_Descriptor lv2_phasex_descriptor = {
+	PHASEX_LV2_URI,
+	lv2_instantiate,
+	lv2_connect_port,
+	lv2_activate,
+	lv2_run,
+	NULL,
+	lv2_cleanup,
+	lv2_extension_data
+};
+
+
+/*****************************************************************************
+ * lv2_descriptor()
+ *
+ * The only symbol exported by the plugin.
+ *****************************************************************************/
+LV2_SYMBOL_EXPORT const LV2_Descriptor *
+lv2_descriptor(uint32_t index)
+{
+	return (index == 0) ? &lv2_phasex_descriptor : NULL;
+}
@@ -0,0 +1,41 @@
+/*****************************************************************************
+ *
+ * lv2_plugin.h
+ *
+ * PHASEX:  [P]hase [H]armonic [A]dvanced [S]ynthesis [EX]periment
+ *
+ * Copyright (C) 2012-2013 William Weston <whw@linuxmail.org>
+ *
+ * PHASEX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PHASEX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PHASEX.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+#ifndef _PHASEX_LV2_PLUGIN_H_
+#define _PHASEX_LV2_PLUGIN_H_
+
+
+#define PHASEX_LV2_URI              "https://github.com/williamweston/phasex"
+
+/* Port layout:  MIDI in, stereo out, then one control port per patch
+   parameter of the first part, in parameter id order. */
+#define PHASEX_LV2_PORT_MIDI_IN     0
+#define PHASEX_LV2_PORT_OUT_1       1
+#define PHASEX_LV2_PORT_OUT_2       2
+#define PHASEX_LV2_PORT_PARAM       3
+
+/* Host blocks of any size are rendered in chunks of at most this many
+   frames, with MIDI events placed at their exact frame offsets. */
+#define PHASEX_LV2_PERIOD_SIZE      256
+
+
+#endif /* _PHASEX_LV2_PLUGIN_H_ */
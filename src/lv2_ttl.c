@@ -0,0 +1,155 @@
+/*****************************************************************************
+ *
+ * lv2_ttl.c
+ *
+ * PHASEX:  [P]hase [H]armonic [A]dvanced [S]ynthesis [EX]periment
+ *
+ * Copyright (C) 2012-2013 William Weston <whw@linuxmail.org>
+ *
+ * PHASEX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PHASEX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PHASEX.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "phasex.h"
+#include "lv2_plugin.h"
+#include "param.h"
+
+
+/*****************************************************************************
+ * print_ttl_string()
+ *
+ * Prints a parameter label as a Turtle string, without the padding used to
+ * line up GUI labels.
+ *****************************************************************************/
+static void
+print_ttl_string(const char *str)
+{
+	size_t          len = strlen(str);
+
+	while ((len > 0) && (str[len - 1] == ' ')) {
+		len--;
+	}
+	putchar('"');
+	while (len-- > 0) {
+		if ((*str == '"') || (*str == '\\')) {
+			putchar('\\');
+		}
+		putchar(*str++);
+	}
+	putchar('"');
+}
+
+
+/*****************************************************************************
+ * main()
+ *
+ * Writes the LV2 plugin description to stdout.  Control ports are generated
+ * from the parameter table, so they always match the plugin binary.
+ *****************************************************************************/
+int
+main(void)
+{
+	PARAM_INFO      *info;
+	unsigned int    param_id;
+	int             j;
+
+	init_params();
+
+	printf("@prefix atom:  <http://lv2plug.in/ns/ext/atom#> .\n"
+	       "@prefix doap:  <http://usefulinc.com/ns/doap#> .\n"
+	       "@prefix log:   <http://lv2plug.in/ns/ext/log#> .\n"
+	       "@prefix lv2:   <http://lv2plug.in/ns/lv2core#> .\n"
+	       "@prefix midi:  <http://lv2plug.in/ns/ext/midi#> .\n"
+	       "@prefix rdf:   <http://www.w3.org/1999/02/22-rdf-syntax-ns#> .\n"
+	       "@prefix rdfs:  <http://www.w3.org/2000/01/rdf-schema#> .\n"
+	       "@prefix state: <http://lv2plug.in/ns/ext/state#> .\n"
+	       "@prefix urid:  <http://lv2plug.in/ns/ext/urid#> .\n"
+	       "@prefix work:  <http://lv2plug.in/ns/ext/worker#> .\n"
+	       "\n"
+	       "<%s>\n"
+	       "\ta lv2:InstrumentPlugin , lv2:Plugin ;\n"
+	       "\tdoap:name \"PHASEX\" ;\n"
+	       "\tdoap:license <http://usefulinc.com/doap/licenses/gpl> ;\n"
+	       "\tlv2:requiredFeature urid:map ;\n"
+	       "\tlv2:optionalFeature state:mapPath , state:makePath , state:freePath ,\n"
+	       "\t\tlog:log , work:schedule ;\n"
+	       "\tlv2:extensionData state:interface , work:interface ;\n"
+	       "\tlv2:port [\n"
+	       "\t\ta lv2:InputPort , atom:AtomPort ;\n"
+	       "\t\tatom:bufferType atom:Sequence ;\n"
+	       "\t\tatom:supports midi:MidiEvent ;\n"
+	       "\t\tlv2:designation lv2:control ;\n"
+	       "\t\tlv2:index %d ;\n"
+	       "\t\tlv2:symbol \"midi_in\" ;\n"
+	       "\t\tlv2:name \"MIDI In\"\n"
+	       "\t] , [\n"
+	       "\t\ta lv2:OutputPort , lv2:AudioPort ;\n"
+	       "\t\tlv2:index %d ;\n"
+	       "\t\tlv2:symbol \"out_1\" ;\n"
+	       "\t\tlv2:name \"Out 1\"\n"
+	       "\t] , [\n"
+	       "\t\ta lv2:OutputPort , lv2:AudioPort ;\n"
+	       "\t\tlv2:index %d ;\n"
+	       "\t\tlv2:symbol \"out_2\" ;\n"
+	       "\t\tlv2:name \"Out 2\"\n"
+	       "\t]",
+	       PHASEX_LV2_URI,
+	       PHASEX_LV2_PORT_MIDI_IN,
+	       PHASEX_LV2_PORT_OUT_1,
+	       PHASEX_LV2_PORT_OUT_2);
+
+	/* one control port per parameter, in MIDI controller units */
+	for (param_id = 0; param_id < NUM_PARAMS; param_id++) {
+		info = get_param_info_by_id(param_id);
+		printf(" , [\n"
+		       "\t\ta lv2:InputPort , lv2:ControlPort ;\n"
+		       "\t\tlv2:index %u ;\n"
+		       "\t\tlv2:symbol \"%s\" ;\n"
+		       "\t\tlv2:name ",
+		       (PHASEX_LV2_PORT_PARAM + param_id),
+		       info->name);
+		print_ttl_string(info->label_text);
+		printf(" ;\n"
+		       "\t\tlv2:default %d ;\n"
+		       "\t\tlv2:minimum 0 ;\n"
+		       "\t\tlv2:maximum %d",
+		       info->cc_default,
+		       info->cc_limit);
+
+		switch (info->type) {
+		case PARAM_TYPE_REAL:
+			break;
+		case PARAM_TYPE_INT:
+			printf(" ;\n\t\tlv2:portProperty lv2:integer");
+			break;
+		default:
+			if (info->list_labels == NULL) {
+				printf(" ;\n\t\tlv2:portProperty lv2:integer");
+				break;
+			}
+			printf(" ;\n\t\tlv2:portProperty lv2:integer , lv2:enumeration");
+			for (j = 0; (j <= info->cc_limit) && (info->list_labels[j] != NULL); j++) {
+				printf(" ;\n\t\tlv2:scalePoint [ rdfs:label ");
+				print_ttl_string(info->list_labels[j]);
+				printf(" ; rdf:value %d ]", j);
+			}
+			break;
+		}
+		printf("\n\t]");
+	}
+	printf(" .\n");
+
+	return 0;
+}
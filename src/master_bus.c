@@ -0,0 +1,503 @@
+/*****************************************************************************
+ *
+ * master_bus.c
+ *
+ * PHASEX:  [P]hase [H]armonic [A]dvanced [S]ynthesis [EX]periment
+ *
+ * Copyright (C) 2012-2013 William Weston <whw@linuxmail.org>
+ *
+ * PHASEX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PHASEX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PHASEX.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+#include <string.h>
+#include <math.h>
+#include <glib.h>
+#include "phasex.h"
+#include "engine.h"
+#include "buffer.h"
+#include "fx_bus.h"
+#include "master_bus.h"
+#include "settings.h"
+#include "debug.h"
+
+
+/* Meters for each part and for the final mix */
+static METER        part_meter[MAX_PARTS];
+static METER        master_meter;
+
+/* Per sample meter falloff (20dB/sec) and rms (300ms) rates */
+static sample_t     meter_fall_rate;
+static sample_t     meter_rms_rate;
+
+/* DC blocker state */
+static int          dc_block_running    = 0;
+static sample_t     dc_block_r;
+static sample_t     dc_block_x1[2];
+static sample_t     dc_block_y1[2];
+
+/* Lookahead limiter state.  Input is delayed by the full lookahead, and
+   each chunk leaving the delay line gets a linear gain ramp that is known
+   to keep all of its samples under the ceiling. */
+static int          limiter_running     = 0;
+static sample_t     limiter_ceiling;
+static sample_t     limiter_release;
+static sample_t     limiter_delay1[MASTER_LIMITER_LOOKAHEAD];
+static sample_t     limiter_delay2[MASTER_LIMITER_LOOKAHEAD];
+static sample_t     limiter_bound[MASTER_LIMITER_CHUNKS];
+static sample_t     limiter_chunk_peak;
+static sample_t     limiter_gain;
+static sample_t     limiter_gain_step;
+static unsigned int limiter_pos;
+static gint         limiter_gain_meter;
+
+
+/*****************************************************************************
+ * reset_limiter()
+ *****************************************************************************/
+static void
+reset_limiter(void)
+{
+	unsigned int    chunk;
+
+	memset(limiter_delay1, 0, sizeof(limiter_delay1));
+	memset(limiter_delay2, 0, sizeof(limiter_delay2));
+	for (chunk = 0; chunk < MASTER_LIMITER_CHUNKS; chunk++) {
+		limiter_bound[chunk] = 1.0;
+	}
+	limiter_chunk_peak = 0.0;
+	limiter_gain       = 1.0;
+	limiter_gain_step  = 0.0;
+	limiter_pos        = 0;
+	g_atomic_int_set(&limiter_gain_meter, (gint) METER_SCALE);
+}
+
+
+/*****************************************************************************
+ * init_master_bus()
+ *
+ * Sets up the master limiter, DC blocker, and meters for the current
+ * sample rate and settings.  Called from init_engine_parameters().
+ *****************************************************************************/
+void
+init_master_bus(void)
+{
+	unsigned int    part_num;
+
+	meter_fall_rate = (sample_t)(M_LN10 / f_sample_rate);
+	meter_rms_rate  = (sample_t)(1.0 / (0.3 * f_sample_rate));
+
+	for (part_num = 0; part_num < MAX_PARTS; part_num++) {
+		memset(&(part_meter[part_num]), 0, sizeof(METER));
+	}
+	memset(&master_meter, 0, sizeof(METER));
+
+	/* (-3dB @ 20Hz) DC blocking filter, same as the per part filter */
+	dc_block_r = (sample_t)(1.0 - (125.6 / f_sample_rate));
+	dc_block_x1[0] = dc_block_x1[1] = 0.0;
+	dc_block_y1[0] = dc_block_y1[1] = 0.0;
+	dc_block_running = setting_master_dc_block;
+
+	/* ceiling in dB below full scale, release in ms to within 1/e */
+	limiter_ceiling = MATH_EXP(setting_master_limiter_ceiling * (sample_t)(M_LN10 / 20.0));
+	limiter_release = (sample_t)(1.0 - MATH_EXP(-(sample_t) MASTER_LIMITER_CHUNK * 1000.0 /
+	                                             ((sample_t) setting_master_limiter_release *
+	                                              f_sample_rate)));
+	reset_limiter();
+	limiter_running = setting_master_limiter;
+
+	if (limiter_running) {
+		PHASEX_DEBUG(DEBUG_CLASS_ENGINE, "Master limiter:  ceiling=%.1fdB  "
+		             "release=%dms  lookahead=%d\n",
+		             (double) setting_master_limiter_ceiling,
+		             setting_master_limiter_release, MASTER_LIMITER_LOOKAHEAD);
+	}
+}
+
+
+/*****************************************************************************
+ * update_meter()
+ *
+ * Folds one period's peak and sum of squares into a meter, and publishes
+ * the result for the gui.
+ *****************************************************************************/
+static void
+update_meter(METER *meter, sample_t peak, sample_t sum, unsigned int nframes,
+             sample_t fall, sample_t rms_coef)
+{
+	sample_t        rms;
+
+	meter->peak_level *= fall;
+	if (peak > meter->peak_level) {
+		meter->peak_level = peak;
+	}
+	meter->ms_level += ((sum / (sample_t)(2 * nframes)) - meter->ms_level) * rms_coef;
+
+	peak = (meter->peak_level < METER_MAX) ? meter->peak_level : METER_MAX;
+	rms  = MATH_SQRT(meter->ms_level);
+	if (rms > METER_MAX) {
+		rms = METER_MAX;
+	}
+	g_atomic_int_set(&(meter->peak), (gint)(peak * METER_SCALE));
+	g_atomic_int_set(&(meter->rms),  (gint)(rms  * METER_SCALE));
+}
+
+
+/*****************************************************************************
+ * mix_segment()
+ *
+ * Mixes <nframes> contiguous frames of one part into the master buffers,
+ * accumulating the part's peak and sum of squares along the way.
+ *****************************************************************************/
+static void
+mix_segment(sample_t *dest1, sample_t *dest2,
+            volatile sample_t *src1, volatile sample_t *src2,
+            unsigned int nframes, sample_t *peak, sample_t *sum)
+{
+	sample_t        s1;
+	sample_t        s2;
+	sample_t        a;
+	sample_t        p = *peak;
+	sample_t        ms = *sum;
+	unsigned int    j;
+
+	for (j = 0; j < nframes; j++) {
+		s1 = src1[j];
+		s2 = src2[j];
+		dest1[j] += s1;
+		dest2[j] += s2;
+		ms += (s1 * s1) + (s2 * s2);
+		a = MATH_ABS(s1);
+		p = (a > p) ? a : p;
+		a = MATH_ABS(s2);
+		p = (a > p) ? a : p;
+	}
+
+	*peak = p;
+	*sum  = ms;
+}
+
+
+/*****************************************************************************
+ * measure_segment()
+ *
+ * Accumulates the peak and sum of squares of <nframes> frames of the mix.
+ *****************************************************************************/
+static void
+measure_segment(sample_t *buf1, sample_t *buf2,
+                unsigned int nframes, sample_t *peak, sample_t *sum)
+{
+	sample_t        a;
+	sample_t        p = *peak;
+	sample_t        ms = *sum;
+	unsigned int    j;
+
+	for (j = 0; j < nframes; j++) {
+		ms += (buf1[j] * buf1[j]) + (buf2[j] * buf2[j]);
+		a = MATH_ABS(buf1[j]);
+		p = (a > p) ? a : p;
+		a = MATH_ABS(buf2[j]);
+		p = (a > p) ? a : p;
+	}
+
+	*peak = p;
+	*sum  = ms;
+}
+
+
+/*****************************************************************************
+ * run_dc_block()
+ *****************************************************************************/
+static void
+run_dc_block(sample_t *buf, unsigned int nframes, unsigned int chan)
+{
+	sample_t        x1 = dc_block_x1[chan];
+	sample_t        y1 = dc_block_y1[chan];
+	sample_t        x;
+	unsigned int    j;
+
+	for (j = 0; j < nframes; j++) {
+		x      = buf[j];
+		y1     = x - x1 + (dc_block_r * y1);
+		x1     = x;
+		buf[j] = y1;
+	}
+
+	/* keep the feedback out of denormal territory during silence */
+	if (MATH_ABS(y1) < 1e-20) {
+		y1 = 0.0;
+	}
+	dc_block_x1[chan] = x1;
+	dc_block_y1[chan] = y1;
+}
+
+
+/*****************************************************************************
+ * end_limiter_chunk()
+ *
+ * Called when a full chunk has entered the delay line.  Records the gain
+ * that chunk needs, then plans the gain ramp for the chunk about to leave
+ * the delay line:  by the end of it, the gain must be under the bound of
+ * that chunk and the next, and on a straight line to reach the bound of
+ * each later chunk by the time it starts.  With no reduction needed, the
+ * gain releases toward the lowest bound in the lookahead.
+ *****************************************************************************/
+static void
+end_limiter_chunk(void)
+{
+	sample_t        bound;
+	sample_t        target;
+	sample_t        lowest;
+	sample_t        gain;
+	unsigned int    chunk = (limiter_pos / MASTER_LIMITER_CHUNK) - 1;
+	unsigned int    k;
+
+	limiter_bound[chunk] = (limiter_chunk_peak > limiter_ceiling) ?
+		(limiter_ceiling / limiter_chunk_peak) : 1.0;
+	limiter_chunk_peak = 0.0;
+
+	/* the outgoing chunk is the oldest one still in the delay line */
+	limiter_gain += limiter_gain_step * (sample_t) MASTER_LIMITER_CHUNK;
+	gain   = limiter_gain;
+	chunk  = (chunk + 1) & (MASTER_LIMITER_CHUNKS - 1);
+	lowest = limiter_bound[chunk];
+	target = lowest;
+	for (k = 1; k < MASTER_LIMITER_CHUNKS; k++) {
+		bound = limiter_bound[(chunk + k) & (MASTER_LIMITER_CHUNKS - 1)];
+		if (bound < lowest) {
+			lowest = bound;
+		}
+		bound = gain + ((bound - gain) / (sample_t) k);
+		if (bound < target) {
+			target = bound;
+		}
+	}
+	if (target >= gain) {
+		target = gain + ((lowest - gain) * limiter_release);
+	}
+
+	limiter_gain_step = (target - gain) / (sample_t) MASTER_LIMITER_CHUNK;
+	limiter_pos &= (MASTER_LIMITER_LOOKAHEAD - 1);
+}
+
+
+/*****************************************************************************
+ * run_limiter()
+ *
+ * Stereo linked lookahead peak limiter.  Works in runs of frames within a
+ * chunk, so the inner loops are simple enough for the compiler to
+ * vectorize.  Returns the lowest gain applied.
+ *****************************************************************************/
+static sample_t
+run_limiter(sample_t *buf1, sample_t *buf2, unsigned int nframes)
+{
+	sample_t        *in1;
+	sample_t        *in2;
+	sample_t        *d1;
+	sample_t        *d2;
+	sample_t        peak;
+	sample_t        a;
+	sample_t        g;
+	sample_t        t1;
+	sample_t        t2;
+	sample_t        min_gain;
+	unsigned int    sub;
+	unsigned int    len;
+	unsigned int    i;
+	unsigned int    j = 0;
+
+	sub      = limiter_pos & (MASTER_LIMITER_CHUNK - 1);
+	min_gain = limiter_gain + (limiter_gain_step * (sample_t) sub);
+
+	while (j < nframes) {
+		sub = limiter_pos & (MASTER_LIMITER_CHUNK - 1);
+		len = MASTER_LIMITER_CHUNK - sub;
+		if (len > (nframes - j)) {
+			len = nframes - j;
+		}
+		in1 = buf1 + j;
+		in2 = buf2 + j;
+		d1  = limiter_delay1 + limiter_pos;
+		d2  = limiter_delay2 + limiter_pos;
+
+		peak = limiter_chunk_peak;
+		for (i = 0; i < len; i++) {
+			a = MATH_ABS(in1[i]);
+			peak = (a > peak) ? a : peak;
+			a = MATH_ABS(in2[i]);
+			peak = (a > peak) ? a : peak;
+		}
+		limiter_chunk_peak = peak;
+
+		for (i = 0; i < len; i++) {
+			g      = limiter_gain + (limiter_gain_step * (sample_t)(sub + i + 1));
+			t1     = d1[i];
+			t2     = d2[i];
+			d1[i]  = in1[i];
+			d2[i]  = in2[i];
+			in1[i] = t1 * g;
+			in2[i] = t2 * g;
+		}
+
+		g = limiter_gain + (limiter_gain_step * (sample_t)(sub + len));
+		if (g < min_gain) {
+			min_gain = g;
+		}
+
+		limiter_pos += len;
+		j           += len;
+		if ((limiter_pos & (MASTER_LIMITER_CHUNK - 1)) == 0) {
+			end_limiter_chunk();
+		}
+	}
+
+	return min_gain;
+}
+
+
+/*****************************************************************************
+ * run_master_bus()
+ *
+ * Mixes <nframes> of all parts, starting at ring buffer <index>, into
+ * output_buffer1/2, along with the shared fx bus returns.  The mix then
+ * runs through the optional DC blocker and lookahead limiter.  Part and
+ * master meters are updated once per call.  Runs in the audio thread,
+ * once per period.
+ *****************************************************************************/
+void
+run_master_bus(unsigned int index, unsigned int nframes)
+{
+	PART            *part;
+	sample_t        fall;
+	sample_t        rms_coef;
+	sample_t        peak;
+	sample_t        sum;
+	sample_t        gain;
+	unsigned int    part_num;
+	unsigned int    len;
+
+	if (nframes == 0) {
+		return;
+	}
+
+	fall     = MATH_EXP(-(sample_t) nframes * meter_fall_rate);
+	rms_coef = (sample_t)(1.0 - MATH_EXP(-(sample_t) nframes * meter_rms_rate));
+
+	memset(output_buffer1, 0, nframes * sizeof(sample_t));
+	memset(output_buffer2, 0, nframes * sizeof(sample_t));
+
+	len = buffer_contiguous_frames(index, nframes);
+	for (part_num = 0; part_num < MAX_PARTS; part_num++) {
+		part = get_part(part_num);
+		peak = sum = 0.0;
+		mix_segment(output_buffer1, output_buffer2,
+		            &(part->output_buffer1[index]), &(part->output_buffer2[index]),
+		            len, &peak, &sum);
+		mix_segment(&(output_buffer1[len]), &(output_buffer2[len]),
+		            part->output_buffer1, part->output_buffer2,
+		            (nframes - len), &peak, &sum);
+		update_meter(&(part_meter[part_num]), peak, sum, nframes, fall, rms_coef);
+	}
+
+	/* shared chorus and delay run once over all part sends */
+	if (fx_bus_active) {
+		run_fx_bus(index, nframes);
+		for (len = 0; len < nframes; len++) {
+			output_buffer1[len] += fx_bus_out1[len];
+			output_buffer2[len] += fx_bus_out2[len];
+		}
+	}
+
+	if (setting_master_dc_block) {
+		if (!dc_block_running) {
+			dc_block_x1[0] = dc_block_x1[1] = 0.0;
+			dc_block_y1[0] = dc_block_y1[1] = 0.0;
+			dc_block_running = 1;
+		}
+		run_dc_block(output_buffer1, nframes, 0);
+		run_dc_block(output_buffer2, nframes, 1);
+	}
+	else {
+		dc_block_running = 0;
+	}
+
+	if (setting_master_limiter) {
+		if (!limiter_running) {
+			reset_limiter();
+			limiter_running = 1;
+		}
+		gain = run_limiter(output_buffer1, output_buffer2, nframes);
+		g_atomic_int_set(&limiter_gain_meter, (gint)(gain * METER_SCALE));
+	}
+	else if (limiter_running) {
+		reset_limiter();
+		limiter_running = 0;
+	}
+
+	peak = sum = 0.0;
+	measure_segment(output_buffer1, output_buffer2, nframes, &peak, &sum);
+	update_meter(&master_meter, peak, sum, nframes, fall, rms_coef);
+}
+
+
+/*****************************************************************************
+ * get_master_latency()
+ *
+ * Returns the frames of latency added by the master bus.
+ *****************************************************************************/
+unsigned int
+get_master_latency(void)
+{
+	return (setting_master_limiter ? MASTER_LIMITER_LOOKAHEAD : 0);
+}
+
+
+/*****************************************************************************
+ * get_part_meter()
+ *
+ * Reads the current peak and rms levels of a part, relative to full scale.
+ * Safe to call from any thread.
+ *****************************************************************************/
+void
+get_part_meter(unsigned int part_num, sample_t *peak, sample_t *rms)
+{
+	*peak = (sample_t) g_atomic_int_get(&(part_meter[part_num].peak)) / METER_SCALE;
+	*rms  = (sample_t) g_atomic_int_get(&(part_meter[part_num].rms))  / METER_SCALE;
+}
+
+
+/*****************************************************************************
+ * get_master_meter()
+ *
+ * Reads the current peak and rms levels of the final mix, after the
+ * limiter.  Safe to call from any thread.
+ *****************************************************************************/
+void
+get_master_meter(sample_t *peak, sample_t *rms)
+{
+	*peak = (sample_t) g_atomic_int_get(&(master_meter.peak)) / METER_SCALE;
+	*rms  = (sample_t) g_atomic_int_get(&(master_meter.rms))  / METER_SCALE;
+}
+
+
+/*****************************************************************************
+ * get_master_limiter_gain()
+ *
+ * Returns the lowest limiter gain applied during the last period (1.0 for
+ * no gain reduction).  Safe to call from any thread.
+ *****************************************************************************/
+sample_t
+get_master_limiter_gain(void)
+{
+	return (sample_t) g_atomic_int_get(&limiter_gain_meter) / METER_SCALE;
+}
@@ -0,0 +1,57 @@
+/*****************************************************************************
+ *
+ * master_bus.h
+ *
+ * PHASEX:  [P]hase [H]armonic [A]dvanced [S]ynthesis [EX]periment
+ *
+ * Copyright (C) 2012-2013 William Weston <whw@linuxmail.org>
+ *
+ * PHASEX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PHASEX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PHASEX.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+#ifndef _PHASEX_MASTER_BUS_H_
+#define _PHASEX_MASTER_BUS_H_
+
+#include <glib.h>
+#include "phasex.h"
+
+
+/* The limiter works in chunks of MASTER_LIMITER_CHUNK frames, and looks
+   ahead MASTER_LIMITER_CHUNKS chunks.  Both must be powers of 2. */
+#define MASTER_LIMITER_CHUNK        16
+#define MASTER_LIMITER_CHUNKS       4
+#define MASTER_LIMITER_LOOKAHEAD    (MASTER_LIMITER_CHUNK * MASTER_LIMITER_CHUNKS)
+
+/* Published meter values are in millionths of full scale. */
+#define METER_SCALE                 1000000.0
+#define METER_MAX                   1000.0
+
+
+typedef struct meter {
+	gint        peak;                       /* decaying peak, for the gui */
+	gint        rms;                        /* rms over ~300ms, for the gui */
+	sample_t    peak_level;                 /* audio thread copies */
+	sample_t    ms_level;
+} METER;
+
+
+void init_master_bus(void);
+void run_master_bus(unsigned int index, unsigned int nframes);
+unsigned int get_master_latency(void);
+void get_part_meter(unsigned int part_num, sample_t *peak, sample_t *rms);
+void get_master_meter(sample_t *peak, sample_t *rms);
+sample_t get_master_limiter_gain(void);
+
+
+#endif /* _PHASEX_MASTER_BUS_H_ */
@@ -24,6 +24,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <strings.h>
 #include <pthread.h>
 #include <time.h>
 #include <asoundlib.h>
@@ -40,6 +41,7 @@
 #include "bank.h"
 #include "settings.h"
 #include "debug.h"
+#include "trace.h"
 #include "driver.h"
 
 
@@ -114,6 +116,7 @@ queue_midi_event(unsigned int part_num,
 		             "cycle_frame=%d >= buffer_period_size=%d  (adjusting)  %%%%%%%%%%\n",
 		             cycle_frame, buffer_period_size);
 		cycle_frame = buffer_period_size - 1;
+		g_atomic_int_inc(&(midi_clock_stats.timing_clamps));
 	}
 
 	/* check main queue for free event and copy the event */
@@ -164,6 +167,28 @@ queue_midi_event(unsigned int part_num,
 }
 
 
+/*****************************************************************************
+ * queue_midi_event_parts()
+ *
+ * Queues an event for every part in part_mask, as returned by
+ * get_midi_route().  Only parts listening for the event are touched.
+ *****************************************************************************/
+void
+queue_midi_event_parts(unsigned int part_mask,
+                       MIDI_EVENT   *event,
+                       unsigned int cycle_frame,
+                       unsigned int index)
+{
+	int             part_num;
+
+	while (part_mask != 0) {
+		part_num   = ffs((int) part_mask) - 1;
+		part_mask &= part_mask - 1;
+		queue_midi_event((unsigned int) part_num, event, cycle_frame, index);
+	}
+}
+
+
 /*****************************************************************************
  * queue_midi_realtime_event()
  *
@@ -228,7 +253,5 @@ queue_midi_param_event(unsigned int part_num, unsigned int id, int cc_val)
 		queue_event.value       = (unsigned char)cc_val;
 	}
 	queue_midi_event(part_num, &queue_event, cycle_frame, m_index);
-	PHASEX_DEBUG(DEBUG_CLASS_MIDI_TIMING,
-	             DEBUG_COLOR_CYAN "[%d] " DEBUG_COLOR_DEFAULT,
-	             (m_index / buffer_period_size));
+	PHASEX_TRACE(TRACE_MIDI_QUEUE, part_num, (m_index / buffer_period_size), 0, 0, 0);
 }
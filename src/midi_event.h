@@ -32,6 +32,10 @@ void queue_midi_event(unsigned int part_num,
                       MIDI_EVENT *event,
                       unsigned int cycle_frame,
                       unsigned int index);
+void queue_midi_event_parts(unsigned int part_mask,
+                            MIDI_EVENT *event,
+                            unsigned int cycle_frame,
+                            unsigned int index);
 void queue_midi_realtime_event(unsigned int part_num,
                                unsigned char type,
                                unsigned int cycle_frame,
@@ -0,0 +1,311 @@
+/*****************************************************************************
+ *
+ * midi_out.c
+ *
+ * PHASEX:  [P]hase [H]armonic [A]dvanced [S]ynthesis [EX]periment
+ *
+ * Copyright (C) 2012-2013 William Weston <whw@linuxmail.org>
+ *
+ * PHASEX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PHASEX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PHASEX.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include "phasex.h"
+#include "mididefs.h"
+#include "midi_out.h"
+#include "midimap.h"
+#include "engine.h"
+#include "buffer.h"
+#include "param.h"
+#include "patch.h"
+#include "settings.h"
+#include "debug.h"
+
+
+/* Set by the midi driver while an output port is available. */
+volatile gint           midi_out_active         = 0;
+
+/* Bounded multi-producer queue, with per-slot sequence numbers.  Engine
+   threads (note output and param echo) and the midi input thread (thru)
+   produce events.  The audio process callback is the only consumer, so
+   the read position needs no atomics. */
+static MIDI_OUT_EVENT   midi_out_queue[MIDI_OUT_QUEUE_SIZE];
+static volatile gint    midi_out_write_pos      = 0;
+static guint            midi_out_read_pos       = 0;
+
+/* Producers queue out of time order with each other, so the consumer
+   takes everything queued, holds what is not yet due, and sorts the
+   events due in the current cycle by frame offset.  Due events keep their
+   frame offset in the index field.  Only touched by the consumer. */
+static MIDI_OUT_EVENT   midi_out_held[MIDI_OUT_QUEUE_SIZE];
+static MIDI_OUT_EVENT   midi_out_due[MIDI_OUT_QUEUE_SIZE];
+static unsigned int     midi_out_held_count     = 0;
+static unsigned int     midi_out_due_count      = 0;
+static unsigned int     midi_out_due_pos        = 0;
+static int              midi_out_in_cycle       = 0;
+
+
+/*****************************************************************************
+ * init_midi_out()
+ *****************************************************************************/
+void
+init_midi_out(void)
+{
+	unsigned int    j;
+
+	for (j = 0; j < MIDI_OUT_QUEUE_SIZE; j++) {
+		memset(&midi_out_queue[j], 0, sizeof(MIDI_OUT_EVENT));
+		g_atomic_int_set(&midi_out_queue[j].sequence, (gint) j);
+	}
+	g_atomic_int_set(&midi_out_write_pos, 0);
+	midi_out_read_pos   = 0;
+	midi_out_held_count = 0;
+	midi_out_due_count  = 0;
+	midi_out_due_pos    = 0;
+	midi_out_in_cycle   = 0;
+}
+
+
+/*****************************************************************************
+ * queue_midi_out()
+ *
+ * Queues a raw midi message for output at ring buffer index <index> (or
+ * MIDI_OUT_INDEX_NOW).  Safe to call from any thread.  Events are dropped
+ * when no output port is active or the queue is full.
+ *****************************************************************************/
+void
+queue_midi_out(int index, unsigned char status, unsigned char data1, unsigned char data2)
+{
+	MIDI_OUT_EVENT  *slot;
+	guint           pos;
+	gint            diff;
+
+	if (!g_atomic_int_get(&midi_out_active)) {
+		return;
+	}
+
+	/* claim a slot */
+	pos = (guint) g_atomic_int_get(&midi_out_write_pos);
+	for (;;) {
+		slot = & (midi_out_queue[pos & MIDI_OUT_QUEUE_MASK]);
+		diff = (gint)((guint) g_atomic_int_get(&slot->sequence) - pos);
+		if (diff == 0) {
+			if (g_atomic_int_compare_and_exchange(&midi_out_write_pos,
+			                                      (gint) pos, (gint)(pos + 1))) {
+				break;
+			}
+		}
+		else if (diff < 0) {
+			PHASEX_DEBUG(DEBUG_CLASS_MIDI, "MIDI output queue full!\n");
+			return;
+		}
+		pos = (guint) g_atomic_int_get(&midi_out_write_pos);
+	}
+
+	/* fill it and hand it to the consumer */
+	slot->index   = index;
+	slot->data[0] = status;
+	slot->data[1] = data1 & 0x7F;
+	slot->data[2] = data2 & 0x7F;
+	if (((status & 0xF0) == MIDI_EVENT_PROGRAM_CHANGE) ||
+	    ((status & 0xF0) == MIDI_EVENT_POLYPRESSURE)) {
+		slot->size = 2;
+	}
+	else {
+		slot->size = 3;
+	}
+	g_atomic_int_set(&slot->sequence, (gint)(pos + 1));
+}
+
+
+/*****************************************************************************
+ * sort_midi_out_event()
+ *
+ * Files an event into the due list if it is due in the cycle of <nframes>
+ * starting at audio ring index <a_index>, keeping the list sorted by frame
+ * offset and in queue order for equal offsets.  Late events are due at
+ * offset 0.  Returns 0 when the event is not due yet.
+ *****************************************************************************/
+static int
+sort_midi_out_event(MIDI_OUT_EVENT *event, unsigned int a_index, unsigned int nframes)
+{
+	unsigned int    distance;
+	int             offset;
+	unsigned int    j;
+
+	if ((event->index < 0) || ((unsigned int) event->index >= buffer_size)) {
+		offset = 0;
+	}
+	else {
+		distance = ((unsigned int) event->index + buffer_size - a_index) % buffer_size;
+		if (distance < nframes) {
+			offset = (int) distance;
+		}
+		/* engine runs ahead of audio, so leave this one for a later cycle */
+		else if (distance < (buffer_size / 2)) {
+			return 0;
+		}
+		else {
+			offset = 0;
+		}
+	}
+
+	/* producers are each in order, so this rarely moves far */
+	j = midi_out_due_count++;
+	while ((j > 0) && (midi_out_due[j - 1].index > offset)) {
+		midi_out_due[j] = midi_out_due[j - 1];
+		j--;
+	}
+	midi_out_due[j]       = *event;
+	midi_out_due[j].index = offset;
+
+	return 1;
+}
+
+
+/*****************************************************************************
+ * gather_midi_out()
+ *
+ * Builds the sorted due list for the current cycle from the events held
+ * back from earlier cycles and everything queued since.
+ *****************************************************************************/
+static void
+gather_midi_out(unsigned int a_index, unsigned int nframes)
+{
+	MIDI_OUT_EVENT  *slot;
+	unsigned int    held_count = midi_out_held_count;
+	unsigned int    j;
+
+	midi_out_due_count  = 0;
+	midi_out_due_pos    = 0;
+	midi_out_held_count = 0;
+
+	/* held events are older than anything still in the queue */
+	for (j = 0; j < held_count; j++) {
+		if (!sort_midi_out_event(&midi_out_held[j], a_index, nframes)) {
+			midi_out_held[midi_out_held_count++] = midi_out_held[j];
+		}
+	}
+
+	for (;;) {
+		slot = & (midi_out_queue[midi_out_read_pos & MIDI_OUT_QUEUE_MASK]);
+		if (((guint) g_atomic_int_get(&slot->sequence) != (midi_out_read_pos + 1)) ||
+		    (midi_out_held_count >= MIDI_OUT_QUEUE_SIZE) ||
+		    (midi_out_due_count >= MIDI_OUT_QUEUE_SIZE)) {
+			break;
+		}
+		if (!sort_midi_out_event(slot, a_index, nframes)) {
+			midi_out_held[midi_out_held_count++] = *slot;
+		}
+		g_atomic_int_set(&slot->sequence, (gint)(midi_out_read_pos + MIDI_OUT_QUEUE_SIZE));
+		midi_out_read_pos++;
+	}
+}
+
+
+/*****************************************************************************
+ * dequeue_midi_out()
+ *
+ * Called by the audio process callback with the audio ring index and size
+ * of the current cycle.  Copies the next event due in this cycle to <data>,
+ * sets its frame offset, and returns its size, or returns 0 when no more
+ * events are due.  Events come out in frame offset order.  Late events are
+ * sent at offset 0.  The callback must keep calling until 0 is returned.
+ *****************************************************************************/
+int
+dequeue_midi_out(unsigned int a_index, unsigned int nframes,
+                 unsigned char *data, unsigned int *offset)
+{
+	MIDI_OUT_EVENT  *event;
+
+	if (!midi_out_in_cycle) {
+		gather_midi_out(a_index, nframes);
+		midi_out_in_cycle = 1;
+	}
+
+	if (midi_out_due_pos >= midi_out_due_count) {
+		midi_out_in_cycle = 0;
+		return 0;
+	}
+
+	event   = & (midi_out_due[midi_out_due_pos++]);
+	*offset = (unsigned int) event->index;
+	memcpy(data, event->data, (size_t) event->size);
+
+	return event->size;
+}
+
+
+/*****************************************************************************
+ * queue_midi_out_thru()
+ *
+ * Passes an incoming channel message through to the midi output, if it is
+ * routed to at least one part.
+ *****************************************************************************/
+void
+queue_midi_out_thru(MIDI_EVENT *event, int index)
+{
+	if (!setting_midi_thru || (event->type >= 0xF0) || (get_midi_route(event) == 0)) {
+		return;
+	}
+	queue_midi_out(index, (unsigned char)(event->type | event->channel),
+	               event->byte2, event->byte3);
+}
+
+
+/*****************************************************************************
+ * queue_midi_out_note()
+ *
+ * Sends a note on or note off event played by a part, after keyboard
+ * routing and voice allocation, on the part's midi channel.  Called from
+ * the engine thread.
+ *****************************************************************************/
+void
+queue_midi_out_note(unsigned int part_num, MIDI_EVENT *event)
+{
+	PART            *part = get_part(part_num);
+	unsigned char   channel;
+
+	if (!setting_midi_note_out) {
+		return;
+	}
+	channel = (unsigned char)((part->midi_channel < 16) ? part->midi_channel : event->channel);
+	queue_midi_out(part->midi_out_index, (unsigned char)(event->type | channel),
+	               event->note, event->velocity);
+}
+
+
+/*****************************************************************************
+ * queue_midi_out_param()
+ *
+ * Echoes a parameter edit as a controller message for control surface
+ * feedback.  Called from the engine thread.
+ *****************************************************************************/
+void
+queue_midi_out_param(PARAM *param)
+{
+	PART            *part = param->patch->part;
+	unsigned char   channel;
+	int             cc    = param->info->cc_num;
+
+	if (!setting_midi_param_echo || (cc < 0) || (cc >= 0x78)) {
+		return;
+	}
+	channel = (unsigned char)((part->midi_channel < 16) ? part->midi_channel : 0);
+	queue_midi_out(part->midi_out_index, (unsigned char)(MIDI_EVENT_CONTROLLER | channel),
+	               (unsigned char) cc, (unsigned char) param->value.cc_val);
+}
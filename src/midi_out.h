@@ -0,0 +1,60 @@
+/*****************************************************************************
+ *
+ * midi_out.h
+ *
+ * PHASEX:  [P]hase [H]armonic [A]dvanced [S]ynthesis [EX]periment
+ *
+ * Copyright (C) 2012-2013 William Weston <whw@linuxmail.org>
+ *
+ * PHASEX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PHASEX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PHASEX.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+#ifndef _PHASEX_MIDI_OUT_H_
+#define _PHASEX_MIDI_OUT_H_
+
+#include <glib.h>
+#include "phasex.h"
+#include "mididefs.h"
+#include "param.h"
+
+
+/* Number of slots in the midi output queue (must be a power of 2). */
+#define MIDI_OUT_QUEUE_SIZE         1024
+#define MIDI_OUT_QUEUE_MASK         (MIDI_OUT_QUEUE_SIZE - 1)
+
+/* Buffer index for events to be sent at the start of the next cycle. */
+#define MIDI_OUT_INDEX_NOW          -1
+
+
+typedef struct midi_out_event {
+	volatile gint   sequence;       /* slot sequence for lock-free queueing */
+	int             index;          /* ring buffer index to send event at */
+	unsigned char   size;           /* number of bytes in message */
+	unsigned char   data[3];        /* raw midi message */
+} MIDI_OUT_EVENT;
+
+
+extern volatile gint    midi_out_active;
+
+
+void init_midi_out(void);
+void queue_midi_out(int index, unsigned char status, unsigned char data1, unsigned char data2);
+int dequeue_midi_out(unsigned int a_index, unsigned int nframes,
+                     unsigned char *data, unsigned int *offset);
+void queue_midi_out_thru(MIDI_EVENT *event, int index);
+void queue_midi_out_note(unsigned int part_num, MIDI_EVENT *event);
+void queue_midi_out_param(PARAM *param);
+
+
+#endif /* _PHASEX_MIDI_OUT_H_ */
@@ -24,13 +24,16 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <ctype.h>
 #include "phasex.h"
 #include "mididefs.h"
 #include "midi_event.h"
+#include "midi_out.h"
 #include "midi_process.h"
 #include "midimap.h"
 #include "engine.h"
+#include "fx_bus.h"
 #include "buffer.h"
 #include "patch.h"
 #include "param.h"
@@ -39,15 +42,27 @@
 #include "bank.h"
 #include "session.h"
 #include "settings.h"
-#include "gui_param.h"
-#include "gui_patch.h"
-#include "gui_midimap.h"
+#include "control.h"
+#include "engine_api.h"
 #include "debug.h"
+#include "trace.h"
 
 
 int             vnum[MAX_PARTS];    /* round robin voice selectors */
 
 
+/* Per-part controller state for 14-bit CC pairs and (N)RPN data entry */
+typedef struct midi_cc_state {
+	int             msb[MIDI_CONTROLLER_NUM_PAIRS]; /* last MSB for each cc pair */
+	int             nrpn_key;       /* selected (n)rpn, MIDI_RPN_FLAG set for rpn */
+	int             data_msb;       /* last data entry MSB */
+} MIDI_CC_STATE;
+
+static MIDI_CC_STATE    cc_state[MAX_PARTS] = {
+	[0 ... (MAX_PARTS - 1)] = { .nrpn_key = MIDI_RPN_NULL | MIDI_RPN_FLAG }
+};
+
+
 /*****************************************************************************
  * init_midi_processor()
  *
@@ -66,8 +81,12 @@ init_midi_processor()
 		/* initialize keylist nodes */
 		for (j = 0; j < 128; j++) {
 			part->keylist[j].midi_key = j & 0x7F;
-			part->keylist[j].next = NULL;
+			part->keylist[j].held     = 0;
+			part->keylist[j].prev     = NULL;
+			part->keylist[j].next     = NULL;
 		}
+		part->head = NULL;
+		part->tail = NULL;
 		/* initialize round robin voice indices */
 		vnum[part_num] = 0;
 
@@ -77,6 +96,150 @@ init_midi_processor()
 }
 
 
+/*****************************************************************************
+ * keylist_remove()
+ *
+ * Unlinks a key from the part's list of keys in play, if it is held.
+ *****************************************************************************/
+static void
+keylist_remove(PART *part, KEYLIST *key)
+{
+	if (!key->held) {
+		return;
+	}
+	if (key->prev != NULL) {
+		key->prev->next = key->next;
+	}
+	else {
+		part->head = key->next;
+	}
+	if (key->next != NULL) {
+		key->next->prev = key->prev;
+	}
+	else {
+		part->tail = key->prev;
+	}
+	key->prev = NULL;
+	key->next = NULL;
+	key->held = 0;
+}
+
+
+/*****************************************************************************
+ * keylist_push()
+ *
+ * Links a key to the end of the part's list of keys in play, moving it
+ * there if it is already held.
+ *****************************************************************************/
+static void
+keylist_push(PART *part, KEYLIST *key)
+{
+	keylist_remove(part, key);
+	key->prev = part->tail;
+	key->next = NULL;
+	if (part->tail != NULL) {
+		part->tail->next = key;
+	}
+	else {
+		part->head = key;
+	}
+	part->tail = key;
+	key->held  = 1;
+}
+
+
+/*****************************************************************************
+ * keylist_clear()
+ *****************************************************************************/
+static void
+keylist_clear(PART *part)
+{
+	while (part->head != NULL) {
+		keylist_remove(part, part->head);
+	}
+}
+
+
+/*****************************************************************************
+ * select_poly_voice()
+ *
+ * Voice allocation with note stealing for poly keymode.  Sets the part's
+ * current voice and returns 0, or returns -1 when the note has to wait for
+ * a stolen voice to fade out (or has to be dropped).
+ *****************************************************************************/
+static int
+select_poly_voice(MIDI_EVENT *event, unsigned int part_num)
+{
+	PART            *part        = get_part(part_num);
+	int             free_voice   = voice_alloc_find_free(part);
+	int             steal_voice  = -1;
+	int             shed_num;
+
+	/* a note replayed after a steal fade gets the voice freed for it */
+	if (part->steal_replay && (free_voice >= 0)) {
+		vnum[part_num] = free_voice;
+		return 0;
+	}
+
+	/* parts with a voice limit steal from themselves once they reach it */
+	if ((free_voice >= 0) && (setting_part_voice_max[part_num] > 0) &&
+	    (g_atomic_int_get(&part->voice_count) >= setting_part_voice_max[part_num])) {
+		free_voice = -1;
+	}
+
+	/* priority 1: retrigger a voice already playing this key */
+	if (setting_voice_steal_same_key) {
+		steal_voice = voice_alloc_find_key(part, part_num, event->note);
+	}
+
+	/* priority 2: a free voice, as long as the global budget allows */
+	if ((steal_voice < 0) && (free_voice >= 0)) {
+		shed_num = voice_budget_shed_part(part_num);
+		if (shed_num < 0) {
+			vnum[part_num] = free_voice;
+			return 0;
+		}
+		/* over budget, so a lower priority part gives up a voice */
+		if (shed_num != (int) part_num) {
+			g_atomic_int_set(&(get_part((unsigned int) shed_num)->voice_shed_request), 1);
+			vnum[part_num] = free_voice;
+			return 0;
+		}
+	}
+
+	/* priority 3: steal a voice according to the stealing policy */
+	if (steal_voice < 0) {
+		steal_voice = voice_alloc_find_victim(part, part_num);
+	}
+	if (steal_voice < 0) {
+		if (free_voice >= 0) {
+			vnum[part_num] = free_voice;
+			return 0;
+		}
+		PHASEX_DEBUG(DEBUG_CLASS_MIDI_NOTE,
+		             "*** Part %d:  all voices fading out.  Dropping note %d!\n",
+		             (part_num + 1), event->note);
+		return -1;
+	}
+
+	vnum[part_num] = steal_voice;
+	PHASEX_DEBUG(DEBUG_CLASS_MIDI_NOTE,
+	             "*** Part %d:  stealing voice %d!\n",
+	             (part_num + 1), vnum[part_num]);
+	PHASEX_DEBUG(DEBUG_CLASS_MIDI_TIMING,
+	             DEBUG_COLOR_YELLOW "+++++++++++ "
+	             DEBUG_COLOR_DEFAULT);
+
+	/* fade out the stolen voice, and play this note once it's free */
+	if (setting_voice_steal_fade_time > 0) {
+		voice_steal_fade(part, get_voice(part_num, (unsigned int) steal_voice), event);
+		return -1;
+	}
+
+	return 0;
+}
+
+
 /*****************************************************************************
  * process_note_on()
  *
@@ -94,14 +257,18 @@ process_note_on(MIDI_EVENT *event, unsigned int part_num)
 	PART            *part          = get_part(part_num);
 	PATCH_STATE     *state         = get_active_state(part_num);
 	int             voice_num;
-	int             oldest_age;
-	int             free_voice;
-	int             steal_voice;
-	int             same_key;
 
 	/* if this is velocity 0 style note off, fall through */
 	if (event->velocity > 0) {
 
+		/* catch up a sleeping part before keytrig resets its lfos */
+		wake_part(part, state, part_num);
+
+		/* poly voices are selected first, since stealing may defer the note */
+		if ((state->keymode == KEYMODE_POLY) && (select_poly_voice(event, part_num) < 0)) {
+			return;
+		}
+
 		/* keep track of previous to last key pressed! */
 		part->prev_key = part->midi_key;
 		part->midi_key = event->note;
@@ -147,54 +314,7 @@ process_note_on(MIDI_EVENT *event, unsigned int part_num)
 			vnum[part_num] = (vnum[part_num] + setting_polyphony - 1) % setting_polyphony;
 			break;
 		case KEYMODE_POLY:
-			vnum[part_num] = 0;
-
-			/* voice allocation with note stealing */
-			oldest_age          = 0;
-			free_voice          = -1;
-			steal_voice         = setting_polyphony - 1;
-			same_key            = -1;
-
-			/* look through all the voices */
-			for (voice_num = 0; voice_num < setting_polyphony; voice_num++) {
-				loop_voice = get_voice(part_num, voice_num);
-
-				/* priority 1: a free voice */
-				if (loop_voice->allocated == 0) {
-					free_voice = voice_num;
-					vnum[part_num] = free_voice;
-					voice_num = setting_polyphony;
-					break;
-				}
-				else {
-					if (loop_voice->midi_key == part->midi_key) {
-						PHASEX_DEBUG(DEBUG_CLASS_MIDI_TIMING,
-						             DEBUG_COLOR_RED "+++++++++++ "
-						             DEBUG_COLOR_DEFAULT);
-					}
-
-					/* priority 2: find the absolute oldest in play */
-					if ((same_key == -1) && (loop_voice->age > oldest_age)) {
-						oldest_age = loop_voice->age;
-						steal_voice = voice_num;
-					}
-				}
-			}
-
-			/* priorities 1 and 2 */
-			if (free_voice >= 0) {
-				vnum[part_num] = free_voice;
-			}
-			else {
-				vnum[part_num] = steal_voice;
-				PHASEX_DEBUG(DEBUG_CLASS_MIDI_NOTE,
-				             "*** Part %d:  stealing voice %d!\n",
-				             (part_num + 1), vnum[part_num]);
-				PHASEX_DEBUG(DEBUG_CLASS_MIDI_TIMING,
-				             DEBUG_COLOR_YELLOW "+++++++++++ "
-				             DEBUG_COLOR_DEFAULT);
-			}
-
+			/* voice already selected by select_poly_voice() */
 			break;
 		}
 
@@ -225,51 +345,23 @@ process_note_on(MIDI_EVENT *event, unsigned int part_num)
 			             (vnum[part_num] + 1),
 			             event->note,
 			             event->velocity);
-			PHASEX_DEBUG(DEBUG_CLASS_MIDI_TIMING,
-			             DEBUG_COLOR_RED "!!!!!!! %d !!!!!!! "
-			             DEBUG_COLOR_DEFAULT,
-			             event->note);
+			PHASEX_TRACE(TRACE_NOTE_ON, part_num, event->note, event->velocity,
+			             vnum[part_num], 0);
 		}
 
 		/* staccato, or no previous notes in play */
 		if ((part->prev_key == -1) || (part->head == NULL)) {
 			old_voice = NULL;
 
-			/* put this key at the start of the list */
-			part->head = & (part->keylist[part->midi_key]);
-			part->head->next = NULL;
+			/* start a new list with just this key */
+			keylist_clear(part);
+			keylist_push(part, & (part->keylist[part->midi_key]));
 		}
 
 		/* legato, or previous notes still in play */
 		else {
-			/* Link this key to the end of the list,
-			   unlinking from the middle if necessary. */
-			part->cur = part->head;
-			part->prev = NULL;
-			while (part->cur != NULL) {
-				PHASEX_DEBUG(DEBUG_CLASS_MIDI_NOTE, "%d:", part->cur->midi_key);
-				if (part->cur == &part->keylist[part->midi_key]) {
-					if (part->prev != NULL) {
-						part->prev->next = part->cur->next;
-					}
-				}
-				part->prev = part->cur;
-				part->cur = part->cur->next;
-			}
-			//PHASEX_DEBUG (DEBUG_CLASS_MIDI_NOTE, "\n");
-			part->cur = & (part->keylist[part->midi_key]);
-
-			/* if there is no end of the list, link it to the head */
-			if (part->prev == NULL) {
-				part->head = part->cur;
-				PHASEX_WARN("*** process_note_on(): [part%d] found "
-				            "previous key in play with no keylist!\n",
-				            (part_num + 1));
-			}
-			else {
-				part->prev->next = part->cur;
-			}
-			part->cur->next = NULL;
+			/* move this key to the end of the list */
+			keylist_push(part, & (part->keylist[part->midi_key]));
 			if ( (state->keymode == KEYMODE_MONO_MULTIKEY) &&
 			     (old_voice->allocated > 0) &&
 			     (old_voice->keypressed == -1) &&
@@ -288,6 +380,8 @@ process_note_on(MIDI_EVENT *event, unsigned int part_num)
 
 		/* process parameters dependent on keytrigger events */
 		process_keytrigger(event, old_voice, voice, part_num);
+
+		queue_midi_out_note(part_num, event);
 	}
 
 	/* velocity 0 style note off */
@@ -314,11 +408,14 @@ process_note_off(MIDI_EVENT *event, unsigned int part_num)
 	VOICE           *loop_voice;
 	PART            *part           = get_part(part_num);
 	PATCH_STATE     *state          = get_active_state(part_num);
+	KEYLIST         *key            = & (part->keylist[event->note & 0x7F]);
 	int             keytrigger      = 0;
 	int             free_voice      = -1;
 	int             voice_num;
 	int             unlink;
 
+	queue_midi_out_note(part_num, event);
+
 	switch (state->keymode) {
 	case KEYMODE_POLY:
 		/* find voice mapped to note being shut off */
@@ -331,6 +428,11 @@ process_note_off(MIDI_EVENT *event, unsigned int part_num)
 				loop_voice->cur_amp_interval = ENV_INTERVAL_SUSTAIN;
 				vnum[part_num] = voice_num;
 			}
+			/* note released before its stolen voice finished fading */
+			if (loop_voice->steal_pending && (loop_voice->steal_event.note == event->note)) {
+				loop_voice->steal_pending = 0;
+				part->steal_pending--;
+			}
 		}
 		if (vnum[part_num] == -1) {
 			vnum[part_num] = 0;
@@ -394,39 +496,13 @@ process_note_off(MIDI_EVENT *event, unsigned int part_num)
 	             event->note,
 	             event->velocity);
 
-	/* remove this key from the list and then find the last key */
-	part->prev = NULL;
-	part->cur = part->head;
-	unlink = 0;
-	while (part->cur != NULL) {
-
-		/* if note is found, unlink it from the list */
-		if (part->cur->midi_key == event->note) {
-			PHASEX_DEBUG(DEBUG_CLASS_MIDI_NOTE, "-%d-:", part->cur->midi_key);
-			unlink = 1;
-			if (part->prev != NULL) {
-				part->prev->next = part->cur->next;
-				part->cur->next  = NULL;
-				part->cur        = part->prev->next;
-			}
-			else {
-				part->head       = part->cur->next;
-				part->cur->next  = NULL;
-				part->cur        = part->head;
-			}
-		}
-		/* otherwise, on to the next key in the list */
-		else {
-			PHASEX_DEBUG(DEBUG_CLASS_MIDI_NOTE, "%d:", part->cur->midi_key);
-			part->prev = part->cur;
-			part->cur  = part->cur->next;
-		}
-	}
+	/* remove this key from the list.  the last key still held is left
+	   at the tail. */
+	unlink = key->held;
+	keylist_remove(part, key);
 
 	PHASEX_DEBUG(DEBUG_CLASS_MIDI_NOTE, "\n");
-	PHASEX_DEBUG(DEBUG_CLASS_MIDI_TIMING,
-	             DEBUG_COLOR_BLUE "------- %d ------- " DEBUG_COLOR_DEFAULT,
-	             event->note);
+	PHASEX_TRACE(TRACE_NOTE_OFF, part_num, event->note, unlink, 0, 0);
 
 	if (!unlink) {
 		/* Received note-off w/o corresponding note-on. */
@@ -437,22 +513,11 @@ process_note_off(MIDI_EVENT *event, unsigned int part_num)
 	/* keep pointer to current voice around */
 	voice = get_voice(part_num, vnum[part_num]);
 
-	/* ignore the note in the note off message if found in list */
-	if ((part->prev != NULL) && (part->prev->midi_key == event->note)) {
-		part->cur = part->head;
-		while (part->cur != NULL) {
-			if (part->cur->midi_key != event->note) {
-				part->prev = part->cur;
-			}
-			part->cur  = part->cur->next;
-		}
-	}
 	/* check for keys left on the list */
-	if (part->prev != NULL) {
+	if (part->tail != NULL) {
 		/* set last/current keys in play respective of notes still held */
-		part->last_key = part->prev->midi_key;
-		part->midi_key = part->prev->midi_key;
-		part->prev->next = NULL;
+		part->last_key = part->tail->midi_key;
+		part->midi_key = part->tail->midi_key;
 
 		/* Retrigger and smooth modes need voice allocation with keys
 		   still on list multikey always need osc remapping until all
@@ -488,7 +553,6 @@ process_note_off(MIDI_EVENT *event, unsigned int part_num)
 	else {
 		voice->midi_key         = -1;
 		voice->keypressed       = -1;
-		part->head              = NULL;
 		if (!part->hold_pedal) {
 			part->midi_key      = -1;
 		}
@@ -531,19 +595,23 @@ process_all_notes_off(MIDI_EVENT *event, unsigned int part_num)
 	/* let engine shut off notes gracefully */
 	for (voice_num = 0; voice_num < (unsigned int) setting_polyphony; voice_num++) {
 		voice = get_voice(part_num, voice_num);
-		voice->keypressed = -1;
+		voice->keypressed    = -1;
+		voice->steal_pending = 0;
 	}
+	part->steal_pending = 0;
 
 	/* re-initialize this part's keylists */
 	part->head     = NULL;
+	part->tail     = NULL;
 	part->cur      = NULL;
-	part->prev     = NULL;
 	part->midi_key = -1;
 	part->prev_key = -1;
 
 	/* re-initialize this part's keylist nodes */
 	for (j = 0; j < 128; j++) {
 		part->keylist[j].midi_key = (short) j;
+		part->keylist[j].held     = 0;
+		part->keylist[j].prev     = NULL;
 		part->keylist[j].next     = NULL;
 	}
 }
@@ -569,9 +637,7 @@ broadcast_notes_off(void)
 	delta_nsec  = get_time_delta(&now);
 	cycle_frame = get_midi_cycle_frame(delta_nsec);
 	m_index     = get_midi_index();
-	PHASEX_DEBUG(DEBUG_CLASS_MIDI_TIMING,
-	             DEBUG_COLOR_CYAN "[%d] " DEBUG_COLOR_DEFAULT,
-	             (m_index / buffer_period_size));
+	PHASEX_TRACE(TRACE_MIDI_QUEUE, -1, (m_index / buffer_period_size), 0, 0, 0);
 
 	queue_event.type      = MIDI_EVENT_NOTES_OFF;
 	queue_event.state     = EVENT_STATE_ALLOCATED;
@@ -953,6 +1019,7 @@ process_keytrigger(MIDI_EVENT   *UNUSED(event),
 
 	/* allocate voice (engine actually activates allocated voices) */
 	voice->allocated = 1;
+	voice_alloc_claim(part, voice->id);
 }
 
 
@@ -1017,22 +1084,156 @@ process_polypressure(MIDI_EVENT *event, unsigned int part_num)
  *****************************************************************************/
 void
 param_midi_update(PARAM *param, int cc_val)
+{
+	param_midi_update_fine(param, cc_val << 7);
+}
+
+
+/*****************************************************************************
+ * param_midi_update_fine()
+ *
+ * Handle synth engine patch state updates for 14-bit values received via
+ * cc pairs or (n)rpn data entry.  The upper 7 bits set the param's cc value,
+ * and callbacks that support it use the lower 7 bits as a fraction.
+ *****************************************************************************/
+void
+param_midi_update_fine(PARAM *param, int fine_val)
 {
 	SESSION         *session = get_current_session();
 	unsigned int    id = param->info->id;
+	int             cc_val;
 
 	/* ignore midi updates for locked params */
 	if (!param->info->locked) {
+		/* clamp to range for parameter */
+		if (fine_val > (param->info->cc_limit << 7)) {
+			fine_val = param->info->cc_limit << 7;
+		}
+		cc_val = fine_val >> 7;
+
 		/* update param value */
-		if (param->value.cc_val != cc_val) {
-			param->value.cc_prev   = param->value.cc_val;
+		if ((param->value.cc_val != cc_val) || (param->value.fine_val != fine_val)) {
+			if (param->value.cc_val != cc_val) {
+				param->value.cc_prev = param->value.cc_val;
+			}
 			param->value.cc_val    = cc_val;
 			param->value.int_val   = cc_val + param->info->cc_offset;
+			param->value.fine_val  = fine_val;
 			param->updated         = 1;
 			param->patch->modified = 1;
 			session->modified      = 1;
-			/* update engine state */
-			cb_info[id].update_patch_state(param);
+			/* update engine state, leaving heavy work for the
+			   control thread */
+			if ((cb_info[id].update_patch_state_rt != NULL) && (control_thread_p != 0)) {
+				cb_info[id].update_patch_state_rt(param);
+				queue_param_control(param);
+			}
+			else {
+				cb_info[id].update_patch_state(param);
+			}
+		}
+	}
+}
+
+
+/*****************************************************************************
+ * process_nrpn_data()
+ *
+ * Apply a 14-bit data entry value to all params mapped to the currently
+ * selected (n)rpn.
+ *****************************************************************************/
+static void
+process_nrpn_data(unsigned int part_num, int fine_val)
+{
+	PARAM           *param;
+	int             key = cc_state[part_num].nrpn_key;
+	int             j;
+
+	for (j = 0; j < nrpn_map_size; j++) {
+		if (nrpn_map[j].key == key) {
+			param = get_param(part_num, (unsigned int) nrpn_map[j].id);
+			param_midi_update_fine(param, fine_val);
+			notify_param_update(param, param->value.cc_val);
+		}
+	}
+}
+
+
+/*****************************************************************************
+ * process_controller_hires()
+ *
+ * Track (n)rpn selection and data entry, and combine LSBs (controllers
+ * 32-63) with the last MSB for params mapped as 14-bit cc pairs.  A new
+ * MSB (controllers 0-31) clears the fraction left by the previous LSB.
+ *****************************************************************************/
+static void
+process_controller_hires(unsigned char cc, int value, unsigned int part_num)
+{
+	MIDI_CC_STATE   *ccs = & (cc_state[part_num]);
+	PARAM           *param;
+	unsigned char   msb_cc;
+	int             id;
+	int             j;
+
+	switch (cc) {
+	case MIDI_CONTROLLER_NRPN_MSB:
+		ccs->nrpn_key = (value << 7) | (ccs->nrpn_key & 0x7F);
+		break;
+	case MIDI_CONTROLLER_NRPN_LSB:
+		ccs->nrpn_key = (ccs->nrpn_key & 0x3F80) | value;
+		break;
+	case MIDI_CONTROLLER_RPN_MSB:
+		ccs->nrpn_key = (value << 7) | (ccs->nrpn_key & 0x7F) | MIDI_RPN_FLAG;
+		break;
+	case MIDI_CONTROLLER_RPN_LSB:
+		ccs->nrpn_key = (ccs->nrpn_key & 0x3F80) | value | MIDI_RPN_FLAG;
+		break;
+	case MIDI_CONTROLLER_DATA_MSB:
+		ccs->data_msb = value;
+		process_nrpn_data(part_num, value << 7);
+		break;
+	case MIDI_CONTROLLER_DATA_LSB:
+		process_nrpn_data(part_num, (ccs->data_msb << 7) | value);
+		break;
+	case MIDI_CONTROLLER_DATA_INC:
+		if (ccs->data_msb < 127) {
+			ccs->data_msb++;
+		}
+		process_nrpn_data(part_num, ccs->data_msb << 7);
+		break;
+	case MIDI_CONTROLLER_DATA_DEC:
+		if (ccs->data_msb > 0) {
+			ccs->data_msb--;
+		}
+		process_nrpn_data(part_num, ccs->data_msb << 7);
+		break;
+	}
+
+	if (cc < MIDI_CONTROLLER_NUM_PAIRS) {
+		ccs->msb[cc] = value;
+		for (j = 0; j < 16; j++) {
+			if ((id = ccmatrix[cc][j]) < 0) {
+				break;
+			}
+			param = get_param(part_num, (unsigned int) id);
+			if (param->info->cc_hires) {
+				param_midi_update_fine(param, value << 7);
+				notify_param_update(param, param->value.cc_val);
+			}
+		}
+	}
+	else if ((cc >= MIDI_CONTROLLER_LSB_OFFSET) &&
+	         (cc < (MIDI_CONTROLLER_LSB_OFFSET + MIDI_CONTROLLER_NUM_PAIRS))) {
+		msb_cc = (unsigned char)(cc - MIDI_CONTROLLER_LSB_OFFSET);
+		for (j = 0; j < 16; j++) {
+			if ((id = ccmatrix[msb_cc][j]) < 0) {
+				break;
+			}
+			param = get_param(part_num, (unsigned int) id);
+			if (param->info->cc_hires) {
+				param_midi_update_fine(param, (ccs->msb[msb_cc] << 7) | value);
+				notify_param_update(param, param->value.cc_val);
+			}
 		}
 	}
 }
@@ -1052,9 +1253,7 @@ process_controller(MIDI_EVENT *event, unsigned int part_num)
 	/* get controller number */
 	cc = event->controller & 0x7F;
 
-	PHASEX_DEBUG(DEBUG_CLASS_MIDI_TIMING,
-	             DEBUG_COLOR_GREEN "ccccc %d:%d=%d ccccc " DEBUG_COLOR_DEFAULT,
-	             (part_num + 1), cc, event->value);
+	PHASEX_TRACE(TRACE_CONTROLLER, part_num, cc, event->value, 0, 0);
 
 	/* 0x78-0x7F (120-127) are channel mode messages. */
 	/* for now, just shut notes off */
@@ -1071,6 +1270,8 @@ process_controller(MIDI_EVENT *event, unsigned int part_num)
 		process_hold_pedal(event, part_num);
 	}
 	else {
+		/* 14-bit cc pairs and (n)rpn data entry */
+		process_controller_hires(cc, event->value & 0x7F, part_num);
 
 		/* now walk through the params in the matrix */
 		for (j = 0; j < 16; j++) {
@@ -1082,6 +1283,11 @@ process_controller(MIDI_EVENT *event, unsigned int part_num)
 
 			param = get_param(part_num, (unsigned int) id);
 
+			/* MSBs of 14-bit cc pairs were applied above */
+			if (param->info->cc_hires && (cc < MIDI_CONTROLLER_NUM_PAIRS)) {
+				continue;
+			}
+
 			/* clamp controller to range for parameter */
 			if (event->value > param->info->cc_limit) {
 				event->value = (unsigned char)(param->info->cc_limit);
@@ -1091,14 +1297,12 @@ process_controller(MIDI_EVENT *event, unsigned int part_num)
 			param_midi_update(param, event->value & 0x7F);
 
 			/* update gui's copy and mark as updated */
-			gui_param_midi_update(param, event->value & 0x7F);
+			notify_param_update(param, event->value & 0x7F);
 		}
 	}
 
-	/* check for active cc edit */
-	if (!cc_edit_ignore_midi && cc_edit_active) {
-		cc_edit_cc_num = cc;
-	}
+	/* let the client see controllers, for midimap learn */
+	notify_controller(part_num, cc);
 }
 
 
@@ -1111,12 +1315,13 @@ process_parameter(MIDI_EVENT *event, unsigned int part_num)
 	int             id      = event->parameter;
 	PARAM           *param  = get_param(part_num, (unsigned int)id);
 
-	PHASEX_DEBUG(DEBUG_CLASS_MIDI_TIMING,
-	             DEBUG_COLOR_GREEN "ppppp %d:%d=%d ppppp " DEBUG_COLOR_DEFAULT,
-	             (part_num + 1), id, event->value);
+	PHASEX_TRACE(TRACE_PARAM, part_num, id, event->value, 0, 0);
 
 	/* set parameter value and run callback */
 	param_midi_update(param, event->value & 0x7F);
+
+	/* echo edit to control surfaces */
+	queue_midi_out_param(param);
 }
 
 
@@ -1151,7 +1356,9 @@ process_program_change(MIDI_EVENT *event, unsigned int part_num)
 	PHASEX_DEBUG(DEBUG_CLASS_MIDI_EVENT, "-- Program Change:  Part %d:  %d %d\n",
 	             (part_num + 1), event->program, event->value);
 
-	midi_select_program(part_num, event->program);
+	if (midi_select_program(part_num, event->program)) {
+		get_part(part_num)->program_change_pending = 1;
+	}
 }
 
 
@@ -1166,8 +1373,6 @@ process_phase_sync(MIDI_EVENT *event, unsigned int part_num)
 {
 	PART            *part              = get_part(part_num);
 	PATCH_STATE     *state             = get_active_state(part_num);
-	DELAY           *delay             = get_delay(part_num);
-	CHORUS          *chorus            = get_chorus(part_num);
 	VOICE           *voice;
 	int             voice_num;
 	int             osc;
@@ -1176,44 +1381,13 @@ process_phase_sync(MIDI_EVENT *event, unsigned int part_num)
 	sample_t        f_phase_correction = (sample_t) phase_correction;
 	sample_t        tmp_1;
 
-	delay->write_index += phase_correction;
-	while (delay->write_index < 0.0) {
-		delay->write_index += delay->bufsize;
-	}
-	while (delay->write_index >= delay->bufsize) {
-		delay->write_index -= delay->bufsize;
-	}
-
-	chorus->lfo_index_a += f_phase_correction * chorus->lfo_adjust;
-	while (chorus->lfo_index_a < 0.0) {
-		chorus->lfo_index_a += F_WAVEFORM_SIZE;
-	}
-	while (chorus->lfo_index_a >= F_WAVEFORM_SIZE) {
-		chorus->lfo_index_a -= F_WAVEFORM_SIZE;
-	}
-
-	chorus->lfo_index_b = chorus->lfo_index_a + (F_WAVEFORM_SIZE * 0.25);
-	while (chorus->lfo_index_b < 0.0) {
-		chorus->lfo_index_b += F_WAVEFORM_SIZE;
-	}
-	while (chorus->lfo_index_b >= F_WAVEFORM_SIZE) {
-		chorus->lfo_index_b -= F_WAVEFORM_SIZE;
-	}
-
-	chorus->lfo_index_c = chorus->lfo_index_a + (F_WAVEFORM_SIZE * 0.5);
-	while (chorus->lfo_index_c < 0.0) {
-		chorus->lfo_index_c += F_WAVEFORM_SIZE;
+	/* the shared buses belong to the audio thread, which picks up the
+	   correction at its next period */
+	if (!part->fx_send) {
+		phase_sync_fx(get_delay(part_num), get_chorus(part_num), phase_correction);
 	}
-	while (chorus->lfo_index_c >= F_WAVEFORM_SIZE) {
-		chorus->lfo_index_c -= F_WAVEFORM_SIZE;
-	}
-
-	chorus->lfo_index_d = chorus->lfo_index_a + (F_WAVEFORM_SIZE * 0.75);
-	while (chorus->lfo_index_d < 0.0) {
-		chorus->lfo_index_d += F_WAVEFORM_SIZE;
-	}
-	while (chorus->lfo_index_d >= F_WAVEFORM_SIZE) {
-		chorus->lfo_index_d -= F_WAVEFORM_SIZE;
+	else if (part_num == fx_bus_part_num) {
+		queue_fx_bus_phase_sync(phase_correction);
 	}
 
 	for (voice_num = 0; voice_num < setting_polyphony; voice_num++) {
@@ -1239,7 +1413,7 @@ process_phase_sync(MIDI_EVENT *event, unsigned int part_num)
 				voice->index[osc] +=
 					f_phase_correction *
 					halfsteps_to_freq_mult((tmp_1 *
-					                        state->freq_lfo_amount[osc]) +
+					                        part->smooth_value[SMOOTH_OSC_FREQ_LFO + osc]) +
 					                       part->osc_pitch_bend[osc] +
 					                       state->osc_transpose[osc]) *
 					voice->osc_freq[osc] * wave_period;
@@ -1307,6 +1481,31 @@ process_hold_pedal(MIDI_EVENT *event, unsigned int part_num)
 }
 
 
+/*****************************************************************************
+ * clear_midi_event()
+ *
+ * Frees a processed event and returns the next event in its bulk list.
+ *****************************************************************************/
+static MIDI_EVENT *
+clear_midi_event(MIDI_EVENT *event)
+{
+	MIDI_EVENT  *next;
+
+	/* keep track of pointers to bulk lists */
+	next = event->next;
+
+	/* Clear event. */
+	event->type    = 0;
+	event->channel = 0;
+	event->byte2   = 0;
+	event->byte3   = 0;
+	event->next    = NULL;
+	event->state   = EVENT_STATE_FREE;
+
+	return next;
+}
+
+
 /*****************************************************************************
  * process_midi_event()
  *
@@ -1316,8 +1515,6 @@ process_hold_pedal(MIDI_EVENT *event, unsigned int part_num)
 MIDI_EVENT *
 process_midi_event(MIDI_EVENT *event, unsigned int part_num)
 {
-	MIDI_EVENT  *next;
-
 	switch (event->type) {
 	case MIDI_EVENT_NOTE_ON:
 		process_note_on(event, part_num);
@@ -1367,18 +1564,26 @@ process_midi_event(MIDI_EVENT *event, unsigned int part_num)
 		break;
 	}
 
-	/* keep track of pointers to bulk lists */
-	next = event->next;
+	return clear_midi_event(event);
+}
 
-	/* Clear event. */
-	event->type    = 0;
-	event->channel = 0;
-	event->byte2   = 0;
-	event->byte3   = 0;
-	event->next    = NULL;
-	event->state   = EVENT_STATE_FREE;
 
-	return next;
+/*****************************************************************************
+ * flush_held_midi_events()
+ *
+ * Processes all events held behind a pending program change, in order,
+ * against the patch that is still active.  The program change stays
+ * pending.
+ *****************************************************************************/
+static void
+flush_held_midi_events(PART *part, unsigned int part_num)
+{
+	int             j;
+
+	for (j = 0; j < part->held_event_count; j++) {
+		process_midi_event(& (part->held_events[j]), part_num);
+	}
+	part->held_event_count = 0;
 }
 
 
@@ -1391,9 +1596,56 @@ process_midi_events(unsigned int m_index, unsigned int cycle_frame, unsigned int
 	PART            *part   = get_part(part_num);
 	MIDI_EVENT      *event;
 
+	/* keymode changes from other threads take effect here */
+	run_voice_reset(part, part_num);
+
 	event = & (part->event_queue[m_index + cycle_frame]);
 
 	while ((event != NULL) && (event->state != EVENT_STATE_FREE)) {
+		/* hold events behind a program change until its patch is live */
+		if (part->program_change_pending) {
+			/* when full, give up on holding the oldest events rather
+			   than letting this one run ahead of them */
+			if (part->held_event_count == MAX_HELD_EVENTS) {
+				PHASEX_DEBUG(DEBUG_CLASS_MIDI_EVENT,
+				             "+++ process_midi_events():  part %d:  "
+				             "held event list full.  Flushing.\n", (part_num + 1));
+				flush_held_midi_events(part, part_num);
+			}
+			part->held_events[part->held_event_count] = *event;
+			part->held_events[part->held_event_count].next = NULL;
+			part->held_event_count++;
+			event = clear_midi_event(event);
+			continue;
+		}
 		event = process_midi_event(event, part_num);
 	}
 }
+
+
+/*****************************************************************************
+ * replay_held_midi_events()
+ *
+ * Processes the events a part held while its program change was pending.
+ * Called from the engine thread once the new patch is live.  A replayed
+ * program change starts holding again, keeping the events behind it.
+ *****************************************************************************/
+void
+replay_held_midi_events(unsigned int part_num)
+{
+	PART            *part   = get_part(part_num);
+	int             count   = part->held_event_count;
+	int             j;
+
+	part->program_change_pending = 0;
+
+	for (j = 0; (j < count) && !part->program_change_pending; j++) {
+		process_midi_event(& (part->held_events[j]), part_num);
+	}
+
+	part->held_event_count = count - j;
+	if (part->held_event_count > 0) {
+		memmove(& (part->held_events[0]), & (part->held_events[j]),
+		        (size_t) part->held_event_count * sizeof(MIDI_EVENT));
+	}
+}
@@ -33,6 +33,7 @@ extern int              vnum[MAX_PARTS];    /* round robin voice selectors */
 void init_midi_processor(void);
 MIDI_EVENT *process_midi_event(MIDI_EVENT *event, unsigned int part_num);
 void process_midi_events(unsigned int m_index, unsigned int cycle_frame, unsigned int part_num);
+void replay_held_midi_events(unsigned int part_num);
 
 void process_note_on(MIDI_EVENT *event, unsigned int part_num);
 void process_note_off(MIDI_EVENT *event, unsigned int part_num);
@@ -46,6 +47,7 @@ void process_keytrigger(MIDI_EVENT *UNUSED(event),
 void process_aftertouch(MIDI_EVENT *event, unsigned int part_num);
 void process_polypressure(MIDI_EVENT *event, unsigned int part_num);
 void param_midi_update(PARAM *param, int cc_val);
+void param_midi_update_fine(PARAM *param, int fine_val);
 void process_controller(MIDI_EVENT *event, unsigned int part_num);
 void process_parameter(MIDI_EVENT *event, unsigned int part_num);
 void process_pitchbend(MIDI_EVENT *event, unsigned int part_num);
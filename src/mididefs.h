@@ -82,7 +82,23 @@
 #define EVENT_STATE_ABANDONED       -7
 
 /* MIDI controller definitions */
+#define MIDI_CONTROLLER_DATA_MSB    6
+#define MIDI_CONTROLLER_DATA_LSB    38
 #define MIDI_CONTROLLER_HOLD_PEDAL  64
+#define MIDI_CONTROLLER_DATA_INC    96
+#define MIDI_CONTROLLER_DATA_DEC    97
+#define MIDI_CONTROLLER_NRPN_LSB    98
+#define MIDI_CONTROLLER_NRPN_MSB    99
+#define MIDI_CONTROLLER_RPN_LSB     100
+#define MIDI_CONTROLLER_RPN_MSB     101
+
+/* Controllers 0-31 pair with an LSB controller 32 higher for 14-bit values. */
+#define MIDI_CONTROLLER_LSB_OFFSET  32
+#define MIDI_CONTROLLER_NUM_PAIRS   32
+
+/* (N)RPN parameter numbers are 14-bit.  RPNs get a flag bit in lookup keys. */
+#define MIDI_RPN_NULL               0x3FFF
+#define MIDI_RPN_FLAG               0x4000
 
 
 /* PHASEX MIDI event structure */
@@ -36,30 +36,45 @@
 #include "session.h"
 #include "settings.h"
 #include "engine.h"
+#include "mididefs.h"
 #include "string_util.h"
 #include "param_strings.h"
+#include "midimap.h"
 #include "gui_main.h"
 #include "gui_patch.h"
 #include "gui_navbar.h"
+#include "autosave.h"
 #include "debug.h"
 
 
-int         ccmatrix[128][16];
+int             ccmatrix[128][16];
 
-char        *midimap_filename   = NULL;
-int         midimap_modified    = 0;
+MIDI_NRPN_MAP   nrpn_map[NUM_PARAMS];
+int             nrpn_map_size       = 0;
+
+MIDI_SPLIT      midi_split[MAX_PARTS] = {
+	[0 ... (MAX_PARTS - 1)] = { 0, 127, 0, 127 }
+};
+
+volatile gint   midi_channel_route[16];
+volatile gint   midi_key_route[128];
+volatile gint   midi_velocity_route[128];
+
+char            *midimap_filename   = NULL;
+int             midimap_modified    = 0;
 
 
 /*****************************************************************************
  * build_ccmatrix()
  *
- * Build the midi controller matrix from current param info.
+ * Build the midi controller matrix and (N)RPN map from current param info.
  *****************************************************************************/
 void
 build_ccmatrix(void)
 {
 	PARAM_INFO      *param_info;
 	int             cc;
+	int             size = 0;
 	unsigned int    id;
 	unsigned int    j;
 
@@ -86,10 +101,114 @@ build_ccmatrix(void)
 				ccmatrix[cc][j] = (int) id;
 			}
 		}
+		/* params mapped to both an nrpn and an rpn need two entries */
+		if ((param_info->nrpn_num >= 0) && (size < NUM_PARAMS)) {
+			nrpn_map[size].key = param_info->nrpn_num;
+			nrpn_map[size].id  = (int) id;
+			size++;
+		}
+		if ((param_info->rpn_num >= 0) && (size < NUM_PARAMS)) {
+			nrpn_map[size].key = param_info->rpn_num | MIDI_RPN_FLAG;
+			nrpn_map[size].id  = (int) id;
+			size++;
+		}
+	}
+	nrpn_map_size = size;
+}
+
+
+/*****************************************************************************
+ * build_midi_route()
+ *
+ * Build the channel, key, and velocity part masks used by the midi drivers
+ * to route incoming events from current part channels and split windows.
+ * Must be called whenever a part's midi channel or split changes.
+ *****************************************************************************/
+void
+build_midi_route(void)
+{
+	MIDI_SPLIT      *split;
+	int             channel;
+	int             key;
+	unsigned int    part_num;
+	gint            mask;
+
+	for (channel = 0; channel < 16; channel++) {
+		mask = 0;
+		for (part_num = 0; part_num < MAX_PARTS; part_num++) {
+			/* channel 16 is omni */
+			if ((get_part(part_num)->midi_channel == channel) ||
+			    (get_part(part_num)->midi_channel == 16)) {
+				mask |= (1 << part_num);
+			}
+		}
+		g_atomic_int_set(&midi_channel_route[channel], mask);
+	}
+
+	for (key = 0; key < 128; key++) {
+		mask = 0;
+		for (part_num = 0; part_num < MAX_PARTS; part_num++) {
+			split = & (midi_split[part_num]);
+			if ((key >= split->key_low) && (key <= split->key_high)) {
+				mask |= (1 << part_num);
+			}
+		}
+		g_atomic_int_set(&midi_key_route[key], mask);
+
+		mask = 0;
+		for (part_num = 0; part_num < MAX_PARTS; part_num++) {
+			split = & (midi_split[part_num]);
+			if ((key >= split->velocity_low) && (key <= split->velocity_high)) {
+				mask |= (1 << part_num);
+			}
+		}
+		g_atomic_int_set(&midi_velocity_route[key], mask);
 	}
 }
 
 
+/*****************************************************************************
+ * get_midi_route()
+ *
+ * Returns the mask of parts that should receive a channel message.  Note
+ * on events are routed by key and velocity.  Note off (including note on
+ * with zero velocity) and aftertouch go to every part on the channel, so
+ * that releases still reach the part that started the note after its split
+ * has changed.  Parts without the note ignore them.
+ *****************************************************************************/
+unsigned int
+get_midi_route(MIDI_EVENT *event)
+{
+	gint    mask = g_atomic_int_get(&midi_channel_route[event->channel & 0x0F]);
+
+	if ((event->type == MIDI_EVENT_NOTE_ON) && (event->velocity != 0)) {
+		mask &= g_atomic_int_get(&midi_key_route[event->note & 0x7F]);
+		mask &= g_atomic_int_get(&midi_velocity_route[event->velocity & 0x7F]);
+	}
+
+	return (unsigned int) mask;
+}
+
+
+/*****************************************************************************
+ * set_midi_split_for_part()
+ *****************************************************************************/
+void
+set_midi_split_for_part(unsigned int part_num,
+                        int key_low, int key_high,
+                        int velocity_low, int velocity_high)
+{
+	MIDI_SPLIT      *split = & (midi_split[part_num]);
+
+	split->key_low       = (key_low < 0)        ? 0   : key_low;
+	split->key_high      = (key_high > 127)     ? 127 : key_high;
+	split->velocity_low  = (velocity_low < 0)   ? 0   : velocity_low;
+	split->velocity_high = (velocity_high > 127) ? 127 : velocity_high;
+
+	build_midi_route();
+}
+
+
 /*****************************************************************************
  * set_midi_channel_for_part()
  *****************************************************************************/
@@ -102,6 +221,7 @@ set_midi_channel_for_part(unsigned int part_num, int new_channel) {
 	if (part->midi_channel != new_channel) {
 		/* set new channel for current part */
 		part->midi_channel = new_channel;
+		build_midi_route();
 
 		patch->param[PARAM_MIDI_CHANNEL].value.cc_prev =
 			patch->param[PARAM_MIDI_CHANNEL].value.cc_val;
@@ -110,6 +230,7 @@ set_midi_channel_for_part(unsigned int part_num, int new_channel) {
 			new_channel + patch->param[PARAM_MIDI_CHANNEL].info->cc_offset;
 		patch->param[PARAM_MIDI_CHANNEL].updated = 1;
 
+#ifndef PHASEX_LV2
 		if (gtkui_ready && (gp != NULL)) {
 			gp->param[PARAM_MIDI_CHANNEL].value.cc_prev =
 				gp->param[PARAM_MIDI_CHANNEL].value.cc_val;
@@ -123,7 +244,39 @@ set_midi_channel_for_part(unsigned int part_num, int new_channel) {
 				gtk_adjustment_set_value(GTK_ADJUSTMENT(midi_channel_adj), new_channel);
 			}
 		}
+#endif /* !PHASEX_LV2 */
+	}
+}
+
+
+/*****************************************************************************
+ * read_midimap_range()
+ *
+ * Parses the '= low, high;' remainder of a split range line.
+ *****************************************************************************/
+static int
+read_midimap_range(char *buffer, int *low, int *high)
+{
+	char    *p;
+
+	if (((p = get_next_token(buffer)) == NULL) || (*p != '=')) {
+		return -1;
+	}
+	if ((p = get_next_token(buffer)) == NULL) {
+		return -1;
+	}
+	*low = atoi(p);
+	if (((p = get_next_token(buffer)) == NULL) || (*p != ',')) {
+		return -1;
+	}
+	if ((p = get_next_token(buffer)) == NULL) {
+		return -1;
 	}
+	*high = atoi(p);
+	if (((p = get_next_token(buffer)) == NULL) || (*p != ';')) {
+		return -1;
+	}
+	return 0;
 }
 
 
@@ -143,6 +296,12 @@ read_midimap(char *filename)
 	unsigned int    part_num;
 	unsigned int    param_num;
 	int             cc_num;
+	int             low;
+	int             high;
+	int             locked;
+	int             hires;
+	int             nrpn_num;
+	int             rpn_num;
 	int             line = 0;
 
 	/* open the midimap file */
@@ -188,6 +347,27 @@ read_midimap(char *filename)
 		strncpy(param_name, p, sizeof(param_name));
 		param_name[sizeof(param_name) - 1] = '\0';
 
+		/* keyboard split ranges have their own syntax */
+		if ((strncmp(param_name, "key_range_", 10) == 0) ||
+		    (strncmp(param_name, "velocity_range_", 15) == 0)) {
+			part_num = (unsigned int)(atoi(index(param_name, '_') + 7) - 1);
+			if ((part_num < MAX_PARTS) && (read_midimap_range(buffer, &low, &high) == 0)) {
+				if (param_name[0] == 'k') {
+					set_midi_split_for_part(part_num, low, high,
+					                        midi_split[part_num].velocity_low,
+					                        midi_split[part_num].velocity_high);
+				}
+				else {
+					set_midi_split_for_part(part_num,
+					                        midi_split[part_num].key_low,
+					                        midi_split[part_num].key_high,
+					                        low, high);
+				}
+			}
+			while (get_next_token(buffer) != NULL);
+			continue;
+		}
+
 		/* find named parameter */
 		id = -1;
 		if (strncmp(param_name, "midi_channel_", 13) == 0) {
@@ -234,42 +414,46 @@ read_midimap(char *filename)
 			set_midi_channel_for_part(part_num, cc_num);
 		}
 
-		/* see if there's a ',locked' */
-		if ((p = get_next_token(buffer)) == NULL) {
-			while (get_next_token(buffer) != NULL);
-			continue;
-		}
-		if (*p == ',') {
+		/* see if there's a list of ',locked', ',hires', ',nrpn <num>',
+		   or ',rpn <num>' flags */
+		locked   = 0;
+		hires    = 0;
+		nrpn_num = -1;
+		rpn_num  = -1;
+		while (((p = get_next_token(buffer)) != NULL) && (*p == ',')) {
 			if ((p = get_next_token(buffer)) == NULL) {
-				while (get_next_token(buffer) != NULL);
-				continue;
-			}
-			if (strcmp(p, "locked") != 0) {
-				while (get_next_token(buffer) != NULL);
-				continue;
+				break;
 			}
-			if ((id >= 0) && (id < NUM_PARAMS)) {
-				for (part_num = 0; part_num < MAX_PARTS; part_num++) {
-					param = get_param(part_num, (unsigned int) id);
-					param->info->locked = 1;
-				}
+			if (strcmp(p, "locked") == 0) {
+				locked = 1;
 			}
-			if ((p = get_next_token(buffer)) == NULL) {
-				while (get_next_token(buffer) != NULL);
-				continue;
+			else if (strcmp(p, "hires") == 0) {
+				hires = 1;
 			}
-		}
-		else {
-			if ((id >= 0) && (id < NUM_PARAMS)) {
-				for (part_num = 0; part_num < MAX_PARTS; part_num++) {
-					param = get_param(part_num, (unsigned int) id);
-					param->info->locked = 0;
+			else if ((strcmp(p, "nrpn") == 0) || (strcmp(p, "rpn") == 0)) {
+				c = *p;
+				if ((p = get_next_token(buffer)) == NULL) {
+					break;
+				}
+				low = atoi(p);
+				if ((low < 0) || (low >= MIDI_RPN_NULL)) {
+					low = -1;
 				}
+				if (c == 'n') {
+					nrpn_num = low;
+				}
+				else {
+					rpn_num = low;
+				}
+			}
+			else {
+				p = NULL;
+				break;
 			}
 		}
 
 		/* make sure there's a ';' */
-		if (*p != ';') {
+		if ((p == NULL) || (*p != ';')) {
 			while (get_next_token(buffer) != NULL);
 			continue;
 		}
@@ -277,11 +461,22 @@ read_midimap(char *filename)
 		/* flush remainder of line */
 		while (get_next_token(buffer) != NULL);
 
-		/* set midi cc number */
+		/* only controllers 0-31 have an LSB controller to pair with */
+		if (hires && ((cc_num < 0) || (cc_num >= MIDI_CONTROLLER_NUM_PAIRS))) {
+			PHASEX_WARN("Ignoring ',hires' for '%s' on cc %d in midimap '%s', line %d.\n",
+			            param_name, cc_num, midimap_filename, line);
+			hires = 0;
+		}
+
+		/* set midi cc number, (n)rpn numbers, and flags */
 		if ((id >= 0) && (id < NUM_PARAMS)) {
 			for (part_num = 0; part_num < MAX_PARTS; part_num++) {
 				param = get_param(part_num, (unsigned int) id);
-				param->info->cc_num = cc_num;
+				param->info->cc_num   = cc_num;
+				param->info->cc_hires = hires;
+				param->info->nrpn_num = nrpn_num;
+				param->info->rpn_num  = rpn_num;
+				param->info->locked   = locked;
 			}
 		}
 		else if (debug && (strncmp(param_name, "midi_channel", 12) != 0)) {
@@ -309,12 +504,13 @@ save_midimap(char *filename)
 {
 	PARAM           *param;
 	FILE            *map_f;
+	char            tmpname[PATH_MAX];
 	unsigned int    param_num;
 	unsigned int    part_num;
 	unsigned int    k;
 
 	/* open the midimap file */
-	if ((map_f = fopen(filename, "wt")) == NULL) {
+	if ((map_f = atomic_fopen(filename, tmpname, sizeof(tmpname))) == NULL) {
 		PHASEX_ERROR("Error opening midimap file %s for write: %s\n",
 		             filename, strerror(errno));
 		return -1;
@@ -334,6 +530,14 @@ save_midimap(char *filename)
 		        (part_num + 1), midi_ch_names[(get_part(part_num)->midi_channel + 1)]);
 	}
 
+	/* keyboard split / layer ranges */
+	for (part_num = 0; part_num < MAX_PARTS; part_num++) {
+		fprintf(map_f, "key_range_%02d            = %d, %d;\n", (part_num + 1),
+		        midi_split[part_num].key_low, midi_split[part_num].key_high);
+		fprintf(map_f, "velocity_range_%02d       = %d, %d;\n", (part_num + 1),
+		        midi_split[part_num].velocity_low, midi_split[part_num].velocity_high);
+	}
+
 	/* output 'param_name = cc_num;' for each param */
 	for (param_num = 0; param_num < NUM_PARAMS; param_num++) {
 		param = get_param(0, param_num);
@@ -343,13 +547,23 @@ save_midimap(char *filename)
 			fputc('\t', map_f);
 			k -= 8;
 		}
-		fprintf(map_f, "= %d%s;\n",
-		        param->info->cc_num,
-		        (param->info->locked ? ",locked" : ""));
+		fprintf(map_f, "= %d", param->info->cc_num);
+		if (param->info->cc_hires) {
+			fprintf(map_f, ",hires");
+		}
+		if (param->info->nrpn_num >= 0) {
+			fprintf(map_f, ",nrpn %d", param->info->nrpn_num);
+		}
+		if (param->info->rpn_num >= 0) {
+			fprintf(map_f, ",rpn %d", param->info->rpn_num);
+		}
+		fprintf(map_f, "%s;\n", (param->info->locked ? ",locked" : ""));
 	}
 
 	/* done writing file */
-	fclose(map_f);
+	if (atomic_fclose(map_f, tmpname, filename) != 0) {
+		return -1;
+	}
 	midimap_modified = 0;
 
 	return 0;
@@ -23,15 +23,52 @@
 #ifndef _PHASEX_MIDIMAP_H_
 #define _PHASEX_MIDIMAP_H_
 
+#include <glib.h>
+#include "phasex.h"
+#include "mididefs.h"
 
-extern int      ccmatrix[128][16];
 
-extern char     *midimap_filename;
-extern int      midimap_modified;
+/* Keyboard split / layer window for a part.  Note events outside of the
+   window are not routed to the part. */
+typedef struct midi_split {
+	int             key_low;
+	int             key_high;
+	int             velocity_low;
+	int             velocity_high;
+} MIDI_SPLIT;
+
+
+/* (N)RPN to parameter mapping.  The key is the 14-bit parameter number,
+   with MIDI_RPN_FLAG set for RPNs. */
+typedef struct midi_nrpn_map {
+	int             key;
+	int             id;
+} MIDI_NRPN_MAP;
+
+
+extern int              ccmatrix[128][16];
+
+extern MIDI_NRPN_MAP    nrpn_map[NUM_PARAMS];
+extern int              nrpn_map_size;
+
+extern MIDI_SPLIT       midi_split[MAX_PARTS];
+
+/* Part bitmasks for MIDI routing, indexed by channel, key, and velocity. */
+extern volatile gint    midi_channel_route[16];
+extern volatile gint    midi_key_route[128];
+extern volatile gint    midi_velocity_route[128];
+
+extern char             *midimap_filename;
+extern int              midimap_modified;
 
 
 void build_ccmatrix(void);
+void build_midi_route(void);
+unsigned int get_midi_route(MIDI_EVENT *event);
 void set_midi_channel_for_part(unsigned int part_num, int new_channel);
+void set_midi_split_for_part(unsigned int part_num,
+                             int key_low, int key_high,
+                             int velocity_low, int velocity_high);
 int read_midimap(char *filename);
 int save_midimap(char *filename);
 
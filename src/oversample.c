@@ -0,0 +1,98 @@
+/*****************************************************************************
+ *
+ * oversample.c
+ *
+ * PHASEX:  [P]hase [H]armonic [A]dvanced [S]ynthesis [EX]periment
+ *
+ * Copyright (C) 2012-2013 William Weston <whw@linuxmail.org>
+ *
+ * PHASEX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PHASEX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PHASEX.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+#include "phasex.h"
+#include "oversample.h"
+
+
+/* Allpass coefficients for 2:1 polyphase IIR halfband decimators, designed
+   as elliptic halfband filters split into two allpass chains (even
+   coefficients in one branch, odd in the other). */
+const sample_t halfband_2x_coef[HALFBAND_2X_COEFS] = {
+	0.04063346092419326,
+	0.15050512902267460,
+	0.30075705599187408,
+	0.46077450496145061,
+	0.60952431489618830,
+	0.73850384111885725,
+	0.84922381039206607,
+	0.94974278370500020
+};
+
+const sample_t halfband_4x_coef[HALFBAND_4X_COEFS] = {
+	0.04189399199765617,
+	0.16890348243995201,
+	0.39056077292116592,
+	0.74389574826847815
+};
+
+
+/*****************************************************************************
+ * get_oversample_shift()
+ *
+ * Returns log2 of a per-part oversampling factor, rounding unsupported
+ * factors down to 1x, 2x, or 4x.
+ *****************************************************************************/
+int
+get_oversample_shift(int factor)
+{
+	if (factor >= 4) {
+		return 2;
+	}
+	if (factor >= 2) {
+		return 1;
+	}
+	return 0;
+}
+
+
+/*****************************************************************************
+ * halfband_decimate()
+ *
+ * Runs one channel of a halfband decimator on a pair of consecutive
+ * oversampled inputs (in0 older than in1), and returns a single sample at
+ * half the rate.  Each branch is a chain of first order allpass sections
+ * running at the decimated rate:  y = (x - y[n-1]) * a + x[n-1].
+ *****************************************************************************/
+sample_t
+halfband_decimate(HALFBAND *hb, const sample_t *coef, int num_coefs,
+                  sample_t in0, sample_t in1)
+{
+	sample_t    spl_0 = in1;
+	sample_t    spl_1 = in0;
+	sample_t    tmp;
+	int         j;
+
+	for (j = 0; j < num_coefs; j += 2) {
+		tmp      = spl_0;
+		spl_0    = ((tmp - hb->y[j]) * coef[j]) + hb->x[j];
+		hb->x[j] = tmp;
+		hb->y[j] = spl_0;
+
+		tmp          = spl_1;
+		spl_1        = ((tmp - hb->y[j + 1]) * coef[j + 1]) + hb->x[j + 1];
+		hb->x[j + 1] = tmp;
+		hb->y[j + 1] = spl_1;
+	}
+
+	return (spl_0 + spl_1) * 0.5;
+}
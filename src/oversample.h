@@ -0,0 +1,54 @@
+/*****************************************************************************
+ *
+ * oversample.h
+ *
+ * PHASEX:  [P]hase [H]armonic [A]dvanced [S]ynthesis [EX]periment
+ *
+ * Copyright (C) 2012-2013 William Weston <whw@linuxmail.org>
+ *
+ * PHASEX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PHASEX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PHASEX.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+#ifndef _PHASEX_OVERSAMPLE_H_
+#define _PHASEX_OVERSAMPLE_H_
+
+#include "phasex.h"
+
+
+/* Number of allpass coefficients for the two halfband decimator stages.
+   The 2x stage is steep (transition band 0.04, ~100dB rejection) since it
+   guards the audio band.  The 4x stage only has to keep the top octave
+   from folding into the upper half of the 2x band, so it can be short. */
+#define HALFBAND_2X_COEFS               8
+#define HALFBAND_4X_COEFS               4
+#define HALFBAND_MAX_COEFS              8
+
+
+/* State for one channel of a polyphase IIR halfband decimator. */
+typedef struct halfband {
+	sample_t    x[HALFBAND_MAX_COEFS];  /* allpass input history */
+	sample_t    y[HALFBAND_MAX_COEFS];  /* allpass output history */
+} HALFBAND;
+
+
+extern const sample_t   halfband_2x_coef[HALFBAND_2X_COEFS];
+extern const sample_t   halfband_4x_coef[HALFBAND_4X_COEFS];
+
+
+int get_oversample_shift(int factor);
+sample_t halfband_decimate(HALFBAND *hb, const sample_t *coef, int num_coefs,
+                           sample_t in0, sample_t in1);
+
+
+#endif /* _PHASEX_OVERSAMPLE_H_ */
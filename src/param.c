@@ -176,6 +176,9 @@ init_param_info(unsigned int id, const char *name, const char *label, unsigned i
 	info->list_labels   = label_list;
 	info->strval_list   = strval_list;
 	info->locked        = 0;
+	info->cc_hires      = 0;
+	info->nrpn_num      = -1;
+	info->rpn_num       = -1;
 	info->prelight      = 0;
 	info->focused       = 0;
 	info->sensitive     = 1;
@@ -186,7 +189,8 @@ init_param_info(unsigned int id, const char *name, const char *label, unsigned i
 		info->button_label[j]   = NULL;
 	}
 
-	cbinfo->update_patch_state = callback;
+	cbinfo->update_patch_state    = callback;
+	cbinfo->update_patch_state_rt = NULL;
 
 	if (id >= NUM_PARAMS) {
 		info->locked = 1;
@@ -404,4 +408,9 @@ init_params(void)
 	init_param_info(PARAM_SESSION_NUMBER,        "session_number",      "Session #",   PARAM_TYPE_HELP, -1,   0,   0,   0, 0,  0, 0, NULL, NULL, NULL);
 	init_param_info(PARAM_SESSION_NAME,          "session_name",        "Session Name",PARAM_TYPE_HELP, -1,   0,   0,   0, 0,  0, 0, NULL, NULL, NULL);
 	init_param_info(PARAM_PHASEX_HELP,           "using_phasex",        "Using PHASEX",PARAM_TYPE_HELP, -1,   0,   0,   0, 0,  0, 0, NULL, NULL, NULL);
+
+	/* Callbacks that touch every part are too heavy for MIDI updates in
+	   the engine thread.  These get a light callback for the engine
+	   thread, and the full callback runs in the control thread. */
+	cb_info[PARAM_BPM].update_patch_state_rt        = update_bpm_rt;
 }
@@ -249,6 +249,9 @@ typedef struct param_info {
 	int             cc_offset;      /* CC to int val offset             */
 	int             cc_default;     /* Default MIDI ctlr value          */
 	int             locked;         /* Allow only user-explicit updates */
+	int             cc_hires;       /* Pair cc_num with cc_num+32 LSB   */
+	int             nrpn_num;       /* MIDI NRPN number (-1 for none)   */
+	int             rpn_num;        /* MIDI RPN number (-1 for none)    */
 	int             prelight;       /* Prelight or hover state active   */
 	int             focused;        /* Currently focused or selected    */
 	int             sensitive;      /* Sensitivity state tracking       */
@@ -268,7 +271,7 @@ typedef struct param_info {
 	GtkWidget       *button_label[12]; /* For sensitivity management    */
 	GSList          *button_group;
 	const gchar     **list_labels;  /* List for list based parameters   */
-	char            _padding[16];
+	char            _padding[4];
 } PARAM_INFO;
 
 
@@ -276,7 +279,7 @@ typedef struct param_value {
 	int         cc_prev;    /* Previous MIDI ctlr value     */
 	int         cc_val;     /* Current MIDI ctlr value      */
 	int         int_val;    /* Current integer param value  */
-	int         _padding;
+	int         fine_val;   /* 14-bit value (cc_val << 7 | lsb) */
 } PARAM_VAL;
 
 
@@ -299,6 +302,9 @@ typedef void (*PARAM_CB)(PARAM *param);
 
 typedef struct param_cb_info {
 	PARAM_CB        update_patch_state; /* Callback for updating engine state   */
+	PARAM_CB        update_patch_state_rt; /* Engine thread subset of the above,
+	                                          or NULL if the full callback
+	                                          is realtime safe */
 	//PARSE_CB        parse;              /* Get cc_val from strval               */
 	//STRVAL_CB       get_strval;         /* Get parseable strval from param val  */
 } PARAM_CB_INFO;
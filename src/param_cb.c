@@ -33,16 +33,221 @@
 #include "param_parse.h"
 #include "bank.h"
 #include "bpm.h"
+#include "midimap.h"
 #include "debug.h"
 
 
+/*****************************************************************************
+ * set_smooth_target()
+ *
+ * Sets a target for the engine's parameter smoothing bank.  The engine
+ * ramps from its current value whenever it sees a new serial.
+ *****************************************************************************/
+static void
+set_smooth_target(PATCH_STATE *state, int slot, sample_t value)
+{
+	state->smooth_target[slot] = value;
+	g_atomic_int_inc(&state->smooth_serial);
+}
+
+/*****************************************************************************
+ * set_gain_targets()
+ *
+ * Combines patch volume and panning into left and right gain targets.
+ *****************************************************************************/
+static void
+set_gain_targets(PATCH_STATE *state)
+{
+	state->smooth_target[SMOOTH_GAIN_LEFT]  = state->volume * pan_table[127 - state->pan_cc];
+	state->smooth_target[SMOOTH_GAIN_RIGHT] = state->volume * pan_table[state->pan_cc];
+	g_atomic_int_inc(&state->smooth_serial);
+}
+
+/*****************************************************************************
+ * get_fine_fraction()
+ *
+ * Returns the fractional cc step from a param's 14-bit midi value, or 0.0
+ * when the cc value has since been set without one.
+ *****************************************************************************/
+static sample_t
+get_fine_fraction(PARAM *param)
+{
+	if ((param->value.fine_val >> 7) != param->value.cc_val) {
+		return 0.0;
+	}
+	return (sample_t)(param->value.fine_val & 0x7F) * 0.0078125;
+}
+
+/*****************************************************************************
+ * fine_table_lookup()
+ *
+ * Linear interpolation between adjacent entries of a 128 entry cc table.
+ *****************************************************************************/
+static sample_t
+fine_table_lookup(sample_t *table, int cc_val, sample_t frac)
+{
+	if ((cc_val >= 127) || (frac == 0.0)) {
+		return table[cc_val];
+	}
+	return table[cc_val] + ((table[cc_val + 1] - table[cc_val]) * frac);
+}
+
+/* Set while building the state of a patch that is not live yet.  The
+   callbacks then write this private state instead of the patch's own, and
+   leave the part, its voices, and its effects alone.  The engine thread
+   takes over the state and applies the rest in apply_patch_part_state(). */
+static __thread PATCH_STATE *state_only = NULL;
+
+/*****************************************************************************
+ * set_param_cb_state_only()
+ *
+ * Limits param callbacks run by the calling thread to building <state>, or
+ * returns them to normal operation when <state> is NULL.
+ *****************************************************************************/
+void
+set_param_cb_state_only(PATCH_STATE *state)
+{
+	state_only = state;
+}
+
+/*****************************************************************************
+ * get_cb_state()
+ *
+ * Returns the patch state a param callback writes to.
+ *****************************************************************************/
+static PATCH_STATE *
+get_cb_state(PARAM *param)
+{
+	return (state_only != NULL) ? state_only : param->patch->state;
+}
+
+/*****************************************************************************
+ * apply_need_portamento()
+ *****************************************************************************/
+static void
+apply_need_portamento(PATCH *patch)
+{
+	int             voice_num;
+
+	for (voice_num = 0; voice_num < setting_polyphony; voice_num++) {
+		get_voice(patch->part_num, voice_num)->need_portamento = 1;
+	}
+}
+
+/*****************************************************************************
+ * apply_filter_env_offset()
+ *****************************************************************************/
+static void
+apply_filter_env_offset(PATCH *patch)
+{
+	PATCH_STATE     *state  = patch->state;
+
+	get_part(patch->part_num)->filter_env_offset =
+		(state->filter_env_sign_cc == 0) ? state->filter_env_amount : 0.0;
+}
+
+/*****************************************************************************
+ * apply_osc_freq()
+ *****************************************************************************/
+static void
+apply_osc_freq(PATCH *patch, int osc)
+{
+	PATCH_STATE     *state  = patch->state;
+	int             voice_num;
+
+	if (state->osc_freq_base[osc] >= FREQ_BASE_TEMPO) {
+		for (voice_num = 0; voice_num < setting_polyphony; voice_num++) {
+			get_voice(patch->part_num, voice_num)->osc_freq[osc] =
+				global.bps * state->osc_rate[osc];
+		}
+	}
+}
+
+/*****************************************************************************
+ * apply_lfo_freq()
+ *****************************************************************************/
+static void
+apply_lfo_freq(PATCH *patch, int lfo)
+{
+	PATCH_STATE     *state  = patch->state;
+	PART            *part   = get_part(patch->part_num);
+
+	if (state->lfo_freq_base[lfo] >= FREQ_BASE_TEMPO) {
+		part->lfo_freq[lfo]   = global.bps * state->lfo_rate[lfo];
+		part->lfo_adjust[lfo] = part->lfo_freq[lfo] * wave_period;
+	}
+}
+
+/*****************************************************************************
+ * apply_patch_part_state()
+ *
+ * Brings the part, its voices, and its effects in line with a patch whose
+ * state was built with set_param_cb_state_only().  Called by the engine
+ * thread for the part at the frame where the patch becomes active.  Only
+ * params that differ from the outgoing patch <prev> (all of them, when NULL)
+ * have their callbacks run, as if they had been changed live, so voices
+ * keep sounding through the swap unless the new patch needs them reset.
+ * The new patch's tempo goes global here, as with a patch load.
+ *****************************************************************************/
+void
+apply_patch_part_state(PATCH *patch, PATCH *prev)
+{
+	PARAM           *param;
+	PARAM           *prev_param;
+	unsigned int    param_id;
+
+	if (patch->state->bpm != global.bpm) {
+		set_bpm(& (patch->param[PARAM_BPM]), 0.0);
+	}
+
+	for (param_id = 0; param_id < NUM_PARAMS; param_id++) {
+		if (param_id == PARAM_BPM) {
+			continue;
+		}
+		param = & (patch->param[param_id]);
+		if (prev != NULL) {
+			prev_param = & (prev->param[param_id]);
+			if ((param->value.cc_val == prev_param->value.cc_val) &&
+			    (param->value.fine_val == prev_param->value.fine_val)) {
+				continue;
+			}
+		}
+		cb_info[param_id].update_patch_state(param);
+	}
+
+	/* a keymode change resets the voices before any held events replay */
+	run_voice_reset(get_part(patch->part_num), patch->part_num);
+}
+
 /*****************************************************************************
  * update_bpm()
  *****************************************************************************/
 void
 update_bpm(PARAM *param)
 {
-	set_bpm(param, 0.0);
+	if (state_only != NULL) {
+		update_bpm_rt(param);
+	}
+	else {
+		set_bpm(param, 0.0);
+	}
+}
+
+/*****************************************************************************
+ * update_bpm_rt()
+ *
+ * Sets bpm for this part only.  The remainder of the bpm change, which
+ * updates every part, is left to update_bpm().
+ *****************************************************************************/
+void
+update_bpm_rt(PARAM *param)
+{
+	PATCH_STATE     *state  = get_cb_state(param);
+	int             cc_val  = param->value.cc_val;
+	int             int_val = param->value.int_val;
+
+	state->bpm_cc = cc_val & 0x7F;
+	state->bpm    = (sample_t) int_val;
 }
 
 /*****************************************************************************
@@ -51,10 +256,13 @@ update_bpm(PARAM *param)
 void
 update_midi_channel(PARAM *param)
 {
-	PART            *part   = param->patch->part;
+	PART            *part   = get_part(param->patch->part_num);
 	int             int_val = param->value.int_val;
 
-	part->midi_channel = int_val;
+	if (!state_only && (part->midi_channel != int_val)) {
+		part->midi_channel = int_val;
+		build_midi_route();
+	}
 }
 
 /*****************************************************************************
@@ -63,7 +271,7 @@ update_midi_channel(PARAM *param)
 void
 update_patch_tune(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 	int             int_val = param->value.int_val;
 
@@ -77,17 +285,18 @@ update_patch_tune(PARAM *param)
 void
 update_portamento(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
-	PART            *part   = param->patch->part;
+	PATCH_STATE     *state  = get_cb_state(param);
+	PART            *part   = get_part(param->patch->part_num);
 	int             cc_val  = param->value.cc_val;
-	VOICE           *voice;
 	int             voice_num;
 
-	state->portamento        = (short) cc_val;
-	part->portamento_samples = env_table[cc_val];
-	for (voice_num = 0; voice_num < setting_polyphony; voice_num++) {
-		voice = get_voice(param->patch->part_num, voice_num);
-		voice->portamento_samples = env_table[cc_val];
+	state->portamento = (short) cc_val;
+	if (!state_only) {
+		part->portamento_samples = env_table[state->portamento];
+		for (voice_num = 0; voice_num < setting_polyphony; voice_num++) {
+			get_voice(param->patch->part_num, voice_num)->portamento_samples =
+				env_table[state->portamento];
+		}
 	}
 }
 
@@ -97,19 +306,12 @@ update_portamento(PARAM *param)
 void
 update_keymode(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
-	VOICE           *voice;
-	int             voice_num;
 
 	state->keymode = (short) cc_val & 0x03;
-
-	/* deactivate voices */
-	for (voice_num = 0; voice_num < MAX_VOICES; voice_num++) {
-		voice = get_voice(param->patch->part_num, voice_num);
-		voice->active    = 0;
-		voice->allocated = 0;
-		voice->midi_key  = -1;
+	if (!state_only) {
+		request_voice_reset(param->patch->part_num);
 	}
 }
 
@@ -119,7 +321,7 @@ update_keymode(PARAM *param)
 void
 update_keyfollow_vol(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 
 	state->keyfollow_vol = (short) cc_val;
@@ -131,11 +333,12 @@ update_keyfollow_vol(PARAM *param)
 void
 update_volume(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 
 	state->volume_cc = (short) cc_val;
-	state->volume    = gain_table[cc_val];
+	state->volume    = fine_table_lookup(gain_table, cc_val, get_fine_fraction(param));
+	set_gain_targets(state);
 }
 
 /*****************************************************************************
@@ -144,17 +347,14 @@ update_volume(PARAM *param)
 void
 update_transpose(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 	int             int_val = param->value.int_val;
-	VOICE           *voice;
-	int             voice_num;
 
 	state->transpose_cc = (short) cc_val;
 	state->transpose    = (short) int_val;
-	for (voice_num = 0; voice_num < setting_polyphony; voice_num++) {
-		voice = get_voice(param->patch->part_num, voice_num);
-		voice->need_portamento = 1;
+	if (!state_only) {
+		apply_need_portamento(param->patch);
 	}
 }
 
@@ -164,12 +364,13 @@ update_transpose(PARAM *param)
 void
 update_input_boost(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 	int             int_val = param->value.int_val;
 
 	state->input_boost_cc = (short) cc_val;
 	state->input_boost    = 1.0 + (((sample_t) int_val) / 32.0);
+	set_smooth_target(state, SMOOTH_INPUT_BOOST, state->input_boost);
 }
 
 /*****************************************************************************
@@ -178,17 +379,18 @@ update_input_boost(PARAM *param)
 void
 update_input_follow(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
-	PART            *part   = param->patch->part;
+	PATCH_STATE     *state  = get_cb_state(param);
+	PART            *part   = get_part(param->patch->part_num);
 	int             cc_val  = param->value.cc_val;
 
 	state->input_follow = (short) cc_val & 0x01;
-
-	part->input_env_raw = 0.0;
-	part->in1  = 0.0;
-	part->in2  = 0.0;
-	part->out1 = 0.0;
-	part->out2 = 0.0;
+	if (!state_only) {
+		part->input_env_raw = 0.0;
+		part->in1  = 0.0;
+		part->in2  = 0.0;
+		part->out1 = 0.0;
+		part->out2 = 0.0;
+	}
 }
 
 /*****************************************************************************
@@ -197,10 +399,11 @@ update_input_follow(PARAM *param)
 void
 update_pan(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 
 	state->pan_cc = (short) cc_val;
+	set_gain_targets(state);
 }
 
 /*****************************************************************************
@@ -209,12 +412,13 @@ update_pan(PARAM *param)
 void
 update_stereo_width(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 	int             int_val = param->value.int_val;
 
 	state->stereo_width_cc = (short) cc_val;
-	state->stereo_width    = ((sample_t)(int_val) / 254.0) + 0.5;
+	state->stereo_width    = (((sample_t)(int_val) + get_fine_fraction(param)) / 254.0) + 0.5;
+	set_smooth_target(state, SMOOTH_STEREO_WIDTH, state->stereo_width);
 }
 
 /*****************************************************************************
@@ -223,7 +427,7 @@ update_stereo_width(PARAM *param)
 void
 update_amp_velocity(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 	int             int_val = param->value.int_val;
 
@@ -237,13 +441,14 @@ update_amp_velocity(PARAM *param)
 void
 update_filter_cutoff(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
-	PART            *part   = param->patch->part;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
-	int             int_val = param->value.int_val;
 
-	state->filter_cutoff_cc    = (short) cc_val;
-	part->filter_cutoff_target = (sample_t) int_val;
+	state->filter_cutoff_cc = (short) cc_val;
+	if (!state_only) {
+		get_part(param->patch->part_num)->filter_cutoff_target =
+			(sample_t) param->value.int_val + get_fine_fraction(param);
+	}
 }
 
 /*****************************************************************************
@@ -252,7 +457,7 @@ update_filter_cutoff(PARAM *param)
 void
 update_filter_resonance(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 	int             int_val = param->value.int_val;
 
@@ -266,13 +471,15 @@ update_filter_resonance(PARAM *param)
 void
 update_filter_smoothing(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
-	PART            *part   = param->patch->part;
+	PATCH_STATE     *state  = get_cb_state(param);
+	PART            *part   = get_part(param->patch->part_num);
 	int             cc_val  = param->value.cc_val;
 
-	state->filter_smoothing    = (short) cc_val;
-	part->filter_smooth_len    = ((sample_t)(cc_val + 1)) * 160.0;
-	part->filter_smooth_factor = 1.0 / (part->filter_smooth_len + 1.0);
+	state->filter_smoothing = (short) cc_val;
+	if (!state_only) {
+		part->filter_smooth_len    = ((sample_t)(state->filter_smoothing + 1)) * 160.0;
+		part->filter_smooth_factor = 1.0 / (part->filter_smooth_len + 1.0);
+	}
 }
 
 /*****************************************************************************
@@ -281,7 +488,7 @@ update_filter_smoothing(PARAM *param)
 void
 update_filter_keyfollow(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 
 	state->filter_keyfollow = (short) cc_val % 5;
@@ -293,7 +500,7 @@ update_filter_keyfollow(PARAM *param)
 void
 update_filter_mode(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 
 	state->filter_mode = (short) cc_val % 9;
@@ -305,14 +512,14 @@ update_filter_mode(PARAM *param)
 void
 update_filter_type(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	VOICE           *voice;
 	int             cc_val  = param->value.cc_val;
 	int             voice_num;
 
 	state->filter_type = (short) cc_val % 6;
 
-	for (voice_num = 0; voice_num < setting_polyphony; voice_num++) {
+	for (voice_num = 0; !state_only && (voice_num < setting_polyphony); voice_num++) {
 		voice = get_voice(param->patch->part_num, voice_num);
 
 		voice->filter_hp1     = voice->filter_hp2     = 0.0;
@@ -337,7 +544,7 @@ update_filter_type(PARAM *param)
 void
 update_filter_gain(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 
 	state->filter_gain_cc = (short) cc_val;
@@ -350,15 +557,15 @@ update_filter_gain(PARAM *param)
 void
 update_filter_env_amount(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
-	PART            *part   = param->patch->part;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 	int             int_val = param->value.int_val;
 
 	state->filter_env_amount_cc = (short) cc_val;
 	state->filter_env_amount    = ((sample_t) int_val) * state->filter_env_sign;
-
-	part->filter_env_offset = (state->filter_env_sign_cc == 0) ? state->filter_env_amount : 0.0;
+	if (!state_only) {
+		apply_filter_env_offset(param->patch);
+	}
 }
 
 /*****************************************************************************
@@ -367,15 +574,15 @@ update_filter_env_amount(PARAM *param)
 void
 update_filter_env_sign(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
-	PART            *part   = param->patch->part;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 
 	state->filter_env_sign_cc = (short) cc_val;
 	state->filter_env_sign    = (((sample_t) cc_val) * 2.0) - 1.0;
 	state->filter_env_amount  = ((sample_t) state->filter_env_amount_cc) * state->filter_env_sign;
-
-	part->filter_env_offset = (state->filter_env_sign_cc == 0) ? state->filter_env_amount : 0.0;
+	if (!state_only) {
+		apply_filter_env_offset(param->patch);
+	}
 }
 
 /*****************************************************************************
@@ -384,7 +591,7 @@ update_filter_env_sign(PARAM *param)
 void
 update_filter_attack(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 
 	state->filter_attack = (short) cc_val;
@@ -396,7 +603,7 @@ update_filter_attack(PARAM *param)
 void
 update_filter_decay(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 
 	state->filter_decay = (short) cc_val;
@@ -408,7 +615,7 @@ update_filter_decay(PARAM *param)
 void
 update_filter_sustain(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 	int             int_val = param->value.int_val;
 	VOICE           *voice;
@@ -416,7 +623,7 @@ update_filter_sustain(PARAM *param)
 
 	state->filter_sustain_cc   = (short) cc_val;
 	state->filter_sustain      = ((sample_t) int_val) / 127.0;
-	for (voice_num = 0; voice_num < setting_polyphony; voice_num++) {
+	for (voice_num = 0; !state_only && (voice_num < setting_polyphony); voice_num++) {
 		voice = get_voice(param->patch->part_num, voice_num);
 		if (voice->cur_filter_interval == ENV_INTERVAL_SUSTAIN) {
 			voice->filter_env_raw = state->filter_sustain;
@@ -430,7 +637,7 @@ update_filter_sustain(PARAM *param)
 void
 update_filter_release(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 
 	state->filter_release = (short) cc_val;
@@ -442,7 +649,7 @@ update_filter_release(PARAM *param)
 void
 update_filter_lfo(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 
 	state->filter_lfo_cc = (short) cc_val;
@@ -455,7 +662,7 @@ update_filter_lfo(PARAM *param)
 void
 update_filter_lfo_cutoff(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 	int             int_val = param->value.int_val;
 
@@ -469,7 +676,7 @@ update_filter_lfo_cutoff(PARAM *param)
 void
 update_filter_lfo_resonance(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 	int             int_val = param->value.int_val;
 
@@ -483,7 +690,7 @@ update_filter_lfo_resonance(PARAM *param)
 void
 update_amp_attack(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 
 	state->amp_attack = (short) cc_val;
@@ -495,7 +702,7 @@ update_amp_attack(PARAM *param)
 void
 update_amp_decay(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 
 	state->amp_decay = (short) cc_val;
@@ -507,7 +714,7 @@ update_amp_decay(PARAM *param)
 void
 update_amp_sustain(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 	int             int_val = param->value.int_val;
 	VOICE           *voice;
@@ -515,7 +722,7 @@ update_amp_sustain(PARAM *param)
 
 	state->amp_sustain_cc   = (short) cc_val;
 	state->amp_sustain      = ((sample_t) int_val) / 127.0;
-	for (voice_num = 0; voice_num < setting_polyphony; voice_num++) {
+	for (voice_num = 0; !state_only && (voice_num < setting_polyphony); voice_num++) {
 		voice = get_voice(param->patch->part_num, voice_num);
 		if (voice->cur_amp_interval == ENV_INTERVAL_SUSTAIN) {
 			voice->amp_env_raw = state->amp_sustain;
@@ -529,7 +736,7 @@ update_amp_sustain(PARAM *param)
 void
 update_amp_release(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 
 	state->amp_release = (short) cc_val;
@@ -541,16 +748,13 @@ update_amp_release(PARAM *param)
 void
 update_delay_mix(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
-	DELAY           *delay  = get_delay(param->patch->part_num);
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 
 	state->delay_mix_cc = (short) cc_val;
 	state->delay_mix    = mix_table[cc_val];
-
-	if (cc_val == 0) {
-		memset((void *)(delay->buf), 0, DELAY_MAX * 2 * sizeof(sample_t));
-	}
+	state->smooth_target[SMOOTH_DELAY_DRY] = mix_table[127 - cc_val];
+	set_smooth_target(state, SMOOTH_DELAY_WET, state->delay_mix);
 }
 
 /*****************************************************************************
@@ -559,7 +763,7 @@ update_delay_mix(PARAM *param)
 void
 update_delay_feed(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 
 	state->delay_feed_cc = (short) cc_val;
@@ -572,7 +776,7 @@ update_delay_feed(PARAM *param)
 void
 update_delay_crossover(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 
 	state->delay_crossover = (short) cc_val & 0x01;
@@ -584,15 +788,17 @@ update_delay_crossover(PARAM *param)
 void
 update_delay_time(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
-	int             cc_val  = param->value.cc_val;
+	PATCH_STATE     *state  = get_cb_state(param);
 	DELAY           *delay  = get_delay(param->patch->part_num);
+	int             cc_val  = param->value.cc_val;
 
 	state->delay_time_cc = (short) cc_val;
 	state->delay_time    = 1.0 / get_rate_val(cc_val);
-	delay->size          = state->delay_time * f_sample_rate / global.bps;
-	delay->half_size     = state->delay_time * f_sample_rate * 0.5 / global.bps;
-	delay->length        = (int)(delay->size);
+	if (!state_only) {
+		delay->size      = state->delay_time * f_sample_rate / global.bps;
+		delay->half_size = state->delay_time * f_sample_rate * 0.5 / global.bps;
+		delay->length    = (int)(delay->size);
+	}
 }
 
 /*****************************************************************************
@@ -601,7 +807,7 @@ update_delay_time(PARAM *param)
 void
 update_delay_lfo(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 
 	state->delay_lfo_cc = (short) cc_val;
@@ -614,21 +820,13 @@ update_delay_lfo(PARAM *param)
 void
 update_chorus_mix(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
-	CHORUS          *chorus = get_chorus(param->patch->part_num);
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 
 	state->chorus_mix_cc = (short) cc_val;
 	state->chorus_mix    = mix_table[cc_val];
-
-	if (cc_val == 0) {
-#ifdef INTERPOLATE_CHORUS
-		memset((void *)(chorus->buf_1), 0, CHORUS_MAX     * sizeof(sample_t));
-		memset((void *)(chorus->buf_2), 0, CHORUS_MAX     * sizeof(sample_t));
-#else
-		memset((void *)(chorus->buf),   0, CHORUS_MAX * 2 * sizeof(sample_t));
-#endif
-	}
+	state->smooth_target[SMOOTH_CHORUS_DRY] = mix_table[127 - cc_val];
+	set_smooth_target(state, SMOOTH_CHORUS_WET, state->chorus_mix);
 }
 
 /*****************************************************************************
@@ -637,7 +835,7 @@ update_chorus_mix(PARAM *param)
 void
 update_chorus_feed(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 
 	state->chorus_feed_cc = (short) cc_val;
@@ -650,7 +848,7 @@ update_chorus_feed(PARAM *param)
 void
 update_chorus_crossover(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 
 	state->chorus_crossover = (short) cc_val & 0x01;
@@ -662,21 +860,23 @@ update_chorus_crossover(PARAM *param)
 void
 update_chorus_time(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
+	CHORUS          *chorus = get_chorus(param->patch->part_num);
 	int             cc_val  = param->value.cc_val;
 	int             int_val = param->value.int_val;
-	CHORUS          *chorus = get_chorus(param->patch->part_num);
 
 	state->chorus_time_cc = (short) cc_val;
 	state->chorus_time    = f_sample_rate / freq_table[state->patch_tune_cc][407 - int_val];
-	chorus->length        = (int)(state->chorus_time) + 1;
-	if (chorus->length == 0) {
-		chorus->length++;
+	if (!state_only) {
+		chorus->length      = (int)(state->chorus_time) + 1;
+		if (chorus->length == 0) {
+			chorus->length++;
+		}
+		chorus->size        = state->chorus_time;
+		chorus->half_size   = state->chorus_time * 0.5;
+		chorus->delay_index = (chorus->write_index + chorus->bufsize -
+		                       chorus->length - 1) & chorus->bufsize_mask;
 	}
-	chorus->size        = state->chorus_time;
-	chorus->half_size   = state->chorus_time * 0.5;
-	chorus->delay_index = (chorus->write_index + chorus->bufsize -
-	                       chorus->length - 1) & chorus->bufsize_mask;
 }
 
 /*****************************************************************************
@@ -685,7 +885,7 @@ update_chorus_time(PARAM *param)
 void
 update_chorus_amount(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 	int             int_val = param->value.int_val;
 
@@ -699,14 +899,16 @@ update_chorus_amount(PARAM *param)
 void
 update_chorus_phase_rate(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 	CHORUS          *chorus = get_chorus(param->patch->part_num);
 
 	state->chorus_phase_rate_cc = (short) cc_val;
 	state->chorus_phase_rate    = get_rate_val(cc_val);
-	chorus->phase_freq          = global.bps * state->chorus_phase_rate;
-	chorus->phase_adjust        = chorus->phase_freq * wave_period;
+	if (!state_only) {
+		chorus->phase_freq   = global.bps * state->chorus_phase_rate;
+		chorus->phase_adjust = chorus->phase_freq * wave_period;
+	}
 }
 
 /*****************************************************************************
@@ -715,7 +917,7 @@ update_chorus_phase_rate(PARAM *param)
 void
 update_chorus_phase_balance(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 	int             int_val = param->value.int_val;
 
@@ -729,7 +931,7 @@ update_chorus_phase_balance(PARAM *param)
 void
 update_chorus_lfo_wave(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 
 	state->chorus_lfo_wave = (short) cc_val % NUM_WAVEFORMS;
@@ -741,14 +943,16 @@ update_chorus_lfo_wave(PARAM *param)
 void
 update_chorus_lfo_rate(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 	CHORUS          *chorus = get_chorus(param->patch->part_num);
 
 	state->chorus_lfo_rate_cc = (short) cc_val;
 	state->chorus_lfo_rate    = get_rate_val(cc_val);
-	chorus->lfo_freq          = global.bps * state->chorus_lfo_rate;
-	chorus->lfo_adjust        = chorus->lfo_freq * wave_period;
+	if (!state_only) {
+		chorus->lfo_freq   = global.bps * state->chorus_lfo_rate;
+		chorus->lfo_adjust = chorus->lfo_freq * wave_period;
+	}
 }
 
 /*****************************************************************************
@@ -757,13 +961,13 @@ update_chorus_lfo_rate(PARAM *param)
 void
 update_osc_modulation(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
-	int             cc_val  = param->value.cc_val;
+	PATCH_STATE     *state  = get_cb_state(param);
 	VOICE           *voice;
+	int             cc_val  = param->value.cc_val;
 	int             voice_num;
 
 	state->osc_modulation[param->info->index] = (short) cc_val & 0x03;
-	if (cc_val == MOD_TYPE_OFF) {
+	if (!state_only && (state->osc_modulation[param->info->index] == MOD_TYPE_OFF)) {
 		for (voice_num = 0; voice_num < MAX_VOICES; voice_num++) {
 			voice = get_voice(param->patch->part_num, voice_num);
 			voice->osc_out1[param->info->index] = 0.0;
@@ -778,7 +982,7 @@ update_osc_modulation(PARAM *param)
 void
 update_osc_wave(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 
 	state->osc_wave[param->info->index] = (short) cc_val % NUM_WAVEFORMS;
@@ -790,18 +994,12 @@ update_osc_wave(PARAM *param)
 void
 update_osc_freq_base(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
-	VOICE           *voice;
-	int             voice_num;
 
 	state->osc_freq_base[param->info->index] = (short) cc_val;
-
-	if (state->osc_freq_base[param->info->index] >= FREQ_BASE_TEMPO) {
-		for (voice_num = 0; voice_num < setting_polyphony; voice_num++) {
-			voice = get_voice(param->patch->part_num, voice_num);
-			voice->osc_freq[param->info->index] = global.bps * state->osc_rate[param->info->index];
-		}
+	if (!state_only) {
+		apply_osc_freq(param->patch, param->info->index);
 	}
 }
 
@@ -811,17 +1009,14 @@ update_osc_freq_base(PARAM *param)
 void
 update_osc_rate(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
-	VOICE           *voice;
-	int             voice_num;
 
 	state->osc_rate_cc[param->info->index] = (short) cc_val;
 	if (state->osc_freq_base[param->info->index] >= FREQ_BASE_TEMPO) {
 		state->osc_rate[param->info->index] = get_rate_val(cc_val);
-		for (voice_num = 0; voice_num < setting_polyphony; voice_num++) {
-			voice = get_voice(param->patch->part_num, voice_num);
-			voice->osc_freq[param->info->index] = global.bps * state->osc_rate[param->info->index];
+		if (!state_only) {
+			apply_osc_freq(param->patch, param->info->index);
 		}
 	}
 }
@@ -832,7 +1027,7 @@ update_osc_rate(PARAM *param)
 void
 update_osc_polarity(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 
 	state->osc_polarity_cc[param->info->index] = (short) cc_val & 0x01;
@@ -844,15 +1039,16 @@ update_osc_polarity(PARAM *param)
 void
 update_osc_init_phase(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
-	PART            *part   = param->patch->part;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 	int             int_val = param->value.int_val;
 
 	state->osc_init_phase_cc[param->info->index] = (short) cc_val;
 	state->osc_init_phase[param->info->index]    = ((sample_t) int_val) / 128.0;
-	part->osc_init_index[param->info->index]     =
-		state->osc_init_phase[param->info->index] * F_WAVEFORM_SIZE;
+	if (!state_only) {
+		get_part(param->patch->part_num)->osc_init_index[param->info->index] =
+			state->osc_init_phase[param->info->index] * F_WAVEFORM_SIZE;
+	}
 }
 
 /*****************************************************************************
@@ -861,7 +1057,7 @@ update_osc_init_phase(PARAM *param)
 void
 update_osc_transpose(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 	VOICE           *voice;
 	int             voice_num;
@@ -870,7 +1066,7 @@ update_osc_transpose(PARAM *param)
 	state->osc_transpose_cc[param->info->index] = (short) cc_val;
 	state->osc_transpose[param->info->index]    =
 		(1.0 / 120.0) * ((sample_t) state->osc_fine_tune[param->info->index]);
-	for (voice_num = 0; voice_num < setting_polyphony; voice_num++) {
+	for (voice_num = 0; !state_only && (voice_num < setting_polyphony); voice_num++) {
 		voice = get_voice(param->patch->part_num, voice_num);
 		voice->need_portamento = 1;
 		if ((state->portamento > 0) && (voice->active)) {
@@ -896,18 +1092,15 @@ update_osc_transpose(PARAM *param)
 void
 update_osc_fine_tune(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 	int             int_val = param->value.int_val;
-	VOICE           *voice;
-	int             voice_num;
 
 	state->osc_fine_tune_cc[param->info->index] = (short) cc_val;
 	state->osc_fine_tune[param->info->index]    = (sample_t) int_val;
 	state->osc_transpose[param->info->index]    = (1.0 / 120.0) * ((sample_t) int_val);
-	for (voice_num = 0; voice_num < setting_polyphony; voice_num++) {
-		voice = get_voice(param->patch->part_num, voice_num);
-		voice->need_portamento = 1;
+	if (!state_only) {
+		apply_need_portamento(param->patch);
 	}
 }
 
@@ -917,7 +1110,7 @@ update_osc_fine_tune(PARAM *param)
 void
 update_osc_pitchbend(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 	int             int_val = param->value.int_val;
 
@@ -931,31 +1124,43 @@ update_osc_pitchbend(PARAM *param)
 void
 update_osc_am_lfo(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
-	PART            *part   = param->patch->part;
+	PATCH_STATE     *state  = get_cb_state(param);
+	PART            *part;
 	short           cc_val  = (short) param->value.cc_val;
 
 	if ((cc_val <= 0) || (cc_val > (NUM_LFOS + NUM_OSCS + 1))) {
 		state->am_lfo_cc[param->info->index] = 0;
 		state->am_lfo[param->info->index]    = LFO_OFF;
-		part->osc_am_mod[param->info->index] = MOD_OFF;
 	}
 	else {
 		state->am_lfo_cc[param->info->index] = cc_val;
 		if (cc_val <= NUM_OSCS) {
 			state->am_mod_type[param->info->index] = MOD_TYPE_OSC;
 			state->am_lfo[param->info->index]      = LFO_OFF;
-			part->osc_am_mod[param->info->index]   = (short)(cc_val - 1);
 		}
 		else if (cc_val <= (NUM_LFOS + NUM_OSCS)) {
 			state->am_mod_type[param->info->index] = MOD_TYPE_LFO;
 			state->am_lfo[param->info->index]      = (short)(cc_val - NUM_OSCS - 1);
-			part->osc_am_mod[param->info->index]   = MOD_OFF;
 		}
 		else if (cc_val == NUM_LFOS + NUM_OSCS + 1) {
 			state->am_mod_type[param->info->index] = MOD_TYPE_VELOCITY;
 			state->am_lfo[param->info->index]      = LFO_OFF;
-			part->osc_am_mod[param->info->index]   = MOD_VELOCITY;
+		}
+	}
+	if (!state_only) {
+		part = get_part(param->patch->part_num);
+		cc_val = state->am_lfo_cc[param->info->index];
+		if (cc_val <= 0) {
+			part->osc_am_mod[param->info->index] = MOD_OFF;
+		}
+		else if (cc_val <= NUM_OSCS) {
+			part->osc_am_mod[param->info->index] = (short)(cc_val - 1);
+		}
+		else if (cc_val <= (NUM_LFOS + NUM_OSCS)) {
+			part->osc_am_mod[param->info->index] = MOD_OFF;
+		}
+		else {
+			part->osc_am_mod[param->info->index] = MOD_VELOCITY;
 		}
 	}
 }
@@ -966,12 +1171,14 @@ update_osc_am_lfo(PARAM *param)
 void
 update_osc_am_lfo_amount(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 	int             int_val = param->value.int_val;
 
 	state->am_lfo_amount_cc[param->info->index] = (short) cc_val;
 	state->am_lfo_amount[param->info->index]    = ((sample_t) int_val) / 64.0;
+	set_smooth_target(state, (SMOOTH_OSC_AM_LFO + param->info->index),
+	                  state->am_lfo_amount[param->info->index]);
 }
 
 /*****************************************************************************
@@ -980,37 +1187,51 @@ update_osc_am_lfo_amount(PARAM *param)
 void
 update_osc_freq_lfo(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
-	PART            *part   = param->patch->part;
-	short   cc_val  = (short) param->value.cc_val;
+	PATCH_STATE     *state  = get_cb_state(param);
+	PART            *part;
+	short           cc_val  = (short) param->value.cc_val;
 
 	if ((cc_val <= 0) || (cc_val > (NUM_LFOS + (NUM_OSCS * 2) + 1))) {
 		state->freq_mod_type[param->info->index] = MOD_TYPE_OFF;
 		state->freq_lfo_cc[param->info->index]   = 0;
 		state->freq_lfo[param->info->index]      = LFO_OFF;
-		part->osc_freq_mod[param->info->index]   = MOD_OFF;
 	}
 	else {
 		state->freq_lfo_cc[param->info->index] = cc_val;
 		if (cc_val <= NUM_OSCS) {
 			state->freq_mod_type[param->info->index] = MOD_TYPE_OSC;
 			state->freq_lfo[param->info->index]      = LFO_OFF;
-			part->osc_freq_mod[param->info->index]   = (short)(cc_val - 1);
 		}
 		else if (cc_val <= (NUM_OSCS * 2)) {
 			state->freq_mod_type[param->info->index] = MOD_TYPE_OSC_LATCH;
 			state->freq_lfo[param->info->index]      = LFO_OFF;
-			part->osc_freq_mod[param->info->index]   = (short)(cc_val - NUM_OSCS - 1);
 		}
 		else if (cc_val <= (NUM_LFOS + (NUM_OSCS * 2))) {
-			part->osc_freq_mod[param->info->index]   = MOD_OFF;
 			state->freq_mod_type[param->info->index] = MOD_TYPE_LFO;
 			state->freq_lfo[param->info->index]      = (short)(cc_val - (NUM_OSCS * 2) - 1);
 		}
 		else if (cc_val == (NUM_LFOS + (NUM_OSCS * 2) + 1)) {
 			state->freq_mod_type[param->info->index] = MOD_TYPE_VELOCITY;
 			state->freq_lfo[param->info->index]      = LFO_OFF;
-			part->osc_freq_mod[param->info->index]   = MOD_VELOCITY;
+		}
+	}
+	if (!state_only) {
+		part = get_part(param->patch->part_num);
+		cc_val = state->freq_lfo_cc[param->info->index];
+		if (cc_val <= 0) {
+			part->osc_freq_mod[param->info->index] = MOD_OFF;
+		}
+		else if (cc_val <= NUM_OSCS) {
+			part->osc_freq_mod[param->info->index] = (short)(cc_val - 1);
+		}
+		else if (cc_val <= (NUM_OSCS * 2)) {
+			part->osc_freq_mod[param->info->index] = (short)(cc_val - NUM_OSCS - 1);
+		}
+		else if (cc_val <= (NUM_LFOS + (NUM_OSCS * 2))) {
+			part->osc_freq_mod[param->info->index] = MOD_OFF;
+		}
+		else {
+			part->osc_freq_mod[param->info->index] = MOD_VELOCITY;
 		}
 	}
 }
@@ -1021,7 +1242,7 @@ update_osc_freq_lfo(PARAM *param)
 void
 update_osc_freq_lfo_amount(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 	int             int_val = param->value.int_val;
 
@@ -1029,6 +1250,8 @@ update_osc_freq_lfo_amount(PARAM *param)
 	state->freq_lfo_amount[param->info->index]    =
 		(((sample_t) int_val)) +
 		((sample_t)(state->freq_lfo_fine[param->info->index]) * (1.0 / 120.0));
+	set_smooth_target(state, (SMOOTH_OSC_FREQ_LFO + param->info->index),
+	                  state->freq_lfo_amount[param->info->index]);
 }
 
 /*****************************************************************************
@@ -1037,7 +1260,7 @@ update_osc_freq_lfo_amount(PARAM *param)
 void
 update_osc_freq_lfo_fine(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 	int             int_val = param->value.int_val;
 
@@ -1046,6 +1269,8 @@ update_osc_freq_lfo_fine(PARAM *param)
 	state->freq_lfo_amount[param->info->index]  =
 		((sample_t)(state->freq_lfo_amount_cc[param->info->index] - 64)) +
 		(((sample_t) int_val) * (1.0 / 120.0));
+	set_smooth_target(state, (SMOOTH_OSC_FREQ_LFO + param->info->index),
+	                  state->freq_lfo_amount[param->info->index]);
 }
 
 /*****************************************************************************
@@ -1054,32 +1279,44 @@ update_osc_freq_lfo_fine(PARAM *param)
 void
 update_osc_phase_lfo(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
-	PART            *part   = param->patch->part;
+	PATCH_STATE     *state  = get_cb_state(param);
+	PART            *part;
 	short           cc_val  = (short) param->value.cc_val;
 
 	if ((cc_val <= 0) || (cc_val > (NUM_LFOS + NUM_OSCS + 1))) {
 		state->phase_mod_type[param->info->index] = MOD_TYPE_OFF;
 		state->phase_lfo_cc[param->info->index]   = 0;
 		state->phase_lfo[param->info->index]      = LFO_OFF;
-		part->osc_phase_mod[param->info->index]   = MOD_OFF;
 	}
 	else {
 		state->phase_lfo_cc[param->info->index] = cc_val;
 		if (cc_val <= NUM_OSCS) {
 			state->phase_mod_type[param->info->index] = MOD_TYPE_OSC;
 			state->phase_lfo[param->info->index]      = LFO_OFF;
-			part->osc_phase_mod[param->info->index]   = (short)(cc_val - 1);
 		}
 		else if (cc_val <= (NUM_LFOS + NUM_OSCS)) {
 			state->phase_mod_type[param->info->index] = MOD_TYPE_LFO;
 			state->phase_lfo[param->info->index]      = (short)(cc_val - NUM_OSCS - 1);
-			part->osc_phase_mod[param->info->index]   = MOD_OFF;
 		}
 		else if (cc_val == (NUM_LFOS + NUM_OSCS + 1)) {
 			state->phase_mod_type[param->info->index] = MOD_TYPE_VELOCITY;
 			state->phase_lfo[param->info->index]      = LFO_OFF;
-			part->osc_phase_mod[param->info->index]   = MOD_VELOCITY;
+		}
+	}
+	if (!state_only) {
+		part = get_part(param->patch->part_num);
+		cc_val = state->phase_lfo_cc[param->info->index];
+		if (cc_val <= 0) {
+			part->osc_phase_mod[param->info->index] = MOD_OFF;
+		}
+		else if (cc_val <= NUM_OSCS) {
+			part->osc_phase_mod[param->info->index] = (short)(cc_val - 1);
+		}
+		else if (cc_val <= (NUM_LFOS + NUM_OSCS)) {
+			part->osc_phase_mod[param->info->index] = MOD_OFF;
+		}
+		else {
+			part->osc_phase_mod[param->info->index] = MOD_VELOCITY;
 		}
 	}
 }
@@ -1090,12 +1327,14 @@ update_osc_phase_lfo(PARAM *param)
 void
 update_osc_phase_lfo_amount(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 	int             int_val = param->value.int_val;
 
 	state->phase_lfo_amount_cc[param->info->index] = (short) cc_val;
 	state->phase_lfo_amount[param->info->index]    = ((sample_t) int_val) / 120.0;
+	set_smooth_target(state, (SMOOTH_OSC_PHASE_LFO + param->info->index),
+	                  state->phase_lfo_amount[param->info->index]);
 }
 
 /*****************************************************************************
@@ -1104,7 +1343,7 @@ update_osc_phase_lfo_amount(PARAM *param)
 void
 update_osc_wave_lfo(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 
 	state->wave_lfo_cc[param->info->index] = (short) cc_val;
@@ -1117,7 +1356,7 @@ update_osc_wave_lfo(PARAM *param)
 void
 update_osc_wave_lfo_amount(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 	int             int_val = param->value.int_val;
 
@@ -1131,7 +1370,7 @@ update_osc_wave_lfo_amount(PARAM *param)
 void
 update_lfo_wave(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 
 	state->lfo_wave[param->info->index] = (short) cc_val % NUM_WAVEFORMS;
@@ -1143,16 +1382,12 @@ update_lfo_wave(PARAM *param)
 void
 update_lfo_freq_base(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
-	PART            *part   = param->patch->part;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 
 	state->lfo_freq_base[param->info->index] = (short) cc_val;
-	if (state->lfo_freq_base[param->info->index] >= FREQ_BASE_TEMPO) {
-		part->lfo_freq[param->info->index]   =
-			global.bps * state->lfo_rate[param->info->index];
-		part->lfo_adjust[param->info->index] =
-			part->lfo_freq[param->info->index] * wave_period;
+	if (!state_only) {
+		apply_lfo_freq(param->patch, param->info->index);
 	}
 }
 
@@ -1162,17 +1397,15 @@ update_lfo_freq_base(PARAM *param)
 void
 update_lfo_rate(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
-	PART            *part   = param->patch->part;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 
 	state->lfo_rate_cc[param->info->index] = (short) cc_val;
 	if (state->lfo_freq_base[param->info->index] >= FREQ_BASE_TEMPO) {
-		state->lfo_rate[param->info->index]  = get_rate_val(cc_val);
-		part->lfo_freq[param->info->index]   =
-			global.bps * state->lfo_rate[param->info->index];
-		part->lfo_adjust[param->info->index] =
-			part->lfo_freq[param->info->index] * wave_period;
+		state->lfo_rate[param->info->index] = get_rate_val(cc_val);
+		if (!state_only) {
+			apply_lfo_freq(param->patch, param->info->index);
+		}
 	}
 }
 
@@ -1182,7 +1415,7 @@ update_lfo_rate(PARAM *param)
 void
 update_lfo_polarity(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 
 	state->lfo_polarity_cc[param->info->index] = (short) cc_val & 0x01;
@@ -1194,15 +1427,16 @@ update_lfo_polarity(PARAM *param)
 void
 update_lfo_init_phase(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
-	PART            *part   = param->patch->part;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 	int             int_val = param->value.int_val;
 
 	state->lfo_init_phase_cc[param->info->index] = (short) cc_val;
 	state->lfo_init_phase[param->info->index]    = ((sample_t) int_val) / 128.0;
-	part->lfo_init_index[param->info->index]     =
-		state->lfo_init_phase[param->info->index] * F_WAVEFORM_SIZE;
+	if (!state_only) {
+		get_part(param->patch->part_num)->lfo_init_index[param->info->index] =
+			state->lfo_init_phase[param->info->index] * F_WAVEFORM_SIZE;
+	}
 }
 
 /*****************************************************************************
@@ -1211,17 +1445,14 @@ update_lfo_init_phase(PARAM *param)
 void
 update_lfo_transpose(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 	int             int_val = param->value.int_val;
-	VOICE           *voice;
-	int             voice_num;
 
 	state->lfo_transpose_cc[param->info->index] = (short) cc_val;
 	state->lfo_transpose[param->info->index]    = (short) int_val;
-	for (voice_num = 0; voice_num < setting_polyphony; voice_num++) {
-		voice = get_voice(param->patch->part_num, voice_num);
-		voice->need_portamento = 1;
+	if (!state_only) {
+		apply_need_portamento(param->patch);
 	}
 }
 
@@ -1231,7 +1462,7 @@ update_lfo_transpose(PARAM *param)
 void
 update_lfo_pitchbend(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 	int             int_val = param->value.int_val;
 
@@ -1245,12 +1476,13 @@ update_lfo_pitchbend(PARAM *param)
 void
 update_lfo_voice_am(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 	int             int_val = param->value.int_val;
 
 	state->lfo_1_voice_am_cc = (short) cc_val;
 	state->lfo_1_voice_am    = ((sample_t) int_val) * 0.015625;
+	set_smooth_target(state, SMOOTH_LFO_VOICE_AM, state->lfo_1_voice_am);
 }
 
 /*****************************************************************************
@@ -1259,20 +1491,19 @@ update_lfo_voice_am(PARAM *param)
 void
 update_lfo_lfo_rate(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
-	PART            *part   = param->patch->part;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 	int             int_val = param->value.int_val;
 
 	if (param->info->index == 1) {
-		state->lfo_2_lfo_1_fm_cc  = (short) cc_val;
-		state->lfo_2_lfo_1_fm     = (sample_t) int_val;
-		part->lfo_freq_lfo_mod[0] = state->lfo_2_lfo_1_fm;
+		state->lfo_2_lfo_1_fm_cc = (short) cc_val;
+		state->lfo_2_lfo_1_fm    = (sample_t) int_val;
+		set_smooth_target(state, (SMOOTH_LFO_FM + 0), state->lfo_2_lfo_1_fm);
 	}
 	else if (param->info->index == 3) {
-		state->lfo_4_lfo_3_fm_cc  = (short) cc_val;
-		state->lfo_4_lfo_3_fm     = (sample_t) int_val;
-		part->lfo_freq_lfo_mod[2] = state->lfo_4_lfo_3_fm;
+		state->lfo_4_lfo_3_fm_cc = (short) cc_val;
+		state->lfo_4_lfo_3_fm    = (sample_t) int_val;
+		set_smooth_target(state, (SMOOTH_LFO_FM + 2), state->lfo_4_lfo_3_fm);
 	}
 }
 
@@ -1282,10 +1513,11 @@ update_lfo_lfo_rate(PARAM *param)
 void
 update_lfo_cutoff(PARAM *param)
 {
-	PATCH_STATE     *state  = param->patch->state;
+	PATCH_STATE     *state  = get_cb_state(param);
 	int             cc_val  = param->value.cc_val;
 	int             int_val = param->value.int_val;
 
 	state->lfo_3_cutoff_cc = (short) cc_val;
 	state->lfo_3_cutoff    = (sample_t) int_val;
+	set_smooth_target(state, SMOOTH_LFO_CUTOFF, state->lfo_3_cutoff);
 }
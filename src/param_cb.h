@@ -26,8 +26,11 @@
 #include "param.h"
 
 
+struct patch_state;
+
 void update_midi_channel(PARAM *param);
 void update_bpm(PARAM *param);
+void update_bpm_rt(PARAM *param);
 void update_patch_tune(PARAM *param);
 void update_portamento(PARAM *param);
 void update_keymode(PARAM *param);
@@ -102,5 +105,8 @@ void update_lfo_voice_am(PARAM *param);
 void update_lfo_lfo_rate(PARAM *param);
 void update_lfo_cutoff(PARAM *param);
 
+void set_param_cb_state_only(struct patch_state *state);
+void apply_patch_part_state(struct patch *patch, struct patch *prev);
+
 
 #endif /* _PHASEX_PARAM_CB_H_ */
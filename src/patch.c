@@ -26,7 +26,9 @@
 #include <ctype.h>
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
 #include <libgen.h>
+#include <sys/stat.h>
 #include "phasex.h"
 #include "config.h"
 #include "engine.h"
@@ -38,6 +40,8 @@
 #include "session.h"
 #include "gui_patch.h"
 #include "string_util.h"
+#include "autosave.h"
+#include "patch_cache.h"
 #include "debug.h"
 
 
@@ -47,7 +51,9 @@ PATCH_STATE *active_state[MAX_PARTS];
 
 DIR_LIST    *patch_dir_list         = NULL;
 
-int         patch_load_in_progress  = 0;
+/* Serializes additions to patch_dir_list, which patches read and saved
+   from the gui and bank threads both make.  Entries are never removed. */
+static pthread_mutex_t  patch_dir_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 int         patch_name_changed      = 0;
 
@@ -78,7 +84,7 @@ get_patch(unsigned int sess_num, unsigned int part_num, unsigned int prog_num)
 	if (prog_num == 0) {
 		return & (session_bank[sess_num].patch[part_num]);
 	}
-	return & (patch_bank[part_num][prog_num]);
+	return get_bank_patch(part_num, prog_num);
 }
 
 
@@ -111,7 +117,7 @@ get_patch_state(unsigned int sess_num, unsigned int part_num, unsigned int prog_
 	if (prog_num == 0) {
 		return & (session_bank[sess_num].state[part_num]);
 	}
-	return & (state_bank[part_num][prog_num]);
+	return get_bank_state(part_num, prog_num);
 }
 
 
@@ -149,8 +155,8 @@ set_active_patch(unsigned int sess_num, unsigned int part_num, unsigned int prog
 		state = & (session_bank[sess_num].state[part_num]);
 	}
 	else {
-		patch = & (patch_bank[part_num][prog_num]);
-		state = & (state_bank[part_num][prog_num]);
+		patch = get_bank_patch(part_num, prog_num);
+		state = patch->state;
 	}
 
 	patch->sess_num = sess_num;
@@ -158,6 +164,9 @@ set_active_patch(unsigned int sess_num, unsigned int part_num, unsigned int prog
 	active_patch[part_num] = patch;
 	active_state[part_num] = state;
 
+	/* get the neighbouring bank programs ready for the next change */
+	request_bank_prefetch(part_num, prog_num);
+
 	return patch;
 }
 
@@ -187,11 +196,13 @@ init_patch_state(PATCH *patch)
 
 	for (param_num = 0; param_num < (NUM_PARAMS + 0); param_num++) {
 		param = & (patch->param[param_num]);
+#ifndef PHASEX_LV2
 		if ((param->info->locked) && (gp != NULL)) {
 			param->value.cc_val  = gp->param[param_num].value.cc_val;
 			param->value.int_val = gp->param[param_num].value.int_val;
 		}
-		cb_info[param_num].update_patch_state(& (patch->param[param_num]));
+#endif /* !PHASEX_LV2 */
+		cb_info[param_num].update_patch_state(param);
 	}
 }
 
@@ -210,6 +221,7 @@ init_patch(PATCH *patch)
 		param->value.cc_val  = param->info->cc_default;
 		param->value.int_val = param->info->cc_default + param->info->cc_offset;
 		param->value.cc_prev = param->value.cc_val;
+		param->value.fine_val = param->value.cc_val << 7;
 		param->updated = 0;
 	}
 }
@@ -232,8 +244,9 @@ init_patch_data_structures(PATCH        *patch,
 	patch->prog_num = prog_num;
 
 	patch->part  = get_part(part_num);
+	/* bank patches get their state from the bank entry that holds them */
 	if (sess_num == SESSION_BANK_SIZE) {
-		patch->state = & (state_bank[part_num][prog_num]);
+		patch->state = NULL;
 		patch->sess_num = 0;
 	}
 	else {
@@ -261,30 +274,9 @@ init_patch_param_data(void)
 	PATCH           *patch;
 	unsigned int    sess_num;
 	unsigned int    part_num;
-	unsigned int    prog_num;
 	unsigned int    param_num;
 
-	/* patch bank */
-	for (part_num = 0; part_num < MAX_PARTS; part_num++) {
-		for (prog_num = 0; prog_num < MAX_PARTS; prog_num++) {
-			patch           = & (patch_bank[part_num][prog_num]);
-			patch->state    = & (state_bank[part_num][prog_num]);
-			patch->sess_num = 0;
-			patch->part_num = part_num;
-			patch->prog_num = prog_num;
-			patch->part = get_part(part_num);
-			for (param_num = 0; param_num < NUM_HELP_PARAMS; param_num++) {
-				param                = & (patch->param[param_num]);
-				param->info          = get_param_info_by_id(param_num);
-				param->patch         = patch;
-				param->value.cc_val  = param->info->cc_default;
-				param->value.int_val = param->info->cc_default + param->info->cc_offset;
-				param->value.cc_prev = param->value.cc_val;
-			}
-		}
-	}
-
-	/* session patch bank */
+	/* session patch bank.  bank programs are initialized when loaded. */
 	for (sess_num = 0; sess_num < MAX_PARTS; sess_num++) {
 		for (part_num = 0; part_num < MAX_PARTS; part_num++) {
 			patch           = & (session_bank[sess_num].patch[part_num]);
@@ -306,6 +298,54 @@ init_patch_param_data(void)
 }
 
 
+/*****************************************************************************
+ * add_patch_dir()
+ *
+ * Adds a directory to the patch directory list, unless it is already listed
+ * or is one of the system or user patch directories.
+ *****************************************************************************/
+static void
+add_patch_dir(char *directory)
+{
+	DIR_LIST        *pdir;
+	DIR_LIST        *ldir   = NULL;
+
+	if ((directory == NULL) || (*directory == '\0') ||
+	    (strcmp(directory, PATCH_DIR) == 0) ||
+	    (strcmp(directory, user_patch_dir) == 0)) {
+		return;
+	}
+
+	pthread_mutex_lock(&patch_dir_mutex);
+
+	pdir = patch_dir_list;
+	while (pdir != NULL) {
+		if (strcmp(pdir->name, directory) == 0) {
+			pthread_mutex_unlock(&patch_dir_mutex);
+			return;
+		}
+		ldir = pdir;
+		pdir = pdir->next;
+	}
+
+	if ((pdir = malloc(sizeof(DIR_LIST))) == NULL) {
+		phasex_shutdown("Out of Memory!\n");
+	}
+	pdir->name = strdup(directory);
+	pdir->load_shortcut = pdir->save_shortcut = 0;
+	if (ldir == NULL) {
+		pdir->next = NULL;
+		patch_dir_list = pdir;
+	}
+	else {
+		pdir->next = ldir->next;
+		ldir->next = pdir;
+	}
+
+	pthread_mutex_unlock(&patch_dir_mutex);
+}
+
+
 /*****************************************************************************
  * read_patch()
  *****************************************************************************/
@@ -314,9 +354,10 @@ read_patch(char *filename, PATCH *patch)
 {
 	char            new_file_name[PATH_MAX];
 	char            lash_patch_filename[16];
+	char            file_patch_name[PATCH_CACHE_NAME_LEN];
+	struct stat     st;
 	PARAM           *param;
 	DIR_LIST        *pdir       = patch_dir_list;
-	DIR_LIST        *ldir       = NULL;
 	FILE            *patch_f    = NULL;
 	char            *token;
 	char            *p;
@@ -329,8 +370,12 @@ read_patch(char *filename, PATCH *patch)
 	int             j;
 	int             line        = 0;
 	int             dir_found   = 0;
+	int             have_stat   = 0;
+	int             cached      = 0;
 	int             cc_val;
+#ifndef PHASEX_LV2
 	unsigned int    param_num;
+#endif /* !PHASEX_LV2 */
 
 	/* return error on missing filename */
 	if ((filename == NULL) || (filename[0] == '\0')) {
@@ -358,8 +403,6 @@ read_patch(char *filename, PATCH *patch)
 		return -1;
 	}
 
-	patch_load_in_progress = 1;
-
 	/* free strings (will be rebuilt next) */
 	if (patch->filename != NULL) {
 		free(patch->filename);
@@ -396,45 +439,24 @@ read_patch(char *filename, PATCH *patch)
 		free(p);
 
 		/* maintain patch directory list */
-		if ((patch->directory != NULL) &&
-		    (* (patch->directory) != '\0') &&
-		    (strcmp(patch->directory, PATCH_DIR) != 0) &&
-		    (strcmp(patch->directory, user_patch_dir) != 0)) {
-			while ((pdir != NULL) && (!dir_found)) {
-				if (strcmp(pdir->name, patch->directory) == 0) {
-					dir_found = 1;
-				}
-				else {
-					ldir = pdir;
-					pdir = pdir->next;
-				}
-			}
-			if (!dir_found) {
-				if ((pdir = malloc(sizeof(DIR_LIST))) == NULL) {
-					phasex_shutdown("Out of Memory!\n");
-				}
-				pdir->name = strdup(patch->directory);
-				pdir->load_shortcut = pdir->save_shortcut = 0;
-				if (ldir == NULL) {
-					pdir->next = NULL;
-					patch_dir_list = pdir;
-				}
-				else {
-					pdir->next = ldir->next;
-					ldir->next = pdir;
-				}
-			}
-		}
+		add_patch_dir(patch->directory);
 	}
 
 	/* start with a "blank" slate in case any parameters are missing */
 	init_patch(patch);
 
+	/* skip parsing if the patch cache is current for this file */
+	if (fstat(fileno(patch_f), &st) == 0) {
+		have_stat = 1;
+		cached = apply_patch_cache(filename, &st, patch);
+	}
+
 	param_name[sizeof(param_name) - 1]       = '\0';
 	param_str_val[sizeof(param_str_val) - 1] = '\0';
+	file_patch_name[0]                       = '\0';
 
 	/* read patch entries */
-	while (fgets(buffer, sizeof(buffer), patch_f) != NULL) {
+	while (!cached && (fgets(buffer, sizeof(buffer), patch_f) != NULL)) {
 		line++;
 
 		/* discard comments and blank lines */
@@ -489,35 +511,27 @@ read_patch(char *filename, PATCH *patch)
 			continue;
 		}
 
-		/* if param_name is a valid param, parse param_str_value */
+		/* if param_name is a valid param, parse param_str_value.  locked
+		   params are parsed too, so that the patch cache holds the values
+		   actually in the file. */
 		if ((param = get_param_by_name(patch, param_name)) != NULL) {
-			param_num = param->info->id;
-			/* ignore locked parameters only after gui patch is initialized */
-			if (param->info->locked && (gp != NULL)) {
-				param->value.cc_val  = gp->param[param_num].value.cc_val;
-				param->value.int_val = gp->param[param_num].value.int_val;
-				param->value.cc_prev = gp->param[param_num].value.cc_prev;
-			}
-			/* unlocked parameters are parsed as normal */
-			else {
-				cc_val = 0;
-				cur = param->info->strval_list;
-				if (cur != NULL) {
-					while (*cur != NULL) {
-						if (strcmp(param_str_val, *cur) == 0) {
-							param->value.cc_val  = cc_val;
-							param->value.int_val = cc_val + param->info->cc_offset;
-							break;
-						}
-						cur++;
-						cc_val++;
+			cc_val = 0;
+			cur = param->info->strval_list;
+			if (cur != NULL) {
+				while (*cur != NULL) {
+					if (strcmp(param_str_val, *cur) == 0) {
+						param->value.cc_val  = cc_val;
+						param->value.int_val = cc_val + param->info->cc_offset;
+						break;
 					}
-				}
-				else {
-					param->value.int_val = atoi(param_str_val);
-					param->value.cc_val  = param->value.int_val - param->info->cc_offset;
+					cur++;
+					cc_val++;
 				}
 			}
+			else {
+				param->value.int_val = atoi(param_str_val);
+				param->value.cc_val  = param->value.int_val - param->info->cc_offset;
+			}
 		}
 		/* param_name could be a patch info parameter */
 		/* TODO:  add info params to standardized parameter system */
@@ -529,6 +543,8 @@ read_patch(char *filename, PATCH *patch)
 				if (tmpname != NULL) {
 					free(tmpname);
 				}
+				strncpy(file_patch_name, param_str_val, (sizeof(file_patch_name) - 1));
+				file_patch_name[sizeof(file_patch_name) - 1] = '\0';
 			}
 			//                      else if (strcmp (param_name, "phasex_version") == 0) {
 			//                      }
@@ -541,6 +557,25 @@ read_patch(char *filename, PATCH *patch)
 	/* done parsing */
 	fclose(patch_f);
 
+	if (!cached && have_stat) {
+		store_patch_cache(filename, &st, patch,
+		                  ((file_patch_name[0] == '\0') ? NULL : file_patch_name));
+	}
+
+#ifndef PHASEX_LV2
+	/* ignore locked parameters only after gui patch is initialized */
+	if (gp != NULL) {
+		for (param_num = 0; param_num < NUM_PARAMS; param_num++) {
+			param = & (patch->param[param_num]);
+			if (param->info->locked) {
+				param->value.cc_val  = gp->param[param_num].value.cc_val;
+				param->value.int_val = gp->param[param_num].value.int_val;
+				param->value.cc_prev = gp->param[param_num].value.cc_prev;
+			}
+		}
+	}
+#endif /* !PHASEX_LV2 */
+
 	/* set midi channel from current channel in part data */
 	patch->param[PARAM_MIDI_CHANNEL].value.cc_prev =
 		patch->param[PARAM_MIDI_CHANNEL].value.cc_val;
@@ -555,7 +590,6 @@ read_patch(char *filename, PATCH *patch)
 	patch->param[PARAM_MIDI_CHANNEL].updated = 1;
 
 	patch->modified = 0;
-	patch_load_in_progress = 0;
 
 	return 0;
 }
@@ -572,16 +606,14 @@ save_patch(char *filename, PATCH *patch)
 {
 	PARAM           *param;
 	char            lash_patch_filename[16];
-	DIR_LIST        *pdir      = patch_dir_list;
-	DIR_LIST        *ldir      = NULL;
 	FILE            *patch_f;
+	char            save_tmpname[PATH_MAX];
 	char            *name;
 	char            *tmp;
 	char            *param_str_val;
 	char            *tmpname;
 	int             j;
 	int             param_num;
-	int             dir_found  = 0;
 	int             dump       = 0;
 
 	/* return error on missing filename */
@@ -597,7 +629,7 @@ save_patch(char *filename, PATCH *patch)
 	}
 
 	/* open the patch file */
-	if ((patch_f = fopen(filename, "wt")) == NULL) {
+	if ((patch_f = atomic_fopen(filename, save_tmpname, sizeof(save_tmpname))) == NULL) {
 		if (debug) {
 			PHASEX_ERROR("Error opening patch file %s for write: %s\n",
 			             filename, strerror(errno));
@@ -641,35 +673,7 @@ save_patch(char *filename, PATCH *patch)
 		free(tmp);
 
 		/* maintain patch directory list */
-		if ((patch->directory != NULL) &&
-		    (* (patch->directory) != '\0') &&
-		    (strcmp(patch->directory, PATCH_DIR) != 0) &&
-		    (strcmp(patch->directory, user_patch_dir) != 0)) {
-			while ((pdir != NULL) && (!dir_found)) {
-				if (strcmp(pdir->name, patch->directory) == 0) {
-					dir_found = 1;
-				}
-				else {
-					ldir = pdir;
-					pdir = pdir->next;
-				}
-			}
-			if (!dir_found) {
-				if ((pdir = malloc(sizeof(DIR_LIST))) == NULL) {
-					phasex_shutdown("Out of Memory!\n");
-				}
-				pdir->name = strdup(patch->directory);
-				pdir->load_shortcut = pdir->save_shortcut = 0;
-				if (ldir == NULL) {
-					pdir->next = NULL;
-					patch_dir_list = pdir;
-				}
-				else {
-					pdir->next = ldir->next;
-					ldir->next = pdir;
-				}
-			}
-		}
+		add_patch_dir(patch->directory);
 	}
 
 	/* write the patch */
@@ -697,7 +701,9 @@ save_patch(char *filename, PATCH *patch)
 	}
 
 	/* Done writing patch */
-	fclose(patch_f);
+	if (atomic_fclose(patch_f, save_tmpname, filename) != 0) {
+		return -1;
+	}
 
 	/* Mark patch unmodified for non buffer dumps */
 	if (!dump) {
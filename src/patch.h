@@ -23,6 +23,7 @@
 #ifndef _PHASEX_PATCH_H_
 #define _PHASEX_PATCH_H_
 
+#include <glib.h>
 #include "phasex.h"
 
 
@@ -192,8 +193,12 @@ typedef struct patch_state {
 	sample_t    lfo_4_lfo_3_fm;
 	short       lfo_4_lfo_3_fm_cc;
 
+	/* targets for the engine's per-part parameter smoothing bank */
+	sample_t    smooth_target[NUM_SMOOTH_PARAMS];
+	gint        smooth_serial;              /* bumped whenever a target changes */
+
 	/* pad to 64-byte boundary for cache performance. */
-	char        padding[14];
+	char        padding[12];
 } PATCH_STATE;
 
 
@@ -224,8 +229,6 @@ extern PATCH_STATE  *active_state[MAX_PARTS];
 
 extern DIR_LIST     *patch_dir_list;
 
-extern int          patch_load_in_progress;
-
 extern int          patch_name_changed;
 
 
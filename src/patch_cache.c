@@ -0,0 +1,388 @@
+/*****************************************************************************
+ *
+ * patch_cache.c
+ *
+ * PHASEX:  [P]hase [H]armonic [A]dvanced [S]ynthesis [EX]periment
+ *
+ * Copyright (C) 2012-2013 William Weston <whw@linuxmail.org>
+ *
+ * PHASEX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PHASEX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PHASEX.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <glib.h>
+#include "phasex.h"
+#include "patch.h"
+#include "param.h"
+#include "patch_cache.h"
+#include "autosave.h"
+#include "debug.h"
+
+
+/* Pointers into the mapped cache file, or to entries allocated at runtime
+   for patch files parsed since the cache was loaded. */
+static PATCH_CACHE_ENTRY    *patch_cache_index[PATCH_CACHE_INDEX_SIZE];
+static char                 patch_cache_used[PATCH_CACHE_INDEX_SIZE];
+static char                 patch_cache_keep[PATCH_CACHE_INDEX_SIZE];
+static unsigned int         patch_cache_num_entries     = 0;
+static unsigned int         patch_cache_num_on_disk      = 0;
+static int                  patch_cache_dirty           = 0;
+
+static void                 *patch_cache_map            = NULL;
+static size_t               patch_cache_map_size        = 0;
+
+static pthread_mutex_t      patch_cache_mutex           = PTHREAD_MUTEX_INITIALIZER;
+
+
+/*****************************************************************************
+ * get_param_layout_hash()
+ *
+ * Returns a hash of everything about the parameter list that affects how
+ * cached cc values map to parameters.  A cache built by a phasex with a
+ * different parameter list is simply ignored.
+ *****************************************************************************/
+static guint32
+get_param_layout_hash(void)
+{
+	PARAM_INFO      *info;
+	const char      *p;
+	guint32         hash = 2166136261U;
+	unsigned int    param_num;
+
+	for (param_num = 0; param_num < NUM_PARAMS; param_num++) {
+		info = get_param_info_by_id(param_num);
+		for (p = info->name; *p != '\0'; p++) {
+			hash = (hash ^ (guint32)(unsigned char)(*p)) * 16777619U;
+		}
+		hash = (hash ^ (guint32) info->cc_offset) * 16777619U;
+		hash = (hash ^ (guint32) info->cc_limit) * 16777619U;
+		hash = (hash ^ (guint32)(info->strval_list != NULL)) * 16777619U;
+	}
+
+	return hash;
+}
+
+
+/*****************************************************************************
+ * get_patch_cache_slot()
+ *
+ * Returns the index slot for <filename>, either the slot holding its entry,
+ * or the empty slot where its entry belongs.  Returns -1 if the index is
+ * full.  Caller must hold patch_cache_mutex.
+ *****************************************************************************/
+static int
+get_patch_cache_slot(char *filename)
+{
+	const char      *p;
+	guint32         hash = 2166136261U;
+	unsigned int    slot;
+	unsigned int    probe;
+
+	for (p = filename; *p != '\0'; p++) {
+		hash = (hash ^ (guint32)(unsigned char)(*p)) * 16777619U;
+	}
+
+	slot = hash & PATCH_CACHE_INDEX_MASK;
+	for (probe = 0; probe < PATCH_CACHE_INDEX_SIZE; probe++) {
+		if ((patch_cache_index[slot] == NULL) ||
+		    (strcmp(patch_cache_index[slot]->filename, filename) == 0)) {
+			return (int) slot;
+		}
+		slot = (slot + 1) & PATCH_CACHE_INDEX_MASK;
+	}
+
+	return -1;
+}
+
+
+/*****************************************************************************
+ * patch_cache_entry_valid()
+ *
+ * Returns true if the cache entry still matches the patch file on disk.
+ *****************************************************************************/
+static int
+patch_cache_entry_valid(PATCH_CACHE_ENTRY *entry, struct stat *st)
+{
+	return ((entry->mtime_sec  == (gint64) st->st_mtim.tv_sec)  &&
+	        (entry->mtime_nsec == (gint64) st->st_mtim.tv_nsec) &&
+	        (entry->size       == (gint64) st->st_size)         &&
+	        (entry->inode      == (gint64) st->st_ino));
+}
+
+
+/*****************************************************************************
+ * patch_cache_entry_current()
+ *
+ * Returns true if the patch file for a cache entry still exists and still
+ * matches the entry.
+ *****************************************************************************/
+static int
+patch_cache_entry_current(PATCH_CACHE_ENTRY *entry)
+{
+	struct stat     st;
+
+	return ((stat(entry->filename, &st) == 0) && patch_cache_entry_valid(entry, &st));
+}
+
+
+/*****************************************************************************
+ * load_patch_cache()
+ *
+ * Memory maps the binary patch cache and builds the filename index.  A
+ * missing, truncated, or mismatched cache is ignored, and will be rebuilt as
+ * patches are read.
+ *****************************************************************************/
+void
+load_patch_cache(char *filename)
+{
+	PATCH_CACHE_HEADER  *header;
+	PATCH_CACHE_ENTRY   *entries;
+	struct stat         st;
+	unsigned int        j;
+	int                 slot;
+	int                 fd;
+
+	if ((fd = open(filename, O_RDONLY)) < 0) {
+		return;
+	}
+	if ((fstat(fd, &st) != 0) || ((size_t) st.st_size < sizeof(PATCH_CACHE_HEADER))) {
+		close(fd);
+		return;
+	}
+	patch_cache_map_size = (size_t) st.st_size;
+	patch_cache_map = mmap(NULL, patch_cache_map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (patch_cache_map == MAP_FAILED) {
+		patch_cache_map = NULL;
+		return;
+	}
+
+	header = (PATCH_CACHE_HEADER *) patch_cache_map;
+	if ((header->magic       != PATCH_CACHE_MAGIC)              ||
+	    (header->version     != PATCH_CACHE_VERSION)            ||
+	    (header->num_params  != NUM_PARAMS)                     ||
+	    (header->param_hash  != get_param_layout_hash())        ||
+	    (header->entry_size  != sizeof(PATCH_CACHE_ENTRY))      ||
+	    (header->num_entries >  PATCH_CACHE_MAX_ENTRIES)        ||
+	    (patch_cache_map_size != (sizeof(PATCH_CACHE_HEADER) +
+	                              (header->num_entries * sizeof(PATCH_CACHE_ENTRY))))) {
+		PHASEX_DEBUG(DEBUG_CLASS_INIT, "Ignoring stale patch cache '%s'.\n", filename);
+		munmap(patch_cache_map, patch_cache_map_size);
+		patch_cache_map = NULL;
+		return;
+	}
+
+	pthread_mutex_lock(&patch_cache_mutex);
+	entries = (PATCH_CACHE_ENTRY *)(header + 1);
+	for (j = 0; j < header->num_entries; j++) {
+		if (entries[j].filename[PATCH_CACHE_FILENAME_LEN - 1] != '\0') {
+			continue;
+		}
+		if ((slot = get_patch_cache_slot(entries[j].filename)) >= 0) {
+			if (patch_cache_index[slot] == NULL) {
+				patch_cache_num_entries++;
+			}
+			patch_cache_index[slot] = & (entries[j]);
+		}
+	}
+	patch_cache_num_on_disk = patch_cache_num_entries;
+	pthread_mutex_unlock(&patch_cache_mutex);
+
+	PHASEX_DEBUG(DEBUG_CLASS_INIT, "Loaded %u entries from patch cache '%s'.\n",
+	             patch_cache_num_entries, filename);
+}
+
+
+/*****************************************************************************
+ * apply_patch_cache()
+ *
+ * If the cache holds a valid entry for <filename> (already stat()ed into
+ * <st>), sets the patch params and name from the cache and returns 1.
+ * Otherwise returns 0, and the patch file needs to be parsed.
+ *****************************************************************************/
+int
+apply_patch_cache(char *filename, struct stat *st, PATCH *patch)
+{
+	PATCH_CACHE_ENTRY   *entry;
+	PARAM               *param;
+	char                *tmpname;
+	unsigned int        param_num;
+	int                 slot;
+	int                 hit         = 0;
+
+	if (strlen(filename) >= PATCH_CACHE_FILENAME_LEN) {
+		return 0;
+	}
+
+	pthread_mutex_lock(&patch_cache_mutex);
+	if (((slot = get_patch_cache_slot(filename)) >= 0) &&
+	    ((entry = patch_cache_index[slot]) != NULL) &&
+	    patch_cache_entry_valid(entry, st)) {
+		for (param_num = 0; param_num < NUM_PARAMS; param_num++) {
+			param = & (patch->param[param_num]);
+			param->value.cc_val   = entry->cc_val[param_num];
+			param->value.int_val  = entry->cc_val[param_num] + param->info->cc_offset;
+			param->value.fine_val = entry->fine_val[param_num];
+			param->value.cc_prev  = param->value.cc_val;
+		}
+		if (entry->name[0] != '\0') {
+			tmpname = patch->name;
+			patch->name = strndup(entry->name, (PATCH_CACHE_NAME_LEN - 1));
+			if (tmpname != NULL) {
+				free(tmpname);
+			}
+		}
+		patch_cache_used[slot] = 1;
+		hit = 1;
+	}
+	pthread_mutex_unlock(&patch_cache_mutex);
+
+	return hit;
+}
+
+
+/*****************************************************************************
+ * store_patch_cache()
+ *
+ * Adds or replaces the cache entry for <filename> using the freshly parsed
+ * param values in <patch>.  <name> is the patch_name read from the file, or
+ * NULL if the file has none.
+ *****************************************************************************/
+void
+store_patch_cache(char *filename, struct stat *st, PATCH *patch, char *name)
+{
+	PATCH_CACHE_ENTRY   *entry;
+	unsigned int        param_num;
+	int                 slot;
+
+	if (strlen(filename) >= PATCH_CACHE_FILENAME_LEN) {
+		return;
+	}
+
+	pthread_mutex_lock(&patch_cache_mutex);
+	if ((slot = get_patch_cache_slot(filename)) < 0) {
+		pthread_mutex_unlock(&patch_cache_mutex);
+		return;
+	}
+	if ((patch_cache_index[slot] == NULL) &&
+	    (patch_cache_num_entries >= PATCH_CACHE_MAX_ENTRIES)) {
+		pthread_mutex_unlock(&patch_cache_mutex);
+		return;
+	}
+
+	/* mapped entries are read-only, so always use a new entry */
+	if ((entry = malloc(sizeof(PATCH_CACHE_ENTRY))) == NULL) {
+		phasex_shutdown("Out of Memory!\n");
+	}
+	memset(entry, 0, sizeof(PATCH_CACHE_ENTRY));
+	entry->mtime_sec  = (gint64) st->st_mtim.tv_sec;
+	entry->mtime_nsec = (gint64) st->st_mtim.tv_nsec;
+	entry->size       = (gint64) st->st_size;
+	entry->inode      = (gint64) st->st_ino;
+	strncpy(entry->filename, filename, (PATCH_CACHE_FILENAME_LEN - 1));
+	if (name != NULL) {
+		strncpy(entry->name, name, (PATCH_CACHE_NAME_LEN - 1));
+	}
+	for (param_num = 0; param_num < NUM_PARAMS; param_num++) {
+		entry->cc_val[param_num]   = (gint16)(patch->param[param_num].value.cc_val);
+		entry->fine_val[param_num] = (gint16)(patch->param[param_num].value.fine_val);
+	}
+
+	if (patch_cache_index[slot] == NULL) {
+		patch_cache_num_entries++;
+	}
+	else if (((void *) patch_cache_index[slot] <  patch_cache_map) ||
+	         ((void *) patch_cache_index[slot] >= (void *)((char *) patch_cache_map +
+	                                                       patch_cache_map_size))) {
+		free(patch_cache_index[slot]);
+	}
+	patch_cache_index[slot] = entry;
+	patch_cache_used[slot]  = 1;
+	patch_cache_dirty       = 1;
+	pthread_mutex_unlock(&patch_cache_mutex);
+}
+
+
+/*****************************************************************************
+ * save_patch_cache()
+ *
+ * Writes all cache entries used since the cache was loaded, along with
+ * entries from the loaded cache that were not used this time but still
+ * match their patch files.  Entries for patch files that have changed or
+ * gone away are dropped.  Nothing is written when the cache on disk is
+ * already current.
+ *****************************************************************************/
+void
+save_patch_cache(char *filename)
+{
+	PATCH_CACHE_HEADER  header;
+	FILE                *cache_f;
+	char                tmpname[PATH_MAX];
+	unsigned int        num_kept    = 0;
+	unsigned int        slot;
+
+	pthread_mutex_lock(&patch_cache_mutex);
+
+	/* unused entries can only be from the mapped cache */
+	for (slot = 0; slot < PATCH_CACHE_INDEX_SIZE; slot++) {
+		patch_cache_keep[slot] = ((patch_cache_index[slot] != NULL) &&
+		                          (patch_cache_used[slot] ||
+		                           patch_cache_entry_current(patch_cache_index[slot])));
+		if (patch_cache_keep[slot]) {
+			num_kept++;
+		}
+	}
+	if (!patch_cache_dirty && (num_kept == patch_cache_num_on_disk)) {
+		pthread_mutex_unlock(&patch_cache_mutex);
+		return;
+	}
+
+	if ((cache_f = atomic_fopen(filename, tmpname, sizeof(tmpname))) == NULL) {
+		PHASEX_ERROR("Error opening patch cache %s for write: %s\n",
+		             filename, strerror(errno));
+		pthread_mutex_unlock(&patch_cache_mutex);
+		return;
+	}
+
+	memset(&header, 0, sizeof(PATCH_CACHE_HEADER));
+	header.magic       = PATCH_CACHE_MAGIC;
+	header.version     = PATCH_CACHE_VERSION;
+	header.num_params  = NUM_PARAMS;
+	header.param_hash  = get_param_layout_hash();
+	header.entry_size  = sizeof(PATCH_CACHE_ENTRY);
+	header.num_entries = num_kept;
+	fwrite(&header, sizeof(PATCH_CACHE_HEADER), 1, cache_f);
+
+	for (slot = 0; slot < PATCH_CACHE_INDEX_SIZE; slot++) {
+		if (patch_cache_keep[slot]) {
+			fwrite(patch_cache_index[slot], sizeof(PATCH_CACHE_ENTRY), 1, cache_f);
+		}
+	}
+
+	if (atomic_fclose(cache_f, tmpname, filename) == 0) {
+		patch_cache_dirty      = 0;
+		patch_cache_num_on_disk = num_kept;
+	}
+
+	pthread_mutex_unlock(&patch_cache_mutex);
+}
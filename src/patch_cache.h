@@ -0,0 +1,76 @@
+/*****************************************************************************
+ *
+ * patch_cache.h
+ *
+ * PHASEX:  [P]hase [H]armonic [A]dvanced [S]ynthesis [EX]periment
+ *
+ * Copyright (C) 2012-2013 William Weston <whw@linuxmail.org>
+ *
+ * PHASEX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PHASEX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PHASEX.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+#ifndef _PHASEX_PATCH_CACHE_H_
+#define _PHASEX_PATCH_CACHE_H_
+
+#include <sys/stat.h>
+#include <glib.h>
+#include "phasex.h"
+#include "patch.h"
+#include "param.h"
+
+
+#define PATCH_CACHE_MAGIC           0x43584850  /* "PHXC" */
+#define PATCH_CACHE_VERSION         2
+
+#define PATCH_CACHE_FILENAME_LEN    256
+#define PATCH_CACHE_NAME_LEN        32
+
+/* Open addressed hash index.  Must be a power of 2, and comfortably larger
+   than the number of distinct patch files in all banks. */
+#define PATCH_CACHE_INDEX_SIZE      32768
+#define PATCH_CACHE_INDEX_MASK      (PATCH_CACHE_INDEX_SIZE - 1)
+#define PATCH_CACHE_MAX_ENTRIES     (PATCH_CACHE_INDEX_SIZE * 3 / 4)
+
+
+/* On-disk cache file is a header followed by num_entries fixed size entries,
+   in host byte order.  The whole file is memory mapped when loaded. */
+typedef struct patch_cache_header {
+	guint32         magic;
+	guint32         version;
+	guint32         num_params;
+	guint32         param_hash;     /* hash of param names and value ranges */
+	guint32         entry_size;
+	guint32         num_entries;
+} PATCH_CACHE_HEADER;
+
+
+typedef struct patch_cache_entry {
+	gint64          mtime_sec;      /* patch file modification time */
+	gint64          mtime_nsec;
+	gint64          size;           /* patch file size in bytes */
+	gint64          inode;
+	char            filename[PATCH_CACHE_FILENAME_LEN];
+	char            name[PATCH_CACHE_NAME_LEN];     /* patch_name from file, or empty */
+	gint16          cc_val[NUM_PARAMS];
+	gint16          fine_val[NUM_PARAMS];           /* 14-bit values */
+} PATCH_CACHE_ENTRY;
+
+
+void load_patch_cache(char *filename);
+void save_patch_cache(char *filename);
+int apply_patch_cache(char *filename, struct stat *st, PATCH *patch);
+void store_patch_cache(char *filename, struct stat *st, PATCH *patch, char *name);
+
+
+#endif /* _PHASEX_PATCH_CACHE_H_ */
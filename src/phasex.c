@@ -52,9 +52,13 @@
 #include "bank.h"
 #include "session.h"
 #include "midimap.h"
+#include "autosave.h"
+#include "control.h"
+#include "patch_cache.h"
 #include "settings.h"
 #include "help.h"
 #include "debug.h"
+#include "trace.h"
 
 
 #ifndef WITHOUT_LASH
@@ -62,9 +66,10 @@
 #endif
 
 
+#ifndef PHASEX_LV2
 /* command line options */
 #define HAS_ARG     1
-#define NUM_OPTS    (27 + 1)
+#define NUM_OPTS    (28 + 1)
 static struct option long_opts[] = {
 	{ "config-file",     HAS_ARG, NULL, 'c' },
 	{ "audio-driver",    HAS_ARG, NULL, 'A' },
@@ -79,6 +84,7 @@ static struct option long_opts[] = {
 	{ "bpm",             HAS_ARG, NULL, 'b' },
 	{ "tuning",          HAS_ARG, NULL, 't' },
 	{ "debug",           HAS_ARG, NULL, 'd' },
+	{ "trace",           HAS_ARG, NULL, 'T' },
 	{ "session-dir",     HAS_ARG, NULL, 'D' },
 	{ "uuid",            HAS_ARG, NULL, 'u' },
 	{ "undersample",     0,       NULL, 'U' },
@@ -95,6 +101,7 @@ static struct option long_opts[] = {
 	{ "lash-id",         HAS_ARG, NULL, 'I' },
 	{ 0,                 0,       NULL, 0 }
 };
+#endif /* !PHASEX_LV2 */
 
 
 int         pending_shutdown              = 0;
@@ -125,6 +132,7 @@ char        user_session_dump_dir[PATH_MAX];
 char        user_patchdump_file[MAX_PARTS][PATH_MAX];
 char        user_midimap_dump_file[PATH_MAX];
 char        user_config_file[PATH_MAX];
+char        user_patch_cache_file[PATH_MAX];
 char        user_default_patch[PATH_MAX];
 char        sys_default_patch[PATH_MAX];
 char        sys_bank_file[PATH_MAX];
@@ -159,6 +167,7 @@ showusage(char *argvzero)
 	printf("  -D, --session-dir=     Set directory for loading initial session.\n");
 	printf("  -u, --uuid=            Set UUID for JACK Session handling.\n");
 	printf("  -d, --debug=           Debug class (Can be repeated. See debug.c).\n");
+	printf("  -T, --trace=           Export realtime trace to file (Chrome trace JSON).\n");
 	printf("  -l, --list             Scan and list audio and MIDI devices.\n");
 	printf("  -v, --version          Display version and exit.\n");
 	printf("  -h, --help             Display this help message and probe ALSA hardware.\n\n");
@@ -366,6 +375,7 @@ check_user_data_dirs(void)
 
 	snprintf(user_midimap_dump_file, PATH_MAX, "%s/%s", user_data_dir,  USER_MIDIMAP_DUMP_FILE);
 	snprintf(user_config_file,       PATH_MAX, "%s/%s", user_data_dir,  USER_CONFIG_FILE);
+	snprintf(user_patch_cache_file,  PATH_MAX, "%s/%s", user_data_dir,  USER_PATCH_CACHE_FILE);
 	snprintf(user_default_patch,     PATH_MAX, "%s/%s", user_patch_dir, SYS_DEFAULT_PATCH);
 	snprintf(sys_default_patch,      PATH_MAX, "%s/%s", PATCH_DIR,      SYS_DEFAULT_PATCH);
 	snprintf(sys_bank_file,          PATH_MAX, "%s/%s", PHASEX_DIR,     USER_BANK_FILE);
@@ -394,6 +404,7 @@ phasex_shutdown(const char *msg)
 		fprintf(stderr, "%s", msg);
 	}
 
+#ifndef PHASEX_LV2
 	/* keep current midi port settings. */
 	if (midi_port_name != NULL) {
 		switch (midi_driver) {
@@ -418,6 +429,7 @@ phasex_shutdown(const char *msg)
 			break;
 		}
 	}
+#endif /* !PHASEX_LV2 */
 
 	/* TODO: be more thorough about gathering settings */
 	save_settings(NULL);
@@ -451,6 +463,8 @@ init_rt_mutex(pthread_mutex_t *mutex, int rt)
 }
 
 
+#ifndef PHASEX_LV2
+/* The LV2 plugin build links the whole engine, but the host owns main(). */
 /*****************************************************************************
  * main()
  *
@@ -635,6 +649,12 @@ main(int argc, char **argv)
 					debug_class |= debug_class_list[j].id;
 				}
 			}
+			if (debug_class & DEBUG_CLASS_TRACE) {
+				g_atomic_int_set(&trace_enabled, 1);
+			}
+			break;
+		case 'T':   /* trace export file */
+			open_trace_file(optarg);
 			break;
 		case 'i':   /* audio input ports */
 			audio_input_ports = strdup(optarg);
@@ -779,8 +799,10 @@ main(int argc, char **argv)
 	   patch bank. */
 	init_engine_internals();
 
-	/* Initialize and load patch bank */
+	/* Initialize and load patch bank, using cached patch data for patch
+	   files that have not changed since last time. */
 	init_patch_param_data();
+	load_patch_cache(user_patch_cache_file);
 	if (init_session_dir == NULL) {
 		init_patch_bank(NULL);
 		init_session_bank(NULL);
@@ -791,6 +813,7 @@ main(int argc, char **argv)
 		snprintf(filename, PATH_MAX, "%s/%s", init_session_dir, USER_BANK_FILE);
 		init_session_bank(filename);
 	}
+	save_patch_cache(user_patch_cache_file);
 
 	/* initialize help system (only after patch data is fully initialized) */
 	init_help();
@@ -842,6 +865,9 @@ main(int argc, char **argv)
 	/* run the callbacks for all the parameters */
 	run_param_callbacks(1);
 
+	/* heavy parameter updates from midi are handled in the control thread */
+	start_control_thread();
+
 	/* start engine threads */
 	start_engine_threads();
 
@@ -857,6 +883,12 @@ main(int argc, char **argv)
 	/* wait until midi thread is ready */
 	wait_midi_start();
 
+	/* session dumps are written from their own thread */
+	start_autosave_thread();
+
+	/* program changes and bank prefetching are handled in the background */
+	start_bank_thread();
+
 	/* Phasex watchdog handles restarting threads on config changes and
 	   runs driver supplied watchdog loop iterations. */
 	phasex_watchdog();
@@ -864,6 +896,7 @@ main(int argc, char **argv)
 	/* Save patch and session bank state for next time. */
 	save_patch_bank(NULL);
 	save_session_bank(NULL);
+	save_patch_cache(user_patch_cache_file);
 
 	/* Wait for threads created directly by PHASEX to terminate. */
 	if (use_gui) {
@@ -878,7 +911,17 @@ main(int argc, char **argv)
 	if (midi_thread_p != 0) {
 		pthread_join(midi_thread_p,  NULL);
 	}
+	if (autosave_thread_p != 0) {
+		pthread_join(autosave_thread_p,  NULL);
+	}
+	if (control_thread_p != 0) {
+		pthread_join(control_thread_p,  NULL);
+	}
+	if (bank_thread_p != 0) {
+		pthread_join(bank_thread_p,  NULL);
+	}
 	pthread_join(debug_thread_p, NULL);
 
 	return 0;
 }
+#endif /* !PHASEX_LV2 */
@@ -98,6 +98,32 @@ typedef float sample_t;
 # define DEFAULT_REFRESH_INTERVAL       40
 #endif
 
+/* Default interval for session autosave (in seconds, 0 to disable). */
+#define DEFAULT_AUTOSAVE_INTERVAL       10
+
+/* Fade out/in time around MIDI program changes (in msec, 0 to disable). */
+#define DEFAULT_PROGRAM_FADE_TIME       5
+#define MAX_PROGRAM_FADE_TIME           50
+
+/* Ramp time for smoothed continuous parameters (in msec, 0 to disable). */
+#define DEFAULT_PARAM_SMOOTH_TIME       10
+#define MAX_PARAM_SMOOTH_TIME           200
+
+/* Fade out time for stolen voices (in msec, 0 to cut off immediately). */
+#define DEFAULT_VOICE_STEAL_FADE_TIME   3
+#define MAX_VOICE_STEAL_FADE_TIME       20
+
+/* Engine DSP load (in percent of each period, 0 to disable) above which
+   the global voice budget shrinks. */
+#define DEFAULT_DSP_LOAD_LIMIT          0
+
+/* Part whose chorus and delay serve as the shared send buses. */
+#define DEFAULT_FX_BUS_PART             1
+
+/* Master limiter ceiling (dB below full scale) and release time (ms). */
+#define DEFAULT_MASTER_LIMITER_CEILING  -0.3
+#define DEFAULT_MASTER_LIMITER_RELEASE  100
+
 /* Factor by which the filter is oversampled.  Increase for richer
    harmonics and more stability at high resonance.  Decrease to save
    CPU cycles or for thinner harmonics.  6x oversampling seems to
@@ -215,6 +241,7 @@ typedef float sample_t;
 #define USER_MIDIMAP_DUMP_FILE          "midimapdump"
 #define USER_SESSION_DUMP_DIR           "_autosave_"
 #define USER_CONFIG_FILE                "phasex.cfg"
+#define USER_PATCH_CACHE_FILE           "patchcache"
 #define SYS_DEFAULT_PATCH               "phasex-default.phx"
 
 /* Default knob image directories. */
@@ -266,8 +293,13 @@ typedef float sample_t;
 /* Phase of MIDI period for synchronizing audio buffer processing period starts. */
 #define DEFAULT_AUDIO_PHASE_LOCK        0.9375
 
-/* max number of samples to use in the 8 period ringbuffer. */
-/* must be a power of 2, and must handle at least 8 periods of >= 1024 */
+/* MIDI clock DLL loop bandwidth, in Hz. */
+#define DEFAULT_MIDI_CLOCK_BANDWIDTH    1.0
+#define MIN_MIDI_CLOCK_BANDWIDTH        0.05
+#define MAX_MIDI_CLOCK_BANDWIDTH        10.0
+
+/* max number of samples to use in the part output / input ringbuffers. */
+/* the ring holds buffer_periods periods of any size, up to this capacity. */
 #define PHASEX_MAX_BUFSIZE              16384   /* up to 8 periods of 2048 */
 #define DEFAULT_BUFFER_PERIOD_SIZE      256
 #define DEFAULT_BUFFER_PERIODS          8
@@ -340,6 +372,23 @@ typedef float sample_t;
 #define LFO_VELOCITY                    NUM_LFOS
 #define MOD_VELOCITY                    NUM_OSCS
 
+/* per-part smoothed parameter slots */
+#define SMOOTH_GAIN_LEFT                0
+#define SMOOTH_GAIN_RIGHT               1
+#define SMOOTH_STEREO_WIDTH             2
+#define SMOOTH_CHORUS_DRY               3
+#define SMOOTH_CHORUS_WET               4
+#define SMOOTH_DELAY_DRY                5
+#define SMOOTH_DELAY_WET                6
+#define SMOOTH_INPUT_BOOST              7
+#define SMOOTH_LFO_VOICE_AM             8
+#define SMOOTH_LFO_CUTOFF               9
+#define SMOOTH_LFO_FM                   10  /* one per lfo */
+#define SMOOTH_OSC_AM_LFO               (SMOOTH_LFO_FM + NUM_LFOS)          /* one per osc */
+#define SMOOTH_OSC_FREQ_LFO             (SMOOTH_OSC_AM_LFO + NUM_OSCS)      /* one per osc */
+#define SMOOTH_OSC_PHASE_LFO            (SMOOTH_OSC_FREQ_LFO + NUM_OSCS)    /* one per osc */
+#define NUM_SMOOTH_PARAMS               (SMOOTH_OSC_PHASE_LFO + NUM_OSCS)
+
 /* modulator types */
 #define MOD_TYPE_OSC                    0
 #define MOD_TYPE_OSC_LATCH              1
@@ -354,6 +403,9 @@ typedef float sample_t;
 #define SAMPLE_RATE_UNDERSAMPLE         1
 #define SAMPLE_RATE_OVERSAMPLE          2
 
+/* Per part oversampling factor for oscillators and filter: 1, 2, or 4 */
+#define MAX_PART_OVERSAMPLE             4
+
 /* Update NUM_WAVEFORMS after adding new waveforms */
 #define NUM_WAVEFORMS                   28
 
@@ -363,6 +415,15 @@ typedef float sample_t;
 #define CHORUS_MAX                      8192
 #define CHORUS_MASK                     (CHORUS_MAX - 1)
 
+/* Delay read position and gains are updated once every control block.
+   Length changes glide by this fraction of the difference per block. */
+#define DELAY_CONTROL_SAMPLES           32
+#define DELAY_GLIDE_COEF                0.0625
+
+/* Chorus reads four taps, with LFOs updated once every control block. */
+#define CHORUS_TAPS                     4
+#define CHORUS_CONTROL_SAMPLES          32
+
 /* Even-multiple octaves work best. */
 /* Must be able to handle patch transpose + part transpose + pitchbend + fm */
 #define FREQ_SHIFT_HALFSTEPS            384
@@ -414,6 +475,7 @@ typedef float sample_t;
 # define MATH_LOG(x) logf(x)
 # define MATH_SQRT(x) sqrtf(x)
 # define MATH_FLOOR(x) floorf(x)
+# define MATH_FMOD(x, y) fmodf(x, y)
 # define MATH_ATAN2(x) atan2f(x)
 #endif
 #ifdef MATH_64_BIT
@@ -427,6 +489,7 @@ typedef float sample_t;
 # define MATH_LOG(x) log(x)
 # define MATH_SQRT(x) sqrt(x)
 # define MATH_FLOOR(x) floor(x)
+# define MATH_FMOD(x, y) fmod(x, y)
 # define MATH_ATAN2(x) atan2(x)
 #endif
 
@@ -465,6 +528,7 @@ extern char user_patchdump_file[MAX_PARTS][PATH_MAX];
 extern char user_session_dump_dir[PATH_MAX];
 extern char user_midimap_dump_file[PATH_MAX];
 extern char user_config_file[PATH_MAX];
+extern char user_patch_cache_file[PATH_MAX];
 extern char user_default_patch[PATH_MAX];
 extern char sys_default_patch[PATH_MAX];
 extern char sys_bank_file[PATH_MAX];
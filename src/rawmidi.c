@@ -36,7 +36,9 @@
 #include "midi_process.h"
 #include "engine.h"
 #include "driver.h"
+#include "midimap.h"
 #include "debug.h"
+#include "trace.h"
 
 
 RAWMIDI_INFO            *rawmidi_info;
@@ -914,14 +916,12 @@ rawmidi_read_byte(void)
 void *
 rawmidi_thread(void *UNUSED(arg))
 {
-	PART                *part;
 	MIDI_EVENT          midi_event;
 	MIDI_EVENT          *out_event      = &midi_event;
 	timecalc_t          delta_nsec;
 	struct timespec     now;
 	struct sched_param  schedparam;
 	pthread_t           thread_id;
-	unsigned int        part_num;
 	int                 running_status;
 	unsigned int        cycle_frame     = 0;
 	unsigned char       type            = MIDI_EVENT_NO_EVENT;
@@ -938,6 +938,8 @@ rawmidi_thread(void *UNUSED(arg))
 	schedparam.sched_priority = setting_midi_priority;
 	pthread_setschedparam(thread_id, setting_sched_policy, &schedparam);
 
+	trace_thread_init("raw midi");
+
 	/* setup thread cleanup handler */
 	pthread_cleanup_push(&rawmidi_cleanup, NULL);
 
@@ -1007,12 +1009,8 @@ rawmidi_thread(void *UNUSED(arg))
 				             DEBUG_COLOR_CYAN "[%d] " DEBUG_COLOR_DEFAULT,
 				             (index / buffer_period_size));
 				/* queue for all parts that want it. */
-				for (part_num = 0; part_num < MAX_PARTS; part_num++) {
-					part = get_part(part_num);
-					if ((channel == part->midi_channel) || (part->midi_channel == 16)) {
-						queue_midi_event(part_num, out_event, cycle_frame, index);
-					}
-				}
+				queue_midi_event_parts(get_midi_route(out_event), out_event,
+				                       cycle_frame, index);
 			}
 			/* handle system and realtime messages */
 			else {
@@ -42,6 +42,7 @@
 #include "gui_main.h"
 #include "gui_patch.h"
 #include "string_util.h"
+#include "autosave.h"
 #include "debug.h"
 
 
@@ -128,6 +129,7 @@ init_session_bank(char *filename)
 		patch = set_active_patch(0, part_num, 0);
 		init_patch_state(patch);
 	}
+	build_midi_route();
 
 	/* load the session_bank for all parts */
 	load_session_bank(filename);
@@ -182,9 +184,11 @@ load_session(char *directory, unsigned int sess_num, int managed)
 					PHASEX_ERROR("patch != active_patch !!!!!!!!!!!!!!!\n");
 				}
 				init_patch_state(patch);
+#ifndef PHASEX_LV2
 				if (gtkui_ready && (part_num == visible_part_num)) {
 					update_gui_patch(patch, 0);
 				}
+#endif /* !PHASEX_LV2 */
 			}
 			return_code = 0;
 		}
@@ -204,7 +208,9 @@ load_session(char *directory, unsigned int sess_num, int managed)
 			sprintf(filename, "Untitled-%04d", sess_num);
 			session->name = strdup(filename);
 		}
+#ifndef PHASEX_LV2
 		update_gui_session_name();
+#endif /* !PHASEX_LV2 */
 
 		/* keep track of session container directory list */
 		strncpy(filename, directory, PATH_MAX);
@@ -492,7 +498,9 @@ save_session(char *directory, unsigned int sess_num, int managed)
 			tmpdir = dirname(filename);
 			session->parent_dir = strdup(tmpdir);
 			if (sess_num == visible_sess_num) {
+#ifndef PHASEX_LV2
 				update_gui_session_name();
+#endif /* !PHASEX_LV2 */
 			}
 			else {
 				new_session = get_session(sess_num);
@@ -550,6 +558,7 @@ save_session_bank(char *filename)
 	SESSION         *session;
 	FILE            *session_bank_f;
 	char            *session_bank_file;
+	char            tmpname[PATH_MAX];
 	unsigned int    sess_num;
 
 	if (filename == NULL) {
@@ -560,7 +569,7 @@ save_session_bank(char *filename)
 	}
 
 	/* open the session_bank file */
-	if ((session_bank_f = fopen(session_bank_file, "wt")) == NULL) {
+	if ((session_bank_f = atomic_fopen(session_bank_file, tmpname, sizeof(tmpname))) == NULL) {
 		PHASEX_ERROR("Error opening session bank file %s for write: %s\n",
 		             session_bank_file, strerror(errno));
 		return;
@@ -581,7 +590,7 @@ save_session_bank(char *filename)
 	}
 
 	/* done saving */
-	fclose(session_bank_f);
+	atomic_fclose(session_bank_f, tmpname, session_bank_file);
 }
 
 
@@ -73,6 +73,7 @@
 #include "driver.h"
 #include "string_util.h"
 #include "midimap.h"
+#include "autosave.h"
 #include "debug.h"
 
 
@@ -95,12 +96,17 @@ char                    *setting_generic_midi_device        = NULL;
 char                    *setting_alsa_raw_midi_device       = NULL;
 char                    *setting_alsa_seq_port              = NULL;
 int                     setting_ignore_midi_program_change  = 0;
+int                     setting_midi_thru                   = 0;
+int                     setting_midi_param_echo             = 0;
+int                     setting_midi_note_out               = 0;
 timecalc_t              setting_audio_phase_lock            = DEFAULT_AUDIO_PHASE_LOCK;
+timecalc_t              setting_midi_clock_bandwidth        = DEFAULT_MIDI_CLOCK_BANDWIDTH;
 timecalc_t              setting_clock_constant              = 1.0;
 
 /* Audio settings */
 int                     setting_audio_driver;
 unsigned int            setting_buffer_latency              = DEFAULT_LATENCY_PERIODS;
+unsigned int            setting_buffer_periods              = DEFAULT_BUFFER_PERIODS;
 
 /* ALSA PCM settings */
 char                    *setting_alsa_pcm_device            = NULL;
@@ -124,12 +130,29 @@ double                  setting_harmonic_steps              = 12.0;
 int                     setting_sample_rate_mode            = SAMPLE_RATE_NORMAL;
 int                     setting_bank_mem_mode               = BANK_MEM_WARN;
 int                     setting_polyphony                   = DEFAULT_POLYPHONY;
+int                     setting_program_fade_time           = DEFAULT_PROGRAM_FADE_TIME;
+int                     setting_param_smooth_time           = DEFAULT_PARAM_SMOOTH_TIME;
+int                     setting_voice_steal_policy          = VOICE_STEAL_RELEASED;
+int                     setting_voice_steal_same_key        = 0;
+int                     setting_voice_steal_fade_time       = DEFAULT_VOICE_STEAL_FADE_TIME;
+int                     setting_voice_budget                = 0;
+int                     setting_dsp_load_limit              = DEFAULT_DSP_LOAD_LIMIT;
+int                     setting_part_voice_min[MAX_PARTS];
+int                     setting_part_voice_max[MAX_PARTS];
+int                     setting_part_oversample[MAX_PARTS];
+int                     setting_part_fx_send[MAX_PARTS];
+int                     setting_fx_bus_part                 = DEFAULT_FX_BUS_PART;
+int                     setting_master_limiter              = 0;
+sample_t                setting_master_limiter_ceiling      = DEFAULT_MASTER_LIMITER_CEILING;
+int                     setting_master_limiter_release      = DEFAULT_MASTER_LIMITER_RELEASE;
+int                     setting_master_dc_block             = 0;
 
 /* Interface settings */
 int                     setting_fullscreen                  = 0;
 int                     setting_maximize                    = 0;
 int                     setting_window_layout               = LAYOUT_ONE_PAGE;
 int                     setting_refresh_interval            = DEFAULT_REFRESH_INTERVAL;
+int                     setting_autosave_interval           = DEFAULT_AUTOSAVE_INTERVAL;
 int                     setting_knob_size                   = KNOB_SIZE_28x28;
 
 /* System settings */
@@ -171,6 +194,8 @@ GtkWidget               *jack_midi_button                   = NULL;
 GtkWidget               *enable_input_button                = NULL;
 GtkWidget               *audio_status_label                 = NULL;
 GtkObject               *audio_phase_lock_adj               = NULL;
+GtkObject               *midi_clock_bandwidth_adj           = NULL;
+GtkWidget               *midi_clock_stats_label             = NULL;
 
 /* Internal font descriptions, based on settings */
 PangoFontDescription    *phasex_font_desc                   = NULL;
@@ -181,6 +206,27 @@ PangoFontDescription    *numeric_font_desc                  = NULL;
 char                    audio_driver_status_msg[256];
 
 /* Strings for gui components */
+char *audio_driver_names[] = {
+	"none",
+	"alsa",
+	"jack",
+	NULL
+};
+
+char *midi_driver_names[] = {
+	"none",
+	"jack",
+	"alsa-seq",
+	"alsa-raw",
+#ifdef ENABLE_RAWMIDI_GENERIC
+	"generic",
+#endif
+#ifdef ENABLE_RAWMIDI_OSS
+	"oss",
+#endif
+	NULL
+};
+
 char *sample_rate_mode_names[] = {
 	"normal",
 	"undersample",
@@ -195,6 +241,13 @@ char *bank_mode_names[] = {
 	NULL
 };
 
+char *voice_steal_policy_names[] = {
+	"oldest",
+	"released",
+	"quietest",
+	NULL
+};
+
 char *layout_names[] = {
 	"one_page",
 	"notebook",
@@ -234,6 +287,69 @@ char *jack_transport_mode_names[] = {
 };
 
 
+/*****************************************************************************
+ * set_font_desc()
+ *
+ * Replaces a font description with one for the named font.  The plugin
+ * build has no gui to draw with it.
+ *****************************************************************************/
+static void
+set_font_desc(PangoFontDescription **desc, char *font)
+{
+#ifndef PHASEX_LV2
+	if (*desc != NULL) {
+		pango_font_description_free(*desc);
+	}
+	*desc = pango_font_description_from_string(font);
+#else
+	(void) desc;
+	(void) font;
+#endif /* !PHASEX_LV2 */
+}
+
+
+/*****************************************************************************
+ * read_part_list()
+ *
+ * Reads a comma separated list of per-part values, one for each part.
+ *****************************************************************************/
+static void
+read_part_list(char *value, int *list, int max_value)
+{
+	char            *p       = value;
+	unsigned int    part_num = 0;
+
+	while ((*p != '\0') && (part_num < MAX_PARTS)) {
+		list[part_num] = atoi(p);
+		if (list[part_num] < 0) {
+			list[part_num] = 0;
+		}
+		else if (list[part_num] > max_value) {
+			list[part_num] = max_value;
+		}
+		part_num++;
+		if ((p = strchr(p, ',')) == NULL) {
+			break;
+		}
+		p++;
+	}
+}
+
+
+/*****************************************************************************
+ * write_part_list()
+ *****************************************************************************/
+static void
+write_part_list(FILE *config_f, int *list)
+{
+	unsigned int    part_num;
+
+	for (part_num = 0; part_num < MAX_PARTS; part_num++) {
+		fprintf(config_f, "%s%d", ((part_num == 0) ? "" : ","), list[part_num]);
+	}
+}
+
+
 /*****************************************************************************
  * read_settings()
  *****************************************************************************/
@@ -437,10 +553,30 @@ read_settings(char *filename)
 				setting_audio_phase_lock = (timecalc_t) atof(setting_value);
 			}
 
+			else if (strcasecmp(setting_name, "midi_clock_bandwidth") == 0) {
+				setting_midi_clock_bandwidth = (timecalc_t) atof(setting_value);
+				if ((setting_midi_clock_bandwidth < MIN_MIDI_CLOCK_BANDWIDTH) ||
+				    (setting_midi_clock_bandwidth > MAX_MIDI_CLOCK_BANDWIDTH)) {
+					setting_midi_clock_bandwidth = DEFAULT_MIDI_CLOCK_BANDWIDTH;
+				}
+			}
+
 			else if (strcasecmp(setting_name, "ignore_midi_program_change") == 0) {
 				setting_ignore_midi_program_change = get_boolean(setting_value, NULL, 0);
 			}
 
+			else if (strcasecmp(setting_name, "midi_thru") == 0) {
+				setting_midi_thru = get_boolean(setting_value, NULL, 0);
+			}
+
+			else if (strcasecmp(setting_name, "midi_param_echo") == 0) {
+				setting_midi_param_echo = get_boolean(setting_value, NULL, 0);
+			}
+
+			else if (strcasecmp(setting_name, "midi_note_out") == 0) {
+				setting_midi_note_out = get_boolean(setting_value, NULL, 0);
+			}
+
 			else if (strcasecmp(setting_name, "sample_rate") == 0) {
 				setting_sample_rate = atoi(setting_value);
 				switch (setting_sample_rate) {
@@ -516,6 +652,14 @@ read_settings(char *filename)
 				}
 			}
 
+			else if (strcasecmp(setting_name, "buffer_periods") == 0) {
+				setting_buffer_periods = (unsigned int) atoi(setting_value);
+				if ((setting_buffer_periods < MIN_BUFFER_PERIODS) ||
+				    (setting_buffer_periods > MAX_BUFFER_PERIODS)) {
+					setting_buffer_periods = DEFAULT_BUFFER_PERIODS;
+				}
+			}
+
 			else if (strcasecmp(setting_name, "enable_mmap") == 0) {
 				setting_enable_mmap = get_boolean(setting_value, NULL, 0);
 			}
@@ -574,6 +718,16 @@ read_settings(char *filename)
 				}
 			}
 
+			else if (strcasecmp(setting_name, "autosave_interval") == 0) {
+				setting_autosave_interval = atoi(setting_value);
+				if (setting_autosave_interval < 0) {
+					setting_autosave_interval = 0;
+				}
+				else if (setting_autosave_interval > 3600) {
+					setting_autosave_interval = 3600;
+				}
+			}
+
 			else if (strcasecmp(setting_name, "midi_thread_priority") == 0) {
 				setting_midi_priority = atoi(setting_value);
 				prio = sched_get_priority_min(PHASEX_SCHED_POLICY);
@@ -642,6 +796,123 @@ read_settings(char *filename)
 				}
 			}
 
+			else if (strcasecmp(setting_name, "program_fade_time") == 0) {
+				setting_program_fade_time = atoi(setting_value);
+				if (setting_program_fade_time < 0) {
+					setting_program_fade_time = 0;
+				}
+				else if (setting_program_fade_time > MAX_PROGRAM_FADE_TIME) {
+					setting_program_fade_time = MAX_PROGRAM_FADE_TIME;
+				}
+			}
+
+			else if (strcasecmp(setting_name, "param_smooth_time") == 0) {
+				setting_param_smooth_time = atoi(setting_value);
+				if (setting_param_smooth_time < 0) {
+					setting_param_smooth_time = 0;
+				}
+				else if (setting_param_smooth_time > MAX_PARAM_SMOOTH_TIME) {
+					setting_param_smooth_time = MAX_PARAM_SMOOTH_TIME;
+				}
+			}
+
+			else if (strcasecmp(setting_name, "voice_steal_policy") == 0) {
+				if (strcasecmp(setting_value, "oldest") == 0) {
+					setting_voice_steal_policy = VOICE_STEAL_OLDEST;
+				}
+				else if (strcasecmp(setting_value, "quietest") == 0) {
+					setting_voice_steal_policy = VOICE_STEAL_QUIETEST;
+				}
+				else {
+					setting_voice_steal_policy = VOICE_STEAL_RELEASED;
+				}
+			}
+
+			else if (strcasecmp(setting_name, "voice_steal_same_key") == 0) {
+				setting_voice_steal_same_key = get_boolean(setting_value, NULL, 0);
+			}
+
+			else if (strcasecmp(setting_name, "voice_steal_fade_time") == 0) {
+				setting_voice_steal_fade_time = atoi(setting_value);
+				if (setting_voice_steal_fade_time < 0) {
+					setting_voice_steal_fade_time = 0;
+				}
+				else if (setting_voice_steal_fade_time > MAX_VOICE_STEAL_FADE_TIME) {
+					setting_voice_steal_fade_time = MAX_VOICE_STEAL_FADE_TIME;
+				}
+			}
+
+			else if (strcasecmp(setting_name, "voice_budget") == 0) {
+				setting_voice_budget = atoi(setting_value);
+				if (setting_voice_budget < 0) {
+					setting_voice_budget = 0;
+				}
+			}
+
+			else if (strcasecmp(setting_name, "dsp_load_limit") == 0) {
+				setting_dsp_load_limit = atoi(setting_value);
+				if (setting_dsp_load_limit < 0) {
+					setting_dsp_load_limit = 0;
+				}
+				else if (setting_dsp_load_limit > 100) {
+					setting_dsp_load_limit = 100;
+				}
+			}
+
+			else if (strcasecmp(setting_name, "part_voice_min") == 0) {
+				read_part_list(setting_value, setting_part_voice_min, MAX_VOICES);
+			}
+
+			else if (strcasecmp(setting_name, "part_voice_max") == 0) {
+				read_part_list(setting_value, setting_part_voice_max, MAX_VOICES);
+			}
+
+			else if (strcasecmp(setting_name, "part_oversample") == 0) {
+				read_part_list(setting_value, setting_part_oversample, MAX_PART_OVERSAMPLE);
+			}
+
+			else if (strcasecmp(setting_name, "part_fx_send") == 0) {
+				read_part_list(setting_value, setting_part_fx_send, 1);
+			}
+
+			else if (strcasecmp(setting_name, "fx_bus_part") == 0) {
+				setting_fx_bus_part = atoi(setting_value);
+				if (setting_fx_bus_part < 1) {
+					setting_fx_bus_part = 1;
+				}
+				else if (setting_fx_bus_part > MAX_PARTS) {
+					setting_fx_bus_part = MAX_PARTS;
+				}
+			}
+
+			else if (strcasecmp(setting_name, "master_limiter") == 0) {
+				setting_master_limiter = get_boolean(setting_value, NULL, 0);
+			}
+
+			else if (strcasecmp(setting_name, "master_limiter_ceiling") == 0) {
+				setting_master_limiter_ceiling = (sample_t) atof(setting_value);
+				if (setting_master_limiter_ceiling < -24.0) {
+					setting_master_limiter_ceiling = -24.0;
+				}
+				else if (setting_master_limiter_ceiling > 0.0) {
+					setting_master_limiter_ceiling = 0.0;
+				}
+			}
+
+			else if (strcasecmp(setting_name, "master_limiter_release") == 0) {
+				setting_master_limiter_release = atoi(setting_value);
+				if (setting_master_limiter_release < 10) {
+					setting_master_limiter_release = 10;
+				}
+				else if (setting_master_limiter_release > 2000) {
+					setting_master_limiter_release = 2000;
+				}
+			}
+
+			else if (strcasecmp(setting_name, "master_dc_block") == 0) {
+				setting_master_dc_block = get_boolean(setting_value, NULL, 0);
+			}
+
 			else if (strcasecmp(setting_name, "tuning_freq") == 0) {
 				a4freq = atof(setting_value);
 				setting_tuning_freq = (sample_t) a4freq;
@@ -692,10 +963,7 @@ read_settings(char *filename)
 					free(setting_font);
 				}
 				setting_font = strdup(setting_value);
-				if (phasex_font_desc != NULL) {
-					pango_font_description_free(phasex_font_desc);
-				}
-				phasex_font_desc = pango_font_description_from_string(setting_font);
+				set_font_desc(&phasex_font_desc, setting_font);
 			}
 
 			else if ((strcasecmp(setting_name, "title_font") == 0) &&
@@ -704,10 +972,7 @@ read_settings(char *filename)
 					free(setting_title_font);
 				}
 				setting_title_font = strdup(setting_value);
-				if (title_font_desc != NULL) {
-					pango_font_description_free(title_font_desc);
-				}
-				title_font_desc = pango_font_description_from_string(setting_title_font);
+				set_font_desc(&title_font_desc, setting_title_font);
 			}
 
 			else if ((strcasecmp(setting_name, "numeric_font") == 0) &&
@@ -716,10 +981,7 @@ read_settings(char *filename)
 					free(setting_numeric_font);
 				}
 				setting_numeric_font = strdup(setting_value);
-				if (numeric_font_desc != NULL) {
-					pango_font_description_free(numeric_font_desc);
-				}
-				numeric_font_desc = pango_font_description_from_string(setting_numeric_font);
+				set_font_desc(&numeric_font_desc, setting_numeric_font);
 			}
 
 			else if (strcasecmp(setting_name, "knob_size") == 0) {
@@ -801,24 +1063,15 @@ read_settings(char *filename)
 	/* set defaults for fonts if missing */
 	if (setting_font == NULL) {
 		setting_font = strdup(DEFAULT_ALPHA_FONT);
-		if (phasex_font_desc != NULL) {
-			pango_font_description_free(phasex_font_desc);
-		}
-		phasex_font_desc = pango_font_description_from_string(setting_font);
+		set_font_desc(&phasex_font_desc, setting_font);
 	}
 	if (setting_numeric_font == NULL) {
 		setting_numeric_font = strdup(DEFAULT_NUMERIC_FONT);
-		if (numeric_font_desc != NULL) {
-			pango_font_description_free(numeric_font_desc);
-		}
-		numeric_font_desc = pango_font_description_from_string(setting_numeric_font);
+		set_font_desc(&numeric_font_desc, setting_numeric_font);
 	}
 	if (setting_title_font == NULL) {
 		setting_title_font = strdup(DEFAULT_TITLE_FONT);
-		if (title_font_desc != NULL) {
-			pango_font_description_free(title_font_desc);
-		}
-		title_font_desc = pango_font_description_from_string(setting_title_font);
+		set_font_desc(&title_font_desc, setting_title_font);
 	}
 
 	/* set defaults for knobs (if missing) based on theme */
@@ -859,8 +1112,13 @@ read_settings(char *filename)
 int
 save_settings(char *filename)
 {
-	FILE    *config_f;
-	char    *old_config;
+	static pthread_mutex_t  save_mutex  = PTHREAD_MUTEX_INITIALIZER;
+	FILE                    *config_f;
+	char                    *old_config;
+	char                    tmpname[PATH_MAX];
+
+	/* gui and audio driver threads both save settings */
+	pthread_mutex_lock(&save_mutex);
 
 	/* use default config file location if no filename is supplied. */
 	if (config_file == NULL) {
@@ -876,6 +1134,7 @@ save_settings(char *filename)
 				if (old_config != NULL) {
 					free(old_config);
 				}
+				pthread_mutex_unlock(&save_mutex);
 				return -ENOENT;
 			}
 			config_file = strdup(user_config_file);
@@ -889,11 +1148,12 @@ save_settings(char *filename)
 	}
 
 	/* open the config file */
-	if ((config_f = fopen(config_file, "wt")) == NULL) {
+	if ((config_f = atomic_fopen(config_file, tmpname, sizeof(tmpname))) == NULL) {
 		if (config_file != NULL) {
 			free(config_file);
 		}
 		config_file = old_config;
+		pthread_mutex_unlock(&save_mutex);
 		return -EIO;
 	}
 
@@ -912,6 +1172,7 @@ save_settings(char *filename)
 	fprintf(config_f, "\tenable_mmap\t\t\t= %s;\n",            boolean_names[setting_enable_mmap]);
 	fprintf(config_f, "\tenable_inputs\t\t\t= %s;\n",          boolean_names[setting_enable_inputs]);
 	fprintf(config_f, "\tbuffer_latency\t\t\t= %d;\n",         setting_buffer_latency);
+	fprintf(config_f, "\tbuffer_periods\t\t\t= %d;\n",         setting_buffer_periods);
 	fprintf(config_f, "# MIDI:\n");
 	fprintf(config_f, "\tmidi_driver\t\t\t= %s;\n",            midi_driver_names[setting_midi_driver]);
 	fprintf(config_f, "\talsa_seq_port\t\t\t= \"%s\";\n",      setting_alsa_seq_port);
@@ -923,7 +1184,11 @@ save_settings(char *filename)
 	fprintf(config_f, "\toss_midi_device\t\t\t= \"%s\";\n",    setting_oss_midi_device);
 #endif
 	fprintf(config_f, "\tmidi_audio_phase_lock\t\t= %f;\n",    setting_audio_phase_lock);
+	fprintf(config_f, "\tmidi_clock_bandwidth\t\t= %f;\n",     setting_midi_clock_bandwidth);
 	fprintf(config_f, "\tignore_midi_program_change\t= %s;\n", boolean_names[setting_ignore_midi_program_change]);
+	fprintf(config_f, "\tmidi_thru\t\t\t= %s;\n",              boolean_names[setting_midi_thru]);
+	fprintf(config_f, "\tmidi_param_echo\t\t\t= %s;\n",        boolean_names[setting_midi_param_echo]);
+	fprintf(config_f, "\tmidi_note_out\t\t\t= %s;\n",          boolean_names[setting_midi_note_out]);
 	fprintf(config_f, "\tclock_constant\t\t\t= %.25f;\n",
 	        (float)((timecalc_t) nsec_per_period /
 	                (f_buffer_period_size * (timecalc_t) 1000000000.0 /
@@ -935,6 +1200,30 @@ save_settings(char *filename)
 	fprintf(config_f, "\tharmonic_steps\t\t\t= %f;\n",         setting_harmonic_steps);
 #endif
 	fprintf(config_f, "\tpolyphony\t\t\t= %d;\n",              setting_polyphony);
+	fprintf(config_f, "\tprogram_fade_time\t\t= %d;\n",        setting_program_fade_time);
+	fprintf(config_f, "\tparam_smooth_time\t\t= %d;\n",        setting_param_smooth_time);
+	fprintf(config_f, "\tvoice_steal_policy\t\t= %s;\n",       voice_steal_policy_names[setting_voice_steal_policy]);
+	fprintf(config_f, "\tvoice_steal_same_key\t\t= %s;\n",     boolean_names[setting_voice_steal_same_key]);
+	fprintf(config_f, "\tvoice_steal_fade_time\t\t= %d;\n",    setting_voice_steal_fade_time);
+	fprintf(config_f, "\tvoice_budget\t\t\t= %d;\n",           setting_voice_budget);
+	fprintf(config_f, "\tdsp_load_limit\t\t\t= %d;\n",         setting_dsp_load_limit);
+	fprintf(config_f, "\tpart_voice_min\t\t\t= \"");
+	write_part_list(config_f, setting_part_voice_min);
+	fprintf(config_f, "\";\n");
+	fprintf(config_f, "\tpart_voice_max\t\t\t= \"");
+	write_part_list(config_f, setting_part_voice_max);
+	fprintf(config_f, "\";\n");
+	fprintf(config_f, "\tpart_oversample\t\t\t= \"");
+	write_part_list(config_f, setting_part_oversample);
+	fprintf(config_f, "\";\n");
+	fprintf(config_f, "\tpart_fx_send\t\t\t= \"");
+	write_part_list(config_f, setting_part_fx_send);
+	fprintf(config_f, "\";\n");
+	fprintf(config_f, "\tfx_bus_part\t\t\t= %d;\n",            setting_fx_bus_part);
+	fprintf(config_f, "\tmaster_limiter\t\t\t= %s;\n",         boolean_names[setting_master_limiter]);
+	fprintf(config_f, "\tmaster_limiter_ceiling\t\t= %3.1f;\n",  (float)setting_master_limiter_ceiling);
+	fprintf(config_f, "\tmaster_limiter_release\t\t= %d;\n",     setting_master_limiter_release);
+	fprintf(config_f, "\tmaster_dc_block\t\t\t= %s;\n",        boolean_names[setting_master_dc_block]);
 	fprintf(config_f, "\tsample_rate_mode\t\t= %s;\n",         sample_rate_mode_names[setting_sample_rate_mode]);
 	fprintf(config_f, "\tbank_mem_mode\t\t\t= %s;\n",          bank_mode_names[setting_bank_mem_mode]);
 	fprintf(config_f, "# System:\n");
@@ -949,6 +1238,7 @@ save_settings(char *filename)
 	fprintf(config_f, "\t# warning:  backing store may be broken\n");
 	fprintf(config_f, "\tbacking_store\t\t\t= %s;\n",          boolean_names[setting_backing_store]);
 	fprintf(config_f, "\trefresh_interval\t\t= %d;\n",         setting_refresh_interval);
+	fprintf(config_f, "\tautosave_interval\t\t= %d;\n",        setting_autosave_interval);
 	fprintf(config_f, "# Theme:\n");
 	fprintf(config_f, "\tknob_size\t\t\t= %s;\n",              knob_sizes[setting_knob_size]);
 	fprintf(config_f, "\tknob_dir\t\t\t= %s;\n",               setting_knob_dir);
@@ -965,14 +1255,18 @@ save_settings(char *filename)
 	}
 
 	/* done */
-	fclose(config_f);
+	atomic_fclose(config_f, tmpname, config_file);
 	if (old_config != NULL) {
 		free(old_config);
 	}
+	pthread_mutex_unlock(&save_mutex);
 	return 0;
 }
 
 
+#ifndef PHASEX_LV2
+/* The plugin build has no gui, so the settings dialog and its callbacks
+   are left out of it. */
 /*****************************************************************************
  * set_midi_channel()
  *****************************************************************************/
@@ -1578,20 +1872,91 @@ void
 set_midi_audio_phase_lock(GtkWidget *UNUSED(widget), gpointer data)
 {
 	setting_audio_phase_lock = (timecalc_t) gtk_spin_button_get_value(GTK_SPIN_BUTTON(data));
-	audio_phase_lock = (timecalc_t)(setting_audio_phase_lock * f_buffer_period_size);
-	if (audio_phase_lock > 1.0) {
-		audio_phase_min  = audio_phase_lock - 2.0;
-	}
-	else {
-		audio_phase_min = 0.0;
-	}
-	if (audio_phase_lock < (f_buffer_period_size - 2.0)) {
-		audio_phase_max  = audio_phase_lock + 2.0;
+	set_audio_phase_lock();
+	save_settings(NULL);
+}
+
+
+/*****************************************************************************
+ * set_midi_clock_bandwidth()
+ *****************************************************************************/
+void
+set_midi_clock_bandwidth(GtkWidget *UNUSED(widget), gpointer data)
+{
+	setting_midi_clock_bandwidth = (timecalc_t) gtk_spin_button_get_value(GTK_SPIN_BUTTON(data));
+	set_midi_clock_dll();
+	save_settings(NULL);
+}
+
+
+/*****************************************************************************
+ * update_midi_clock_stats_label()
+ *
+ * Called periodically from the gui main loop while the config dialog is
+ * open.  Histograms are shown as counts per frame of error, from -8 (and
+ * below) to +8 (and above).
+ *****************************************************************************/
+void
+update_midi_clock_stats_label(void)
+{
+	MIDI_CLOCK_STATS    stats;
+	char                jitter_buf[256];
+	char                offset_buf[256];
+	char                msg[1024];
+	int                 jitter_len  = 0;
+	int                 offset_len  = 0;
+	int                 j;
+
+	if (midi_clock_stats_label == NULL) {
+		return;
 	}
-	else {
-		audio_phase_max = (f_buffer_period_size - 2.0);
+
+	get_midi_clock_stats(&stats);
+
+	jitter_buf[0] = '\0';
+	offset_buf[0] = '\0';
+	for (j = 0; j < MIDI_CLOCK_HIST_BINS; j++) {
+		jitter_len += snprintf(jitter_buf + jitter_len,
+		                       sizeof(jitter_buf) - (size_t) jitter_len,
+		                       " %d", stats.jitter_hist[j]);
+		offset_len += snprintf(offset_buf + offset_len,
+		                       sizeof(offset_buf) - (size_t) offset_len,
+		                       " %d", stats.offset_hist[j]);
+		if ((jitter_len >= (int) sizeof(jitter_buf)) ||
+		    (offset_len >= (int) sizeof(offset_buf))) {
+			break;
+		}
 	}
-	save_settings(NULL);
+
+	snprintf(msg, sizeof(msg),
+	         "%s   period=%0.1fus   periods=%d\n"
+	         "relatches=%d   unlocks=%d   clamped events=%d\n"
+	         "max jitter=%0.1fus   max offset=%0.1fus\n"
+	         "jitter:%s\n"
+	         "offset:%s",
+	         (stats.locked ? "Locked" : "Unlocked"),
+	         (double) stats.period_nsec / 1000.0,
+	         stats.periods,
+	         stats.relatches,
+	         stats.unlocks,
+	         stats.timing_clamps,
+	         (double) stats.max_jitter_nsec / 1000.0,
+	         (double) stats.max_offset_nsec / 1000.0,
+	         jitter_buf,
+	         offset_buf);
+
+	gtk_label_set_text(GTK_LABEL(midi_clock_stats_label), msg);
+}
+
+
+/*****************************************************************************
+ * on_midi_clock_stats_reset()
+ *****************************************************************************/
+void
+on_midi_clock_stats_reset(GtkWidget *UNUSED(widget), gpointer UNUSED(data))
+{
+	reset_midi_clock_stats();
+	update_midi_clock_stats_label();
 }
 
 
@@ -2370,6 +2735,7 @@ close_config_dialog(GtkWidget *widget, gpointer data)
 	jack_midi_button            = NULL;
 	enable_input_button         = NULL;
 	audio_status_label          = NULL;
+	midi_clock_stats_label      = NULL;
 }
 
 
@@ -2793,6 +3159,59 @@ create_config_dialog(void)
 	                 GTK_SIGNAL_FUNC(set_midi_audio_phase_lock),
 	                 (gpointer) spin);
 
+	/* MIDI Clock Bandwidth: hbox w/ label + spinbutton */
+	hbox = gtk_hbox_new(TRUE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox), hbox, FALSE, FALSE, 4);
+
+	label = gtk_label_new("MIDI Clock DLL Bandwidth (Hz):");
+	widget_set_custom_font(label, phasex_font_desc);
+	gtk_misc_set_alignment(GTK_MISC(label), 1.0, 0.5);
+	gtk_box_pack_start(GTK_BOX(hbox), label, TRUE, TRUE, 4);
+
+	midi_clock_bandwidth_adj = gtk_adjustment_new(setting_midi_clock_bandwidth,
+	                                              MIN_MIDI_CLOCK_BANDWIDTH,
+	                                              MAX_MIDI_CLOCK_BANDWIDTH,
+	                                              0.05, 0.5, 0.0);
+
+	box = gtk_hbox_new(FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(hbox), box, TRUE, TRUE, 4);
+
+	spin = gtk_spin_button_new(GTK_ADJUSTMENT(midi_clock_bandwidth_adj), 0.05, 2);
+	widget_set_custom_font(spin, numeric_font_desc);
+	gtk_spin_button_set_numeric(GTK_SPIN_BUTTON(spin), TRUE);
+	gtk_spin_button_set_update_policy(GTK_SPIN_BUTTON(spin), GTK_UPDATE_IF_VALID);
+	gtk_spin_button_set_value(GTK_SPIN_BUTTON(spin), setting_midi_clock_bandwidth);
+	gtk_box_pack_start(GTK_BOX(box), spin, FALSE, FALSE, 4);
+
+	g_signal_connect(GTK_OBJECT(midi_clock_bandwidth_adj), "value_changed",
+	                 GTK_SIGNAL_FUNC(set_midi_clock_bandwidth),
+	                 (gpointer) spin);
+
+	/* MIDI Clock Statistics: hbox w/ label + vbox w/ label + button */
+	hbox = gtk_hbox_new(TRUE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox), hbox, FALSE, FALSE, 4);
+
+	label = gtk_label_new("MIDI Clock Statistics:");
+	widget_set_custom_font(label, phasex_font_desc);
+	gtk_misc_set_alignment(GTK_MISC(label), 1.0, 0.0);
+	gtk_box_pack_start(GTK_BOX(hbox), label, TRUE, TRUE, 4);
+
+	box = gtk_vbox_new(FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(hbox), box, TRUE, TRUE, 4);
+
+	midi_clock_stats_label = gtk_label_new("");
+	widget_set_custom_font(midi_clock_stats_label, numeric_font_desc);
+	gtk_misc_set_alignment(GTK_MISC(midi_clock_stats_label), 0.0, 0.5);
+	gtk_box_pack_start(GTK_BOX(box), midi_clock_stats_label, TRUE, TRUE, 4);
+	update_midi_clock_stats_label();
+
+	button1 = gtk_button_new_with_label(" Reset Statistics ");
+	gtk_box_pack_start(GTK_BOX(box), button1, FALSE, FALSE, 4);
+
+	g_signal_connect(G_OBJECT(button1), "clicked",
+	                 GTK_SIGNAL_FUNC(on_midi_clock_stats_reset),
+	                 NULL);
+
 	/* separator */
 	sep = gtk_hseparator_new();
 	gtk_box_pack_start(GTK_BOX(vbox), sep, FALSE, FALSE, 3);
@@ -4710,3 +5129,4 @@ create_config_dialog(void)
 	gtk_notebook_set_current_page(GTK_NOTEBOOK(config_notebook), page_num);
 }
 #endif /* ENABLE_CONFIG_DIALOG */
+#endif /* !PHASEX_LV2 */
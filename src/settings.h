@@ -89,12 +89,17 @@ extern char                         *setting_generic_midi_device;
 extern char                         *setting_alsa_raw_midi_device;
 extern char                         *setting_alsa_seq_port;
 extern int                          setting_ignore_midi_program_change;
+extern int                          setting_midi_thru;
+extern int                          setting_midi_param_echo;
+extern int                          setting_midi_note_out;
 extern timecalc_t                   setting_audio_phase_lock;
+extern timecalc_t                   setting_midi_clock_bandwidth;
 extern timecalc_t                   setting_clock_constant;
 
 /* Audio settings */
 extern int                          setting_audio_driver;
 extern unsigned int                 setting_buffer_latency;
+extern unsigned int                 setting_buffer_periods;
 
 /* ALSA PCM settings */
 extern char                         *setting_alsa_pcm_device;
@@ -116,6 +121,22 @@ extern double                       setting_harmonic_base;
 extern double                       setting_harmonic_steps;
 #endif
 extern int                          setting_polyphony;
+extern int                          setting_program_fade_time;
+extern int                          setting_param_smooth_time;
+extern int                          setting_voice_steal_policy;
+extern int                          setting_voice_steal_same_key;
+extern int                          setting_voice_steal_fade_time;
+extern int                          setting_voice_budget;
+extern int                          setting_dsp_load_limit;
+extern int                          setting_part_voice_min[MAX_PARTS];
+extern int                          setting_part_voice_max[MAX_PARTS];
+extern int                          setting_part_oversample[MAX_PARTS];
+extern int                          setting_part_fx_send[MAX_PARTS];
+extern int                          setting_fx_bus_part;
+extern int                          setting_master_limiter;
+extern sample_t                     setting_master_limiter_ceiling;
+extern int                          setting_master_limiter_release;
+extern int                          setting_master_dc_block;
 extern int                          setting_sample_rate_mode;
 extern int                          setting_bank_mem_mode;
 
@@ -125,6 +146,7 @@ extern int                          setting_backing_store;
 extern int                          setting_window_layout;
 extern int                          setting_knob_size;
 extern int                          setting_refresh_interval;
+extern int                          setting_autosave_interval;
 
 /* System settings */
 extern int                          setting_audio_priority;
@@ -156,6 +178,8 @@ extern GtkWidget                    *jack_midi_button;
 extern GtkWidget                    *enable_input_button;
 extern GtkWidget                    *audio_status_label;
 extern GtkObject                    *audio_phase_lock_adj;
+extern GtkObject                    *midi_clock_bandwidth_adj;
+extern GtkWidget                    *midi_clock_stats_label;
 
 /* Internal font descriptions, based on settings */
 extern PangoFontDescription         *phasex_font_desc;
@@ -166,8 +190,11 @@ extern PangoFontDescription         *numeric_font_desc;
 extern char                         audio_driver_status_msg[256];
 
 /* Strings for gui components */
+extern char                         *audio_driver_names[];
+extern char                         *midi_driver_names[];
 extern char                         *sample_rate_mode_names[];
 extern char                         *bank_mem_mode_names[];
+extern char                         *voice_steal_policy_names[];
 extern char                         *layout_names[];
 extern char                         *theme_names[];
 
@@ -182,6 +209,9 @@ void set_generic_midi_device(GtkWidget *UNUSED(widget), gpointer UNUSED(data));
 void set_alsa_raw_midi_device(GtkWidget *UNUSED(widget), gpointer UNUSED(data));
 void set_alsa_seq_port(GtkWidget *UNUSED(widget), gpointer UNUSED(data));
 void set_midi_audio_phase_lock(GtkWidget *UNUSED(widget), gpointer data);
+void set_midi_clock_bandwidth(GtkWidget *UNUSED(widget), gpointer data);
+void update_midi_clock_stats_label(void);
+void on_midi_clock_stats_reset(GtkWidget *UNUSED(widget), gpointer UNUSED(data));
 void on_restart_midi(GtkWidget *widget, gpointer UNUSED(data));
 
 /* Audio settings */
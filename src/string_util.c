@@ -30,17 +30,19 @@
  * Use in a while loop to split a patch definition line into its tokens.
  * Whitespace always delimits a token.  The special tokens '{', '}', '=', and
  * ';' are always tokenized, regardless of leading or trailing whitespace.
+ * Tokenizer state is kept per thread, so that the bank thread can parse
+ * patch files while the gui thread parses others.
  *****************************************************************************/
 char *
 get_next_token(char *inbuf)
 {
-	unsigned int    len;
-	int             in_quote        = 0;
-	static int      eob             = 1;
-	char            *token_begin;
-	static char     *t_index          = NULL;
-	static char     *last_inbuf     = NULL;
-	static char     token_buf[256];
+	unsigned int        len;
+	int                 in_quote        = 0;
+	static __thread int eob             = 1;
+	char                *token_begin;
+	static __thread char *t_index       = NULL;
+	static __thread char *last_inbuf    = NULL;
+	static __thread char token_buf[256];
 
 	/* keep us out of trouble */
 	if ((inbuf == NULL) && (last_inbuf == NULL)) {
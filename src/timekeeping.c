@@ -23,9 +23,11 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <ctype.h>
 #include <pthread.h>
 #include <time.h>
+#include <math.h>
 #include <asoundlib.h>
 #include <glib.h>
 #include "phasex.h"
@@ -37,6 +39,7 @@
 #include "settings.h"
 #include "debug.h"
 #include "driver.h"
+#include "trace.h"
 
 
 #if (ARCH_BITS == 32)
@@ -70,12 +73,23 @@ volatile gint               need_increment        = 0;
 volatile gint               last_cycle_frame      = 0;
 
 timecalc_t                  audio_phase_lock      = 252.0;
-timecalc_t                  audio_phase_min       = 1.0;
-timecalc_t                  audio_phase_max       = 255.0;
+
+/* Set for synchronous rendering.  The wall clock is never read, and events
+   generated inside PHASEX land on the first frame of the next block. */
+int                         midi_clock_virtual    = 0;
+
+timecalc_t                  midi_clock_dll_b      = 0.0;
+timecalc_t                  midi_clock_dll_c      = 0.0;
+
+MIDI_CLOCK_STATS            midi_clock_stats;
 
 
 /*****************************************************************************
  * set_audio_phase_lock()
+ *
+ * Sets the target frame within the MIDI period at which the audio thread is
+ * expected to wake up.  The clock DLL steers the MIDI period start so that
+ * audio wakeups land on this frame.
  *****************************************************************************/
 void
 set_audio_phase_lock(void)
@@ -86,17 +100,112 @@ set_audio_phase_lock(void)
 	}
 
 	audio_phase_lock = (timecalc_t)(setting_audio_phase_lock * f_buffer_period_size);
-	if (audio_phase_lock > 2.0) {
-		audio_phase_min  = audio_phase_lock - 2.0;
+}
+
+
+/*****************************************************************************
+ * set_midi_clock_dll()
+ *
+ * Computes the coefficients for the second order delay-locked loop driving
+ * the MIDI clock, using the same loop filter as JACK's DLL:  with
+ * omega = 2 * pi * bandwidth * period, the phase error feeds back into the
+ * period start with b = sqrt(2) * omega and into the period estimate with
+ * c = omega * omega, for a critically damped loop.  Lower bandwidth rejects
+ * more wakeup jitter at the cost of slower settling.
+ *****************************************************************************/
+void
+set_midi_clock_dll(void)
+{
+	timecalc_t      omega;
+
+	if ((setting_midi_clock_bandwidth < MIN_MIDI_CLOCK_BANDWIDTH) ||
+	    (setting_midi_clock_bandwidth > MAX_MIDI_CLOCK_BANDWIDTH)) {
+		setting_midi_clock_bandwidth = DEFAULT_MIDI_CLOCK_BANDWIDTH;
 	}
-	else {
-		audio_phase_min  = 0.0;
+
+	omega = (timecalc_t)(M_PI * 2.0 * setting_midi_clock_bandwidth *
+	                     f_buffer_period_size / f_sample_rate);
+
+	midi_clock_dll_b = (timecalc_t)(M_SQRT2 * omega);
+	midi_clock_dll_c = omega * omega;
+}
+
+
+/*****************************************************************************
+ * get_midi_clock_stats()
+ *
+ * Copies a snapshot of the MIDI clock statistics for display.  Counters are
+ * updated atomically by the audio and MIDI threads, so individual values are
+ * always consistent, but the snapshot as a whole may straddle a period.
+ *****************************************************************************/
+void
+get_midi_clock_stats(MIDI_CLOCK_STATS *stats)
+{
+	int             j;
+
+	stats->locked          = g_atomic_int_get(&(midi_clock_stats.locked));
+	stats->periods         = g_atomic_int_get(&(midi_clock_stats.periods));
+	stats->relatches       = g_atomic_int_get(&(midi_clock_stats.relatches));
+	stats->unlocks         = g_atomic_int_get(&(midi_clock_stats.unlocks));
+	stats->timing_clamps   = g_atomic_int_get(&(midi_clock_stats.timing_clamps));
+	stats->period_nsec     = g_atomic_int_get(&(midi_clock_stats.period_nsec));
+	stats->max_jitter_nsec = g_atomic_int_get(&(midi_clock_stats.max_jitter_nsec));
+	stats->max_offset_nsec = g_atomic_int_get(&(midi_clock_stats.max_offset_nsec));
+	for (j = 0; j < MIDI_CLOCK_HIST_BINS; j++) {
+		stats->jitter_hist[j] = g_atomic_int_get(&(midi_clock_stats.jitter_hist[j]));
+		stats->offset_hist[j] = g_atomic_int_get(&(midi_clock_stats.offset_hist[j]));
+	}
+}
+
+
+/*****************************************************************************
+ * reset_midi_clock_stats()
+ *
+ * Clears counters and histograms.  Lock state and period estimate are live
+ * clock state and are left untouched.
+ *****************************************************************************/
+void
+reset_midi_clock_stats(void)
+{
+	int             j;
+
+	g_atomic_int_set(&(midi_clock_stats.periods),         0);
+	g_atomic_int_set(&(midi_clock_stats.relatches),       0);
+	g_atomic_int_set(&(midi_clock_stats.unlocks),         0);
+	g_atomic_int_set(&(midi_clock_stats.timing_clamps),   0);
+	g_atomic_int_set(&(midi_clock_stats.max_jitter_nsec), 0);
+	g_atomic_int_set(&(midi_clock_stats.max_offset_nsec), 0);
+	for (j = 0; j < MIDI_CLOCK_HIST_BINS; j++) {
+		g_atomic_int_set(&(midi_clock_stats.jitter_hist[j]), 0);
+		g_atomic_int_set(&(midi_clock_stats.offset_hist[j]), 0);
 	}
-	if (audio_phase_lock < (f_buffer_period_size - 2.0)) {
-		audio_phase_max  = audio_phase_lock + 2.0;
+}
+
+
+/*****************************************************************************
+ * midi_clock_stats_add()
+ *
+ * Adds one sample (in nsec) to a histogram and its running maximum.  Only
+ * called from the audio thread, so the max needs no compare and exchange.
+ *****************************************************************************/
+static void
+midi_clock_stats_add(volatile gint *hist, volatile gint *max_nsec, timecalc_t nsec)
+{
+	int             bin;
+	int             abs_nsec;
+
+	bin = (int) floor((nsec / nsec_per_frame) + 0.5) + MIDI_CLOCK_HIST_CENTER;
+	if (bin < 0) {
+		bin = 0;
 	}
-	else {
-		audio_phase_max  = (f_buffer_period_size - 2.0);
+	else if (bin >= MIDI_CLOCK_HIST_BINS) {
+		bin = MIDI_CLOCK_HIST_BINS - 1;
+	}
+	g_atomic_int_inc(&(hist[bin]));
+
+	abs_nsec = (int) fabs(nsec);
+	if (abs_nsec > g_atomic_int_get(max_nsec)) {
+		g_atomic_int_set(max_nsec, abs_nsec);
 	}
 }
 
@@ -136,6 +245,10 @@ start_midi_clock(void)
 	nsec_per_frame   = nsec_per_period / f_buffer_period_size;
 
 	set_audio_phase_lock();
+	set_midi_clock_dll();
+
+	g_atomic_int_set(&(midi_clock_stats.locked), 0);
+	g_atomic_int_set(&(midi_clock_stats.period_nsec), (gint) nsec_per_period);
 
 #ifdef HAVE_CLOCK_GETTIME
 
@@ -220,6 +333,12 @@ get_time_delta(struct timespec *now)
 	int                 c_index;
 #endif
 
+	if (midi_clock_virtual) {
+		now->tv_sec  = 0;
+		now->tv_nsec = 0;
+		return 0.0;
+	}
+
 	if (
 #ifdef HAVE_CLOCK_GETTIME
 	    clock_gettime(midi_clockid, now)
@@ -268,13 +387,12 @@ inc_midi_index(void)
 	if (g_atomic_int_compare_and_exchange(&need_increment, 1, 0)) {
 		do {
 			old_midi_index = (guint) g_atomic_int_get(&midi_index);
-			new_midi_index = (old_midi_index + buffer_period_size) & buffer_size_mask;
+			new_midi_index = buffer_index_add(old_midi_index, buffer_period_size);
 		}
 		while (!g_atomic_int_compare_and_exchange(&midi_index,
 		                                          (gint) old_midi_index,
 		                                          (gint) new_midi_index));
-		PHASEX_DEBUG(DEBUG_CLASS_MIDI_TIMING,
-		             DEBUG_COLOR_ORANGE ": " DEBUG_COLOR_DEFAULT);
+		PHASEX_TRACE(TRACE_MIDI_INDEX, -1, (new_midi_index / buffer_period_size), 0, 0, 0);
 		return new_midi_index;
 	}
 
@@ -287,29 +405,32 @@ inc_midi_index(void)
  *
  * This function sets the midi period time reference to a regular cycle, using
  * the timing of when this function is called as an incoming clock pulse to
- * generate an absolutely steady phase locked time reference for determining
- * the frame position within the audio buffer of incoming MIDI events.  This
- * function is to be called exactly once for every audio buffer period, and
- * can be called at any time within the processing period.  Basically, this is
- * a fancy software PLL with the incoming clock pulse handled by one thread
- * while another thread checks to see when the stable output clock pulse
- * _would_ have fired, times its events, and updates its buffer index
- * accordingly.  Timing jitter of when this function is called is not a
- * problem as long as the average period time remains relatively stable.  We
- * just need to remember that in the absense of xruns, we assume that an audio
- * processing period is never actually late, just later than we expected.  It
- * can only be early (and always less than 1 full period early).
+ * generate a steady phase locked time reference for determining the frame
+ * position within the audio buffer of incoming MIDI events.  This function
+ * is to be called exactly once for every audio buffer period, and can be
+ * called at any time within the processing period.
+ *
+ * The reference is driven by a second order delay-locked loop, as used by
+ * JACK:  the phase error between the actual audio wakeup and the wakeup
+ * expected at audio_phase_lock frames into the MIDI period is filtered into
+ * both the next period start and the period length estimate, with loop
+ * bandwidth set by set_midi_clock_dll().  Wakeups falling outside of
+ * the current MIDI period, or a period estimate drifting too far from
+ * nominal, relatch the clock to the current wakeup.  Lock is reported once
+ * the phase error stays within MIDI_CLOCK_LOCK_FRAMES for
+ * MIDI_CLOCK_LOCK_PERIODS consecutive periods.
  *****************************************************************************/
 void
 set_midi_cycle_time(void)
 {
 	ATOMIC_TIMESTAMP        next_timeref;
-	ATOMIC_TIMESTAMP        timeref;
 	PHASEX_TIMESTAMP        last;
 	timecalc_t              delta_nsec;
-	timecalc_t              avg_period_nsec     = nsec_per_period;
-	static int              cycle_frame;
-	static int              last_cycle_frame;
+	timecalc_t              offset_nsec;
+	timecalc_t              interval_nsec;
+	timecalc_t              nominal_nsec;
+	int                     relatch             = 0;
+	static int              lock_count          = 0;
 #if (ARCH_BITS == 32)
 	int                     c_index;
 #endif
@@ -321,127 +442,109 @@ set_midi_cycle_time(void)
 
 	inc_midi_index();
 
+	/* phase error of this wakeup against the locked phase. */
+	offset_nsec = delta_nsec - (nsec_per_frame * audio_phase_lock);
+
 	/* Delay between start_midi_clock() and first call to this
 	   function is not always determinate, so check for clock init
-	   and set timestamp here. */
+	   and latch the timestamp here. */
 	if (last.nsec == PHASEX_CLOCK_INIT) {
 		PHASEX_DEBUG(DEBUG_CLASS_MIDI_TIMING,
 		             DEBUG_COLOR_YELLOW "!!! Clock Start !!! " DEBUG_COLOR_DEFAULT);
-		/* set initial timeref to match target audio wakeup phase. */
-		delta_nsec = nsec_per_frame * (timecalc_t)(audio_phase_lock);
-#if (ARCH_BITS == 32)
-		midi_clock_time[0].timestamp.sec   = (int) audio_start_time.tv_sec;
-		midi_clock_time[0].timestamp.nsec  = (int) audio_start_time.tv_nsec;
-		midi_clock_time[0].timestamp.nsec -= (int) delta_nsec;
-		g_atomic_int_set(&midi_clock_time_index, 0);
-#endif
-#if (ARCH_BITS == 64)
-		next_timeref.timestamp.sec   = (int) audio_start_time.tv_sec;
-		next_timeref.timestamp.nsec  = (int) audio_start_time.tv_nsec;
-		next_timeref.timestamp.nsec -= (int)(delta_nsec);
-		g_atomic_pointer_set(& (midi_timeref.gptr), next_timeref.gptr);
-#endif
+		relatch = 1;
 	}
-
-	/* handle the normal case. */
 	else {
-		avg_period_nsec  -= (avg_period_nsec / 2048.0);
-		/* handle system clock wrapping around. */
-		if ((audio_start_time.tv_sec == 0) && (last.sec != 0)) {
-			avg_period_nsec += ((timecalc_t)(1000000000 +
-			                                 audio_start_time.tv_nsec -
-			                                 last.nsec) / 2048.0);
+		interval_nsec = (((timecalc_t)(audio_start_time.tv_sec - last.sec) * 1000000000.0) +
+		                 (timecalc_t)(audio_start_time.tv_nsec - last.nsec));
+		midi_clock_stats_add(midi_clock_stats.jitter_hist,
+		                     & (midi_clock_stats.max_jitter_nsec),
+		                     (interval_nsec - nsec_per_period));
+		midi_clock_stats_add(midi_clock_stats.offset_hist,
+		                     & (midi_clock_stats.max_offset_nsec),
+		                     offset_nsec);
+		g_atomic_int_inc(&(midi_clock_stats.periods));
+
+		/* Audio woke up before the calculated midi period start
+		   (allowing for the common single frame early wakeup),
+		   or after the calculated midi period end. */
+		if ((delta_nsec < (nsec_per_frame + nsec_per_frame)) ||
+		    (delta_nsec >= (nsec_per_period + nsec_per_frame))) {
+			relatch = 1;
 		}
-		else {
-			avg_period_nsec += ((timecalc_t)(((audio_start_time.tv_sec -
-			                                   last.sec) * 1000000000) +
-			                                 (audio_start_time.tv_nsec -
-			                                  last.nsec)) / 2048.0);
+	}
+
+	if (relatch) {
+		/* set timeref so this wakeup lands exactly on the lock phase. */
+		next_timeref.timestamp.sec   = (int) audio_start_time.tv_sec;
+		next_timeref.timestamp.nsec  = (int) audio_start_time.tv_nsec;
+		next_timeref.timestamp.nsec -= (int)(nsec_per_frame * audio_phase_lock);
+		if (last.nsec != PHASEX_CLOCK_INIT) {
+			g_atomic_int_inc(&(midi_clock_stats.relatches));
 		}
-		nsec_per_period = avg_period_nsec;
-		nsec_per_frame  = (nsec_per_period / f_buffer_period_size);
+		g_atomic_int_set(&(midi_clock_stats.locked), 0);
+		lock_count = 0;
 	}
+	else {
 #if (ARCH_BITS == 32)
-	c_index = g_atomic_int_get(&midi_clock_time_index);
-	timeref.timestamp.sec   = midi_clock_time[c_index].timestamp.sec;
-	timeref.timestamp.nsec  = midi_clock_time[c_index].timestamp.nsec;
-	next_timeref.timestamp.sec  = timeref.timestamp.sec;
-	next_timeref.timestamp.nsec = timeref.timestamp.nsec;
+		c_index = g_atomic_int_get(&midi_clock_time_index);
+		next_timeref.timestamp.sec  = midi_clock_time[c_index].timestamp.sec;
+		next_timeref.timestamp.nsec = midi_clock_time[c_index].timestamp.nsec;
 #endif
 #if (ARCH_BITS == 64)
-	timeref.gptr      = g_atomic_pointer_get(& (midi_timeref.gptr));
-	next_timeref.gptr = timeref.gptr;
+		next_timeref.gptr = g_atomic_pointer_get(& (midi_timeref.gptr));
 #endif
-	last_cycle_frame = cycle_frame;
-	cycle_frame = (int)(delta_nsec / nsec_per_frame);
-	/* Latch the clock when audio wakes up before the calculated
-	   midi period start. coming in one frame too early is
-	   unfortunately common with non-rt kernels or missing
-	   realtime priveleges.  allow for an extra 2 frames. */
-	if (delta_nsec < (nsec_per_frame + nsec_per_frame)) {
-		next_timeref.timestamp.sec  = (int) audio_start_time.tv_sec;
-		next_timeref.timestamp.nsec = (int) audio_start_time.tv_nsec;
-		next_timeref.timestamp.nsec -= ((int)(nsec_per_period -
-		                                      (nsec_per_frame * (f_buffer_period_size -
-		                                                         audio_phase_lock))));
-		/* Nudge nsec_per_period in the right direction to
-		   speed up clock settling time. */
-		nsec_per_period -= (0.015625 * nsec_per_frame);
-		PHASEX_DEBUG(DEBUG_CLASS_MIDI_TIMING,
-		             DEBUG_COLOR_YELLOW "---|||%d||| " DEBUG_COLOR_DEFAULT,
-		             cycle_frame);
-	}
-	/* Half frame jitter correction for audio waking up too early,
-	   but within the current midi period. */
-	else if (delta_nsec < (nsec_per_frame * audio_phase_min)) {
-		next_timeref.timestamp.nsec -= ((int)(nsec_per_frame * 0.5));
-		PHASEX_DEBUG(DEBUG_CLASS_MIDI_TIMING,
-		             DEBUG_COLOR_CYAN "-<<" DEBUG_COLOR_LTBLUE "%d"
-		             DEBUG_COLOR_CYAN "<< " DEBUG_COLOR_DEFAULT,
-		             cycle_frame);
-	}
-	/* This condition is reached when the phase is locked. */
-	else if (delta_nsec < (nsec_per_frame * audio_phase_max)) {
-		PHASEX_DEBUG(DEBUG_CLASS_MIDI_TIMING,
-		             DEBUG_COLOR_LTBLUE "%d " DEBUG_COLOR_DEFAULT,
-		             cycle_frame);
-	}
-	/* Half frame jitter correction for audio waking up too late,
-	   but within the current midi period. coming in one frame too
-	   early is unfortunately common with non-rt kernels or
-	   missing realtime priveleges.  Allow for an extra frame as
-	   well as single isolated late wakeups. */
-	else if ((delta_nsec < (nsec_per_period + nsec_per_frame)) &&
-	         (last_cycle_frame < f_buffer_period_size)) {
-		next_timeref.timestamp.nsec += ((int)(nsec_per_frame * 0.5));
-		PHASEX_DEBUG(DEBUG_CLASS_MIDI_TIMING,
-		             DEBUG_COLOR_CYAN "+>>" DEBUG_COLOR_LTBLUE "%d"
-		             DEBUG_COLOR_CYAN ">> " DEBUG_COLOR_DEFAULT,
-		             cycle_frame);
+		/* DLL: steer period start and period length by phase error. */
+		next_timeref.timestamp.nsec += (int)(midi_clock_dll_b * offset_nsec);
+		nsec_per_period += midi_clock_dll_c * offset_nsec;
+
+		/* lock detection. */
+		if (fabs(offset_nsec) < (nsec_per_frame * MIDI_CLOCK_LOCK_FRAMES)) {
+			if (lock_count < MIDI_CLOCK_LOCK_PERIODS) {
+				lock_count++;
+				if (lock_count == MIDI_CLOCK_LOCK_PERIODS) {
+					g_atomic_int_set(&(midi_clock_stats.locked), 1);
+				}
+			}
+		}
+		else {
+			if (lock_count == MIDI_CLOCK_LOCK_PERIODS) {
+				g_atomic_int_inc(&(midi_clock_stats.unlocks));
+				g_atomic_int_set(&(midi_clock_stats.locked), 0);
+			}
+			lock_count = 0;
+		}
 	}
-	/* Latch the clock when audio wakes up after the calculated
-	   midi period end. */
-	else {
-		next_timeref.timestamp.nsec += (int)(delta_nsec - (nsec_per_frame * audio_phase_lock));
-		/* Nudge nsec_per_period in the right direction to
-		   speed up clock settling time. */
-		nsec_per_period += (0.015625 * nsec_per_frame);
+
+	PHASEX_TRACE(TRACE_MIDI_CLOCK, -1, (delta_nsec / nsec_per_frame), offset_nsec,
+	             g_atomic_int_get(&(midi_clock_stats.locked)), relatch);
+
+	/* keep the period estimate sane, or start over from nominal. */
+	nominal_nsec = f_buffer_period_size * 1000000000.0 / f_sample_rate;
+	if (fabs(nsec_per_period - nominal_nsec) > (nominal_nsec * MIDI_CLOCK_MAX_DRIFT)) {
 		PHASEX_DEBUG(DEBUG_CLASS_MIDI_TIMING,
-		             DEBUG_COLOR_YELLOW "+++|||%d||| " DEBUG_COLOR_DEFAULT,
-		             cycle_frame);
+		             DEBUG_COLOR_YELLOW "!!! Clock Drift !!! " DEBUG_COLOR_DEFAULT);
+		nsec_per_period = nominal_nsec;
+		if (g_atomic_int_get(&(midi_clock_stats.locked))) {
+			g_atomic_int_inc(&(midi_clock_stats.unlocks));
+			g_atomic_int_set(&(midi_clock_stats.locked), 0);
+		}
+		lock_count = 0;
 	}
+	nsec_per_frame  = (nsec_per_period / f_buffer_period_size);
+	g_atomic_int_set(&(midi_clock_stats.period_nsec), (gint) nsec_per_period);
+
 	/* Advance the timeref by one period */
 	next_timeref.timestamp.nsec += (int)(nsec_per_period);
-	if (next_timeref.timestamp.nsec >= 1000000000) {
+	while (next_timeref.timestamp.nsec >= 1000000000) {
 		next_timeref.timestamp.nsec -= 1000000000;
 		next_timeref.timestamp.sec  = (next_timeref.timestamp.sec + 1);
 	}
-	else if (next_timeref.timestamp.nsec < 0) {
+	while (next_timeref.timestamp.nsec < 0) {
 		next_timeref.timestamp.nsec += 1000000000;
 		next_timeref.timestamp.sec  = (next_timeref.timestamp.sec - 1);
 	}
 #if (ARCH_BITS == 32)
-	c_index = (c_index + 1) & 0x7;
+	c_index = (g_atomic_int_get(&midi_clock_time_index) + 1) & 0x7;
 	midi_clock_time[c_index].timestamp.sec  = next_timeref.timestamp.sec;
 	midi_clock_time[c_index].timestamp.nsec = next_timeref.timestamp.nsec;
 	g_atomic_int_add(&need_increment, 1);
@@ -465,34 +568,19 @@ get_midi_cycle_frame(timecalc_t delta_nsec)
 {
 	int         cycle_frame = 0;
 
+	if (midi_clock_virtual) {
+		return 0;
+	}
+
 	if (delta_nsec >= 0.0) {
 		inc_midi_index();
 		cycle_frame = (int)(((delta_nsec * f_buffer_period_size) -
 		                     (nsec_per_frame)) / (nsec_per_period + nsec_per_frame));
-		if (cycle_frame <= 1) {
-			PHASEX_DEBUG(DEBUG_CLASS_MIDI_TIMING,
-			             DEBUG_COLOR_YELLOW "-(%d)- " DEBUG_COLOR_DEFAULT,
-			             cycle_frame);
-		}
-		else {
-			PHASEX_DEBUG(DEBUG_CLASS_MIDI_TIMING,
-			             DEBUG_COLOR_CYAN "-(%d)- " DEBUG_COLOR_DEFAULT,
-			             cycle_frame);
-		}
 	}
 	else {
 		cycle_frame = (int) buffer_period_size + (int)(delta_nsec / nsec_per_frame);
-		if (cycle_frame >= (int)(buffer_period_size - 1)) {
-			PHASEX_DEBUG(DEBUG_CLASS_MIDI_TIMING,
-			             DEBUG_COLOR_YELLOW "={%d}= " DEBUG_COLOR_DEFAULT,
-			             cycle_frame);
-		}
-		else {
-			PHASEX_DEBUG(DEBUG_CLASS_MIDI_TIMING,
-			             DEBUG_COLOR_CYAN "={%d}= " DEBUG_COLOR_DEFAULT,
-			             cycle_frame);
-		}
 	}
+	PHASEX_TRACE(TRACE_MIDI_FRAME, -1, cycle_frame, (delta_nsec / 1000.0), 0, 0);
 
 	/* calculated frame position is beyond current period. */
 	if (cycle_frame < 0) {
@@ -500,11 +588,66 @@ get_midi_cycle_frame(timecalc_t delta_nsec)
 	}
 	if (cycle_frame >= (int) buffer_period_size) {
 		cycle_frame = (int) buffer_period_size - 1;
+		g_atomic_int_inc(&(midi_clock_stats.timing_clamps));
 	}
 	return (unsigned int) cycle_frame;
 }
 
 
+/*****************************************************************************
+ * get_midi_cycle_frames()
+ *
+ * Batch version of get_midi_cycle_frame() for drivers that timestamp their
+ * own events.  Takes the age of each event in nsec (time elapsed between the
+ * event timestamp and now) and fills in frame positions for the whole batch
+ * from a single clock read and midi index update.  Returns the midi index
+ * for the batch.  Events older than the current period land on its first
+ * frame.
+ *****************************************************************************/
+unsigned int
+get_midi_cycle_frames(timecalc_t *age_nsec, unsigned int *cycle_frame, int num_events)
+{
+	struct timespec     now;
+	timecalc_t          now_delta   = get_time_delta(&now);
+	timecalc_t          delta_nsec;
+	int                 frame;
+	int                 j;
+
+	if (midi_clock_virtual) {
+		memset(cycle_frame, 0, (size_t) num_events * sizeof(unsigned int));
+		return get_midi_index();
+	}
+
+	if (now_delta >= 0.0) {
+		inc_midi_index();
+	}
+
+	for (j = 0; j < num_events; j++) {
+		delta_nsec = now_delta - age_nsec[j];
+		if (now_delta >= 0.0) {
+			if (delta_nsec < 0.0) {
+				delta_nsec = 0.0;
+			}
+			frame = (int)(((delta_nsec * f_buffer_period_size) -
+			               (nsec_per_frame)) / (nsec_per_period + nsec_per_frame));
+		}
+		else {
+			frame = (int) buffer_period_size + (int)(delta_nsec / nsec_per_frame);
+		}
+		if (frame < 0) {
+			frame = 0;
+		}
+		else if (frame >= (int) buffer_period_size) {
+			frame = (int) buffer_period_size - 1;
+			g_atomic_int_inc(&(midi_clock_stats.timing_clamps));
+		}
+		cycle_frame[j] = (unsigned int) frame;
+	}
+
+	return get_midi_index();
+}
+
+
 /*****************************************************************************
  * set_active_sensing_timeout()
  *
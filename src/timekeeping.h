@@ -29,6 +29,20 @@
 
 #define PHASEX_CLOCK_INIT           1111111111
 
+/* MIDI clock DLL lock detection: phase error window (in frames) and the
+   number of consecutive periods inside the window needed to report lock. */
+#define MIDI_CLOCK_LOCK_FRAMES      2.0
+#define MIDI_CLOCK_LOCK_PERIODS     16
+
+/* MIDI clock DLL period estimate may not stray further than this fraction
+   from the nominal period before the clock is relatched. */
+#define MIDI_CLOCK_MAX_DRIFT        0.01
+
+/* jitter / offset histograms: one bin per frame, centered on zero, with
+   the outermost bins collecting everything beyond. */
+#define MIDI_CLOCK_HIST_BINS        17
+#define MIDI_CLOCK_HIST_CENTER      8
+
 
 #if (ARCH_BITS == 32)
 
@@ -81,6 +95,21 @@ extern volatile ATOMIC_TIMESTAMP    active_sensing_timeout;
 
 #endif /* (ARCH_BITS == 64) */
 
+
+typedef struct midi_clock_stats {
+	volatile gint               locked;         /* DLL phase locked flag */
+	volatile gint               periods;        /* audio periods clocked */
+	volatile gint               relatches;      /* hard clock resets */
+	volatile gint               unlocks;        /* lock lost without relatch */
+	volatile gint               timing_clamps;  /* event frames clamped to period */
+	volatile gint               period_nsec;    /* current period estimate */
+	volatile gint               max_jitter_nsec;
+	volatile gint               max_offset_nsec;
+	volatile gint               jitter_hist[MIDI_CLOCK_HIST_BINS];
+	volatile gint               offset_hist[MIDI_CLOCK_HIST_BINS];
+} MIDI_CLOCK_STATS;
+
+
 extern clockid_t        midi_clockid;
 
 extern timecalc_t       nsec_per_frame;
@@ -90,15 +119,25 @@ extern timecalc_t       f_buffer_period_size;
 extern volatile gint    need_increment;
 
 extern timecalc_t       audio_phase_lock;
-extern timecalc_t       audio_phase_min;
-extern timecalc_t       audio_phase_max;
+
+extern int              midi_clock_virtual;
+
+extern timecalc_t       midi_clock_dll_b;
+extern timecalc_t       midi_clock_dll_c;
+
+extern MIDI_CLOCK_STATS midi_clock_stats;
 
 
+void set_audio_phase_lock(void);
+void set_midi_clock_dll(void);
+void get_midi_clock_stats(MIDI_CLOCK_STATS *stats);
+void reset_midi_clock_stats(void);
 void start_midi_clock(void);
 timecalc_t get_time_delta(struct timespec *now);
 guint inc_midi_index(void);
 void set_midi_cycle_time(void);
 unsigned int get_midi_cycle_frame(timecalc_t delta_nsec);
+unsigned int get_midi_cycle_frames(timecalc_t *age_nsec, unsigned int *cycle_frame, int num_events);
 void set_active_sensing_timeout(void);
 int check_active_sensing_timeout(void);
 
@@ -0,0 +1,303 @@
+/*****************************************************************************
+ *
+ * trace.c
+ *
+ * PHASEX:  [P]hase [H]armonic [A]dvanced [S]ynthesis [EX]periment
+ *
+ * Copyright (C) 2012-2013 William Weston <whw@linuxmail.org>
+ *
+ * PHASEX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PHASEX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PHASEX.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <glib.h>
+#include "phasex.h"
+#include "trace.h"
+#include "debug.h"
+
+
+volatile gint       trace_enabled       = 0;
+
+TRACE_EVENT_INFO    trace_event_list[TRACE_NUM_EVENTS] = {
+	{ "none",           'i', { NULL,      NULL,        NULL,     NULL } },
+	{ "engine_period",  'B', { "index",   "midi_index", NULL,    NULL } },
+	{ "engine_period",  'E', { "busy_us", NULL,        NULL,     NULL } },
+	{ "engine_sleep",   'i', { "kind",    "sleep_us",  NULL,     NULL } },
+	{ "audio_period",   'B', { "index",   "nframes",   NULL,     NULL } },
+	{ "audio_period",   'E', { NULL,      NULL,        NULL,     NULL } },
+	{ "audio_xrun",     'i', { "where",   "result",    NULL,     NULL } },
+	{ "midi_clock",     'C', { "frame",   "offset_ns", "locked", "relatch" } },
+	{ "midi_index",     'i', { "index",   NULL,        NULL,     NULL } },
+	{ "midi_frame",     'i', { "frame",   "delta_us",  NULL,     NULL } },
+	{ "midi_queue",     'i', { "index",   NULL,        NULL,     NULL } },
+	{ "note_on",        'i', { "note",    "velocity",  "voice",  NULL } },
+	{ "note_off",       'i', { "note",    "held",      NULL,     NULL } },
+	{ "controller",     'i', { "cc",      "value",     NULL,     NULL } },
+	{ "param",          'i', { "id",      "value",     NULL,     NULL } }
+};
+
+static TRACE_RING           trace_ring[TRACE_MAX_THREADS];
+static volatile gint        num_trace_rings     = 0;
+static pthread_mutex_t      trace_ring_lock     = PTHREAD_MUTEX_INITIALIZER;
+static __thread TRACE_RING  *thread_trace_ring  = NULL;
+static volatile gint        trace_unattached    = 0;
+
+static FILE                 *trace_file         = NULL;
+static int                  trace_file_records  = 0;
+static int                  trace_ring_named[TRACE_MAX_THREADS];
+
+
+/*****************************************************************************
+ * trace_thread_init()
+ *
+ * Attaches a trace ring to the calling thread.  Rings are looked up by name
+ * first, so that threads restarted along with the audio or engine reuse the
+ * ring left behind by their predecessor.  Takes a lock, so call it once at
+ * thread start (or from a driver's thread init callback), before the thread
+ * does any realtime work.
+ *****************************************************************************/
+void
+trace_thread_init(const char *name)
+{
+	TRACE_RING      *ring   = NULL;
+	int             num_rings;
+	int             j;
+
+	if (thread_trace_ring != NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&trace_ring_lock);
+
+	num_rings = g_atomic_int_get(&num_trace_rings);
+	for (j = 0; j < num_rings; j++) {
+		if (strcmp(trace_ring[j].name, name) == 0) {
+			ring = & (trace_ring[j]);
+			break;
+		}
+	}
+	if ((ring == NULL) && (num_rings < TRACE_MAX_THREADS)) {
+		ring = & (trace_ring[num_rings]);
+		memset(ring, 0, sizeof(TRACE_RING));
+		ring->tid = num_rings + 1;
+		strncpy(ring->name, name, (TRACE_NAME_SIZE - 1));
+		g_atomic_int_set(&num_trace_rings, (num_rings + 1));
+	}
+
+	pthread_mutex_unlock(&trace_ring_lock);
+
+	if (ring == NULL) {
+		PHASEX_WARN("Out of trace rings.  Not tracing thread '%s'.\n", name);
+	}
+	thread_trace_ring = ring;
+}
+
+
+/*****************************************************************************
+ * trace_event()
+ *
+ * Writes a single fixed size record to the calling thread's trace ring.
+ * Never blocks or formats.  When the ring is full, the record is dropped and
+ * counted.  Records from threads that never called trace_thread_init() are
+ * dropped and counted as well.
+ *****************************************************************************/
+void
+trace_event(int event, int part, gint32 a0, gint32 a1, gint32 a2, gint32 a3)
+{
+	TRACE_RING      *ring   = thread_trace_ring;
+	TRACE_RECORD    *rec;
+	struct timespec now;
+	int             w_index;
+
+	if (ring == NULL) {
+		g_atomic_int_inc(&trace_unattached);
+		return;
+	}
+
+	w_index = g_atomic_int_get(&(ring->write_index));
+	if (((w_index + 1) & TRACE_RING_MASK) == g_atomic_int_get(&(ring->read_index))) {
+		g_atomic_int_inc(&(ring->dropped));
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	rec = & (ring->rec[w_index]);
+	rec->time_nsec = ((guint64) now.tv_sec * 1000000000ULL) + (guint64) now.tv_nsec;
+	rec->event     = (guint16) event;
+	rec->part      = (gint16) part;
+	rec->arg[0]    = a0;
+	rec->arg[1]    = a1;
+	rec->arg[2]    = a2;
+	rec->arg[3]    = a3;
+
+	g_atomic_int_set(&(ring->write_index), ((w_index + 1) & TRACE_RING_MASK));
+}
+
+
+/*****************************************************************************
+ * open_trace_file()
+ *
+ * Starts exporting trace records to a Chrome trace event format JSON file
+ * (loadable in chrome://tracing, Perfetto, and similar viewers), and turns
+ * on tracing.  Records are written by the debug thread.
+ *****************************************************************************/
+int
+open_trace_file(const char *filename)
+{
+	int             saved_errno;
+
+	if ((trace_file = fopen(filename, "w")) == NULL) {
+		saved_errno = errno;
+		PHASEX_ERROR("Unable to open trace file '%s':  %s\n",
+		             filename, strerror(saved_errno));
+		return -1;
+	}
+	fprintf(trace_file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	trace_file_records = 0;
+	memset(trace_ring_named, 0, sizeof(trace_ring_named));
+	g_atomic_int_set(&trace_enabled, 1);
+
+	return 0;
+}
+
+
+/*****************************************************************************
+ * close_trace_file()
+ *****************************************************************************/
+void
+close_trace_file(void)
+{
+	if (trace_file != NULL) {
+		trace_drain();
+		fprintf(trace_file, "\n]}\n");
+		fclose(trace_file);
+		trace_file = NULL;
+	}
+}
+
+
+/*****************************************************************************
+ * trace_write_json()
+ *****************************************************************************/
+static void
+trace_write_json(TRACE_RING *ring, TRACE_RECORD *rec)
+{
+	TRACE_EVENT_INFO    *info   = & (trace_event_list[rec->event]);
+	int                 j;
+
+	/* name the thread the first time it shows up in the export. */
+	if (!trace_ring_named[ring->tid - 1]) {
+		trace_ring_named[ring->tid - 1] = 1;
+		fprintf(trace_file,
+		        "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+		        "\"args\":{\"name\":\"%s\"}}",
+		        (trace_file_records++ ? ",\n" : ""), ring->tid, ring->name);
+	}
+
+	fprintf(trace_file,
+	        "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03u,\"pid\":1,\"tid\":%d,",
+	        (trace_file_records++ ? ",\n" : ""),
+	        info->name, info->phase,
+	        (unsigned long long)(rec->time_nsec / 1000),
+	        (unsigned int)(rec->time_nsec % 1000),
+	        ring->tid);
+	if (info->phase == 'i') {
+		fprintf(trace_file, "\"s\":\"t\",");
+	}
+	fprintf(trace_file, "\"args\":{\"part\":%d", rec->part);
+	for (j = 0; j < TRACE_NUM_ARGS; j++) {
+		if (info->arg_name[j] != NULL) {
+			fprintf(trace_file, ",\"%s\":%d", info->arg_name[j], rec->arg[j]);
+		}
+	}
+	fprintf(trace_file, "}}");
+}
+
+
+/*****************************************************************************
+ * trace_write_text()
+ *****************************************************************************/
+static void
+trace_write_text(TRACE_RING *ring, TRACE_RECORD *rec)
+{
+	TRACE_EVENT_INFO    *info   = & (trace_event_list[rec->event]);
+	char                msg[DEBUG_MESSAGE_SIZE];
+	int                 len;
+	int                 j;
+
+	len = snprintf(msg, sizeof(msg), "[%llu.%09llu] %-12s %c %-14s part=%-2d",
+	               (unsigned long long)(rec->time_nsec / 1000000000ULL),
+	               (unsigned long long)(rec->time_nsec % 1000000000ULL),
+	               ring->name, info->phase, info->name, rec->part);
+	for (j = 0; (j < TRACE_NUM_ARGS) && (len < (int) sizeof(msg)); j++) {
+		if (info->arg_name[j] != NULL) {
+			len += snprintf(msg + len, sizeof(msg) - (size_t) len,
+			                "  %s=%d", info->arg_name[j], rec->arg[j]);
+		}
+	}
+	fprintf(stderr, "%s\n", msg);
+}
+
+
+/*****************************************************************************
+ * trace_drain()
+ *
+ * Called from the debug thread to empty all trace rings, formatting records
+ * as text (debug class 'trace') and/or exporting them as JSON.  Records from
+ * different threads are not merged by time; trace viewers sort on load.
+ *****************************************************************************/
+void
+trace_drain(void)
+{
+	TRACE_RING      *ring;
+	TRACE_RECORD    *rec;
+	int             num_rings   = g_atomic_int_get(&num_trace_rings);
+	int             r_index;
+	int             dropped;
+	int             j;
+
+	for (j = 0; j < num_rings; j++) {
+		ring = & (trace_ring[j]);
+		r_index = g_atomic_int_get(&(ring->read_index));
+		while (r_index != g_atomic_int_get(&(ring->write_index))) {
+			rec = & (ring->rec[r_index]);
+			if (rec->event < TRACE_NUM_EVENTS) {
+				if (debug_class & DEBUG_CLASS_TRACE) {
+					trace_write_text(ring, rec);
+				}
+				if (trace_file != NULL) {
+					trace_write_json(ring, rec);
+				}
+			}
+			r_index = (r_index + 1) & TRACE_RING_MASK;
+			g_atomic_int_set(&(ring->read_index), r_index);
+		}
+		if ((dropped = g_atomic_int_get(&(ring->dropped))) > 0) {
+			g_atomic_int_add(&(ring->dropped), -dropped);
+			fprintf(stderr, "Trace ring '%s' full:  %d records dropped.\n",
+			        ring->name, dropped);
+		}
+	}
+	if ((dropped = g_atomic_int_get(&trace_unattached)) > 0) {
+		g_atomic_int_add(&trace_unattached, -dropped);
+		fprintf(stderr, "Trace:  %d records dropped from threads without a trace ring.\n",
+		        dropped);
+	}
+}
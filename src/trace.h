@@ -0,0 +1,107 @@
+/*****************************************************************************
+ *
+ * trace.h
+ *
+ * PHASEX:  [P]hase [H]armonic [A]dvanced [S]ynthesis [EX]periment
+ *
+ * Copyright (C) 2012-2013 William Weston <whw@linuxmail.org>
+ *
+ * PHASEX is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * PHASEX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with PHASEX.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+#ifndef _PHASEX_TRACE_H_
+#define _PHASEX_TRACE_H_
+
+#include <stdio.h>
+#include <glib.h>
+#include "phasex.h"
+
+
+#define TRACE_RING_SIZE             2048
+#define TRACE_RING_MASK             (TRACE_RING_SIZE - 1)
+#define TRACE_MAX_THREADS           (MAX_PARTS + 8)
+#define TRACE_NAME_SIZE             24
+#define TRACE_NUM_ARGS              4
+
+/* trace event ids.  keep in sync with trace_event_list[] in trace.c. */
+#define TRACE_NONE                  0
+#define TRACE_ENGINE_PERIOD_BEGIN   1
+#define TRACE_ENGINE_PERIOD_END     2
+#define TRACE_ENGINE_SLEEP          3
+#define TRACE_AUDIO_PERIOD_BEGIN    4
+#define TRACE_AUDIO_PERIOD_END      5
+#define TRACE_AUDIO_XRUN            6
+#define TRACE_MIDI_CLOCK            7
+#define TRACE_MIDI_INDEX            8
+#define TRACE_MIDI_FRAME            9
+#define TRACE_MIDI_QUEUE            10
+#define TRACE_NOTE_ON               11
+#define TRACE_NOTE_OFF              12
+#define TRACE_CONTROLLER            13
+#define TRACE_PARAM                 14
+#define TRACE_NUM_EVENTS            15
+
+/* kinds of TRACE_ENGINE_SLEEP */
+#define TRACE_SLEEP_CLOCK_START     0
+#define TRACE_SLEEP_EARLY           1
+#define TRACE_SLEEP_ADAPTIVE        2
+#define TRACE_SLEEP_WAIT_CLOCK      3
+
+
+typedef struct trace_record {
+	guint64             time_nsec;
+	guint16             event;
+	gint16              part;
+	gint32              arg[TRACE_NUM_ARGS];
+} TRACE_RECORD;
+
+/* single writer (owning thread), single reader (debug thread) */
+typedef struct trace_ring {
+	TRACE_RECORD        rec[TRACE_RING_SIZE];
+	volatile gint       write_index;
+	volatile gint       read_index;
+	volatile gint       dropped;
+	int                 tid;
+	char                name[TRACE_NAME_SIZE];
+} TRACE_RING;
+
+typedef struct trace_event_info {
+	char                *name;
+	char                phase;          /* chrome trace phase: B, E, i, or C */
+	char                *arg_name[TRACE_NUM_ARGS];
+} TRACE_EVENT_INFO;
+
+
+extern volatile gint    trace_enabled;
+
+extern TRACE_EVENT_INFO trace_event_list[TRACE_NUM_EVENTS];
+
+
+/* Records are only written when tracing is enabled, so the cost of leaving
+   trace points in realtime paths is a single atomic read. */
+#define PHASEX_TRACE(event, part, a0, a1, a2, a3)                       \
+	if (g_atomic_int_get(&trace_enabled)) { \
+		trace_event((event), (part), (gint32)(a0), (gint32)(a1), \
+		            (gint32)(a2), (gint32)(a3)); \
+	}
+
+
+void trace_thread_init(const char *name);
+void trace_event(int event, int part, gint32 a0, gint32 a1, gint32 a2, gint32 a3);
+int open_trace_file(const char *filename);
+void close_trace_file(void);
+void trace_drain(void);
+
+
+#endif /* _PHASEX_TRACE_H_ */
@@ -773,6 +773,61 @@ chorus_hermite(sample_t *buf, sample_t sample_index)
 }
 
 
+/*****************************************************************************
+ * chorus_hermite_taps()
+ *
+ * Read all chorus taps from a pair of mono buffers in one pass.  The
+ * hermite polynomial is folded into four weights per tap, computed once
+ * and shared by both channels.  Weight setup and the weighted sums are
+ * straight loops over the taps, so the compiler can vectorize them.
+ *****************************************************************************/
+void
+chorus_hermite_taps(sample_t *buf_1, sample_t *buf_2, sample_t *sample_index,
+                    sample_t *out_1, sample_t *out_2)
+{
+	sample_t        w0[CHORUS_TAPS];
+	sample_t        w1[CHORUS_TAPS];
+	sample_t        w2[CHORUS_TAPS];
+	sample_t        w3[CHORUS_TAPS];
+	sample_t        mu;
+	sample_t        mu2;
+	sample_t        mu3;
+	sample_t        a1;
+	sample_t        a2;
+	sample_t        index_floor;
+	unsigned int    index_int[CHORUS_TAPS];
+	unsigned int    j;
+
+	/* same curve as chorus_hermite(), with slopes m0 = 0.75 * (y2 - y0)
+	   and m1 = 0.75 * (y3 - y1) expanded into per-sample weights */
+	for (j = 0; j < CHORUS_TAPS; j++) {
+		index_floor  = (sample_t) MATH_FLOOR(sample_index[j]);
+		index_int[j] = ((unsigned int) ((int) index_floor +
+		                                CHORUS_MAX + CHORUS_MAX - 1)) & CHORUS_MASK;
+		mu  = sample_index[j] - index_floor;
+		mu2 = mu * mu;
+		mu3 = mu2 * mu;
+		a1  = (mu3) - (2.0 * mu2) + mu;
+		a2  = (mu3) - (mu2);
+		w0[j] = -0.75 * a1;
+		w1[j] = (2.0 * mu3) - (3.0 * mu2) + 1.0 - (0.75 * a2);
+		w2[j] = (-2.0 * mu3) + (3.0 * mu2) + (0.75 * a1);
+		w3[j] = 0.75 * a2;
+	}
+
+	for (j = 0; j < CHORUS_TAPS; j++) {
+		out_1[j] = ((w0[j] * buf_1[index_int[j]]) +
+		            (w1[j] * buf_1[(index_int[j] + 1) & CHORUS_MASK]) +
+		            (w2[j] * buf_1[(index_int[j] + 2) & CHORUS_MASK]) +
+		            (w3[j] * buf_1[(index_int[j] + 3) & CHORUS_MASK]));
+		out_2[j] = ((w0[j] * buf_2[index_int[j]]) +
+		            (w1[j] * buf_2[(index_int[j] + 1) & CHORUS_MASK]) +
+		            (w2[j] * buf_2[(index_int[j] + 2) & CHORUS_MASK]) +
+		            (w3[j] * buf_2[(index_int[j] + 3) & CHORUS_MASK]));
+	}
+}
+
+
 /*****************************************************************************
  * osc_table_hermite()
  *
@@ -97,6 +97,8 @@ int load_waveform_sample(int wavenum, int num_cycles, double octaves, sample_t s
 sample_t hermite(sample_t *buf, unsigned int max, sample_t sample_index);
 #endif
 sample_t chorus_hermite(sample_t *buf, sample_t sample_index);
+void chorus_hermite_taps(sample_t *buf_1, sample_t *buf_2, sample_t *sample_index,
+                         sample_t *out_1, sample_t *out_2);
 sample_t osc_table_hermite(int wave_num, sample_t sample_index);
 sample_t osc_table_linear(int wave_num, sample_t sample_index);
 